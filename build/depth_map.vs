@@ -1,4 +1,4 @@
-#version 420 core
+#version 460 core
 
 layout (location = 0) in vec3 aPos;
 
@@ -9,10 +9,27 @@ layout (std140, binding = 0) uniform Matrices
 	mat4 dirLightSpaceMatrix;
 	mat4 spotLightSpaceMatrix;
 };
-uniform mat4 modelMatrix;
-uniform mat3 normalMatrix;
+
+// See: DrawData and ExecuteRenderQueue().
+struct DrawData
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix;
+    uint objectId;
+};
+
+layout (std430, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+layout (std430, binding = 2) readonly buffer CommandDraws
+{
+    uint commandDraws[];
+};
+uniform uint u_firstCommand;
 
 void main()
 {
+    mat4 modelMatrix = draws[commandDraws[u_firstCommand + gl_DrawID]].modelMatrix;
     gl_Position = dirLightSpaceMatrix * modelMatrix * vec4(aPos, 1.f);
 }
\ No newline at end of file
@@ -3,11 +3,10 @@
 #extension GL_ARB_gpu_shader_int64 : enable
 #extension GL_ARB_bindless_texture : enable    
 	
+// See: PackedVertex.
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec4 aTangentFrame;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
 
 out vec3 fragPosWS;
 out vec2 texCoords;
@@ -29,10 +28,7 @@ layout (std140, binding = 0) uniform Matrices
 	mat4 spotLightSpaceMatrix;
     mat4 pointShadowMatrices[6];
 };
-uniform mat4 modelMatrix;
-uniform mat3 normalMatrix;
 uniform vec3 cameraPos;
-uniform uint u_objectId;
 
 struct TextureHandle
 {
@@ -42,24 +38,71 @@ struct TextureHandle
     uvec2 aDisplacementHandle;
 };
 
-#define MAX_MESHES_PER_MODEL 100
+#define PI 3.1415926536f
 
-layout (std140, binding = 1) uniform TextureHandles
+// See: DrawData and ExecuteRenderQueue().
+struct DrawData
 {
-	TextureHandle handles[100];
+    mat4 modelMatrix;
+    mat3 normalMatrix;
+    uint objectId;
 };
 
+layout (std430, binding = 0) readonly buffer Materials
+{
+    TextureHandle materials[];
+};
+layout (std430, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+layout (std430, binding = 2) readonly buffer CommandDraws
+{
+    uint commandDraws[];
+};
+uniform uint u_firstCommand;
+
+// NOTE: these mirror OctahedralDecode() and GetOrthonormalBasis() in vertex.h, which pack the tangent frame.
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += (n.x >= 0.f) ? -t : t;
+    n.y += (n.y >= 0.f) ? -t : t;
+    return normalize(n);
+}
+
+// Unpacks the normal, and the tangent from its angle around the normal (see: PackedVertex).
+void DecodeTangentFrame(vec4 frame, out vec3 normal, out vec3 tangent, out float bitangentSign)
+{
+    normal = OctahedralDecode(frame.xy);
+    float zSign = (normal.z >= 0.f) ? 1.f : -1.f;
+    float a = -1.f / (zSign + normal.z);
+    float b = normal.x * normal.y * a;
+    vec3 b1 = vec3(1.f + zSign * normal.x * normal.x * a, zSign * b, -zSign * normal.x);
+    vec3 b2 = vec3(b, zSign + normal.y * normal.y * a, -normal.y);
+    float angle = frame.z * PI;
+    tangent = cos(angle) * b1 + sin(angle) * b2;
+    bitangentSign = frame.w;
+}
+
 void main()
 {
+    DrawData draw = draws[commandDraws[u_firstCommand + gl_DrawID]];
+    mat4 modelMatrix = draw.modelMatrix;
+    mat3 normalMatrix = draw.normalMatrix;
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.f);
     fragPosWS = vec3(modelMatrix * vec4(aPos, 1.f));
     texCoords = aTexCoords;
 	
-	// NOTE: Assimp's aiProcess_CalcTangentSpace produces unit vectors.
-	vec3 tangent = normalize(normalMatrix * aTangent);
-	vec3 norm = normalize(normalMatrix * aNormal);
+	vec3 normal;
+	vec3 tangent;
+	float bitangentSign;
+	DecodeTangentFrame(aTangentFrame, normal, tangent, bitangentSign);
+	tangent = normalize(normalMatrix * tangent);
+	vec3 norm = normalize(normalMatrix * normal);
 	tangent = normalize(tangent - dot(tangent, norm) * norm);
-	// vec3 bitangent = normalize(vec3(modelMatrix * vec4(aBitangent, 0.f)));
+	// NOTE: the bitangent's sign isn't applied (yet), as it never was; mirrored texture coordinates will need it.
 	vec3 bitangent = cross(norm, tangent);
 	tbn = mat3(tangent, bitangent, norm);
 	
@@ -67,12 +110,13 @@ void main()
 	cameraPosTS = invTbn * cameraPos;
 	fragPosTS = invTbn * fragPosWS;
 	
-	diffuseHandle = handles[gl_DrawID].aDiffuseHandle;
-	specularHandle = handles[gl_DrawID].aSpecularHandle;
-	normalsHandle = handles[gl_DrawID].aNormalsHandle;
-	displacementHandle = handles[gl_DrawID].aDisplacementHandle;
+	// NOTE: every draw command carries its material as the base instance (see: UploadMaterials()).
+	diffuseHandle = materials[gl_BaseInstance].aDiffuseHandle;
+	specularHandle = materials[gl_BaseInstance].aSpecularHandle;
+	normalsHandle = materials[gl_BaseInstance].aNormalsHandle;
+	displacementHandle = materials[gl_BaseInstance].aDisplacementHandle;
 	
-	objectId = u_objectId;
+	objectId = draw.objectId;
 	uint facingX = uint(dot(norm, vec3(1, 0, 0)) + 1);
 	uint facingY = uint(dot(norm, vec3(0, 1, 0)) + 1);
 	uint facingZ = uint(dot(norm, vec3(0, 0, 1)) + 1);
@@ -1,11 +1,10 @@
 #version 450 core
 
 // NOTE: make sure this tracks gbuffer.vs.
+// See: PackedVertex.
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec4 aTangentFrame;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
 layout (location = 5) in mat4 aModelMatrix; // Also takes up locations 6, 7 and 8.
 layout (location = 9) in float aRadius;
 layout (location = 10) in float aY;
@@ -31,6 +30,30 @@ uniform float time;
 
 #define PI 3.1415926536f
 
+// NOTE: these mirror OctahedralDecode() and GetOrthonormalBasis() in vertex.h, which pack the tangent frame.
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += (n.x >= 0.f) ? -t : t;
+    n.y += (n.y >= 0.f) ? -t : t;
+    return normalize(n);
+}
+
+// Unpacks the normal, and the tangent from its angle around the normal (see: PackedVertex).
+void DecodeTangentFrame(vec4 frame, out vec3 normal, out vec3 tangent, out float bitangentSign)
+{
+    normal = OctahedralDecode(frame.xy);
+    float zSign = (normal.z >= 0.f) ? 1.f : -1.f;
+    float a = -1.f / (zSign + normal.z);
+    float b = normal.x * normal.y * a;
+    vec3 b1 = vec3(1.f + zSign * normal.x * normal.x * a, zSign * b, -zSign * normal.x);
+    vec3 b2 = vec3(b, zSign + normal.y * normal.y * a, -normal.y);
+    float angle = frame.z * PI;
+    tangent = cos(angle) * b1 + sin(angle) * b2;
+    bitangentSign = frame.w;
+}
+
 void main()
 {
     float angle = (float(gl_InstanceID) * (time / 60.f) / 100000.f) * 2 * PI;
@@ -47,11 +70,14 @@ void main()
     fragPosWS = vec3(modelMatrix * vec4(aPos, 1.f));
     texCoords = aTexCoords;
 	
-	// NOTE: Assimp's aiProcess_CalcTangentSpace produces unit vectors.
-	vec3 tangent = normalize(normalMatrix * aTangent);
-	vec3 norm = normalize(normalMatrix * aNormal);
+	vec3 normal;
+	vec3 tangent;
+	float bitangentSign;
+	DecodeTangentFrame(aTangentFrame, normal, tangent, bitangentSign);
+	tangent = normalize(normalMatrix * tangent);
+	vec3 norm = normalize(normalMatrix * normal);
 	tangent = normalize(tangent - dot(tangent, norm) * norm);
-	// vec3 bitangent = normalize(vec3(modelMatrix * vec4(aBitangent, 0.f)));
+	// NOTE: the bitangent's sign isn't applied (yet), as it never was; mirrored texture coordinates will need it.
 	vec3 bitangent = cross(norm, tangent);
 	tbn = mat3(tangent, bitangent, norm);
 	
@@ -1,10 +1,8 @@
 #version 450 core
 	
+// See: PackedVertex.
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
 
 #define NUM_POINTLIGHTS 4
 
@@ -0,0 +1,41 @@
+#version 460 core
+	
+// See: PackedVertex.
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 texCoords;
+
+layout (std140, binding = 0) uniform Matrices
+{
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+	mat4 dirLightSpaceMatrix;
+	mat4 spotLightSpaceMatrix;
+    mat4 pointShadowMatrices[6];
+};
+
+// See: DrawData and ExecuteRenderQueue().
+struct DrawData
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix;
+    uint objectId;
+};
+
+layout (std430, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+layout (std430, binding = 2) readonly buffer CommandDraws
+{
+    uint commandDraws[];
+};
+uniform uint u_firstCommand;
+
+void main()
+{
+    mat4 modelMatrix = draws[commandDraws[u_firstCommand + gl_DrawID]].modelMatrix;
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.f);
+    texCoords = aTexCoords;
+}
\ No newline at end of file
@@ -1,8 +1,8 @@
-#version 450 core
+#version 460 core
 
+// See: PackedVertex.
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+layout (location = 1) in vec4 aTangentFrame;
 
 out VS_OUT
 {
@@ -17,12 +17,39 @@ layout (std140, binding = 0) uniform Matrices
 	mat4 spotLightSpaceMatrix;
     mat4 pointShadowMatrices[6];
 };
-uniform mat4 modelMatrix;
-uniform mat3 normalMatrix;
+
+// See: DrawData and ExecuteRenderQueue().
+struct DrawData
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix;
+    uint objectId;
+};
+
+layout (std430, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+layout (std430, binding = 2) readonly buffer CommandDraws
+{
+    uint commandDraws[];
+};
+uniform uint u_firstCommand;
+
+// NOTE: mirrors OctahedralDecode() in vertex.h.
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.f);
+    n.x += (n.x >= 0.f) ? -t : t;
+    n.y += (n.y >= 0.f) ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
+    mat4 modelMatrix = draws[commandDraws[u_firstCommand + gl_DrawID]].modelMatrix;
     gl_Position = viewMatrix * modelMatrix * vec4(aPos, 1.f);
 	mat3 viewNormalMatrix = mat3(transpose(inverse(viewMatrix * modelMatrix)));
-	vs_out.vs_Normal = normalize(viewNormalMatrix * aNormal);
+	vs_out.vs_Normal = normalize(viewNormalMatrix * OctahedralDecode(aTangentFrame.xy));
 }
\ No newline at end of file
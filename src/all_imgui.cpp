@@ -2,6 +2,8 @@
 #include "imgui/imgui_demo.cpp"
 #include "imgui/imgui_draw.cpp"
 #include "imgui/imgui_impl_opengl3.cpp"
+#ifdef _WIN32
 #include "imgui/imgui_impl_win32.cpp"
+#endif
 #include "imgui/imgui_tables.cpp"
 #include "imgui/imgui_widgets.cpp"
@@ -2,47 +2,801 @@
 
 #include "common.h"
 
-struct Arena
+#include <atomic>
+#include <stdlib.h> // abort().
+
+/***********************************************************************************************************************
+ *
+ * Arenas reserve their full size as address space up front and only commit pages as the stack pointer grows past
+ * them, so the size passed to AllocArena() is an upper bound rather than what the arena costs.
+ *
+ **********************************************************************************************************************/
+
+// Pages are committed in chunks of this size, which is a multiple of the page size on both platforms (and of the
+// allocation granularity on Windows).
+#define ARENA_COMMIT_GRANULARITY (64 * 1024)
+// ArenaClear() gives the pages above this back to the OS, so that a one-off spike doesn't stay resident.
+#define ARENA_DECOMMIT_THRESHOLD (4 * 1024 * 1024)
+
+#define ARENA_NAME_LENGTH 32
+
+// AllocArena() flags. Huge pages cut TLB misses on arenas which are walked through a lot (scratch memory during model
+// import, the per-frame temp arena), at the cost of committing in larger chunks. Both fall back to regular pages when
+// the OS can't provide them; the arena's backing says what it got.
+//
+// Transparent huge pages (Linux only): the address space is aligned to, and committed in, huge pages, and the kernel
+// is asked to back it with them as it gets touched.
+#define ARENA_FLAG_HUGE_PAGES 0x1
+// Explicit huge pages (MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows): these can't be committed lazily, so the
+// whole arena is committed and pinned up front. Falls back to transparent huge pages, then to regular pages.
+#define ARENA_FLAG_EXPLICIT_HUGE_PAGES 0x2
+
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+enum class ArenaBacking
+{
+    Pages,
+    TransparentHugePages,
+    ExplicitHugePages,
+};
+
+// Tracy memory events can only come from the module which links the Tracy client (see: game.cpp); elsewhere they
+// compile out even when profiling.
+#if defined(TRACY_ENABLE) && defined(ARENA_TRACY_MEMORY)
+#include "tracy/public/tracy/Tracy.hpp"
+#define ArenaTracyAlloc(ptr, size, name) TracyAllocN(ptr, size, name)
+#define ArenaTracyFree(ptr, name) TracyFreeN(ptr, name)
+#define ArenaTracyPlot(name, value) TracyPlot(name, value)
+#else
+#define ArenaTracyAlloc(ptr, size, name)
+#define ArenaTracyFree(ptr, name)
+#define ArenaTracyPlot(name, value)
+#endif
+
+struct Arena;
+struct ConcurrentArena;
+
+//
+// Registry.
+//
+
+// Every live arena, for the memory panel (see: DrawMemoryPanel() in game.cpp). The platform layer owns the registry
+// and hands it to the game code when loading it (see: SetArenaRegistry()), so that both modules' arenas show up.
+struct ArenaRegistry
+{
+    std::atomic<bool> lock; // Guards the lists and numPushesOfFreedArenas.
+    Arena *arenas;
+    ConcurrentArena *concurrentArenas;
+    u64 numPushesOfFreedArenas;
+
+    // Makes AllocArena() ignore the huge page flags, to compare against regular pages (see: cw_bench --huge-pages 0).
+    bool disableHugePages;
+
+    // Reserve, commit, decommit and release calls, see: Platform*Memory().
+    std::atomic<u64> numOsCalls;
+
+    // Per-frame counts, see: EndArenaFrame().
+    u64 lastNumPushes;
+    u64 lastNumOsCalls;
+    u64 framePushes;
+    u64 frameOsCalls;
+    f32 framePushesHistory[FRAME_TIMING_HISTORY];
+    u32 framePushesHistoryIndex;
+};
+
+global_variable ArenaRegistry gDefaultArenaRegistry;
+global_variable ArenaRegistry *gArenaRegistry = &gDefaultArenaRegistry;
+
+internal void LockArenaRegistry(ArenaRegistry *registry)
+{
+    while (registry->lock.exchange(true, std::memory_order_acquire))
+    {
+    }
+}
+
+internal void UnlockArenaRegistry(ArenaRegistry *registry)
+{
+    registry->lock.store(false, std::memory_order_release);
+}
+
+//
+// Platform virtual memory.
+//
+
+internal void *PlatformReserveMemory(u64 size)
+{
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *result = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (result == MAP_FAILED) ? NULL : result;
+#endif
+}
+
+internal bool PlatformCommitMemory(void *address, u64 size)
+{
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+internal void PlatformDecommitMemory(void *address, u64 size)
+{
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    VirtualFree(address, size, MEM_DECOMMIT);
+#else
+    // NOTE: MADV_DONTNEED drops the pages right away (they read back as zero), mprotect() makes any stray access
+    // fault like it would on Windows.
+    madvise(address, size, MADV_DONTNEED);
+    mprotect(address, size, PROT_NONE);
+#endif
+}
+
+internal void PlatformReleaseMemory(void *address, u64 size)
+{
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+    // NOTE: MEM_RELEASE requires a size of zero and releases the whole reservation.
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+
+// Huge pages, see: ARENA_FLAG_HUGE_PAGES. PlatformReserveHugePages() reserves address space backed as requested by the
+// flags, returning the size actually reserved and the backing obtained, or NULL if the OS can't provide any. Explicit
+// huge pages come back fully committed.
+#ifdef _WIN32
+internal bool EnableLockMemoryPrivilege()
+{
+    // NOTE: large pages need SeLockMemoryPrivilege, which the user must have been granted (Local Security Policy >
+    // Lock pages in memory) and which is disabled in the process token until we enable it.
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool result = LookupPrivilegeValueW(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+                  AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+                  GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+    CloseHandle(token);
+    return result;
+}
+
+internal void *PlatformReserveHugePages(u64 size, u32 flags, u64 *reserved, ArenaBacking *backing)
+{
+    // NOTE: Windows has no transparent huge pages, so ARENA_FLAG_HUGE_PAGES alone always gets regular pages.
+    if (!(flags & ARENA_FLAG_EXPLICIT_HUGE_PAGES))
+    {
+        return NULL;
+    }
+    u64 largePageSize = GetLargePageMinimum();
+    if (largePageSize == 0 || !EnableLockMemoryPrivilege())
+    {
+        return NULL;
+    }
+
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+    u64 largeSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+    void *result = VirtualAlloc(NULL, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (result)
+    {
+        *reserved = largeSize;
+        *backing = ArenaBacking::ExplicitHugePages;
+    }
+    return result;
+}
+#else
+internal bool TransparentHugePagesEnabled()
+{
+    // Reads e.g. "always [madvise] never"; madvise() is enough for both "always" and "madvise".
+    FILE *file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+    char mode[64] = {};
+    fgets(mode, sizeof(mode), file);
+    fclose(file);
+    return strstr(mode, "[never]") == NULL;
+}
+
+internal void *PlatformReserveHugePages(u64 size, u32 flags, u64 *reserved, ArenaBacking *backing)
+{
+    u64 hugeSize = (size + ARENA_HUGE_PAGE_SIZE - 1) & ~(u64)(ARENA_HUGE_PAGE_SIZE - 1);
+    if (flags & ARENA_FLAG_EXPLICIT_HUGE_PAGES)
+    {
+        // NOTE: fails unless huge pages have been set aside, e.g. through /proc/sys/vm/nr_hugepages.
+        gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+        void *result = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (result != MAP_FAILED)
+        {
+            *reserved = hugeSize;
+            *backing = ArenaBacking::ExplicitHugePages;
+            return result;
+        }
+    }
+    if (!TransparentHugePagesEnabled())
+    {
+        return NULL;
+    }
+
+    // The kernel only maps huge pages at huge page aligned addresses, which mmap() doesn't guarantee, so we reserve
+    // an extra huge page and trim the misaligned ends.
+    gArenaRegistry->numOsCalls.fetch_add(1, std::memory_order_relaxed);
+    u64 overSize = hugeSize + ARENA_HUGE_PAGE_SIZE;
+    void *mem = mmap(NULL, overSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        return NULL;
+    }
+    u8 *start = (u8 *)mem;
+    u8 *aligned = (u8 *)(((u64)start + ARENA_HUGE_PAGE_SIZE - 1) & ~(u64)(ARENA_HUGE_PAGE_SIZE - 1));
+    if (aligned > start)
+    {
+        munmap(start, aligned - start);
+    }
+    if (start + overSize > aligned + hugeSize)
+    {
+        munmap(aligned + hugeSize, (start + overSize) - (aligned + hugeSize));
+    }
+    if (madvise(aligned, hugeSize, MADV_HUGEPAGE) != 0)
+    {
+        munmap(aligned, hugeSize);
+        return NULL;
+    }
+    *reserved = hugeSize;
+    *backing = ArenaBacking::TransparentHugePages;
+    return aligned;
+}
+#endif
+
+//
+// Arena.
+//
+
+// NOTE: the alignment keeps the memory following the header aligned for SIMD loads.
+struct alignas(64) Arena
 {
     void *memory;
     u64 stackPointer;
-    u64 size;
+    u64 size;      // Usable bytes, reserved up front.
+    u64 committed; // Bytes committed from the start of the reservation, including this header.
+    u64 reserved;  // Bytes reserved, including this header.
+    u64 commitGranularity;
+    ArenaBacking backing;
+
+    // Instrumentation.
+    u64 peak; // Highest stack pointer so far.
+    u64 numPushes;
+    char name[ARENA_NAME_LENGTH]; // Copied, as the arena can outlive the module which named it.
+    const char *tracyName;        // Must stay valid for as long as the arena, ie a string literal.
+    Arena *prev;
+    Arena *next;
 };
 
-internal Arena *AllocArena(u64 size)
+internal u64 AlignUp(u64 value, u64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+internal u64 GetArenaReservedSize(Arena *arena)
+{
+    return arena->reserved;
+}
+
+internal const char *GetArenaBackingName(ArenaBacking backing)
+{
+    switch (backing)
+    {
+    case ArenaBacking::TransparentHugePages:
+        return "huge pages";
+    case ArenaBacking::ExplicitHugePages:
+#ifdef _WIN32
+        return "large pages";
+#else
+        return "huge pages (explicit)";
+#endif
+    default:
+        return "pages";
+    }
+}
+
+// NOTE: running out of arena space is a bug, but carrying on would scribble over whatever is mapped next, so this
+// stops the program in release builds too.
+internal void ArenaFatalError(const char *message, u64 requested, u64 size)
+{
+    DebugPrintA("Arena error: %s (%llu bytes requested, %llu bytes reserved).\n", message,
+                (unsigned long long)requested, (unsigned long long)size);
+    myAssert(false);
+    abort();
+}
+
+// The name must be a string literal, see: Arena::tracyName. For the flags, see: ARENA_FLAG_HUGE_PAGES.
+internal Arena *AllocArena(u64 size, const char *name = "Unnamed arena", u32 flags = 0)
 {
     myAssert(size % sizeof(void *) == 0);
-    size_t allocated = sizeof(Arena) + size;
-    void *mem = VirtualAlloc(NULL, allocated, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    DebugPrintA("AllocArena(), %zu allocated\n", allocated);
+    u64 reserved = 0;
+    ArenaBacking backing = ArenaBacking::Pages;
+    void *mem = NULL;
+    if (flags != 0 && !gArenaRegistry->disableHugePages)
+    {
+        mem = PlatformReserveHugePages(sizeof(Arena) + size, flags, &reserved, &backing);
+    }
+    if (mem == NULL)
+    {
+        reserved = AlignUp(sizeof(Arena) + size, ARENA_COMMIT_GRANULARITY);
+        mem = PlatformReserveMemory(reserved);
+    }
+
+    u64 commitGranularity = ARENA_COMMIT_GRANULARITY;
+    u64 committed = reserved;
+    if (backing == ArenaBacking::TransparentHugePages)
+    {
+        commitGranularity = ARENA_HUGE_PAGE_SIZE;
+    }
+    if (backing != ArenaBacking::ExplicitHugePages)
+    {
+        committed = commitGranularity;
+        if (mem != NULL && !PlatformCommitMemory(mem, committed))
+        {
+            mem = NULL;
+        }
+    }
+    if (mem == NULL)
+    {
+        ArenaFatalError("could not reserve memory", size, size);
+    }
+    DebugPrintA("AllocArena(%s), %llu reserved, %s\n", name, (unsigned long long)reserved,
+                GetArenaBackingName(backing));
     Arena *newArena = (Arena *)mem;
     newArena->memory = (u8 *)mem + sizeof(Arena);
+    newArena->stackPointer = 0;
     newArena->size = size;
+    newArena->committed = committed;
+    newArena->reserved = reserved;
+    newArena->commitGranularity = commitGranularity;
+    newArena->backing = backing;
+    newArena->peak = 0;
+    newArena->numPushes = 0;
+    snprintf(newArena->name, sizeof(newArena->name), "%s", name);
+    newArena->tracyName = name;
+    ArenaTracyAlloc(newArena, newArena->committed, name);
+
+    LockArenaRegistry(gArenaRegistry);
+    newArena->prev = NULL;
+    newArena->next = gArenaRegistry->arenas;
+    if (newArena->next)
+    {
+        newArena->next->prev = newArena;
+    }
+    gArenaRegistry->arenas = newArena;
+    UnlockArenaRegistry(gArenaRegistry);
     return newArena;
 }
 
 internal void FreeArena(Arena *arena)
 {
-    size_t deallocated = sizeof(Arena) + arena->size;
-    VirtualFree(arena, deallocated, MEM_RELEASE);
-    DebugPrintA("FreeArena(), %zu deallocated\n", deallocated);
+    LockArenaRegistry(gArenaRegistry);
+    if (arena->prev)
+    {
+        arena->prev->next = arena->next;
+    }
+    else
+    {
+        gArenaRegistry->arenas = arena->next;
+    }
+    if (arena->next)
+    {
+        arena->next->prev = arena->prev;
+    }
+    gArenaRegistry->numPushesOfFreedArenas += arena->numPushes;
+    UnlockArenaRegistry(gArenaRegistry);
+
+    u64 reserved = GetArenaReservedSize(arena);
+    u64 committed = arena->committed;
+    ArenaTracyFree(arena, arena->tracyName);
+    PlatformReleaseMemory(arena, reserved);
+    DebugPrintA("FreeArena(), %llu released (%llu committed)\n", (unsigned long long)reserved,
+                (unsigned long long)committed);
+}
+
+// Commits or decommits so that the given number of bytes, counted from the start of the reservation, is committed.
+internal void SetArenaCommitted(Arena *arena, u64 newCommitted)
+{
+    if (newCommitted > arena->committed)
+    {
+        if (!PlatformCommitMemory((u8 *)arena + arena->committed, newCommitted - arena->committed))
+        {
+            ArenaFatalError("could not commit memory", arena->stackPointer, arena->size);
+        }
+    }
+    else
+    {
+        PlatformDecommitMemory((u8 *)arena + newCommitted, arena->committed - newCommitted);
+    }
+    ArenaTracyFree(arena, arena->tracyName);
+    ArenaTracyAlloc(arena, newCommitted, arena->tracyName);
+    arena->committed = newCommitted;
 }
 
 internal void *ArenaPush(Arena *arena, u64 size)
 {
+    if (size > arena->size - arena->stackPointer)
+    {
+        ArenaFatalError("out of memory", arena->stackPointer + size, arena->size);
+    }
+
     void *mem = (void *)((u8 *)arena->memory + arena->stackPointer);
     arena->stackPointer += size;
-    myAssert(arena->stackPointer <= arena->size);
+    arena->peak = intMax(arena->peak, arena->stackPointer);
+    arena->numPushes++;
+
+    u64 needed = sizeof(Arena) + arena->stackPointer;
+    if (needed > arena->committed)
+    {
+        SetArenaCommitted(arena, intMin(AlignUp(needed, arena->commitGranularity), GetArenaReservedSize(arena)));
+    }
     return mem;
 }
 
 internal void ArenaPop(Arena *arena, u64 size)
 {
+    myAssert(size <= arena->stackPointer);
     arena->stackPointer -= size;
-    myAssert(arena->stackPointer >= 0);
 }
 
 internal void ArenaClear(Arena *arena)
 {
     arena->stackPointer = 0;
+    // NOTE: explicit huge pages can't be decommitted; the threshold is a multiple of the transparent huge page size.
+    if (arena->backing != ArenaBacking::ExplicitHugePages && arena->committed > ARENA_DECOMMIT_THRESHOLD)
+    {
+        SetArenaCommitted(arena, ARENA_DECOMMIT_THRESHOLD);
+    }
+}
+
+//
+// Typed pushes.
+//
+
+// NOTE: ArenaPush() itself doesn't align, so the stack pointer is padded up to the alignment first.
+internal void *ArenaPushAligned(Arena *arena, u64 size, u64 alignment)
+{
+    u64 alignedStackPointer = AlignUp(arena->stackPointer, alignment);
+    if (alignedStackPointer != arena->stackPointer)
+    {
+        ArenaPush(arena, alignedStackPointer - arena->stackPointer);
+    }
+    return ArenaPush(arena, size);
+}
+
+template <typename T> internal T *PushArray(Arena *arena, u64 count)
+{
+    return (T *)ArenaPushAligned(arena, count * sizeof(T), alignof(T));
+}
+
+template <typename T> internal T *PushStruct(Arena *arena)
+{
+    return PushArray<T>(arena, 1);
+}
+
+//
+// Temporary memory.
+//
+
+// Marks the stack pointer of an arena so that everything pushed after TempBegin() can be popped in one go by
+// TempEnd(). Markers nest like the scopes they are used in.
+struct TempMemory
+{
+    Arena *arena;
+    u64 stackPointer;
+};
+
+internal TempMemory TempBegin(Arena *arena)
+{
+    TempMemory result = {arena, arena->stackPointer};
+    return result;
+}
+
+internal void TempEnd(TempMemory temp)
+{
+    myAssert(temp.arena->stackPointer >= temp.stackPointer);
+    temp.arena->stackPointer = temp.stackPointer;
+}
+
+/***********************************************************************************************************************
+ *
+ * Scratch arenas: every thread lazily gets a couple of arenas for temporary allocations, so that hot paths never have
+ * to go to the OS. Since the pages stay committed between uses, a thread stops making system calls for scratch
+ * memory once it has been through its largest use.
+ *
+ * A function which is handed an arena to push its results into, and which also wants scratch memory, passes that
+ * arena as a conflict: if the caller got it from GetScratch(), the callee's scratch has to come from the other one,
+ * otherwise TempEnd() would pop the results along with the scratch.
+ *
+ **********************************************************************************************************************/
+
+#define NUM_SCRATCH_ARENAS 2
+// Address space only; see: AllocArena().
+#define SCRATCH_ARENA_SIZE (256 * 1024 * 1024)
+
+// Threads which can get scratch memory from a module, see: FreeScratchArenas().
+#define MAX_SCRATCH_THREADS 128
+
+// NOTE: the game DLL and the executable each get their own set, and a reloaded DLL starts over with fresh ones, the
+// platform layer having its old ones freed before unloading it (see: LoadRenderingCode()).
+global_variable thread_local Arena *tScratchArenas[NUM_SCRATCH_ARENAS];
+// Every thread's scratch arenas, in the order they were allocated.
+global_variable Arena *gScratchArenas[MAX_SCRATCH_THREADS * NUM_SCRATCH_ARENAS];
+global_variable std::atomic<u32> gNumScratchArenas;
+
+internal TempMemory GetScratch(Arena **conflicts = NULL, u32 numConflicts = 0)
+{
+    for (u32 i = 0; i < NUM_SCRATCH_ARENAS; i++)
+    {
+        if (tScratchArenas[i] == NULL)
+        {
+            u32 index = gNumScratchArenas.fetch_add(1, std::memory_order_relaxed);
+            if (index >= myArraySize(gScratchArenas))
+            {
+                ArenaFatalError("too many threads use scratch memory", 0, SCRATCH_ARENA_SIZE);
+            }
+            tScratchArenas[i] =
+                AllocArena(SCRATCH_ARENA_SIZE, (i == 0) ? "Scratch 0" : "Scratch 1", ARENA_FLAG_HUGE_PAGES);
+            gScratchArenas[index] = tScratchArenas[i];
+        }
+
+        bool conflicting = false;
+        for (u32 j = 0; j < numConflicts; j++)
+        {
+            if (conflicts[j] == tScratchArenas[i])
+            {
+                conflicting = true;
+                break;
+            }
+        }
+        if (!conflicting)
+        {
+            return TempBegin(tScratchArenas[i]);
+        }
+    }
+
+    ArenaFatalError("every scratch arena is in use by the caller", 0, SCRATCH_ARENA_SIZE);
+    return {};
+}
+
+// Frees the scratch arenas of every thread. Only for a module which is about to be unloaded, once no thread runs its
+// code anymore: the threads' pointers to them are left dangling.
+internal void FreeScratchArenas()
+{
+    u32 count = intMin(gNumScratchArenas.exchange(0, std::memory_order_acquire), (u32)myArraySize(gScratchArenas));
+    for (u32 i = 0; i < count; i++)
+    {
+        FreeArena(gScratchArenas[i]);
+        gScratchArenas[i] = NULL;
+    }
+}
+
+/***********************************************************************************************************************
+ *
+ * Concurrent arena: a bump allocator which any number of threads can push into at once, so that parallel workers can
+ * emit vertices, indices or draw commands into one contiguous buffer which is then uploaded in a single call.
+ *
+ * Pushing is a single atomic fetch-add. Workers which push many small items should go through a
+ * ConcurrentArenaChunk, which claims CONCURRENT_ARENA_CHUNK_SIZE bytes at a time and bumps through them without
+ * touching the shared stack pointer; the tail of a chunk that doesn't fit the next item is left unused.
+ *
+ **********************************************************************************************************************/
+
+#define CONCURRENT_ARENA_CHUNK_SIZE (16 * 1024)
+
+struct ConcurrentArena
+{
+    void *memory;
+    u64 size; // Usable bytes, reserved up front.
+
+    // Pushes race on the stack pointer, so it gets a cache line of its own.
+    alignas(64) std::atomic<u64> stackPointer;
+
+    // Committed bytes from the start of the reservation, including this header. Always a prefix of the reservation:
+    // growing it is rare, and done under the lock.
+    alignas(64) std::atomic<u64> committed;
+    std::atomic<bool> commitLock;
+
+    // Instrumentation, see: Arena.
+    char name[ARENA_NAME_LENGTH];
+    const char *tracyName;
+    ConcurrentArena *prev;
+    ConcurrentArena *next;
+};
+
+// A contiguous block handed out by ConcurrentArenaPush(); the offset is relative to the arena's memory, e.g. to
+// compute a base vertex or the first index of what a worker wrote.
+struct ConcurrentArenaBlock
+{
+    void *memory;
+    u64 offset;
+    u64 size;
+};
+
+// Owned by a single worker.
+struct ConcurrentArenaChunk
+{
+    u8 *cursor;
+    u8 *end;
+};
+
+internal u64 GetConcurrentArenaReservedSize(ConcurrentArena *arena)
+{
+    return AlignUp(sizeof(ConcurrentArena) + arena->size, ARENA_COMMIT_GRANULARITY);
+}
+
+internal ConcurrentArena *AllocConcurrentArena(u64 size, const char *name = "Unnamed concurrent arena")
+{
+    myAssert(size % sizeof(void *) == 0);
+    u64 reserved = AlignUp(sizeof(ConcurrentArena) + size, ARENA_COMMIT_GRANULARITY);
+    void *mem = PlatformReserveMemory(reserved);
+    if (mem == NULL || !PlatformCommitMemory(mem, ARENA_COMMIT_GRANULARITY))
+    {
+        ArenaFatalError("could not reserve memory", size, size);
+    }
+    DebugPrintA("AllocConcurrentArena(%s), %llu reserved\n", name, (unsigned long long)reserved);
+    ConcurrentArena *newArena = (ConcurrentArena *)mem;
+    newArena->memory = (u8 *)mem + sizeof(ConcurrentArena);
+    newArena->size = size;
+    newArena->stackPointer.store(0, std::memory_order_relaxed);
+    newArena->committed.store(ARENA_COMMIT_GRANULARITY, std::memory_order_relaxed);
+    newArena->commitLock.store(false, std::memory_order_relaxed);
+    snprintf(newArena->name, sizeof(newArena->name), "%s", name);
+    newArena->tracyName = name;
+    ArenaTracyAlloc(newArena, ARENA_COMMIT_GRANULARITY, name);
+
+    LockArenaRegistry(gArenaRegistry);
+    newArena->prev = NULL;
+    newArena->next = gArenaRegistry->concurrentArenas;
+    if (newArena->next)
+    {
+        newArena->next->prev = newArena;
+    }
+    gArenaRegistry->concurrentArenas = newArena;
+    UnlockArenaRegistry(gArenaRegistry);
+    return newArena;
+}
+
+internal void FreeConcurrentArena(ConcurrentArena *arena)
+{
+    LockArenaRegistry(gArenaRegistry);
+    if (arena->prev)
+    {
+        arena->prev->next = arena->next;
+    }
+    else
+    {
+        gArenaRegistry->concurrentArenas = arena->next;
+    }
+    if (arena->next)
+    {
+        arena->next->prev = arena->prev;
+    }
+    UnlockArenaRegistry(gArenaRegistry);
+
+    ArenaTracyFree(arena, arena->tracyName);
+    u64 reserved = GetConcurrentArenaReservedSize(arena);
+    PlatformReleaseMemory(arena, reserved);
+    DebugPrintA("FreeConcurrentArena(), %llu released\n", (unsigned long long)reserved);
+}
+
+internal void CommitConcurrentArena(ConcurrentArena *arena, u64 needed)
+{
+    if (needed <= arena->committed.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    while (arena->commitLock.exchange(true, std::memory_order_acquire))
+    {
+        // Another thread is committing, most likely the pages we need too.
+    }
+    u64 committed = arena->committed.load(std::memory_order_relaxed);
+    if (needed > committed)
+    {
+        u64 newCommitted = intMin(AlignUp(needed, ARENA_COMMIT_GRANULARITY), GetConcurrentArenaReservedSize(arena));
+        if (!PlatformCommitMemory((u8 *)arena + committed, newCommitted - committed))
+        {
+            ArenaFatalError("could not commit memory", needed, arena->size);
+        }
+        ArenaTracyFree(arena, arena->tracyName);
+        ArenaTracyAlloc(arena, newCommitted, arena->tracyName);
+        arena->committed.store(newCommitted, std::memory_order_release);
+    }
+    arena->commitLock.store(false, std::memory_order_release);
+}
+
+// Safe to call from any thread.
+internal ConcurrentArenaBlock ConcurrentArenaPush(ConcurrentArena *arena, u64 size)
+{
+    u64 offset = arena->stackPointer.fetch_add(size, std::memory_order_relaxed);
+    if (offset + size > arena->size)
+    {
+        ArenaFatalError("out of memory", offset + size, arena->size);
+    }
+    CommitConcurrentArena(arena, sizeof(ConcurrentArena) + offset + size);
+
+    ConcurrentArenaBlock result = {(u8 *)arena->memory + offset, offset, size};
+    return result;
+}
+
+// Pushes through the worker's chunk, only going to the shared stack pointer when the chunk runs out.
+internal void *ConcurrentArenaPushFromChunk(ConcurrentArena *arena, ConcurrentArenaChunk *chunk, u64 size,
+                                           u64 alignment = 8)
+{
+    u8 *mem = (u8 *)AlignUp((u64)chunk->cursor, alignment);
+    if (chunk->cursor == NULL || mem + size > chunk->end)
+    {
+        ConcurrentArenaBlock block = ConcurrentArenaPush(arena, intMax(size + alignment, CONCURRENT_ARENA_CHUNK_SIZE));
+        chunk->cursor = (u8 *)block.memory;
+        chunk->end = chunk->cursor + block.size;
+        mem = (u8 *)AlignUp((u64)chunk->cursor, alignment);
+    }
+    chunk->cursor = mem + size;
+    return mem;
+}
+
+// Bytes handed out so far, e.g. the size of the upload once every worker is done.
+internal u64 GetConcurrentArenaUsed(ConcurrentArena *arena)
+{
+    return intMin(arena->stackPointer.load(std::memory_order_acquire), arena->size);
+}
+
+// NOTE: not thread safe; every worker must be done with the arena and drop its chunk.
+internal void ConcurrentArenaClear(ConcurrentArena *arena)
+{
+    arena->stackPointer.store(0, std::memory_order_relaxed);
+    u64 committed = arena->committed.load(std::memory_order_relaxed);
+    if (committed > ARENA_DECOMMIT_THRESHOLD)
+    {
+        PlatformDecommitMemory((u8 *)arena + ARENA_DECOMMIT_THRESHOLD, committed - ARENA_DECOMMIT_THRESHOLD);
+        ArenaTracyFree(arena, arena->tracyName);
+        ArenaTracyAlloc(arena, ARENA_DECOMMIT_THRESHOLD, arena->tracyName);
+        arena->committed.store(ARENA_DECOMMIT_THRESHOLD, std::memory_order_relaxed);
+    }
+}
+
+/***********************************************************************************************************************
+ *
+ * Instrumentation.
+ *
+ **********************************************************************************************************************/
+
+// Turns the running totals into per-frame counts; called once per rendered frame. Pushes are counted per arena by
+// their owning thread and only summed here, so that counting doesn't make threads contend on a shared counter.
+internal void EndArenaFrame(ArenaRegistry *registry)
+{
+    LockArenaRegistry(registry);
+    u64 numPushes = registry->numPushesOfFreedArenas;
+    for (Arena *arena = registry->arenas; arena; arena = arena->next)
+    {
+        numPushes += arena->numPushes;
+    }
+    UnlockArenaRegistry(registry);
+    u64 numOsCalls = registry->numOsCalls.load(std::memory_order_relaxed);
+
+    registry->framePushes = numPushes - registry->lastNumPushes;
+    registry->frameOsCalls = numOsCalls - registry->lastNumOsCalls;
+    registry->lastNumPushes = numPushes;
+    registry->lastNumOsCalls = numOsCalls;
+    registry->framePushesHistory[registry->framePushesHistoryIndex] = (f32)registry->framePushes;
+    registry->framePushesHistoryIndex = (registry->framePushesHistoryIndex + 1) % FRAME_TIMING_HISTORY;
+
+    ArenaTracyPlot("Arena pushes per frame", (int64_t)registry->framePushes);
+    ArenaTracyPlot("OS memory calls per frame", (int64_t)registry->frameOsCalls);
 }
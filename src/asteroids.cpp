@@ -8,10 +8,10 @@ internal void SetUpAsteroids(Model *asteroid)
     u32 radiiSize = NUM_ASTEROIDS * sizeof(f32);
     u32 yValuesSize = NUM_ASTEROIDS * sizeof(f32);
 
-    Arena *arena = AllocArena(modelMatricesSize + radiiSize + yValuesSize);
-    glm::mat4 *modelMatrices = (glm::mat4 *)ArenaPush(arena, modelMatricesSize);
-    f32 *radii = (f32 *)ArenaPush(arena, radiiSize);
-    f32 *yValues = (f32 *)ArenaPush(arena, yValuesSize);
+    TempMemory scratch = GetScratch();
+    glm::mat4 *modelMatrices = PushArray<glm::mat4>(scratch.arena, NUM_ASTEROIDS);
+    f32 *radii = PushArray<f32>(scratch.arena, NUM_ASTEROIDS);
+    f32 *yValues = PushArray<f32>(scratch.arena, NUM_ASTEROIDS);
     for (u32 i = 0; i < NUM_ASTEROIDS; i++)
     {
         float radius = CreateRandomNumber(.8f, 1.2f) * 50.f;
@@ -73,5 +73,5 @@ internal void SetUpAsteroids(Model *asteroid)
         glEnableVertexArrayAttrib(curVao, 10);
     }
     */
-    FreeArena(arena);
+    TempEnd(scratch);
 }
\ No newline at end of file
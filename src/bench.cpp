@@ -0,0 +1,561 @@
+#include "arena.h"
+#include "common.h"
+#include "jobs.h"
+#include "telemetry.h"
+
+#include <dlfcn.h>
+
+/***********************************************************************************************************************
+ *
+ * cw_bench: headless Linux platform layer that renders offscreen through a surfaceless EGL context (e.g. on Mesa's
+ * llvmpipe), replays a scripted camera path through the game code's DrawWindow() and reports per-frame CPU time,
+ * GL timer-query time and model triangles drawn as CSV.
+ *
+ * Usage: cw_bench [--frames N] [--warmup N] [--width W] [--height H] [--path camera_path.txt] [--out frames.csv]
+ *                 [--game cwgame.so] [--huge-pages 0|1] [--workers N] [--lod-error pixels] [--meshlet-culling 0|1]
+ *
+ * --lod-error overrides the saved LOD error budget (see: PersistentDrawingInfo::lodErrorPixels), 0 drawing every model
+ * in full detail. --meshlet-culling overrides the saved PersistentDrawingInfo::meshletCulling.
+ *
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ *
+ * Function pointers assigned from the game shared object at load time.
+ *
+ **********************************************************************************************************************/
+
+typedef void (*InitializeTracyGPUContext_t)();
+InitializeTracyGPUContext_t InitializeTracyGPUContext;
+
+typedef void (*SetArenaRegistry_t)(ArenaRegistry *registry);
+SetArenaRegistry_t SetArenaRegistry;
+
+typedef void (*SetJobSystem_t)(JobSystem *system);
+SetJobSystem_t SetJobSystem;
+
+typedef bool (*InitializeImGuiInModule_t)(HWND window);
+InitializeImGuiInModule_t InitializeImGuiInModule;
+
+typedef bool (*InitializeDrawingInfo_t)(HWND window, TransientDrawingInfo *transientInfo,
+                                        PersistentDrawingInfo *drawingInfo, CameraInfo *cameraInfo);
+InitializeDrawingInfo_t InitializeDrawingInfo;
+
+typedef void (*DrawWindow_t)(HWND window, ApplicationState *appState, Arena *listArena, Arena *tempArena);
+DrawWindow_t DrawWindow;
+
+typedef void (*ProvideCameraVectors_t)(CameraInfo *cameraInfo);
+ProvideCameraVectors_t ProvideCameraVectors;
+
+internal bool LoadGameCode(const char *filename)
+{
+    void *gameLib = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+    if (!gameLib)
+    {
+        DebugPrintA("Failed to load game code: %s\n", dlerror());
+        return false;
+    }
+
+    SetArenaRegistry = (SetArenaRegistry_t)dlsym(gameLib, "SetArenaRegistry");
+    SetJobSystem = (SetJobSystem_t)dlsym(gameLib, "SetJobSystem");
+    InitializeTracyGPUContext = (InitializeTracyGPUContext_t)dlsym(gameLib, "InitializeTracyGPUContext");
+    InitializeImGuiInModule = (InitializeImGuiInModule_t)dlsym(gameLib, "InitializeImGuiInModule");
+    InitializeDrawingInfo = (InitializeDrawingInfo_t)dlsym(gameLib, "InitializeDrawingInfo");
+    DrawWindow = (DrawWindow_t)dlsym(gameLib, "DrawWindow");
+    ProvideCameraVectors = (ProvideCameraVectors_t)dlsym(gameLib, "ProvideCameraVectors");
+
+    return SetArenaRegistry && SetJobSystem && InitializeTracyGPUContext && InitializeImGuiInModule &&
+           InitializeDrawingInfo && DrawWindow && ProvideCameraVectors;
+}
+
+/***********************************************************************************************************************
+ *
+ * Surfaceless EGL context.
+ *
+ **********************************************************************************************************************/
+
+// NOTE: we render into a pbuffer rather than using EGL_KHR_surfaceless_context without any surface, since DrawWindow()
+// draws the final post-processed image into the default framebuffer, which must therefore exist.
+internal bool InitializeEGL(LinuxDeviceContext *hdc, s32 width, s32 height)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!eglGetPlatformDisplayEXT)
+    {
+        DebugPrintA("EGL_EXT_platform_base is not supported.\n");
+        return false;
+    }
+
+    EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        DebugPrintA("Failed to initialize surfaceless EGL display.\n");
+        return false;
+    }
+    DebugPrintA("EGL %i.%i, vendor: %s\n", major, minor, eglQueryString(display, EGL_VENDOR));
+
+    EGLint configAttribs[] = {EGL_SURFACE_TYPE,
+                              EGL_PBUFFER_BIT,
+                              EGL_RENDERABLE_TYPE,
+                              EGL_OPENGL_BIT,
+                              EGL_RED_SIZE,
+                              8,
+                              EGL_GREEN_SIZE,
+                              8,
+                              EGL_BLUE_SIZE,
+                              8,
+                              EGL_ALPHA_SIZE,
+                              8,
+                              EGL_DEPTH_SIZE,
+                              24,
+                              EGL_STENCIL_SIZE,
+                              8,
+                              EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+    {
+        DebugPrintA("Failed to choose EGL config.\n");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        DebugPrintA("Failed to bind the OpenGL API.\n");
+        return false;
+    }
+
+    EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                               4,
+                               EGL_CONTEXT_MINOR_VERSION,
+                               6,
+                               EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                               EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef NDEBUG
+                               EGL_CONTEXT_OPENGL_DEBUG,
+                               EGL_TRUE,
+#endif
+                               EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        DebugPrintA("Failed to create OpenGL 4.6 core context.\n");
+        return false;
+    }
+
+    EGLint pbufferAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    if (surface == EGL_NO_SURFACE)
+    {
+        DebugPrintA("Failed to create %ix%i pbuffer surface.\n", width, height);
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        DebugPrintA("Failed to make the OpenGL context current.\n");
+        return false;
+    }
+
+    hdc->display = display;
+    hdc->surface = surface;
+    return true;
+}
+
+void GLAPIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                              const GLchar *message, const void *userParam)
+{
+    if (source == GL_DEBUG_SOURCE_APPLICATION || severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+    {
+        return;
+    }
+    DebugPrintA("%s\n", message);
+    myAssert(type != GL_DEBUG_TYPE_ERROR);
+}
+
+/***********************************************************************************************************************
+ *
+ * Scripted camera path.
+ *
+ **********************************************************************************************************************/
+
+struct CameraKeyframe
+{
+    f32 time;
+    glm::vec3 pos;
+    f32 yaw;
+    f32 pitch;
+};
+
+#define MAX_CAMERA_KEYFRAMES 256
+
+struct CameraPath
+{
+    CameraKeyframe keyframes[MAX_CAMERA_KEYFRAMES];
+    u32 numKeyframes;
+};
+
+// Camera path files contain one keyframe per line as "time x y z yaw pitch", with time in seconds and angles in
+// radians; lines starting with '#' are ignored. Keyframes must be sorted by time.
+internal bool LoadCameraPath(const char *filename, CameraPath *path)
+{
+    FILE *file;
+    if (fopen_s(&file, filename, "r") != 0)
+    {
+        DebugPrintA("Failed to open camera path %s\n", filename);
+        return false;
+    }
+
+    char line[256];
+    path->numKeyframes = 0;
+    while (fgets(line, sizeof(line), file) && path->numKeyframes < MAX_CAMERA_KEYFRAMES)
+    {
+        CameraKeyframe *keyframe = &path->keyframes[path->numKeyframes];
+        if (line[0] != '#' && sscanf(line, "%f %f %f %f %f %f", &keyframe->time, &keyframe->pos.x, &keyframe->pos.y,
+                                     &keyframe->pos.z, &keyframe->yaw, &keyframe->pitch) == 6)
+        {
+            path->numKeyframes++;
+        }
+    }
+    fclose(file);
+
+    return path->numKeyframes > 0;
+}
+
+// Default path: one slow orbit around the origin, looking inwards.
+internal void CreateOrbitCameraPath(CameraPath *path, f32 duration)
+{
+    u32 numKeyframes = 33;
+    f32 radius = 12.f;
+    for (u32 i = 0; i < numKeyframes; i++)
+    {
+        f32 alpha = (f32)i / (numKeyframes - 1);
+        f32 angle = alpha * 2.f * PI;
+        CameraKeyframe *keyframe = &path->keyframes[i];
+        keyframe->time = alpha * duration;
+        keyframe->pos = glm::vec3(radius * sinf(angle), 2.f, radius * cosf(angle));
+        keyframe->yaw = angle;
+        keyframe->pitch = -.15f;
+    }
+    path->numKeyframes = numKeyframes;
+}
+
+internal void SampleCameraPath(CameraPath *path, f32 time, CameraInfo *cameraInfo)
+{
+    CameraKeyframe *keyframes = path->keyframes;
+    u32 last = path->numKeyframes - 1;
+    f32 duration = keyframes[last].time;
+    if (duration > 0.f)
+    {
+        time = fmodf(time, duration);
+    }
+
+    u32 next = 1;
+    while (next < last && keyframes[next].time < time)
+    {
+        next++;
+    }
+    CameraKeyframe *a = &keyframes[intMin(next - 1, last)];
+    CameraKeyframe *b = &keyframes[intMin(next, last)];
+    f32 span = b->time - a->time;
+    f32 alpha = (span > 0.f) ? clamp((time - a->time) / span, 0.f, 1.f) : 0.f;
+
+    cameraInfo->pos = glm::mix(a->pos, b->pos, alpha);
+    cameraInfo->yaw = lerp(a->yaw, b->yaw, alpha);
+    cameraInfo->pitch = lerp(a->pitch, b->pitch, alpha);
+}
+
+/***********************************************************************************************************************
+ *
+ * Entry point.
+ *
+ **********************************************************************************************************************/
+
+struct FrameSample
+{
+    f64 cpuMs;
+    f64 gpuMs;
+    u64 modelTriangles;
+    u32 meshletCommands;
+};
+
+// Timer query results are read back this many frames late so that reading them doesn't stall the pipeline.
+#define QUERY_LATENCY 4
+
+int main(int argc, char **argv)
+{
+    u32 numFrames = 600;
+    u32 numWarmupFrames = 30;
+    s32 width = 1280;
+    s32 height = 720;
+    const char *pathFilename = NULL;
+    const char *outFilename = "cw_bench.csv";
+    const char *gameFilename = "./cwgame.so";
+    u32 numWorkers = intMax(GetNumCores(), 2u) - 1;
+    f32 lodErrorPixels = -1.f; // Negative keeps the saved one.
+    s32 meshletCulling = -1;   // Likewise.
+
+    for (s32 i = 1; i < argc; i += 2)
+    {
+        const char *option = argv[i];
+        if (i + 1 == argc)
+        {
+            DebugPrintA("Missing value for option %s\n", option);
+            return -1;
+        }
+        const char *value = argv[i + 1];
+        if (strcmp(option, "--frames") == 0)
+        {
+            numFrames = (u32)atoi(value);
+        }
+        else if (strcmp(option, "--warmup") == 0)
+        {
+            numWarmupFrames = (u32)atoi(value);
+        }
+        else if (strcmp(option, "--width") == 0)
+        {
+            width = atoi(value);
+        }
+        else if (strcmp(option, "--height") == 0)
+        {
+            height = atoi(value);
+        }
+        else if (strcmp(option, "--path") == 0)
+        {
+            pathFilename = value;
+        }
+        else if (strcmp(option, "--out") == 0)
+        {
+            outFilename = value;
+        }
+        else if (strcmp(option, "--game") == 0)
+        {
+            gameFilename = value;
+        }
+        else if (strcmp(option, "--huge-pages") == 0)
+        {
+            gArenaRegistry->disableHugePages = (atoi(value) == 0);
+        }
+        else if (strcmp(option, "--workers") == 0)
+        {
+            // NOTE: assets stream in on the workers, so there has to be at least one.
+            numWorkers = (u32)intMax(atoi(value), 1);
+        }
+        else if (strcmp(option, "--lod-error") == 0)
+        {
+            lodErrorPixels = fmaxf((f32)atof(value), 0.f);
+        }
+        else if (strcmp(option, "--meshlet-culling") == 0)
+        {
+            meshletCulling = (atoi(value) != 0);
+        }
+        else
+        {
+            DebugPrintA("Unknown option %s\n", option);
+            return -1;
+        }
+    }
+    if (numFrames == 0 || width <= 0 || height <= 0)
+    {
+        DebugPrintA("Invalid frame count or resolution.\n");
+        return -1;
+    }
+
+    LinuxWindow window = {width, height};
+    LinuxDeviceContext hdc = {};
+    if (!InitializeEGL(&hdc, width, height))
+    {
+        return -1;
+    }
+
+    // NOTE: GLEW builds without EGL support report a missing GLX display even though the entry points were loaded.
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && glewStatus != GLEW_ERROR_NO_GLX_DISPLAY)
+    {
+        DebugPrintA("Failed to initialize GLEW.\n");
+        return -1;
+    }
+    DebugPrintA("GL renderer: %s, version: %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    if (!glewIsSupported("GL_ARB_bindless_texture GL_ARB_gpu_shader_int64"))
+    {
+        DebugPrintA("The renderer requires GL_ARB_bindless_texture and GL_ARB_gpu_shader_int64.\n");
+        return -1;
+    }
+
+#ifndef NDEBUG
+    glDebugMessageCallback(&DebugCallback, NULL);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+
+    if (!LoadGameCode(gameFilename))
+    {
+        return -1;
+    }
+    SetArenaRegistry(gArenaRegistry);
+    gJobSystem = StartJobSystem(numWorkers);
+    SetGLJobThread(gJobSystem);
+    SetJobSystem(gJobSystem);
+    InitializeTracyGPUContext();
+    InitializeImGuiInModule(&window);
+
+    // Load the scene.
+    ApplicationState appState = {};
+    TransientDrawingInfo *transientInfo = &appState.transientInfo;
+    PersistentDrawingInfo *persistentInfo = &appState.persistentInfo;
+    CameraInfo *cameraInfo = &appState.cameraInfo;
+    glViewport(0, 0, width, height);
+    u64 loadStart = Win32GetWallClock();
+    appState.telemetry.startTimestamp = loadStart;
+    if (!InitializeDrawingInfo(&window, transientInfo, persistentInfo, cameraInfo))
+    {
+        DebugPrintA("Failed to load the scene.\n");
+        return -1;
+    }
+    DebugPrintA("Scene initialized in %.1f ms\n", (Win32GetWallClock() - loadStart) * Win32GetWallClockPeriod());
+    // NOTE: the saved session may have been recorded at another resolution.
+    cameraInfo->aspectRatio = (f32)width / (f32)height;
+    if (lodErrorPixels >= 0.f)
+    {
+        persistentInfo->lodErrorPixels = lodErrorPixels;
+    }
+    if (meshletCulling >= 0)
+    {
+        persistentInfo->meshletCulling = (meshletCulling != 0);
+    }
+
+    CameraPath *cameraPath = (CameraPath *)calloc(1, sizeof(CameraPath));
+    f32 frameInterval = 1.f / 60.f;
+    if (pathFilename)
+    {
+        if (!LoadCameraPath(pathFilename, cameraPath))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        CreateOrbitCameraPath(cameraPath, numFrames * frameInterval);
+    }
+
+    // Allocate memory arenas used on a per-frame basis.
+    Arena *listArena = AllocArena(2048, "Render list");
+    Arena *tempArena = AllocArena(1920 * 1080 * 32, "Render temp", ARENA_FLAG_HUGE_PAGES);
+    Arena *samplesArena = AllocArena(numFrames * sizeof(FrameSample), "Frame samples");
+    FrameSample *samples = (FrameSample *)ArenaPush(samplesArena, numFrames * sizeof(FrameSample));
+
+    // Render until every asset has streamed in, so that the measured frames all draw the full scene.
+    u32 numStreamingFrames = 0;
+    SampleCameraPath(cameraPath, 0.f, cameraInfo);
+    appState.simulation.current.cameraPos = cameraInfo->pos;
+    appState.simulation.previous = appState.simulation.current;
+    while (appState.telemetry.fullyLoadedMs == 0.f)
+    {
+        ProvideCameraVectors(cameraInfo);
+        RunGLJobs(gJobSystem, JOB_GL_FRAME_BUDGET_MS);
+        DrawWindow(&window, &appState, listArena, tempArena);
+        SwapBuffers(&hdc);
+        if (numStreamingFrames++ == 0)
+        {
+            appState.telemetry.firstFrameMs = Win32GetElapsedMs(loadStart, Win32GetWallClock());
+        }
+    }
+    DebugPrintA("First frame after %.1f ms, fully loaded after %.1f ms (%u frames)\n", appState.telemetry.firstFrameMs,
+                appState.telemetry.fullyLoadedMs, numStreamingFrames);
+
+    u32 timerQueries[QUERY_LATENCY];
+    glCreateQueries(GL_TIME_ELAPSED, QUERY_LATENCY, timerQueries);
+
+    // Replay the camera path; time advances by a fixed interval per frame so that every run renders the same frames.
+    u32 totalFrames = numWarmupFrames + numFrames;
+    appState.running = true;
+    for (u32 frame = 0; frame < totalFrames && appState.running; frame++)
+    {
+        f32 time = (frame >= numWarmupFrames) ? (frame - numWarmupFrames) * frameInterval : 0.f;
+        SampleCameraPath(cameraPath, time, cameraInfo);
+        // The path drives the camera directly rather than through SimulateGame(), so there is nothing to interpolate.
+        appState.simulation.current.cameraPos = cameraInfo->pos;
+        appState.simulation.previous = appState.simulation.current;
+
+        u64 frameStart = Win32GetWallClock();
+        ProvideCameraVectors(cameraInfo);
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[frame % QUERY_LATENCY]);
+        RunGLJobs(gJobSystem, JOB_GL_FRAME_BUDGET_MS);
+        DrawWindow(&window, &appState, listArena, tempArena);
+        glEndQuery(GL_TIME_ELAPSED);
+        u64 swapStart = Win32GetWallClock();
+        SwapBuffers(&hdc);
+        u64 frameEnd = Win32GetWallClock();
+
+        if (frame >= numWarmupFrames)
+        {
+            samples[frame - numWarmupFrames].cpuMs = (f64)(frameEnd - frameStart) * Win32GetWallClockPeriod();
+            samples[frame - numWarmupFrames].modelTriangles = transientInfo->numModelTriangles;
+            samples[frame - numWarmupFrames].meshletCommands = transientInfo->numMeshletCommands;
+            RecordFrameTiming(&appState.telemetry, FrameTimingCategory::Frame, Win32GetElapsedMs(frameStart, frameEnd));
+            RecordFrameTiming(&appState.telemetry, FrameTimingCategory::RenderSubmit,
+                              Win32GetElapsedMs(frameStart, swapStart));
+            RecordFrameTiming(&appState.telemetry, FrameTimingCategory::Swap, Win32GetElapsedMs(swapStart, frameEnd));
+        }
+
+        // Collect the GPU time of the frame issued QUERY_LATENCY - 1 frames ago.
+        s64 queriedFrame = (s64)frame - (QUERY_LATENCY - 1);
+        if (queriedFrame >= (s64)numWarmupFrames)
+        {
+            u64 elapsedNs;
+            glGetQueryObjectui64v(timerQueries[queriedFrame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsedNs);
+            samples[queriedFrame - numWarmupFrames].gpuMs = elapsedNs / 1000000.0;
+        }
+    }
+
+    // Drain the queries still in flight.
+    for (u32 frame = (u32)intMax((s64)totalFrames - (QUERY_LATENCY - 1), (s64)numWarmupFrames); frame < totalFrames;
+         frame++)
+    {
+        u64 elapsedNs;
+        glGetQueryObjectui64v(timerQueries[frame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsedNs);
+        samples[frame - numWarmupFrames].gpuMs = elapsedNs / 1000000.0;
+    }
+
+    FILE *outFile;
+    if (fopen_s(&outFile, outFilename, "w") != 0)
+    {
+        DebugPrintA("Failed to open %s for writing.\n", outFilename);
+        return -1;
+    }
+    fprintf(outFile, "frame,cpu_ms,gpu_ms,model_triangles,meshlet_commands\n");
+    f64 totalCpuMs = 0.0;
+    f64 totalGpuMs = 0.0;
+    u64 totalModelTriangles = 0;
+    u64 totalMeshletCommands = 0;
+    for (u32 i = 0; i < numFrames; i++)
+    {
+        fprintf(outFile, "%u,%.4f,%.4f,%llu,%u\n", i, samples[i].cpuMs, samples[i].gpuMs,
+                (unsigned long long)samples[i].modelTriangles, samples[i].meshletCommands);
+        totalCpuMs += samples[i].cpuMs;
+        totalGpuMs += samples[i].gpuMs;
+        totalModelTriangles += samples[i].modelTriangles;
+        totalMeshletCommands += samples[i].meshletCommands;
+    }
+    fclose(outFile);
+
+    DebugPrintA("%u frames at %ix%i: mean CPU %.3f ms, mean GPU %.3f ms, written to %s\n", numFrames, width, height,
+                totalCpuMs / numFrames, totalGpuMs / numFrames, outFilename);
+    DebugPrintA("Model triangles per frame, over every pass: %llu (LOD error %.2f pixels), meshlet commands: %llu%s\n",
+                (unsigned long long)(totalModelTriangles / numFrames), persistentInfo->lodErrorPixels,
+                (unsigned long long)(totalMeshletCommands / numFrames),
+                persistentInfo->meshletCulling ? "" : " (meshlet culling off)");
+    TimingHistogram *frameHistogram = &appState.telemetry.histograms[(u32)FrameTimingCategory::Frame];
+    DebugPrintA("CPU frame time p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                GetTimingPercentile(frameHistogram, .5f), GetTimingPercentile(frameHistogram, .95f),
+                GetTimingPercentile(frameHistogram, .99f), frameHistogram->maxMs);
+
+    glDeleteQueries(QUERY_LATENCY, timerQueries);
+    FreeArena(samplesArena);
+    FreeArena(tempArena);
+    FreeArena(listArena);
+    free(cameraPath);
+    StopJobSystem(gJobSystem);
+
+    return 0;
+}
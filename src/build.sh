@@ -0,0 +1,19 @@
+#!/bin/sh
+
+# Linux build of the game code (cwgame.so), of the headless benchmark runner (cw_bench) and of the CPU-only
+# micro-benchmarks (cw_microbench).
+# Requires the GLEW, Assimp and EGL development packages; renders on Mesa's llvmpipe when no GPU is available.
+# To profile with tracy, add -O2 and -DTRACY_ENABLE.
+set -e
+
+compilerflags="-I../src/ -std=c++17 -g -Wall -Wno-unused-variable -Wno-unused-but-set-variable -Wno-unused-function -fno-rtti -fno-exceptions"
+linkerflags="-lGLEW -lEGL -lassimp -ldl -lpthread"
+
+mkdir -p ../build
+cd ../build
+if [ ! -f all_imgui.o ]; then
+    c++ -c ../src/all_imgui.cpp -I../src/ -O2 -fPIC -o all_imgui.o
+fi
+c++ -shared -fPIC ../src/game.cpp $compilerflags all_imgui.o -o cwgame.so $linkerflags
+c++ ../src/bench.cpp $compilerflags -o cw_bench $linkerflags
+c++ ../src/microbench.cpp $compilerflags -O2 -o cw_microbench $linkerflags
@@ -1,19 +1,28 @@
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 #include <math.h> // sinf().
 #include <stdint.h>
 #include <stdio.h>
+#ifdef _WIN32
 #include <windowsx.h>
 #include <wingdi.h>
 #include <winuser.h>
+#else
+#include "linux_platform.h"
+#endif
 
 #include <GL/glew.h>
+#ifdef _WIN32
 #include "wglext.h"
+#endif
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/packing.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -21,7 +30,9 @@
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_opengl3.h"
+#ifdef _WIN32
 #include "imgui/imgui_impl_win32.h"
+#endif
 
 #include "assimp/Importer.hpp"
 #include <assimp/postprocess.h>
@@ -112,6 +123,7 @@ struct SpotLight
     float outerCutoff = PI / 9.f;
 };
 
+// Full precision, as imported; vertex buffers hold them packed (see: PackedVertex).
 struct Vertex
 {
     glm::vec3 position;
@@ -121,6 +133,83 @@ struct Vertex
     glm::vec3 bitangent;
 };
 
+// Generational handle into a Pool (see: pool.h). Generations start at one, so a zero-initialized handle is null.
+template <typename T> struct Handle
+{
+    u32 index;
+    u32 generation;
+};
+
+struct PoolSlot
+{
+    u32 generation;
+    u32 denseIndex; // Index of the item while the slot is live, the next free slot otherwise.
+};
+
+struct Arena;
+
+template <typename T> struct Pool
+{
+    T *items;       // Live items, densely packed.
+    u32 *itemSlots; // The slot of every live item.
+    PoolSlot *slots;
+    u32 count;
+    u32 numSlots;
+    u32 capacity;
+    u32 firstFree;
+
+    Arena *itemsArena;
+    Arena *itemSlotsArena;
+    Arena *slotsArena;
+};
+
+struct FreeRange
+{
+    u32 offset;
+    u32 size;
+};
+
+// See: range_allocator.h.
+struct RangeAllocator
+{
+    FreeRange *freeRanges; // Sorted by offset, never adjacent.
+    u32 numFreeRanges;
+    u32 maxFreeRanges;
+    u32 capacity;
+    u32 used;
+
+    Arena *arena;
+};
+
+// Slots are probed in groups of this many control bytes at once (see: hashmap.h).
+#define HASH_MAP_GROUP_SIZE 16
+
+// Open-addressing hash map backed by an arena (see: hashmap.h and InitHashMap()).
+template <typename K, typename V> struct HashMap
+{
+    u8 *control; // One byte per slot: empty, deleted, or full with 7 bits of the key's hash.
+    K *keys;
+    V *values;
+    u32 capacity; // Zero or a power of two, at least HASH_MAP_GROUP_SIZE.
+    u32 count;
+    u32 numDeleted;
+    Arena *arena;
+};
+
+// The same, with its capacity fixed and its slots inline, for maps with a known bound such as caches and per-frame
+// tables. Zero-initialized, it is empty.
+template <typename K, typename V, u32 N> struct FixedHashMap
+{
+    static_assert(N >= HASH_MAP_GROUP_SIZE && (N & (N - 1)) == 0, "capacity must be a power of two");
+    static constexpr u32 capacity = N;
+
+    alignas(HASH_MAP_GROUP_SIZE) u8 control[N];
+    K keys[N];
+    V values[N];
+    u32 count;
+    u32 numDeleted;
+};
+
 enum class TextureType
 {
     Diffuse,
@@ -146,10 +235,6 @@ struct Material
 
 struct Mesh
 {
-    Vertex *vertices;
-    u32 verticesSize;
-    u32 *indices;
-    u32 indicesSize;
     Material material;
     u32 numTextures;
 
@@ -157,6 +242,23 @@ struct Mesh
 };
 
 #define MAX_MESHES_PER_MODEL 100
+// Levels of detail of a model, the first being the full mesh, each about half the triangles of the one before (see:
+// SimplifyMesh()).
+#define MAX_MODEL_LODS 4
+// How far a LOD may be off, projected on screen, before a pass draws a finer one (see: SelectModelLod()); shadow
+// passes tolerate more.
+#define DEFAULT_LOD_ERROR_PIXELS 1.f
+#define LOD_SHADOW_ERROR_SCALE 4.f
+// Draw commands and draws the frame's buffers hold, meshlets included: passes which don't fit start them over (see:
+// ExecuteRenderQueue()).
+#define MAX_FRAME_DRAW_COMMANDS (256 * 1024)
+#define MAX_FRAME_DRAWS (64 * 1024)
+// Capacities of the geometry buffer (see: GeometryBuffer).
+#define GEOMETRY_MAX_VERTICES (2 * 1024 * 1024)
+#define GEOMETRY_MAX_INDICES (8 * 1024 * 1024)
+#define GEOMETRY_MAX_COMMANDS (64 * 1024)
+#define GEOMETRY_MAX_MATERIALS (64 * 1024)
+#define GEOMETRY_MAX_FREE_RANGES 4096
 
 struct TextureHandles
 {
@@ -172,11 +274,50 @@ struct TextureHandleBuffer
     u32 numHandleGroups = 0;
 };
 
-struct Model
+// Where a mesh is in the geometry buffer, see: UploadGeometry().
+struct GeometryRange
+{
+    u32 firstIndex;
+    u32 numIndices;
+    s32 baseVertex;
+};
+
+// The vertices and indices of every model, cube and quad, drawn through a single vertex array, along with the models'
+// draw commands and the textures of every model's meshes and of every object (see: UploadGeometry()). Each is
+// sub-allocated (see: range_allocator.h).
+struct GeometryBuffer
 {
     u32 vao;
-    u32 commandBuffer;
+    u32 vertexBuffer;   // PackedVertex.
+    u32 indexBuffer;    // u32, relative to the base vertex of their draw.
+    u32 commandBuffer;  // DrawElementsIndirectCommand, see: Model::firstCommand.
+    u32 materialBuffer; // TextureHandles, picked by the base instance of a draw command.
+    RangeAllocator vertices;
+    RangeAllocator indices;
+    RangeAllocator commands;
+    RangeAllocator materials;
+};
+
+struct Model
+{
     u32 meshCount;
+    // The model's ranges of the geometry buffer. Its commands are numLods runs of meshCount, from the finest LOD to the
+    // coarsest, and point into its vertices and indices already, their base instances being its meshes' materials.
+    u32 firstVertex;
+    u32 numVertices;
+    u32 firstIndex;
+    u32 numIndices;
+    u32 firstCommand;
+    u32 firstMaterial;
+    struct DrawElementsIndirectCommand *commands; // A copy of the commands, which the passes draw from.
+    u32 numLods;
+    f32 lodErrors[MAX_MODEL_LODS]; // In model space, see: SelectModelLod().
+    u32 lodTriangles[MAX_MODEL_LODS];
+    f32 boundingRadius; // Around the model's origin, in model space.
+    // Every LOD's meshlets, culled by the passes which draw the model (see: meshlet.h). LOD l's blocks are
+    // [lodMeshletBlocks[l], lodMeshletBlocks[l + 1]).
+    struct MeshletBlock *meshletBlocks;
+    u32 lodMeshletBlocks[MAX_MODEL_LODS + 1];
     // NOTE: the elements below don't seem like they belong here and reflects a conflation
     // of information about a generic model and information about specific instances of the
     // model that need to be rendered. Once we have the model geometry, we'll probably want
@@ -186,40 +327,64 @@ struct Model
     TextureHandleBuffer textureHandleBuffer;
     glm::vec3 position;
     glm::vec3 scale;
+    u32 shaderPasses; // See: SHADER_PASS_GBUFFER.
+    // Set every frame from the above, see: UpdateTransforms().
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix;
+    // Until it's set, the model is being streamed in and is drawn as a cube with placeholder textures.
+    bool loaded;
 };
+typedef Handle<Model> ModelHandle;
 
-#define MAX_CUBES 100
-
-struct Cubes
+struct Object
 {
-    glm::ivec3 positions[MAX_CUBES];
-    TextureHandles textures[MAX_CUBES];
-    u32 numCubes = 0;
+    u32 id;
+    GeometryRange geometry;
+    glm::vec3 position;
+    TextureHandles textures = {};
+    u32 material; // Holds the above, see: GeometryBuffer::materials.
+    u32 shaderPasses; // See: SHADER_PASS_GBUFFER.
+    // Set every frame from the above, see: UpdateTransforms().
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix;
 };
+typedef Handle<Object> ObjectHandle;
 
-struct VaoInformation
+struct Cube
 {
-    f32 *vertices;
-    u32 verticesSize;
-    s32 *elemCounts;
-    u32 elementCountsSize;
-    u32 *indices;
-    u32 indicesSize;
+    glm::ivec3 position;
+    ObjectHandle object;
 };
 
-struct Object
-{
-    u32 id;
-    u32 vao;
-    // u32 commandBuffer;
-    u32 numIndices;
+// Shader passes which an object or a model is drawn in, see: RenderShaderPass().
+#define SHADER_PASS_GBUFFER (1 << 0)
+#define SHADER_PASS_SSAO (1 << 1)
+#define SHADER_PASS_SSAO_BLUR (1 << 2)
+#define SHADER_PASS_DIR_DEPTH_MAP (1 << 3)
+#define SHADER_PASS_SPOT_DEPTH_MAP (1 << 4)
+#define SHADER_PASS_POINT_DEPTH_MAP (1 << 5)
+#define SHADER_PASS_GEOMETRY (1 << 6)
+#define SHADER_PASS_TEXTURE (1 << 7)
+// Blended, so drawn back to front (see: render_queue.h).
+#define SHADER_PASS_GLASS (1 << 8)
+
+// Pool capacities, only committed as they fill up (see: pool.h).
+#define OBJECT_POOL_CAPACITY 65536
+#define MODEL_POOL_CAPACITY 4096
+#define CUBE_POOL_CAPACITY 65536
+
+// How many object and model positions are kept in the save file.
+#define MAX_SAVED_OBJECTS 20
+#define MAX_SAVED_MODELS 20
+
+// Saved along with the item's handle, through which it's restored, since pools don't keep their items in order (see:
+// PoolFree()).
+template <typename T> struct SavedPosition
+{
+    Handle<T> handle;
     glm::vec3 position;
-    TextureHandles textures = {};
 };
 
-#define MAX_OBJECTS 20
-#define MAX_MODELS 20
-
 struct ShaderProgram
 {
     u32 id = 0;
@@ -229,11 +394,6 @@ struct ShaderProgram
     FILETIME geometryShaderTime;
     char fragmentShaderFilename[64];
     FILETIME fragmentShaderTime;
-
-    u32 objectIndices[MAX_OBJECTS];
-    u32 numObjects;
-    u32 modelIndices[MAX_MODELS];
-    u32 numModels;
 };
 
 #define MAX_ATTACHMENTS 8
@@ -247,17 +407,15 @@ struct Framebuffer
 
 struct Ball
 {
-    Model *model;
+    ModelHandle model;
     glm::ivec3 position = glm::ivec3(0, 1, 0);
     glm::ivec3 rotation = glm::ivec3(0, 0, -1);
 };
 
 struct TransientDrawingInfo
 {
-    Object objects[MAX_OBJECTS];
-    u32 numObjects;
-    Model models[MAX_MODELS];
-    u32 numModels;
+    Pool<Object> objects;
+    Pool<Model> models;
 
     ShaderProgram gBufferShader;
     ShaderProgram ssaoShader;
@@ -277,18 +435,44 @@ struct TransientDrawingInfo
     ShaderProgram geometryShader;
     ShaderProgram gaussianShader;
 
-    Cubes cubes;
+    Pool<Cube> cubes;
     Ball ball;
 
+    // Objects by the ID they write into the picking buffer (see: GameHandleClick()).
+    HashMap<u32, ObjectHandle> objectsById;
+    u32 nextObjectId; // Shared between objects and models.
+
     u32 matricesUBO;
-    u32 textureHandlesUBO;
 
-    u32 cubeVao;
-    Model *sphereModel;
+    GeometryBuffer geometry;
+    GeometryRange cube;
+    TextureHandles cubeTextures; // Shared by every cube, see: LoadCube().
+    u32 cubeMaterial;
+    ModelHandle sphereModel;
+
+    // Assets still streaming in, NULL once they all are (see: UpdateAssetLoading()).
+    struct AssetLoading *assetLoading;
+    u32 placeholderMaterial;
 
     u32 skyboxTexture;
 
-    u32 quadVao;
+    u64 numModelTriangles; // Drawn this frame, over every pass, see: SelectModelLod().
+
+    // The models' copies of their commands and their meshlets.
+    Arena *modelGeometryArena;
+
+    // The draws of the frame's passes, a multi-draw per pass written one pass after the other through the frame (see:
+    // ExecuteRenderQueue()): their commands, the draw of every command, and the draws' per-draw data (see: DrawData).
+    u32 frameCommandBuffer;
+    u32 frameCommandDrawsBuffer;
+    u32 frameDrawsBuffer;
+    u32 frameBufferCommands; // Written to the buffers, which start over when full.
+    u32 frameBufferDraws;
+    u32 numFrameCommands; // Drawn this frame, over every pass.
+    u32 numFrameDraws;
+    u32 numMeshletCommands; // Of the frame's commands, those of culled meshlets (see: CullModelMeshlets()).
+
+    GeometryRange quad;
     Framebuffer mainFramebuffer;
     Framebuffer lightingFramebuffer;
     Framebuffer postProcessingFramebuffer;
@@ -311,9 +495,9 @@ struct PersistentDrawingInfo
     bool wireframeMode = false;
 
     u32 numObjects;
-    glm::vec3 objectPositions[MAX_OBJECTS];
+    SavedPosition<Object> objectPositions[MAX_SAVED_OBJECTS];
     u32 numModels;
-    glm::vec3 modelPositions[MAX_MODELS];
+    SavedPosition<Model> modelPositions[MAX_SAVED_MODELS];
 
     DirLight dirLight;
     PointLight pointLights[NUM_POINTLIGHTS];
@@ -326,6 +510,8 @@ struct PersistentDrawingInfo
     f32 exposure = 1.f;
     f32 ssaoSamplingRadius = .5f;
     f32 ssaoPower = 1.f;
+    f32 lodErrorPixels = DEFAULT_LOD_ERROR_PIXELS; // 0 draws every model in full detail.
+    bool meshletCulling = true;
 };
 
 struct CameraInfo
@@ -340,13 +526,96 @@ struct CameraInfo
     glm::vec3 rightVector;
 };
 
+// Movement intent gathered from input, consumed by every simulation step.
+struct SimulationInput
+{
+    f32 forward; // -1 to 1.
+    f32 right;   // -1 to 1.
+    f32 speed = .1f;
+};
+
+// State advanced by the game at a fixed rate; rendering interpolates between the last two states so that the render
+// rate can vary without changing gameplay.
+struct SimulationState
+{
+    glm::vec3 cameraPos;
+    glm::vec3 ballPos;
+    glm::vec3 ballTarget; // Grid position the ball rolls towards.
+};
+
+#define DEFAULT_SIMULATION_RATE 120.f
+// Upper bound on the number of catch-up steps per frame, so that a long frame can't trigger a spiral of ever longer
+// frames; simulation time is dropped instead.
+#define MAX_SIMULATION_STEPS_PER_FRAME 8
+
+struct Simulation
+{
+    SimulationInput input;
+    SimulationState previous;
+    SimulationState current;
+    f32 rate = DEFAULT_SIMULATION_RATE; // In Hz.
+    f32 accumulatorMs;
+    f32 alpha; // Interpolation factor between previous and current state for the frame being rendered.
+    u64 tick;
+};
+
+// Log-bucketed histogram of durations in microseconds: each power of two is split into
+// 2^TIMING_SUB_BUCKET_BITS linear sub-buckets, which bounds the relative error of a reported percentile to 12.5%
+// while keeping an update down to a bit scan and an increment (see: telemetry.h).
+#define TIMING_SUB_BUCKET_BITS 3
+#define TIMING_SUB_BUCKETS (1 << TIMING_SUB_BUCKET_BITS)
+#define TIMING_HISTOGRAM_BUCKETS ((32 - TIMING_SUB_BUCKET_BITS + 1) * TIMING_SUB_BUCKETS)
+
+struct TimingHistogram
+{
+    u32 counts[TIMING_HISTOGRAM_BUCKETS];
+    u64 totalCount;
+    f64 totalMs;
+    f32 maxMs;
+};
+
+enum class FrameTimingCategory
+{
+    Frame,        // Whole frame, from one iteration of the main loop to the next.
+    MessagePump,  // Platform message processing, ie turning window messages into input events.
+    Game,         // Game-side updates outside of rendering: simulation, hot reload checks.
+    RenderSubmit, // DrawWindow(), ie CPU-side GL command submission.
+    Swap,         // SwapBuffers(), including any wait for vsync.
+    InputLatency, // From pumping the newest mouse look message to the end of the swap that presents it.
+    Count
+};
+
+#define FRAME_TIMING_HISTORY 128
+
+struct FrameTelemetry
+{
+    TimingHistogram histograms[(u32)FrameTimingCategory::Count];
+    f32 lastMs[(u32)FrameTimingCategory::Count];
+
+    // Recent whole-frame times, for plotting hitches.
+    f32 frameHistory[FRAME_TIMING_HISTORY];
+    u32 frameHistoryIndex;
+
+    bool showOverlay = true;
+    bool showMemoryPanel = false; // See: DrawMemoryPanel().
+
+    // Startup times, from the platform layer's start: to the first frame presented, and to the last asset streamed
+    // in. Zero until then.
+    u64 startTimestamp;
+    f32 firstFrameMs;
+    f32 fullyLoadedMs;
+};
+
 struct ApplicationState
 {
     TransientDrawingInfo transientInfo;
     PersistentDrawingInfo persistentInfo;
     CameraInfo cameraInfo;
+    Simulation simulation;
+    FrameTelemetry telemetry;
     bool running;
     bool playing;
+    bool shadersChanged; // Set by the platform layer's file watcher, cleared once the shaders have been reloaded.
 };
 
 struct Vec3
@@ -370,6 +639,11 @@ internal f32 Win32GetWallClockPeriod()
     return 1000.f / perfCounterFrequency.QuadPart;
 }
 
+internal f32 Win32GetElapsedMs(u64 start, u64 end)
+{
+    return (f32)(end - start) * Win32GetWallClockPeriod();
+}
+
 internal float Win32GetTime()
 {
     return Win32GetWallClock() * Win32GetWallClockPeriod() / 1000.f;
@@ -385,6 +659,47 @@ internal void DebugPrintA(const char *formatString, ...)
     OutputDebugStringA(debugString);
 }
 
+struct MappedFile
+{
+    void *memory;
+    u64 size;
+};
+
+// Maps the whole file read-only, so that it can be used in place rather than read into memory first. Fails if there's
+// no such file or it's empty.
+internal bool Win32MapFile(const char *filename, MappedFile *result)
+{
+    *result = {};
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    DWORD sizeHigh = 0;
+    DWORD sizeLow = GetFileSize(file, &sizeHigh);
+    u64 size = ((u64)sizeHigh << 32) | sizeLow;
+    HANDLE mapping = (size > 0) ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    // NOTE: the view keeps the file open, so the handles can go right away.
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+    result->memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    result->size = result->memory ? size : 0;
+    CloseHandle(mapping);
+    return result->memory != NULL;
+}
+
+internal void Win32UnmapFile(MappedFile *file)
+{
+    if (file->memory)
+    {
+        UnmapViewOfFile(file->memory);
+    }
+    *file = {};
+}
+
 struct EnvironmentMap
 {
     bool initialized;
@@ -428,6 +743,32 @@ internal u64 fnv1a(u8 *data, size_t len)
     return hash;
 }
 
+// Returns the index of the highest set bit; value must be non-zero.
+internal u32 FindMostSignificantBit(u64 value)
+{
+    myAssert(value != 0);
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#else
+    return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+// Returns the index of the lowest set bit; value must be non-zero.
+internal u32 FindLeastSignificantBit(u64 value)
+{
+    myAssert(value != 0);
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(value);
+#endif
+}
+
 internal f32 CreateRandomNumber(f32 min, f32 max)
 {
     f32 midpoint = (max + min) / 2.f;
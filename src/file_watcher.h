@@ -0,0 +1,349 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#endif
+
+/***********************************************************************************************************************
+ *
+ * File watcher: a background thread waiting on directory change notifications (ReadDirectoryChangesW on Windows,
+ * inotify on Linux), which posts debounced changes to shaders, the game code and assets through a single-producer/
+ * single-consumer lock-free ring. Polling it from the main loop is a pair of atomic loads when nothing has changed.
+ *
+ **********************************************************************************************************************/
+
+#ifdef _WIN32
+#define GAME_CODE_FILENAME "logl.dll"
+#else
+#define GAME_CODE_FILENAME "cwgame.so"
+#endif
+
+// Editors and linkers tend to write a file in several goes, so a change is only posted once the file has been left
+// alone for this long.
+#define FILE_CHANGE_DEBOUNCE_MS 100.f
+#define GAME_CODE_DEBOUNCE_MS 500.f
+
+#define MAX_WATCHED_PATH 128
+#define MAX_PENDING_FILE_CHANGES 64
+// Must be a power of two.
+#define FILE_CHANGE_QUEUE_SIZE 64
+
+enum class FileChangeKind
+{
+    None,
+    Shader,
+    GameCode,
+    Asset,
+};
+
+struct FileChange
+{
+    FileChangeKind kind;
+    char path[MAX_WATCHED_PATH]; // Relative to the watched directory.
+};
+
+struct PendingFileChange
+{
+    FileChange change;
+    u64 lastModified; // See: Win32GetWallClock().
+};
+
+struct FileWatcher
+{
+    // Posted changes, see: PushInputEvent() in input.h for the reasoning behind the layout.
+    FileChange changes[FILE_CHANGE_QUEUE_SIZE];
+    alignas(64) std::atomic<u32> writeIndex; // Only written by the watcher thread.
+    alignas(64) std::atomic<u32> readIndex;  // Only written by the consumer.
+
+    // Watcher thread only: changes waiting for their file to settle.
+    PendingFileChange pending[MAX_PENDING_FILE_CHANGES];
+    u32 numPending;
+
+    char directory[MAX_WATCHED_PATH];
+#ifdef _WIN32
+    HANDLE thread;
+    HANDLE stopEvent;
+#else
+    pthread_t thread;
+    s32 stopPipe[2];
+#endif
+};
+
+internal FileChangeKind ClassifyFile(const char *path)
+{
+    if (strcmp(path, GAME_CODE_FILENAME) == 0)
+    {
+        return FileChangeKind::GameCode;
+    }
+
+    const char *extension = strrchr(path, '.');
+    if (extension == NULL)
+    {
+        return FileChangeKind::None;
+    }
+
+    const char *shaderExtensions[] = {".vs", ".fs", ".gs", ".glsl"};
+    for (u32 i = 0; i < myArraySize(shaderExtensions); i++)
+    {
+        if (strcmp(extension, shaderExtensions[i]) == 0)
+        {
+            return FileChangeKind::Shader;
+        }
+    }
+
+    const char *assetExtensions[] = {".obj", ".mtl", ".fbx", ".png", ".jpg", ".jpeg", ".tga", ".hdr"};
+    for (u32 i = 0; i < myArraySize(assetExtensions); i++)
+    {
+        if (strcmp(extension, assetExtensions[i]) == 0)
+        {
+            return FileChangeKind::Asset;
+        }
+    }
+
+    return FileChangeKind::None;
+}
+
+//
+// Watcher thread side.
+//
+
+internal void AddPendingFileChange(FileWatcher *watcher, const char *path)
+{
+    FileChangeKind kind = ClassifyFile(path);
+    if (kind == FileChangeKind::None)
+    {
+        return;
+    }
+
+    u64 now = Win32GetWallClock();
+    for (u32 i = 0; i < watcher->numPending; i++)
+    {
+        if (strcmp(watcher->pending[i].change.path, path) == 0)
+        {
+            watcher->pending[i].lastModified = now;
+            return;
+        }
+    }
+
+    if (watcher->numPending == MAX_PENDING_FILE_CHANGES)
+    {
+        DebugPrintA("Too many pending file changes, dropping %s.\n", path);
+        return;
+    }
+    PendingFileChange *pending = &watcher->pending[watcher->numPending++];
+    pending->change.kind = kind;
+    strcpy_s(pending->change.path, path);
+    pending->lastModified = now;
+}
+
+internal f32 GetDebounceMs(FileChangeKind kind)
+{
+    return (kind == FileChangeKind::GameCode) ? GAME_CODE_DEBOUNCE_MS : FILE_CHANGE_DEBOUNCE_MS;
+}
+
+// Posts the pending changes whose file has settled, and returns how long to wait for the next one to, in
+// milliseconds, or -1 if there is none left.
+internal s32 PostSettledFileChanges(FileWatcher *watcher)
+{
+    u64 now = Win32GetWallClock();
+    f32 nextTimeout = -1.f;
+    for (u32 i = 0; i < watcher->numPending;)
+    {
+        PendingFileChange *pending = &watcher->pending[i];
+        f32 remainingMs = GetDebounceMs(pending->change.kind) - Win32GetElapsedMs(pending->lastModified, now);
+        if (remainingMs > 0.f)
+        {
+            nextTimeout = (nextTimeout < 0.f) ? remainingMs : fmin(nextTimeout, remainingMs);
+            i++;
+            continue;
+        }
+
+        u32 writeIndex = watcher->writeIndex.load(std::memory_order_relaxed);
+        u32 readIndex = watcher->readIndex.load(std::memory_order_acquire);
+        if (writeIndex - readIndex == FILE_CHANGE_QUEUE_SIZE)
+        {
+            // The consumer is behind; try again shortly.
+            nextTimeout = FILE_CHANGE_DEBOUNCE_MS;
+            break;
+        }
+        watcher->changes[writeIndex & (FILE_CHANGE_QUEUE_SIZE - 1)] = pending->change;
+        watcher->writeIndex.store(writeIndex + 1, std::memory_order_release);
+
+        *pending = watcher->pending[--watcher->numPending];
+    }
+    return (nextTimeout < 0.f) ? -1 : (s32)ceil(nextTimeout);
+}
+
+#ifdef _WIN32
+internal DWORD WINAPI FileWatcherThreadProc(LPVOID parameter)
+{
+    FileWatcher *watcher = (FileWatcher *)parameter;
+
+    HANDLE directory =
+        CreateFileA(watcher->directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (directory == INVALID_HANDLE_VALUE)
+    {
+        DebugPrintA("Failed to open %s for watching.\n", watcher->directory);
+        return 1;
+    }
+
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    alignas(DWORD) u8 buffer[16384];
+    DWORD notifyFilter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+    bool watching = ReadDirectoryChangesW(directory, buffer, sizeof(buffer), TRUE, notifyFilter, NULL, &overlapped,
+                                          NULL);
+
+    HANDLE handles[] = {overlapped.hEvent, watcher->stopEvent};
+    DWORD timeout = INFINITE;
+    while (watching)
+    {
+        DWORD waitResult = WaitForMultipleObjects(myArraySize(handles), handles, FALSE, timeout);
+        if (waitResult == WAIT_OBJECT_0 + 1)
+        {
+            break;
+        }
+        if (waitResult == WAIT_OBJECT_0)
+        {
+            DWORD numBytes = 0;
+            GetOverlappedResult(directory, &overlapped, &numBytes, FALSE);
+
+            // NOTE: zero bytes means the buffer overflowed and the changes were lost; there is nothing to recover
+            // but we keep watching.
+            u8 *cursor = buffer;
+            while (numBytes > 0)
+            {
+                FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)cursor;
+                char path[MAX_WATCHED_PATH];
+                s32 pathLength = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                                                     path, sizeof(path) - 1, NULL, NULL);
+                path[pathLength] = '\0';
+                AddPendingFileChange(watcher, path);
+
+                if (info->NextEntryOffset == 0)
+                {
+                    break;
+                }
+                cursor += info->NextEntryOffset;
+            }
+
+            watching = ReadDirectoryChangesW(directory, buffer, sizeof(buffer), TRUE, notifyFilter, NULL,
+                                             &overlapped, NULL);
+        }
+
+        s32 nextTimeout = PostSettledFileChanges(watcher);
+        timeout = (nextTimeout < 0) ? INFINITE : (DWORD)nextTimeout;
+    }
+
+    CancelIoEx(directory, &overlapped);
+    CloseHandle(overlapped.hEvent);
+    CloseHandle(directory);
+    return 0;
+}
+#else
+internal void *FileWatcherThreadProc(void *parameter)
+{
+    FileWatcher *watcher = (FileWatcher *)parameter;
+
+    // NOTE: unlike ReadDirectoryChangesW(), inotify does not watch subdirectories.
+    s32 inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd == -1 || inotify_add_watch(inotifyFd, watcher->directory, IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        DebugPrintA("Failed to watch %s.\n", watcher->directory);
+        return NULL;
+    }
+
+    pollfd fds[] = {{inotifyFd, POLLIN, 0}, {watcher->stopPipe[0], POLLIN, 0}};
+    s32 timeout = -1;
+    while (true)
+    {
+        if (poll(fds, myArraySize(fds), timeout) == -1 || (fds[1].revents & POLLIN))
+        {
+            break;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            alignas(inotify_event) u8 buffer[4096];
+            ssize_t numBytes;
+            while ((numBytes = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (u8 *cursor = buffer; cursor < buffer + numBytes;)
+                {
+                    inotify_event *event = (inotify_event *)cursor;
+                    if (event->len > 0)
+                    {
+                        AddPendingFileChange(watcher, event->name);
+                    }
+                    cursor += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+
+        timeout = PostSettledFileChanges(watcher);
+    }
+
+    close(inotifyFd);
+    return NULL;
+}
+#endif
+
+//
+// Consumer side.
+//
+
+internal bool StartFileWatcher(FileWatcher *watcher, const char *directory)
+{
+    strcpy_s(watcher->directory, directory);
+#ifdef _WIN32
+    watcher->stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    watcher->thread = CreateThread(NULL, 0, FileWatcherThreadProc, watcher, 0, NULL);
+    return watcher->thread != NULL;
+#else
+    if (pipe(watcher->stopPipe) == -1)
+    {
+        return false;
+    }
+    return pthread_create(&watcher->thread, NULL, FileWatcherThreadProc, watcher) == 0;
+#endif
+}
+
+internal void StopFileWatcher(FileWatcher *watcher)
+{
+#ifdef _WIN32
+    SetEvent(watcher->stopEvent);
+    WaitForSingleObject(watcher->thread, INFINITE);
+    CloseHandle(watcher->thread);
+    CloseHandle(watcher->stopEvent);
+#else
+    u8 stop = 1;
+    write(watcher->stopPipe[1], &stop, 1);
+    pthread_join(watcher->thread, NULL);
+    close(watcher->stopPipe[0]);
+    close(watcher->stopPipe[1]);
+#endif
+}
+
+// Returns the oldest posted change without consuming it, or NULL if there is none.
+internal FileChange *PeekFileChange(FileWatcher *watcher)
+{
+    u32 readIndex = watcher->readIndex.load(std::memory_order_relaxed);
+    u32 writeIndex = watcher->writeIndex.load(std::memory_order_acquire);
+    if (readIndex == writeIndex)
+    {
+        return NULL;
+    }
+    return &watcher->changes[readIndex & (FILE_CHANGE_QUEUE_SIZE - 1)];
+}
+
+internal void PopFileChange(FileWatcher *watcher)
+{
+    u32 readIndex = watcher->readIndex.load(std::memory_order_relaxed);
+    watcher->readIndex.store(readIndex + 1, std::memory_order_release);
+}
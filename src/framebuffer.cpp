@@ -128,8 +128,10 @@ internal void CreateFramebuffers(HWND window, TransientDrawingInfo *transientInf
     hdrBuffer.type = GL_FLOAT;
 
     FramebufferOptions pickingBuffer = {};
-    pickingBuffer.internalFormat = GL_RG8UI;
+    // NOTE: the whole 32-bit object ID, see: GameHandleClick().
+    pickingBuffer.internalFormat = GL_RG32UI;
     pickingBuffer.pixelFormat = GL_RG_INTEGER;
+    pickingBuffer.type = GL_UNSIGNED_INT;
 
     // Main G-buffer, with 4 colour buffers:
     // 0 = position buffer, 1 = normal buffer, 2 = albedo buffer, 3 = picking buffer.
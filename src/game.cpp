@@ -1,5 +1,14 @@
+// The game code links the Tracy client, so its arenas can report to it (see: arena.h).
+#define ARENA_TRACY_MEMORY
+
 #include "common.h"
+#include "hashmap.h"
+#include "jobs.h"
+#include "meshlet.h"
+#include "pool.h"
+#include "render_queue.h"
 #include "skiplist.h"
+#include "telemetry.h"
 
 #include "asteroids.cpp"
 #include "framebuffer.cpp"
@@ -18,13 +27,6 @@
 global_variable ImGuiContext *imGuiContext;
 global_variable ImGuiIO *imGuiIO;
 
-global_variable s32 gElemCounts[] = {3, 3, 2};                // Position, normal, texcoords.
-global_variable s32 gBitangentElemCounts[] = {3, 3, 2, 3, 3}; // Position, normal, texcoords, tangent, bitangent.
-
-// NOTE: for now we put this here as a convenient way to share IDs between models and objects.
-// Will no longer be a global if we get rid of that distinction and only use models.
-global_variable u32 gObjectId = 0;
-
 /***********************************************************************************************************************
  *
  * Functions exported from game DLL to main process to allow hot reloading.
@@ -42,10 +44,52 @@ extern "C" __declspec(dllexport) void InitializeTracyGPUContext()
     TracyGpuContext;
 }
 
+//
+// Memory.
+//
+
+// Shares the platform layer's arena registry, so that the memory panel covers the arenas of both modules.
+extern "C" __declspec(dllexport) void SetArenaRegistry(ArenaRegistry *registry)
+{
+    gArenaRegistry = registry;
+}
+
+// Frees the arenas this module keeps for itself, right before the platform layer unloads it.
+extern "C" __declspec(dllexport) void FreeModuleArenas()
+{
+    FreeScratchArenas();
+}
+
+//
+// Jobs.
+//
+
+internal void RunJobInTracyZone(Job *job)
+{
+    ZoneTransientN(jobZone, job->name, true);
+    job->proc(job->data, job->begin, job->end);
+}
+
+// Shares the platform layer's job system, whose workers outlive the game code. Jobs run in Tracy zones named after
+// them until the platform layer unhooks this module before unloading it (see: LoadRenderingCode()).
+extern "C" __declspec(dllexport) void SetJobSystem(JobSystem *system)
+{
+    gJobSystem = system;
+    system->runJobHook.store(RunJobInTracyZone, std::memory_order_release);
+}
+
 //
 // Dear ImGui.
 //
 
+#ifdef _WIN32
+// The Win32 backend calls SetCapture(), TrackMouseEvent(), GetKeyState() and SetCursor(), which only work on the thread
+// which owns the window, so the platform layer runs it there (see: Win32ProcessMessages() in main.cpp) while the render
+// thread draws the frames. The backend queues up input which ImGui::NewFrame() drains, hence the lock. The render
+// thread hands back the cursor for the window's thread to set (see: GetImGuiMouseCursor()).
+global_variable CRITICAL_SECTION imGuiInputLock;
+#endif
+
 extern "C" __declspec(dllexport) void InitializeImGuiInModule(HWND window)
 {
     IMGUI_CHECKVERSION();
@@ -54,7 +98,18 @@ extern "C" __declspec(dllexport) void InitializeImGuiInModule(HWND window)
     (void)io;
     imGuiIO = &io;
     ImGui::StyleColorsDark();
+#ifdef _WIN32
+    InitializeCriticalSection(&imGuiInputLock);
     ImGui_ImplWin32_Init(window);
+    io.ConfigFlags |= ImGuiConfigFlags_NoMouseCursorChange;
+    // NOTE: a reload's first frame comes before the window's thread begins one with this module, see:
+    // ImGuiPlatformNewFrame().
+    RECT clientRect;
+    GetClientRect(window, &clientRect);
+    io.DisplaySize = ImVec2((f32)clientRect.right, (f32)clientRect.bottom);
+#else
+    io.DisplaySize = ImVec2((f32)window->width, (f32)window->height);
+#endif
     ImGui_ImplOpenGL3_Init("#version 460");
 }
 
@@ -63,11 +118,52 @@ extern "C" __declspec(dllexport) ImGuiIO *GetImGuiIO()
     return imGuiIO;
 }
 
+// The cursor Dear ImGui wants, as of the last frame drawn, see: ImGuiMouseCursor.
+extern "C" __declspec(dllexport) s32 GetImGuiMouseCursor()
+{
+    return imGuiIO->MouseDrawCursor ? ImGuiMouseCursor_None : ImGui::GetMouseCursor();
+}
+
+#ifdef _WIN32
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
+// Called on the window's thread.
 extern "C" __declspec(dllexport) LRESULT ImGui_WndProcHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
-    return ImGui_ImplWin32_WndProcHandler(hWnd, uMsg, wParam, lParam);
+    EnterCriticalSection(&imGuiInputLock);
+    LRESULT result = ImGui_ImplWin32_WndProcHandler(hWnd, uMsg, wParam, lParam);
+    LeaveCriticalSection(&imGuiInputLock);
+    return result;
+}
+
+// Called on the window's thread, once for every frame it hands over to the render thread.
+extern "C" __declspec(dllexport) void ImGuiPlatformNewFrame()
+{
+    EnterCriticalSection(&imGuiInputLock);
+    ImGui_ImplWin32_NewFrame();
+    LeaveCriticalSection(&imGuiInputLock);
+}
+#else
+// The headless Linux platform layer has no window messages to feed Dear ImGui, so we only keep its display size in
+// sync with the render target.
+internal void ImGuiPlatformNewFrame(HWND window)
+{
+    imGuiIO->DisplaySize = ImVec2((f32)window->width, (f32)window->height);
+    imGuiIO->DeltaTime = 1.f / 60.f;
+}
+#endif
+
+internal void ImGuiNewFrame(HWND window)
+{
+    ImGui_ImplOpenGL3_NewFrame();
+#ifdef _WIN32
+    EnterCriticalSection(&imGuiInputLock);
+    ImGui::NewFrame();
+    LeaveCriticalSection(&imGuiInputLock);
+#else
+    ImGuiPlatformNewFrame(window);
+    ImGui::NewFrame();
+#endif
 }
 
 //
@@ -77,95 +173,173 @@ extern "C" __declspec(dllexport) LRESULT ImGui_WndProcHandler(HWND hWnd, UINT uM
 internal void AddCube(TransientDrawingInfo *info, glm::ivec3 position);
 
 // The G-buffer pass writes into an offscreen "picking buffer" attachment, created in
-// CreateFramebuffers() with an RG8 format (see: framebuffer.cpp).
+// CreateFramebuffers() with an RG32UI format (see: framebuffer.cpp).
 // The red channel contains an object ID and the green channel some information about the face
 // orientation (see: gbuffer.vs and gbuffer.fs).
 extern "C" __declspec(dllexport) void GameHandleClick(TransientDrawingInfo *transientInfo, CWInput button,
                                                       CWPoint coordinates, CWPoint screenSize)
 {
     DebugPrintA("Clicked at (%i, %i)\n", coordinates.x, coordinates.y);
-    // TODO: remove hard coding.
-    u32 bufSize = 1920 * 1080 * 2;
-    Arena *pixelsArena = AllocArena(bufSize);
-    u8 *pixels = (u8 *)ArenaPush(pixelsArena, bufSize);
-
-    // Retrieve picking buffer.
-    glGetTextureImage(transientInfo->mainFramebuffer.attachments[3], 0, GL_RG_INTEGER, GL_UNSIGNED_BYTE, bufSize,
-                      pixels);
-    u32 stride = screenSize.x;
-    u16 *pixelsAsRG = (u16 *)pixels;
-    u16 pickedPixel = pixelsAsRG[coordinates.x + coordinates.y * stride];
+    // Retrieve the clicked-on pixel of the picking buffer.
+    u32 pickedPixel[2] = {};
+    glGetTextureSubImage(transientInfo->mainFramebuffer.attachments[3], 0, coordinates.x, coordinates.y, 0, 1, 1, 1,
+                         GL_RG_INTEGER, GL_UNSIGNED_INT, sizeof(pickedPixel), pickedPixel);
 
     // Retrieve object ID.
-    u32 id = (pickedPixel & 0xff);
+    u32 id = pickedPixel[0];
 
     // Retrieve face orientation.
-    u8 faceInfo = ((pickedPixel & 0xff00) >> 8);
+    u8 faceInfo = (u8)pickedPixel[1];
     s8 facingX = ((faceInfo & 0x30) >> 4) - 1;
     s8 facingY = ((faceInfo & 0xc) >> 2) - 1;
     s8 facingZ = ((faceInfo & 0x3)) - 1;
     DebugPrintA("Value: %u, %i, %i, %i\n", id, facingX, facingY, facingZ);
-    FreeArena(pixelsArena);
 
     // Find the object with the given ID and add the cube alongside the picked face.
-    for (u32 i = 0; i < transientInfo->numObjects; i++)
+    ObjectHandle *handle = HashMapFind(&transientInfo->objectsById, id);
+    Object *obj = handle ? PoolGet(&transientInfo->objects, *handle) : NULL;
+    if (obj)
     {
-        Object *obj = &transientInfo->objects[i];
-        if (obj->id == id)
-        {
-            AddCube(transientInfo, obj->position + glm::vec3(facingX, facingY, facingZ));
-        }
+        AddCube(transientInfo, obj->position + glm::vec3(facingX, facingY, facingZ));
     }
 }
 
-/***********************************************************************************************************************
- *
- * Mesh handling.
- *
- **********************************************************************************************************************/
+//
+// Simulation.
+//
+
+// In units per second at a speed of 1, see: SimulationInput.
+#define CAMERA_SPEED_SCALE 50.f
+// In units per second.
+#define BALL_SPEED 4.f
+
+// Advances the game by one fixed step. Only state that affects gameplay belongs here; anything that is
+// purely a function of rendering (eg camera orientation) is left to the frame loop.
+// NOTE: this runs on the game thread, so it must not touch transientInfo, which belongs to the render thread.
+extern "C" __declspec(dllexport) void SimulateGame(ApplicationState *appState, f32 stepSeconds)
+{
+    Simulation *simulation = &appState->simulation;
+    simulation->previous = simulation->current;
+    SimulationState *state = &simulation->current;
+
+    // Free-flying editor camera.
+    SimulationInput *input = &simulation->input;
+    CameraInfo *cameraInfo = &appState->cameraInfo;
+    glm::vec3 direction = cameraInfo->forwardVector * input->forward + cameraInfo->rightVector * input->right;
+    state->cameraPos += direction * input->speed * CAMERA_SPEED_SCALE * stepSeconds;
+
+    // The ball rolls towards its grid position at a constant speed.
+    glm::vec3 target = state->ballTarget;
+    glm::vec3 toTarget = target - state->ballPos;
+    f32 distance = glm::length(toTarget);
+    f32 maxDistance = BALL_SPEED * stepSeconds;
+    state->ballPos = (distance <= maxDistance) ? target : state->ballPos + toTarget * (maxDistance / distance);
+
+    simulation->tick++;
+}
+
+// Teleports simulated entities, ie skips interpolation from their previous state.
+internal void ResetSimulationState(Simulation *simulation)
+{
+    simulation->previous = simulation->current;
+}
+
+// Writes the state to render, interpolated between the last two simulation steps, into the rendered entities.
+internal void InterpolateSimulationState(ApplicationState *appState)
+{
+    Simulation *simulation = &appState->simulation;
+    f32 alpha = clamp(simulation->alpha, 0.f, 1.f);
+    SimulationState *previous = &simulation->previous;
+    SimulationState *current = &simulation->current;
+
+    appState->cameraInfo.pos = glm::mix(previous->cameraPos, current->cameraPos, alpha);
+
+    Ball *ball = &appState->transientInfo.ball;
+    Model *ballModel = PoolGet(&appState->transientInfo.models, ball->model);
+    if (appState->playing && ballModel)
+    {
+        ballModel->position = glm::mix(previous->ballPos, current->ballPos, alpha);
+    }
+}
+
+// Model matrix: transforms vertices from local to world space.
+internal void SetObjectTransform(Object *object, f32 yRot = 0.f, f32 scale = 1.f)
+{
+    object->modelMatrix = glm::mat4(1.f);
+    object->modelMatrix = glm::translate(object->modelMatrix, object->position);
+    object->modelMatrix = glm::rotate(object->modelMatrix, yRot, glm::vec3(0.f, 1.f, 0.f));
+    object->modelMatrix = glm::scale(object->modelMatrix, glm::vec3(scale));
+    object->normalMatrix = glm::mat3(glm::transpose(glm::inverse(object->modelMatrix)));
+}
+
+internal void SetModelTransform(Model *model)
+{
+    model->modelMatrix = glm::mat4(1.f);
+    model->modelMatrix = glm::translate(model->modelMatrix, model->position);
+    // NOTE: the proxy of a model which isn't loaded yet is a unit cube, whatever the model's scale.
+    if (model->loaded)
+    {
+        model->modelMatrix = glm::scale(model->modelMatrix, model->scale);
+    }
 
-// NOTE + TODO: see note in Model struct. There needs to be a clear separation of model geometry data and
-// data used to render specific instances of that model with given materials and transforms.
-internal void AddModelToShaderPass(ShaderProgram *shader, u32 modelIndex)
+    // TODO: store relative transforms and textures somewhere indexed and shader-accessible.
+    // modelMatrix *= mesh->relativeTransform;
+
+    model->normalMatrix = glm::mat3(glm::transpose(glm::inverse(model->modelMatrix)));
+}
+
+internal void SetObjectTransformsJob(void *data, u32 begin, u32 end)
 {
-    shader->modelIndices[shader->numModels] = modelIndex;
-    shader->numModels++;
-    myAssert(shader->numModels <= MAX_MODELS);
+    Pool<Object> *objects = (Pool<Object> *)data;
+    for (u32 i = begin; i < end; i++)
+    {
+        SetObjectTransform(&objects->items[i]);
+    }
 }
 
-internal void AddObjectToShaderPass(ShaderProgram *shader, u32 objectIndex)
+internal void SetModelTransformsJob(void *data, u32 begin, u32 end)
 {
-    shader->objectIndices[shader->numObjects] = objectIndex;
-    shader->numObjects++;
-    myAssert(shader->numObjects <= MAX_OBJECTS);
+    Pool<Model> *models = (Pool<Model> *)data;
+    for (u32 i = begin; i < end; i++)
+    {
+        SetModelTransform(&models->items[i]);
+    }
 }
 
-internal void LoadModels(TransientDrawingInfo *transientInfo, Arena *texturesArena, Arena *meshDataArena)
+// Computes the matrices of every object and model once per frame, on the job system, rather than in every pass which
+// draws them.
+internal void UpdateTransforms(TransientDrawingInfo *transientInfo)
 {
-    u32 backpackIndex = AddModel("backpack.obj", transientInfo, gBitangentElemCounts, myArraySize(gBitangentElemCounts),
-                                 texturesArena, meshDataArena, &gObjectId);
-    u32 planetIndex = AddModel("planet.obj", transientInfo, gBitangentElemCounts, myArraySize(gBitangentElemCounts),
-                               texturesArena, meshDataArena, &gObjectId);
-    u32 rockIndex = AddModel("rock.obj", transientInfo, gBitangentElemCounts, myArraySize(gBitangentElemCounts),
-                             texturesArena, meshDataArena, &gObjectId);
-    u32 deccerCubesIndex = AddModel("SM_Deccer_Cubes_Textured_Complex.fbx", transientInfo, gBitangentElemCounts,
-                                    myArraySize(gBitangentElemCounts), texturesArena, meshDataArena, &gObjectId, .01f);
-    u32 sphereIndex = AddModel("sphere.fbx", transientInfo, gBitangentElemCounts, myArraySize(gBitangentElemCounts),
-                               texturesArena, meshDataArena, &gObjectId);
-    transientInfo->sphereModel = &transientInfo->models[sphereIndex];
-    // TODO: remove this once per-mesh relative transform is once again accounted for.
-    transientInfo->sphereModel->scale = glm::vec3(50.f);
+    ZoneScoped;
+    ParallelFor(gJobSystem, transientInfo->objects.count, 256, SetObjectTransformsJob, &transientInfo->objects,
+                "Object transforms");
+    ParallelFor(gJobSystem, transientInfo->models.count, 64, SetModelTransformsJob, &transientInfo->models,
+                "Model transforms");
+}
+
+/***********************************************************************************************************************
+ *
+ * Mesh handling.
+ *
+ **********************************************************************************************************************/
+
+// Starts streaming the models in, see: StartLoadingModel().
+internal void LoadModels(TransientDrawingInfo *transientInfo, AssetLoading *loading)
+{
+    u32 *objectId = &transientInfo->nextObjectId;
+    ModelHandle backpack = StartLoadingModel("backpack.obj", loading, objectId);
+    ModelHandle planet = StartLoadingModel("planet.obj", loading, objectId);
+    ModelHandle rock = StartLoadingModel("rock.obj", loading, objectId);
+    ModelHandle deccerCubes = StartLoadingModel("SM_Deccer_Cubes_Textured_Complex.fbx", loading, objectId, .01f);
+    // TODO: scale back to 1 once per-mesh relative transform is once again accounted for.
+    transientInfo->sphereModel = StartLoadingModel("sphere.fbx", loading, objectId, 50.f);
 
     return;
 
     /*
-    AddModelToShaderPass(&transientInfo->dirDepthMapShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->spotDepthMapShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->pointDepthMapShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->gBufferShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->geometryShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->ssaoShader, backpackIndex);
-    AddModelToShaderPass(&transientInfo->ssaoBlurShader, backpackIndex);
+    PoolGet(&transientInfo->models, backpack)->shaderPasses |=
+        SHADER_PASS_DIR_DEPTH_MAP | SHADER_PASS_SPOT_DEPTH_MAP | SHADER_PASS_POINT_DEPTH_MAP | SHADER_PASS_GBUFFER |
+        SHADER_PASS_GEOMETRY | SHADER_PASS_SSAO | SHADER_PASS_SSAO_BLUR;
     */
 }
 
@@ -181,31 +355,24 @@ internal void LoadCube(TransientDrawingInfo *transientInfo, Arena *texturesArena
     fclose(rectFile);
     CalculateTangents((Vertex *)rectVertices, 24, rectIndices, 36, texturesArena);
 
-    transientInfo->cubeVao = CreateVAO(rectVertices, sizeof(rectVertices), gBitangentElemCounts,
-                                       myArraySize(gBitangentElemCounts), rectIndices, sizeof(rectIndices));
-}
+    transientInfo->cube = CreateGeometry(&transientInfo->geometry, (Vertex *)rectVertices, 24, rectIndices, 36);
 
-internal void AddCube(TransientDrawingInfo *info, glm::ivec3 position)
-{
+    // NOTE: every cube shares the textures and their material, rather than using up a material slot of its own.
     Material cubeTextures = {};
     cubeTextures.diffuse = CreateTexture("window.png", TextureType::Diffuse, GL_CLAMP_TO_EDGE);
     cubeTextures.normals = CreateTexture("flat_surface_normals.png", TextureType::Normals);
+    transientInfo->cubeTextures = CreateTextureHandlesFromMaterial(&cubeTextures);
+    transientInfo->cubeMaterial = UploadMaterials(&transientInfo->geometry, &transientInfo->cubeTextures, 1);
+}
 
-    Cubes *cubes = &info->cubes;
-    u32 i = cubes->numCubes;
-
-    cubes->positions[i] = position;
-    cubes->textures[i] = CreateTextureHandlesFromMaterial(&cubeTextures);
-
-    u32 curi = AddObject(info, info->cubeVao, 36, position, &gObjectId, &cubeTextures);
-    AddObjectToShaderPass(&info->dirDepthMapShader, curi);
-    AddObjectToShaderPass(&info->spotDepthMapShader, curi);
-    AddObjectToShaderPass(&info->pointDepthMapShader, curi);
-    AddObjectToShaderPass(&info->gBufferShader, curi);
-    AddObjectToShaderPass(&info->ssaoShader, curi);
-    AddObjectToShaderPass(&info->ssaoBlurShader, curi);
-
-    cubes->numCubes++;
+internal void AddCube(TransientDrawingInfo *info, glm::ivec3 position)
+{
+    Cube *cube = PoolGet(&info->cubes, PoolAlloc(&info->cubes));
+    cube->position = position;
+    cube->object = AddObject(info, info->cube, position, &info->nextObjectId, &info->cubeTextures, info->cubeMaterial);
+    PoolGet(&info->objects, cube->object)->shaderPasses =
+        SHADER_PASS_DIR_DEPTH_MAP | SHADER_PASS_SPOT_DEPTH_MAP | SHADER_PASS_POINT_DEPTH_MAP | SHADER_PASS_GBUFFER |
+        SHADER_PASS_SSAO | SHADER_PASS_SSAO_BLUR;
 }
 
 internal void CreateQuad(TransientDrawingInfo *transientInfo, Arena *texturesArena)
@@ -244,9 +411,7 @@ internal void CreateQuad(TransientDrawingInfo *transientInfo, Arena *texturesAre
                               }};
     u32 quadIndices[] = {0, 1, 3, 1, 2, 3};
     CalculateTangents(quadVertices, 4, quadIndices, 6, texturesArena);
-    u32 mainQuadVao = CreateVAO((f32 *)quadVertices, sizeof(quadVertices), gBitangentElemCounts,
-                                myArraySize(gBitangentElemCounts), quadIndices, sizeof(quadIndices));
-    transientInfo->quadVao = mainQuadVao;
+    transientInfo->quad = CreateGeometry(&transientInfo->geometry, quadVertices, 4, quadIndices, 6);
 }
 
 /***********************************************************************************************************************
@@ -259,8 +424,6 @@ internal void CreateQuad(TransientDrawingInfo *transientInfo, Arena *texturesAre
 extern "C" __declspec(dllexport) bool InitializeDrawingInfo(HWND window, TransientDrawingInfo *transientInfo,
                                                             PersistentDrawingInfo *drawingInfo, CameraInfo *cameraInfo)
 {
-    u64 arenaSize = 100 * 1024 * 1024;
-
     // Create shaders.
     if (!CreateShaderPrograms(transientInfo))
     {
@@ -269,14 +432,40 @@ extern "C" __declspec(dllexport) bool InitializeDrawingInfo(HWND window, Transie
 
     // Load meshes.
     {
+        InitPool(&transientInfo->objects, OBJECT_POOL_CAPACITY, "Objects");
+        InitPool(&transientInfo->models, MODEL_POOL_CAPACITY, "Models");
+        InitPool(&transientInfo->cubes, CUBE_POOL_CAPACITY, "Cubes");
+        // NOTE: the map is sized up front so that it never grows, which would abandon its old arrays in the arena.
+        // HashMapInsert() clears out tombstones in place, rather than growing, as long as the keys fill at most half
+        // of its max count: a map which holds twice the keys of a full object pool leaves that much room (with 2^16
+        // objects, a capacity of 2^18 slots, rehashing in place up to 114688 keys). The arena only commits what the
+        // IDs touch.
+        u32 objectIdsCapacity = GetHashMapCapacity(2 * OBJECT_POOL_CAPACITY);
+        myAssert(OBJECT_POOL_CAPACITY <= GetHashMapMaxCount(objectIdsCapacity) / 2);
+        u64 objectIdsSize = (u64)objectIdsCapacity * (1 + sizeof(u32) + sizeof(ObjectHandle));
+        Arena *objectIdsArena = AllocArena(objectIdsSize, "Object IDs");
+        InitHashMap(&transientInfo->objectsById, objectIdsArena, GetHashMapMaxCount(objectIdsCapacity));
+        myAssert(transientInfo->objectsById.capacity == objectIdsCapacity);
+        transientInfo->modelGeometryArena = AllocArena(256 * 1024 * 1024, "Model geometry");
+        CreateGeometryBuffer(&transientInfo->geometry);
+
+        // The models and the skybox stream in from the job system while the first frames are drawn with
+        // placeholders (see: UpdateAssetLoading()).
+        transientInfo->assetLoading = StartAssetLoading(transientInfo);
+        LoadModels(transientInfo, transientInfo->assetLoading);
+        Material placeholder = {};
+        placeholder.diffuse = CreateSolidColorTexture(128, 128, 128, TextureType::Diffuse, "Texture: placeholder");
+        placeholder.normals =
+            CreateSolidColorTexture(128, 128, 255, TextureType::Normals, "Texture: placeholder normals");
+        TextureHandles placeholderTextures = CreateTextureHandlesFromMaterial(&placeholder);
+        transientInfo->placeholderMaterial = UploadMaterials(&transientInfo->geometry, &placeholderTextures, 1);
+
         // TODO: sort out arena usage; don't use texturesArena for anything other than texture, or if you do
         // then rename it.
-        Arena *texturesArena = AllocArena(1024);
-        Arena *meshDataArena = AllocArena(100 * 1024 * 1024);
-        LoadModels(transientInfo, texturesArena, meshDataArena);
+        // NOTE: sizes are reservations, see: AllocArena().
+        Arena *texturesArena = AllocArena(64 * 1024, "Textures");
         LoadCube(transientInfo, texturesArena);
         CreateQuad(transientInfo, texturesArena);
-        FreeArena(meshDataArena);
         FreeArena(texturesArena);
     }
 
@@ -309,7 +498,7 @@ extern "C" __declspec(dllexport) bool InitializeDrawingInfo(HWND window, Transie
     {
         CreateFramebuffers(window, transientInfo);
 
-        CreateSkybox(transientInfo);
+        CreateSkybox(transientInfo, transientInfo->assetLoading);
         glDepthFunc(GL_LEQUAL); // All skybox points are given a depth of 1.f.
 
         u32 *matricesUBO = &transientInfo->matricesUBO;
@@ -319,10 +508,22 @@ extern "C" __declspec(dllexport) bool InitializeDrawingInfo(HWND window, Transie
         glNamedBufferData(*matricesUBO, 10 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
         glBindBufferBase(GL_UNIFORM_BUFFER, 0, *matricesUBO);
 
-        u32 *textureHandlesUBO = &transientInfo->textureHandlesUBO;
-        glCreateBuffers(1, textureHandlesUBO);
-        glNamedBufferData(*textureHandlesUBO, sizeof(TextureHandles) * MAX_MESHES_PER_MODEL, NULL, GL_STATIC_DRAW);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 1, *textureHandlesUBO);
+        u32 *frameCommandBuffer = &transientInfo->frameCommandBuffer;
+        glCreateBuffers(1, frameCommandBuffer);
+        glObjectLabel(GL_BUFFER, *frameCommandBuffer, -1, "Indirect buffer: frame");
+        glNamedBufferStorage(*frameCommandBuffer, MAX_FRAME_DRAW_COMMANDS * sizeof(DrawElementsIndirectCommand), NULL,
+                             GL_DYNAMIC_STORAGE_BIT);
+        u32 *frameCommandDrawsBuffer = &transientInfo->frameCommandDrawsBuffer;
+        glCreateBuffers(1, frameCommandDrawsBuffer);
+        glObjectLabel(GL_BUFFER, *frameCommandDrawsBuffer, -1, "SSBO: frame command draws");
+        glNamedBufferStorage(*frameCommandDrawsBuffer, MAX_FRAME_DRAW_COMMANDS * sizeof(u32), NULL,
+                             GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_COMMAND_DRAWS, *frameCommandDrawsBuffer);
+        u32 *frameDrawsBuffer = &transientInfo->frameDrawsBuffer;
+        glCreateBuffers(1, frameDrawsBuffer);
+        glObjectLabel(GL_BUFFER, *frameDrawsBuffer, -1, "SSBO: frame draws");
+        glNamedBufferStorage(*frameDrawsBuffer, MAX_FRAME_DRAWS * sizeof(DrawData), NULL, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_DRAWS, *frameDrawsBuffer);
 
         GenerateSSAOSamplesAndNoise(transientInfo);
     }
@@ -332,43 +533,14 @@ extern "C" __declspec(dllexport) bool InitializeDrawingInfo(HWND window, Transie
     return true;
 }
 
-// Returns true iff the given file has been modified since the given time.
-internal bool HasNewVersion(const char *filename, FILETIME *lastFileTime)
-{
-    HANDLE file = CreateFileA(filename, GENERIC_READ, 0, 0, OPEN_EXISTING, 0, 0);
-    FILETIME fileTime = {};
-    GetFileTime(file, 0, 0, &fileTime);
-    CloseHandle(file);
-
-    bool returnVal = (CompareFileTime(lastFileTime, &fileTime) != 0);
-    *lastFileTime = fileTime;
-    return returnVal;
-}
-
-// Returns true iff a new version of the given shader program is available.
-internal bool HasNewVersion(ShaderProgram *program)
+// Handles hot reloading of modified shaders, as reported by the platform layer (see: file_watcher.h).
+internal void CheckForNewShaders(ApplicationState *appState)
 {
-    bool hasGeometryShader = (strlen(program->geometryShaderFilename) > 0);
-    return HasNewVersion(program->vertexShaderFilename, &program->vertexShaderTime) ||
-           (hasGeometryShader && HasNewVersion(program->geometryShaderFilename, &program->geometryShaderTime)) ||
-           HasNewVersion(program->fragmentShaderFilename, &program->fragmentShaderTime);
-}
-
-// Handles hot reloading of modified shaders.
-internal void CheckForNewShaders(TransientDrawingInfo *info)
-{
-    if (HasNewVersion(&info->gBufferShader) || HasNewVersion(&info->ssaoShader) ||
-        HasNewVersion(&info->ssaoBlurShader) || HasNewVersion(&info->nonPointLightingShader) ||
-        HasNewVersion(&info->pointLightingShader) || HasNewVersion(&info->dirDepthMapShader) ||
-        HasNewVersion(&info->spotDepthMapShader) || HasNewVersion(&info->pointDepthMapShader) ||
-        HasNewVersion(&info->instancedObjectShader) || HasNewVersion(&info->colorShader) ||
-        HasNewVersion(&info->outlineShader) || HasNewVersion(&info->glassShader) ||
-        HasNewVersion(&info->textureShader) || HasNewVersion(&info->postProcessShader) ||
-        HasNewVersion(&info->skyboxShader) || HasNewVersion(&info->geometryShader) ||
-        HasNewVersion(&info->gaussianShader))
+    if (appState->shadersChanged)
     {
-        bool reloadedShaders = CreateShaderPrograms(info);
+        bool reloadedShaders = CreateShaderPrograms(&appState->transientInfo);
         myAssert(reloadedShaders);
+        appState->shadersChanged = false;
     }
 }
 
@@ -378,24 +550,14 @@ internal void CheckForNewShaders(TransientDrawingInfo *info)
  *
  **********************************************************************************************************************/
 
-internal void RenderObject(Object *object, u32 shaderProgram, u32 textureHandlesUBO, f32 yRot = 0.f, float scale = 1.f)
+// Draws the object on its own, through the per-draw uniforms of shaders which aren't those of a pass (see:
+// RenderShaderPass()), its program being bound already. Its matrices are set already (see: UpdateTransforms()).
+internal void RenderObject(Object *object, u32 shaderProgram, GeometryBuffer *geometry)
 {
-    glBindVertexArray(object->vao);
-
-    glNamedBufferSubData(textureHandlesUBO, 0, sizeof(object->textures), &object->textures);
-    SetShaderUniformInt(shaderProgram, "displace", object->textures.displacementHandle > 0);
-
-    // Model matrix: transforms vertices from local to world space.
-    glm::mat4 modelMatrix = glm::mat4(1.f);
-    modelMatrix = glm::translate(modelMatrix, object->position);
-    modelMatrix = glm::rotate(modelMatrix, yRot, glm::vec3(0.f, 1.f, 0.f));
-    modelMatrix = glm::scale(modelMatrix, glm::vec3(scale));
-    glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
-
-    SetShaderUniformMat4(shaderProgram, "modelMatrix", &modelMatrix);
-    SetShaderUniformMat3(shaderProgram, "normalMatrix", &normalMatrix);
-    SetShaderUniformUint(shaderProgram, "u_objectId", object->id);
-    glDrawElements(GL_TRIANGLES, object->numIndices, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(geometry->vao);
+    SetShaderUniformMat4(shaderProgram, "modelMatrix", &object->modelMatrix);
+    SetShaderUniformMat3(shaderProgram, "normalMatrix", &object->normalMatrix);
+    DrawGeometry(&object->geometry);
 }
 
 internal void RenderWithColorShader(TransientDrawingInfo *transientInfo, PersistentDrawingInfo *persistentInfo)
@@ -403,8 +565,6 @@ internal void RenderWithColorShader(TransientDrawingInfo *transientInfo, Persist
     u32 shaderProgram = transientInfo->colorShader.id;
     glUseProgram(shaderProgram);
 
-    glBindVertexArray(transientInfo->cubeVao);
-
     for (u32 lightIndex = 0; lightIndex < NUM_POINTLIGHTS; lightIndex++)
     {
         PointLight *curLight = &persistentInfo->pointLights[lightIndex];
@@ -417,15 +577,17 @@ internal void RenderWithColorShader(TransientDrawingInfo *transientInfo, Persist
 
         SetShaderUniformVec3(shaderProgram, "color", curLight->diffuse);
         // NOTE: id = 0 because we don't care about selecting outlines.
-        Object lightObject = {0, transientInfo->cubeVao, 36, curLight->position};
-        RenderObject(&lightObject, shaderProgram, transientInfo->textureHandlesUBO, 0.f, .1f);
+        Object lightObject = {0, transientInfo->cube, curLight->position};
+        SetObjectTransform(&lightObject, 0.f, .1f);
+        RenderObject(&lightObject, shaderProgram, &transientInfo->geometry);
 
         glStencilMask(0x00);
         glStencilFunc(GL_NOTEQUAL, 1, 0xff);
 
         glm::vec4 stencilColor = glm::vec4(0.f, 0.f, 1.f, 1.f);
         SetShaderUniformVec3(shaderProgram, "color", stencilColor);
-        RenderObject(&lightObject, shaderProgram, transientInfo->textureHandlesUBO, 0.f, .11f);
+        SetObjectTransform(&lightObject, 0.f, .11f);
+        RenderObject(&lightObject, shaderProgram, &transientInfo->geometry);
 
         glDisable(GL_STENCIL_TEST);
     }
@@ -443,64 +605,315 @@ void DrawScene(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo, Pers
                u32 fbo, HWND window, Arena *listArena, Arena *tempArena, bool dynamicEnvPass = false,
                RenderPassType passType = RenderPassType::Normal);
 
-internal void RenderModel(Model *model, u32 shaderProgram, u32 textureHandlesUBO, u32 skyboxTexture = 0,
-                          u32 numInstances = 1)
+// How far off from the full detail models may be drawn in a pass (see: SelectModelLod()). The projection scale turns
+// an error in world space into pixels, once divided by the distance for a perspective projection.
+struct LodSelection
 {
-    glUseProgram(shaderProgram);
-    glBindVertexArray(model->vao);
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, model->commandBuffer);
-    glNamedBufferSubData(textureHandlesUBO, 0, sizeof(model->textureHandleBuffer.handleGroups),
-                         model->textureHandleBuffer.handleGroups);
+    f32 projectionScale;
+    bool orthographic;
+    f32 maxErrorPixels; // 0 draws every model in full detail.
+};
 
-    // Model matrix: transforms vertices from local to world space.
-    glm::mat4 modelMatrix = glm::mat4(1.f);
-    modelMatrix = glm::translate(modelMatrix, model->position);
-    modelMatrix = glm::scale(modelMatrix, model->scale);
+// Pixels per world unit at a distance of 1, for a perspective projection which covers the given pixels.
+internal f32 GetPerspectiveProjectionScale(f32 fovRadians, f32 pixels)
+{
+    return pixels / (2.f * tanf(fovRadians / 2.f));
+}
 
-    // TODO: store relative transforms and textures somewhere indexed and shader-accessible.
-    // modelMatrix *= mesh->relativeTransform;
+// Picks the coarsest LOD of the model whose error stays within the pass' budget once projected, from the point of the
+// model's bounding sphere which is closest to the eye.
+internal u32 SelectModelLod(Model *model, glm::vec3 eye, LodSelection *selection)
+{
+    if (!model->loaded || selection->maxErrorPixels <= 0.f)
+    {
+        return 0;
+    }
 
-    glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+    f32 scale = fmaxf(model->scale.x, fmaxf(model->scale.y, model->scale.z));
+    f32 pixelsPerUnit = selection->projectionScale * scale;
+    if (!selection->orthographic)
+    {
+        // NOTE: an eye within the bounding sphere gets the error at 10cm.
+        f32 distance = glm::distance(eye, model->position) - model->boundingRadius * scale;
+        pixelsPerUnit /= fmaxf(distance, .1f);
+    }
 
-    SetShaderUniformMat4(shaderProgram, "modelMatrix", &modelMatrix);
-    SetShaderUniformMat3(shaderProgram, "normalMatrix", &normalMatrix);
+    u32 lod = 0;
+    while (lod + 1 < model->numLods && model->lodErrors[lod + 1] * pixelsPerUnit <= selection->maxErrorPixels)
+    {
+        lod++;
+    }
+    return lod;
+}
 
-    // TODO: just have a single command buffer and have each model keep an offset into it?
-    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, model->meshCount, 0);
+// Draws the model's meshes at the given LOD on their own, from its range of the geometry buffer's commands, or its
+// proxy while it's streaming in (see: Model::loaded), the geometry buffer's vertex array being bound.
+internal void DrawModelGeometry(TransientDrawingInfo *transientInfo, Model *model, u32 lod = 0)
+{
+    if (!model->loaded)
+    {
+        DrawGeometry(&transientInfo->cube);
+        return;
+    }
 
-    // TODO: figure out instanced rendering with MDI.
-    /*
-    for (u32 i = 0; i < model->meshCount; i++)
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, transientInfo->geometry.commandBuffer);
+    u64 commandsOffset = ((u64)model->firstCommand + lod * model->meshCount) * sizeof(DrawElementsIndirectCommand);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)commandsOffset, model->meshCount, 0);
+}
+
+// The commands a draw adds to its pass' multi-draw, see: ExecuteRenderQueue().
+internal u32 GetDrawCommandCount(RenderDraw *draw, TransientDrawingInfo *transientInfo)
+{
+    if (draw->meshletsCulled)
     {
-        if (numInstances == 1)
-        {
+        return draw->numMeshletCommands;
+    }
+    if (draw->kind == RenderDrawKind::Model)
+    {
+        Model *model = &transientInfo->models.items[draw->itemIndex];
+        return model->loaded ? model->meshCount : 1;
+    }
+    return 1;
+}
 
-            glDrawElements(GL_TRIANGLES, mesh->indicesSize / sizeof(u32), GL_UNSIGNED_INT, 0);
+internal void SetDrawData(DrawData *drawData, glm::mat4 *modelMatrix, glm::mat3 *normalMatrix, u32 objectId)
+{
+    drawData->modelMatrix = *modelMatrix;
+    for (u32 i = 0; i < 3; i++)
+    {
+        drawData->normalMatrix[i] = glm::vec4((*normalMatrix)[i], 0.f);
+    }
+    drawData->objectId = objectId;
+}
+
+// Writes the given entries of a sorted render queue to the frame's buffers, where they must fit, and draws them as a
+// single multi-draw through the geometry buffer, see: ExecuteRenderQueue().
+internal void ExecuteRenderBatch(RenderQueue *queue, u32 program, u32 firstEntry, u32 endEntry, u32 numCommands,
+                                 TransientDrawingInfo *transientInfo, DrawElementsIndirectCommand *meshletCommands,
+                                 Arena *arena)
+{
+    u32 numDraws = endEntry - firstEntry;
+    u32 firstCommand = transientInfo->frameBufferCommands;
+    u32 firstDraw = transientInfo->frameBufferDraws;
+    myAssert(firstCommand + numCommands <= MAX_FRAME_DRAW_COMMANDS && firstDraw + numDraws <= MAX_FRAME_DRAWS);
+
+    TempMemory temp = TempBegin(arena);
+    DrawElementsIndirectCommand *commands = PushArray<DrawElementsIndirectCommand>(arena, numCommands);
+    u32 *commandDraws = PushArray<u32>(arena, numCommands);
+    DrawData *draws = PushArray<DrawData>(arena, numDraws);
+    GeometryRange *cube = &transientInfo->cube;
+    u32 numWritten = 0;
+    for (u32 i = 0; i < numDraws; i++)
+    {
+        RenderDraw *draw = &queue->draws[queue->entries[firstEntry + i].drawIndex];
+        u32 drawFirstCommand = numWritten;
+        if (draw->kind == RenderDrawKind::Object)
+        {
+            Object *object = &transientInfo->objects.items[draw->itemIndex];
+            SetDrawData(&draws[i], &object->modelMatrix, &object->normalMatrix, object->id);
+            GeometryRange *range = &object->geometry;
+            commands[numWritten++] = {range->numIndices, 1, range->firstIndex, range->baseVertex, object->material};
         }
         else
         {
-            SetShaderUniformFloat(shaderProgram, "time", Win32GetTime());
-            glDrawElementsInstanced(GL_TRIANGLES, mesh->indicesSize / sizeof(u32), GL_UNSIGNED_INT, 0, numInstances);
+            Model *model = &transientInfo->models.items[draw->itemIndex];
+            SetDrawData(&draws[i], &model->modelMatrix, &model->normalMatrix, model->id);
+            if (draw->meshletsCulled)
+            {
+                // NOTE: the triangles drawn are counted by the culling.
+                memcpy(&commands[numWritten], &meshletCommands[draw->firstMeshletCommand],
+                       draw->numMeshletCommands * sizeof(DrawElementsIndirectCommand));
+                numWritten += draw->numMeshletCommands;
+            }
+            else if (model->loaded)
+            {
+                memcpy(&commands[numWritten], &model->commands[draw->lod * model->meshCount],
+                       model->meshCount * sizeof(DrawElementsIndirectCommand));
+                numWritten += model->meshCount;
+                transientInfo->numModelTriangles += model->lodTriangles[draw->lod];
+            }
+            else
+            {
+                commands[numWritten++] = {cube->numIndices, 1, cube->firstIndex, cube->baseVertex,
+                                          transientInfo->placeholderMaterial};
+                transientInfo->numModelTriangles += 12;
+            }
+        }
+        for (u32 j = drawFirstCommand; j < numWritten; j++)
+        {
+            commandDraws[j] = firstDraw + i;
         }
     }
-    */
+    myAssert(numWritten == numCommands);
+
+    glNamedBufferSubData(transientInfo->frameCommandBuffer, (u64)firstCommand * sizeof(DrawElementsIndirectCommand),
+                         numCommands * sizeof(DrawElementsIndirectCommand), commands);
+    glNamedBufferSubData(transientInfo->frameCommandDrawsBuffer, (u64)firstCommand * sizeof(u32),
+                         numCommands * sizeof(u32), commandDraws);
+    glNamedBufferSubData(transientInfo->frameDrawsBuffer, (u64)firstDraw * sizeof(DrawData),
+                         numDraws * sizeof(DrawData), draws);
+    transientInfo->frameBufferCommands += numCommands;
+    transientInfo->frameBufferDraws += numDraws;
+    transientInfo->numFrameCommands += numCommands;
+    transientInfo->numFrameDraws += numDraws;
+    TempEnd(temp);
+
+    glUseProgram(program);
+    // NOTE: gl_DrawID counts from 0 in every multi-draw.
+    SetShaderUniformUint(program, "u_firstCommand", firstCommand);
+    glBindVertexArray(transientInfo->geometry.vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, transientInfo->frameCommandBuffer);
+    u64 commandsOffset = (u64)firstCommand * sizeof(DrawElementsIndirectCommand);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)commandsOffset, numCommands, 0);
 }
 
-internal void RenderShaderPass(ShaderProgram *shaderProgram, TransientDrawingInfo *transientInfo)
+// Draws a sorted render queue (see: render_queue.h), whose draws all share a pass, with the pass' program as a
+// multi-draw through the geometry buffer. Every draw adds the commands of its model's meshes at its LOD, of its
+// meshlets which remain once culled (see: CullModelMeshlets()), or of its object or proxy, in the queue's order and
+// after the commands of the frame's previous passes. The vertex shaders find the draw's per-draw data (see: DrawData)
+// through the command, the base instance picking the textures.
+// A queue which doesn't fit in what's left of the frame's buffers is drawn in batches, the buffers starting over
+// whenever not even the next draw fits: GL orders those writes after the multi-draws which read the earlier commands.
+internal void ExecuteRenderQueue(RenderQueue *queue, u32 program, TransientDrawingInfo *transientInfo,
+                                 DrawElementsIndirectCommand *meshletCommands, Arena *arena)
 {
-    glUseProgram(shaderProgram->id);
+    u32 firstEntry = 0;
+    while (firstEntry < queue->count)
+    {
+        u32 commandRoom = MAX_FRAME_DRAW_COMMANDS - transientInfo->frameBufferCommands;
+        u32 drawRoom = MAX_FRAME_DRAWS - transientInfo->frameBufferDraws;
+        u32 endEntry = firstEntry;
+        u32 numCommands = 0;
+        while (endEntry < queue->count && endEntry - firstEntry < drawRoom)
+        {
+            u32 drawCommands = GetDrawCommandCount(&queue->draws[queue->entries[endEntry].drawIndex], transientInfo);
+            if (numCommands + drawCommands > commandRoom)
+            {
+                break;
+            }
+            numCommands += drawCommands;
+            endEntry++;
+        }
+
+        if (endEntry == firstEntry)
+        {
+            // NOTE: every draw fits in the empty buffers, see: CullModelMeshlets().
+            myAssert(transientInfo->frameBufferCommands > 0 || transientInfo->frameBufferDraws > 0);
+            transientInfo->frameBufferCommands = 0;
+            transientInfo->frameBufferDraws = 0;
+            continue;
+        }
+        ExecuteRenderBatch(queue, program, firstEntry, endEntry, numCommands, transientInfo, meshletCommands, arena);
+        firstEntry = endEntry;
+    }
+}
+
+// What a pass culls the meshlets of its models against (see: meshlet.h).
+struct MeshletCulling
+{
+    glm::mat4 viewProjection;
+    bool cones; // Only when the pass culls back faces.
+};
+
+// Culls the meshlets of the queue's models, and returns the commands of those which remain, pushed onto the arena, for
+// ExecuteRenderQueue() to draw. The culled commands of a queue are capped at what the frame's command buffer holds,
+// which bounds the memory the culling takes and lets every draw fit in a batch: models past the cap are drawn whole.
+internal DrawElementsIndirectCommand *CullModelMeshlets(RenderQueue *queue, TransientDrawingInfo *transientInfo,
+                                                        glm::vec3 eye, MeshletCulling *culling, Arena *arena)
+{
+    ZoneScoped;
+    MeshletCullDraw *cullDraws = PushArray<MeshletCullDraw>(arena, queue->count);
+    u32 *drawIndices = PushArray<u32>(arena, queue->count);
+    u32 room = MAX_FRAME_DRAW_COMMANDS;
+    u32 numCullDraws = 0;
+    u32 maxCommands = 0;
+    for (u32 i = 0; i < queue->count; i++)
+    {
+        RenderDraw *draw = &queue->draws[i];
+        Model *model = (draw->kind == RenderDrawKind::Model) ? &transientInfo->models.items[draw->itemIndex] : NULL;
+        if (!model || !model->loaded)
+        {
+            continue;
+        }
+        MeshletCullDraw *cullDraw = &cullDraws[numCullDraws];
+        cullDraw->blocks = model->meshletBlocks + model->lodMeshletBlocks[draw->lod];
+        cullDraw->numBlocks = model->lodMeshletBlocks[draw->lod + 1] - model->lodMeshletBlocks[draw->lod];
+        if (maxCommands + cullDraw->numBlocks * MESHLET_BLOCK_SIZE > room)
+        {
+            continue;
+        }
+        cullDraw->view = MakeMeshletCullView(culling->viewProjection, model->modelMatrix, eye, culling->cones);
+        maxCommands += cullDraw->numBlocks * MESHLET_BLOCK_SIZE;
+        drawIndices[numCullDraws++] = i;
+    }
+
+    DrawElementsIndirectCommand *commands = PushArray<DrawElementsIndirectCommand>(arena, maxCommands);
+    u32 numCommands = CullMeshletDraws(gJobSystem, cullDraws, numCullDraws, commands, arena);
+    for (u32 i = 0; i < numCullDraws; i++)
+    {
+        RenderDraw *draw = &queue->draws[drawIndices[i]];
+        draw->meshletsCulled = true;
+        draw->firstMeshletCommand = cullDraws[i].firstCommand;
+        draw->numMeshletCommands = cullDraws[i].numCommands;
+        transientInfo->numModelTriangles += cullDraws[i].numTriangles;
+    }
+    transientInfo->numMeshletCommands += numCommands;
+    return commands;
+}
 
-    for (u32 i = 0; i < shaderProgram->numObjects; i++)
+// Draws the objects and models which are part of the given pass (see: SHADER_PASS_GBUFFER) in a single multi-draw,
+// sorted by state and by distance to the eye (see: render_queue.h), the models at the LOD which the selection picks,
+// and only their meshlets which remain once culled when the pass culls them.
+internal void RenderShaderPass(ShaderProgram *shaderProgram, u32 pass, TransientDrawingInfo *transientInfo,
+                               glm::vec3 eye, LodSelection lodSelection = {}, MeshletCulling *meshletCulling = NULL)
+{
+    u32 passIndex = 0;
+    while ((pass >> passIndex) != 1)
+    {
+        passIndex++;
+    }
+    bool transparent = (pass == SHADER_PASS_GLASS);
+    u32 program = shaderProgram->id;
+
+    Pool<Object> *objects = &transientInfo->objects;
+    Pool<Model> *models = &transientInfo->models;
+    TempMemory scratch = GetScratch();
+    RenderQueue queue = BeginRenderQueue(scratch.arena, objects->count + models->count);
+    for (u32 i = 0; i < objects->count; i++)
+    {
+        Object *object = &objects->items[i];
+        if (object->shaderPasses & pass)
+        {
+            u32 material = GetDrawKeyMaterial(&object->textures, sizeof(object->textures));
+            f32 distance = glm::distance(eye, object->position);
+            u64 key = transparent ? MakeTransparentDrawKey(passIndex, material, distance)
+                                  : MakeOpaqueDrawKey(passIndex, material, distance);
+            PushRenderDraw(&queue, key, {RenderDrawKind::Object, i});
+        }
+    }
+    for (u32 i = 0; i < models->count; i++)
     {
-        u32 curIndex = shaderProgram->objectIndices[i];
-        Object *curObject = &transientInfo->objects[curIndex];
-        RenderObject(curObject, shaderProgram->id, transientInfo->textureHandlesUBO);
+        Model *model = &models->items[i];
+        if (model->shaderPasses & pass)
+        {
+            u32 material = GetDrawKeyMaterial(model->textureHandleBuffer.handleGroups,
+                                              model->meshCount * sizeof(TextureHandles));
+            f32 distance = glm::distance(eye, model->position);
+            u64 key = transparent ? MakeTransparentDrawKey(passIndex, material, distance)
+                                  : MakeOpaqueDrawKey(passIndex, material, distance);
+            u32 lod = SelectModelLod(model, eye, &lodSelection);
+            PushRenderDraw(&queue, key, {RenderDrawKind::Model, i, lod});
+        }
     }
-    for (u32 i = 0; i < shaderProgram->numModels; i++)
+
+    SortRenderQueue(&queue, scratch.arena);
+    DrawElementsIndirectCommand *meshletCommands = NULL;
+    if (meshletCulling)
     {
-        u32 curIndex = shaderProgram->modelIndices[i];
-        RenderModel(&transientInfo->models[curIndex], shaderProgram->id, transientInfo->textureHandlesUBO);
+        meshletCommands = CullModelMeshlets(&queue, transientInfo, eye, meshletCulling, scratch.arena);
     }
+    ExecuteRenderQueue(&queue, program, transientInfo, meshletCommands, scratch.arena);
+    TempEnd(scratch);
 }
 
 internal void FlipImage(u8 *data, s32 width, s32 height, u32 bytesPerPixel, Arena *arena)
@@ -526,13 +939,24 @@ internal void SetGBufferUniforms(u32 shaderProgram, PersistentDrawingInfo *persi
     SetShaderUniformFloat(shaderProgram, "heightScale", .1f);
 }
 
+// NOTE: the G-buffer pass draws back faces, which open and double-sided meshes need, whether meshlets are culled or
+// not; back-facing meshlets are culled (see: MeshletCulling::cones) only when the pass culls back faces.
+#define GBUFFER_CULL_BACK_FACES false
+
 internal void FillGBuffer(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
-                          PersistentDrawingInfo *persistentInfo)
+                          PersistentDrawingInfo *persistentInfo, LodSelection lodSelection,
+                          MeshletCulling *meshletCulling)
 {
     u32 shaderProgram = transientInfo->gBufferShader.id;
     SetGBufferUniforms(shaderProgram, persistentInfo, cameraInfo);
 
-    RenderShaderPass(&transientInfo->gBufferShader, transientInfo);
+    if (GBUFFER_CULL_BACK_FACES)
+    {
+        glEnable(GL_CULL_FACE);
+    }
+    RenderShaderPass(&transientInfo->gBufferShader, SHADER_PASS_GBUFFER, transientInfo, cameraInfo->pos,
+                     lodSelection, meshletCulling);
+    glDisable(GL_CULL_FACE);
 }
 
 internal void SetLightingShaderUniforms(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
@@ -582,10 +1006,10 @@ internal void RenderQuad(TransientDrawingInfo *transientInfo, u32 shaderProgram)
     glNamedBufferSubData(transientInfo->matricesUBO, 0, 64, &identity);
     glNamedBufferSubData(transientInfo->matricesUBO, 64, 64, &identity);
 
-    glBindVertexArray(transientInfo->quadVao);
+    glBindVertexArray(transientInfo->geometry.vao);
     glUseProgram(shaderProgram);
     SetShaderUniformMat4(shaderProgram, "modelMatrix", &identity);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    DrawGeometry(&transientInfo->quad);
 }
 
 internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
@@ -733,10 +1157,10 @@ internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *
         glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
         glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
 
-        Model *model = transientInfo->sphereModel;
+        // Until the sphere is loaded, the light volume is a cube around it.
+        Model *model = PoolGet(&transientInfo->models, transientInfo->sphereModel);
 
-        glBindVertexArray(model->vao);
-        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, model->commandBuffer);
+        glBindVertexArray(transientInfo->geometry.vao);
 
         glm::mat4 lightModelMatrix = glm::mat4(1.f);
         lightModelMatrix = glm::translate(lightModelMatrix, light.position);
@@ -746,7 +1170,7 @@ internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *
         f32 lightMax = fmax(fmax(light.diffuse.r, light.diffuse.g), light.diffuse.b);
         f32 radius = (-linear + sqrtf(linear * linear - 4.f * quadratic * (constant - (256.f / 5.f) * lightMax))) /
                      (2.f * quadratic);
-        lightModelMatrix = glm::scale(lightModelMatrix, glm::vec3(radius));
+        lightModelMatrix = glm::scale(lightModelMatrix, glm::vec3(model->loaded ? radius : 2.f * radius));
 
         // TODO: restore use of relativeTransform.
         // lightModelMatrix *= mesh->relativeTransform;
@@ -756,7 +1180,7 @@ internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *
         SetShaderUniformMat4(pointShader, "modelMatrix", &lightModelMatrix);
         SetShaderUniformMat3(pointShader, "normalMatrix", &lightNormalMatrix);
 
-        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, model->meshCount, 0);
+        DrawModelGeometry(transientInfo, model);
 
         glColorMask(0xff, 0xff, 0xff, 0xff);
 
@@ -778,7 +1202,7 @@ internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *
 
         glBindTextureUnit(17, transientInfo->pointShadowMapQuad[lightIndex]);
 
-        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, model->meshCount, 0);
+        DrawModelGeometry(transientInfo, model);
 
         glCullFace(GL_BACK);
         glDisable(GL_CULL_FACE);
@@ -790,14 +1214,14 @@ internal void ExecuteLightingPass(CameraInfo *cameraInfo, TransientDrawingInfo *
     glPopDebugGroup();
 }
 
-internal void RenderWithGeometryShader(TransientDrawingInfo *transientInfo)
+internal void RenderWithGeometryShader(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo)
 {
     u32 shaderProgram = transientInfo->geometryShader.id;
     glUseProgram(shaderProgram);
 
     SetShaderUniformVec3(shaderProgram, "color", glm::vec3(1.f, 1.f, 0.f));
 
-    RenderShaderPass(&transientInfo->geometryShader, transientInfo);
+    RenderShaderPass(&transientInfo->geometryShader, SHADER_PASS_GEOMETRY, transientInfo, cameraInfo->pos);
 }
 
 internal void RenderWithTextureShader(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
@@ -810,38 +1234,18 @@ internal void RenderWithTextureShader(CameraInfo *cameraInfo, TransientDrawingIn
     SetShaderUniformVec3(shaderProgram, "cameraPos", cameraInfo->pos);
 
     glEnable(GL_CULL_FACE);
-    RenderShaderPass(&transientInfo->textureShader, transientInfo);
+    RenderShaderPass(&transientInfo->textureShader, SHADER_PASS_TEXTURE, transientInfo, cameraInfo->pos);
     glDisable(GL_CULL_FACE);
 }
 
-internal void RenderWithGlassShader(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
-                                    PersistentDrawingInfo *persistentInfo, Arena *listArena, Arena *tempArena)
+// Draws the objects in the glass pass, blended back to front.
+internal void RenderWithGlassShader(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo)
 {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    u32 shaderProgram = transientInfo->glassShader.id;
-    glUseProgram(shaderProgram);
-
     glBindTextureUnit(11, transientInfo->skyboxTexture);
-
-    SkipList list = CreateNewList(listArena);
-    // TODO: account for in refactor.
-    // for (u32 i = 0; i < NUM_CUBES; i++)
-    // {
-    //     f32 dist = glm::distance(cameraInfo->pos, persistentInfo->windowPos[i]);
-    //     Insert(&list, dist, persistentInfo->windowPos[i], listArena, tempArena);
-    // }
-
-    // for (u32 i = 0; i < NUM_CUBES; i++)
-    // {
-    //     glm::vec3 pos = GetValue(&list, i);
-
-    //     RenderObject(transientInfo->mainQuadVao, 6, pos, shaderProgram, cameraInfo->yaw);
-    // }
-    ArenaClear(listArena);
-    memset(listArena->memory, 0, listArena->size);
-    ArenaClear(tempArena);
+    RenderShaderPass(&transientInfo->glassShader, SHADER_PASS_GLASS, transientInfo, cameraInfo->pos);
 
     glDisable(GL_BLEND);
 }
@@ -887,10 +1291,12 @@ void DrawScene(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo, Pers
     // 90 degrees.
     f32 dirLightNearPlaneDistance = 1.f;
     f32 dirLightFarPlaneDistance = 7.5f;
+    f32 dirLightHalfExtent = 10.f;
     glm::vec3 dirEye = glm::vec3(0.f) - glm::normalize(persistentInfo->dirLight.direction) * 5.f;
     glm::mat4 dirLightViewMatrix = glm::lookAt(dirEye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
     glm::mat4 dirLightProjectionMatrix =
-        glm::ortho(-10.f, 10.f, -10.f, 10.f, dirLightNearPlaneDistance, dirLightFarPlaneDistance);
+        glm::ortho(-dirLightHalfExtent, dirLightHalfExtent, -dirLightHalfExtent, dirLightHalfExtent,
+                   dirLightNearPlaneDistance, dirLightFarPlaneDistance);
     glm::mat4 dirLightSpaceMatrix = dirLightProjectionMatrix * dirLightViewMatrix;
 
     glm::mat4 viewMatrix, projectionMatrix;
@@ -906,17 +1312,35 @@ void DrawScene(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo, Pers
     glNamedBufferSubData(transientInfo->matricesUBO, 128, 64, &dirLightSpaceMatrix);
     glNamedBufferSubData(transientInfo->matricesUBO, 192, 64, &spotLightSpaceMatrix);
 
+    // LODs are picked against the resolution of the pass' target. Shadow maps get coarser ones, since they only show
+    // in the outlines of the shadows, which filtering blurs anyway.
+    f32 shadowLodErrorPixels = persistentInfo->lodErrorPixels * LOD_SHADOW_ERROR_SCALE;
+    // Meshlets are culled against the frustum of the pass, and against the eye in the G-buffer pass, the only one which
+    // culls back faces. The point shadow pass renders every direction at once, so it draws its models whole.
+    bool meshletCulling = persistentInfo->meshletCulling;
     if (passType == RenderPassType::DirShadowMap)
     {
-        RenderShaderPass(&transientInfo->dirDepthMapShader, transientInfo);
+        LodSelection lodSelection = {DIR_SHADOW_MAP_SIZE / (2.f * dirLightHalfExtent), true, shadowLodErrorPixels};
+        MeshletCulling culling = {dirLightSpaceMatrix, false};
+        RenderShaderPass(&transientInfo->dirDepthMapShader, SHADER_PASS_DIR_DEPTH_MAP, transientInfo, dirEye,
+                         lodSelection, meshletCulling ? &culling : NULL);
     }
     else if (passType == RenderPassType::SpotShadowMap)
     {
-        RenderShaderPass(&transientInfo->spotDepthMapShader, transientInfo);
+        // NOTE: the spot light's shadow map is rendered with the camera's projection.
+        LodSelection lodSelection = {
+            GetPerspectiveProjectionScale(glm::radians(cameraInfo->fov), DIR_SHADOW_MAP_SIZE), false,
+            shadowLodErrorPixels};
+        MeshletCulling culling = {spotLightSpaceMatrix, false};
+        RenderShaderPass(&transientInfo->spotDepthMapShader, SHADER_PASS_SPOT_DEPTH_MAP, transientInfo, spotEye,
+                         lodSelection, meshletCulling ? &culling : NULL);
     }
     else if (passType == RenderPassType::PointShadowMap)
     {
-        RenderShaderPass(&transientInfo->pointDepthMapShader, transientInfo);
+        LodSelection lodSelection = {GetPerspectiveProjectionScale(PI / 2.f, POINT_SHADOW_MAP_SIZE), false,
+                                     shadowLodErrorPixels};
+        RenderShaderPass(&transientInfo->pointDepthMapShader, SHADER_PASS_POINT_DEPTH_MAP, transientInfo,
+                         cameraInfo->pos, lodSelection);
     }
     else
     {
@@ -930,17 +1354,23 @@ void DrawScene(CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo, Pers
         glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
         // G-buffer pass.
-        FillGBuffer(cameraInfo, transientInfo, persistentInfo);
+        RECT clientRect;
+        GetClientRect(window, &clientRect);
+        LodSelection lodSelection = {
+            GetPerspectiveProjectionScale(glm::radians(cameraInfo->fov), (f32)clientRect.bottom), false,
+            persistentInfo->lodErrorPixels};
+        MeshletCulling culling = {projectionMatrix * viewMatrix, GBUFFER_CULL_BACK_FACES};
+        FillGBuffer(cameraInfo, transientInfo, persistentInfo, lodSelection, meshletCulling ? &culling : NULL);
 
         glDisable(GL_STENCIL_TEST);
 
-        // RenderWithGeometryShader(transientInfo);
+        // RenderWithGeometryShader(cameraInfo, transientInfo);
 
         // Textured cubes.
         // RenderWithTextureShader(cameraInfo, transientInfo, persistentInfo);
 
         // Windows.
-        // RenderWithGlassShader(cameraInfo, transientInfo, persistentInfo, listArena, tempArena);
+        // RenderWithGlassShader(cameraInfo, transientInfo);
     }
 
     glPopDebugGroup();
@@ -960,30 +1390,35 @@ void DrawEditorMenu(ApplicationState *appState, CameraInfo *cameraInfo)
         *playing = !*playing;
         if (*playing)
         {
-            // TODO: fix this disgusting hard-coding. Model-related functions should really be
-            // operating with Model pointers, not indices. See also:
-            // - note in Model struct;
-            // - note + todo above AddModelToShaderPass().
+            // TODO: see note in Model struct.
             transientInfo->ball.model = transientInfo->sphereModel;
-            transientInfo->models[4].position = transientInfo->ball.position;
-            AddModelToShaderPass(&transientInfo->dirDepthMapShader, 4);
-            AddModelToShaderPass(&transientInfo->spotDepthMapShader, 4);
-            AddModelToShaderPass(&transientInfo->pointDepthMapShader, 4);
-            AddModelToShaderPass(&transientInfo->gBufferShader, 4);
-            AddModelToShaderPass(&transientInfo->geometryShader, 4);
-            AddModelToShaderPass(&transientInfo->ssaoShader, 4);
-            AddModelToShaderPass(&transientInfo->ssaoBlurShader, 4);
+            Model *ballModel = PoolGet(&transientInfo->models, transientInfo->ball.model);
+            ballModel->position = transientInfo->ball.position;
+            appState->simulation.current.ballPos = transientInfo->ball.position;
+            appState->simulation.current.ballTarget = transientInfo->ball.position;
+            ResetSimulationState(&appState->simulation);
+            ballModel->shaderPasses |= SHADER_PASS_DIR_DEPTH_MAP | SHADER_PASS_SPOT_DEPTH_MAP |
+                                       SHADER_PASS_POINT_DEPTH_MAP | SHADER_PASS_GBUFFER | SHADER_PASS_GEOMETRY |
+                                       SHADER_PASS_SSAO | SHADER_PASS_SSAO_BLUR;
         }
     }
 
-    ImGui::SliderFloat3("Camera position", glm::value_ptr(cameraInfo->pos), -150.f, 150.f);
+    Simulation *simulation = &appState->simulation;
+    if (ImGui::SliderFloat3("Camera position", glm::value_ptr(simulation->current.cameraPos), -150.f, 150.f))
+    {
+        ResetSimulationState(simulation);
+    }
     ImGui::SliderFloat2("Camera rotation", &cameraInfo->yaw, -PI, PI);
     if (ImGui::Button("Reset camera"))
     {
-        cameraInfo->pos = glm::vec3(0.f);
+        simulation->current.cameraPos = glm::vec3(0.f);
+        ResetSimulationState(simulation);
         cameraInfo->yaw = 0.f;
         cameraInfo->pitch = 0.f;
     }
+    ImGui::SliderFloat("Simulation rate (Hz)", &simulation->rate, 10.f, 240.f);
+    ImGui::Checkbox("Show frame timings", &appState->telemetry.showOverlay);
+    ImGui::Checkbox("Show memory", &appState->telemetry.showMemoryPanel);
 
     ImGui::Separator();
 
@@ -991,6 +1426,11 @@ void DrawEditorMenu(ApplicationState *appState, CameraInfo *cameraInfo)
     ImGui::SliderFloat("Exposure", &persistentInfo->exposure, 0.f, 5.f);
     ImGui::SliderFloat("SSAO sampling radius", &persistentInfo->ssaoSamplingRadius, 0.f, 1.f);
     ImGui::SliderFloat("SSAO power", &persistentInfo->ssaoPower, 0.f, 8.f);
+    ImGui::SliderFloat("LOD error (pixels)", &persistentInfo->lodErrorPixels, 0.f, 8.f);
+    ImGui::Checkbox("Meshlet culling", &persistentInfo->meshletCulling);
+    ImGui::Text("Model triangles: %llu, meshlets: %u", (unsigned long long)transientInfo->numModelTriangles,
+                transientInfo->numMeshletCommands);
+    ImGui::Text("Draw commands: %u, draws: %u", transientInfo->numFrameCommands, transientInfo->numFrameDraws);
 
     ImGui::Separator();
 
@@ -1018,16 +1458,16 @@ void DrawEditorMenu(ApplicationState *appState, CameraInfo *cameraInfo)
 
     if (ImGui::CollapsingHeader("Positions"))
     {
-        for (u32 i = 0; i < transientInfo->numModels; i++)
+        for (u32 i = 0; i < transientInfo->models.count; i++)
         {
             ImGui::PushID(id++);
-            ImGui::SliderFloat3("Position", glm::value_ptr(transientInfo->models[i].position), -10.f, 10.f);
+            ImGui::SliderFloat3("Position", glm::value_ptr(transientInfo->models.items[i].position), -10.f, 10.f);
             ImGui::PopID();
         }
-        for (u32 i = 0; i < transientInfo->numObjects; i++)
+        for (u32 i = 0; i < transientInfo->objects.count; i++)
         {
             ImGui::PushID(id++);
-            ImGui::SliderFloat3("Position", glm::value_ptr(transientInfo->objects[i].position), -10.f, 10.f);
+            ImGui::SliderFloat3("Position", glm::value_ptr(transientInfo->objects.items[i].position), -10.f, 10.f);
             ImGui::PopID();
         }
     }
@@ -1100,6 +1540,173 @@ void DrawEditorMenu(ApplicationState *appState, CameraInfo *cameraInfo)
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+// Frame timing overlay. Percentiles rather than averages, so that hitches such as shader hot reloads or picking
+// readbacks remain visible.
+internal void DrawFrameTimings(FrameTelemetry *telemetry)
+{
+    if (!telemetry->showOverlay)
+    {
+        return;
+    }
+
+    ImGui::SetNextWindowBgAlpha(.7f);
+    if (!ImGui::Begin("Frame timings", &telemetry->showOverlay, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::BeginTable("Timings", 6, ImGuiTableFlags_RowBg))
+    {
+        const char *headers[] = {"(ms)", "last", "p50", "p95", "p99", "max"};
+        for (u32 i = 0; i < myArraySize(headers); i++)
+        {
+            ImGui::TableSetupColumn(headers[i]);
+        }
+        ImGui::TableHeadersRow();
+
+        for (u32 i = 0; i < (u32)FrameTimingCategory::Count; i++)
+        {
+            TimingHistogram *histogram = &telemetry->histograms[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(GetFrameTimingCategoryName((FrameTimingCategory)i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", telemetry->lastMs[i]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", GetTimingPercentile(histogram, .5f));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", GetTimingPercentile(histogram, .95f));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", GetTimingPercentile(histogram, .99f));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", histogram->maxMs);
+        }
+        ImGui::EndTable();
+    }
+
+    if (telemetry->fullyLoadedMs > 0.f)
+    {
+        ImGui::Text("Startup: first frame %.1f ms, fully loaded %.1f ms", telemetry->firstFrameMs,
+                    telemetry->fullyLoadedMs);
+    }
+    else
+    {
+        ImGui::Text("Startup: first frame %.1f ms, streaming assets...", telemetry->firstFrameMs);
+    }
+    ImGui::PlotLines("Frame", telemetry->frameHistory, FRAME_TIMING_HISTORY, telemetry->frameHistoryIndex, NULL, 0.f,
+                     50.f, ImVec2(0.f, 60.f));
+    if (ImGui::Button("Reset"))
+    {
+        ResetFrameTelemetry(telemetry);
+    }
+
+    ImGui::End();
+}
+
+internal void FormatBytes(u64 bytes, char *outString, u32 outStringSize)
+{
+    if (bytes >= 1024 * 1024)
+    {
+        snprintf(outString, outStringSize, "%.1f MB", bytes / (1024.f * 1024.f));
+    }
+    else if (bytes >= 1024)
+    {
+        snprintf(outString, outStringSize, "%.1f KB", bytes / 1024.f);
+    }
+    else
+    {
+        snprintf(outString, outStringSize, "%llu B", (unsigned long long)bytes);
+    }
+}
+
+internal void MemoryPanelBytesColumn(u64 bytes)
+{
+    char text[32];
+    FormatBytes(bytes, text, sizeof(text));
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted(text);
+}
+
+// Memory panel: every registered arena with its current, peak, committed and reserved size, plus how many pushes
+// and OS memory calls the last frame made, which should stay flat once the scene is loaded.
+internal void DrawMemoryPanel(FrameTelemetry *telemetry, ArenaRegistry *registry)
+{
+    if (!telemetry->showMemoryPanel)
+    {
+        return;
+    }
+
+    ImGui::SetNextWindowBgAlpha(.7f);
+    if (!ImGui::Begin("Memory", &telemetry->showMemoryPanel, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Last frame: %llu arena pushes, %llu OS memory calls", (unsigned long long)registry->framePushes,
+                (unsigned long long)registry->frameOsCalls);
+    ImGui::PlotLines("Pushes", registry->framePushesHistory, FRAME_TIMING_HISTORY,
+                     registry->framePushesHistoryIndex, NULL, 0.f, FLT_MAX, ImVec2(0.f, 40.f));
+
+    u64 totalCommitted = 0;
+    u64 totalReserved = 0;
+    if (ImGui::BeginTable("Arenas", 7, ImGuiTableFlags_RowBg))
+    {
+        const char *headers[] = {"arena", "used", "peak", "committed", "reserved", "pushes", "backing"};
+        for (u32 i = 0; i < myArraySize(headers); i++)
+        {
+            ImGui::TableSetupColumn(headers[i]);
+        }
+        ImGui::TableHeadersRow();
+
+        // NOTE: the owning threads keep updating these as we read them, which is fine for display purposes.
+        LockArenaRegistry(registry);
+        for (Arena *arena = registry->arenas; arena; arena = arena->next)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(arena->name);
+            MemoryPanelBytesColumn(arena->stackPointer);
+            MemoryPanelBytesColumn(arena->peak);
+            MemoryPanelBytesColumn(arena->committed);
+            MemoryPanelBytesColumn(GetArenaReservedSize(arena));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)arena->numPushes);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(GetArenaBackingName(arena->backing));
+            totalCommitted += arena->committed;
+            totalReserved += GetArenaReservedSize(arena);
+        }
+        for (ConcurrentArena *arena = registry->concurrentArenas; arena; arena = arena->next)
+        {
+            u64 committed = arena->committed.load(std::memory_order_relaxed);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(arena->name);
+            MemoryPanelBytesColumn(GetConcurrentArenaUsed(arena));
+            ImGui::TableNextColumn();
+            MemoryPanelBytesColumn(committed);
+            MemoryPanelBytesColumn(GetConcurrentArenaReservedSize(arena));
+            ImGui::TableNextColumn();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(GetArenaBackingName(ArenaBacking::Pages));
+            totalCommitted += committed;
+            totalReserved += GetConcurrentArenaReservedSize(arena);
+        }
+        UnlockArenaRegistry(registry);
+        ImGui::EndTable();
+    }
+
+    char committedText[32];
+    char reservedText[32];
+    FormatBytes(totalCommitted, committedText, sizeof(committedText));
+    FormatBytes(totalReserved, reservedText, sizeof(reservedText));
+    ImGui::Text("Total: %s committed, %s reserved", committedText, reservedText);
+
+    ImGui::End();
+}
+
 internal void DrawSkybox(TransientDrawingInfo *transientInfo, CameraInfo *cameraInfo, s32 width, s32 height)
 {
     // Draw skybox where geometry rendering pass did not set stencil value to 1.
@@ -1125,11 +1732,11 @@ internal void DrawSkybox(TransientDrawingInfo *transientInfo, CameraInfo *camera
     glNamedBufferSubData(transientInfo->matricesUBO, 0, 64, &skyboxViewMatrix);
     glNamedBufferSubData(transientInfo->matricesUBO, 64, 64, &projectionMatrix);
 
-    glBindVertexArray(transientInfo->cubeVao);
+    glBindVertexArray(transientInfo->geometry.vao);
     glBindTextureUnit(10, transientInfo->skyboxTexture);
 
     glBindFramebuffer(GL_FRAMEBUFFER, blitDest);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    DrawGeometry(&transientInfo->cube);
 
     glDisable(GL_STENCIL_TEST);
 
@@ -1184,12 +1791,10 @@ internal void ExecuteSSAOPass(TransientDrawingInfo *transientInfo, PersistentDra
     glPopDebugGroup();
 }
 
-extern "C" __declspec(dllexport) void DrawWindow(HWND window, HDC hdc, ApplicationState *appState, Arena *listArena,
+extern "C" __declspec(dllexport) void DrawWindow(HWND window, ApplicationState *appState, Arena *listArena,
                                                  Arena *tempArena)
 {
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplWin32_NewFrame();
-    ImGui::NewFrame();
+    ImGuiNewFrame(window);
 
     TransientDrawingInfo *transientInfo = &appState->transientInfo;
     PersistentDrawingInfo *persistentInfo = &appState->persistentInfo;
@@ -1200,7 +1805,16 @@ extern "C" __declspec(dllexport) void DrawWindow(HWND window, HDC hdc, Applicati
         return;
     }
 
-    CheckForNewShaders(transientInfo);
+    CheckForNewShaders(appState);
+    InterpolateSimulationState(appState);
+    UpdateTransforms(transientInfo);
+    UpdateAssetLoading(transientInfo, &appState->telemetry);
+    transientInfo->numModelTriangles = 0;
+    transientInfo->numMeshletCommands = 0;
+    transientInfo->numFrameCommands = 0;
+    transientInfo->numFrameDraws = 0;
+    transientInfo->frameBufferCommands = 0;
+    transientInfo->frameBufferDraws = 0;
 
     RECT clientRect;
     GetClientRect(window, &clientRect);
@@ -1358,15 +1972,11 @@ extern "C" __declspec(dllexport) void DrawWindow(HWND window, HDC hdc, Applicati
         glPopDebugGroup();
     }
 
-    DrawEditorMenu(appState, cameraInfo);
+    EndArenaFrame(gArenaRegistry);
 
-    if (!SwapBuffers(hdc))
-    {
-        if (MessageBoxW(window, L"Failed to swap buffers", L"OpenGL error", MB_OK) == S_OK)
-        {
-            appState->running = false;
-        }
-    }
+    DrawFrameTimings(&appState->telemetry);
+    DrawMemoryPanel(&appState->telemetry, gArenaRegistry);
+    DrawEditorMenu(appState, cameraInfo);
 
     TracyGpuCollect;
 }
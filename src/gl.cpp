@@ -1,41 +1,23 @@
 #include "arena.h"
 #include "common.h"
+#include "range_allocator.h"
+#include "render.h"
+#include "vertex.h"
 
-internal u32 CreateVAO(VaoInformation *vaoInfo)
+// Binds the vertex buffer to binding 0 of the vertex array, with the attributes the vertex shaders unpack (see:
+// PackedVertex).
+internal void SetPackedVertexFormat(u32 vao, u32 vbo)
 {
-    u32 vao;
-    glCreateVertexArrays(1, &vao);
+    glVertexArrayVertexBuffer(vao, 0, vbo, 0, sizeof(PackedVertex));
 
-    u32 vbo;
-    glCreateBuffers(1, &vbo);
-    glNamedBufferData(vbo, vaoInfo->verticesSize, vaoInfo->vertices, GL_STATIC_DRAW);
-
-    u32 ebo;
-    glCreateBuffers(1, &ebo);
-    glNamedBufferData(ebo, vaoInfo->indicesSize, vaoInfo->indices, GL_STATIC_DRAW);
-
-    u32 total = 0;
-    for (u32 elemCount = 0; elemCount < vaoInfo->elementCountsSize; elemCount++)
-    {
-        total += vaoInfo->elemCounts[elemCount];
-    }
-
-    glVertexArrayVertexBuffer(vao, 0, vbo, 0, total * sizeof(float));
-    glVertexArrayElementBuffer(vao, ebo);
-
-    u32 accumulator = 0;
-    for (u32 index = 0; index < vaoInfo->elementCountsSize; index++)
+    glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, position));
+    glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, tangentFrame));
+    glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoords));
+    for (u32 i = 0; i < 3; i++)
     {
-        u32 elemCount = vaoInfo->elemCounts[index];
-
-        glVertexArrayAttribFormat(vao, index, elemCount, GL_FLOAT, GL_FALSE, accumulator * sizeof(float));
-        glVertexArrayAttribBinding(vao, index, 0);
-        glEnableVertexArrayAttrib(vao, index);
-
-        accumulator += elemCount;
+        glVertexArrayAttribBinding(vao, i, 0);
+        glEnableVertexArrayAttrib(vao, i);
     }
-
-    return vao;
 }
 
 // Returns the size of the previous buffer.
@@ -44,26 +26,116 @@ internal u32 AppendToVAO(u32 vao, void *data, u32 dataSize)
     glBindVertexArray(vao);
     s32 bufferSize;
     glGetNamedBufferParameteriv(vao, GL_BUFFER_SIZE, &bufferSize);
-    Arena *tempArena = AllocArena(bufferSize);
-    void *savedBuffer = ArenaPush(tempArena, bufferSize);
+    TempMemory scratch = GetScratch();
+    void *savedBuffer = PushArray<u8>(scratch.arena, bufferSize);
     glGetNamedBufferSubData(vao, 0, bufferSize, savedBuffer);
     glNamedBufferData(vao, bufferSize + dataSize, NULL, GL_STATIC_DRAW);
     glNamedBufferSubData(vao, 0, bufferSize, savedBuffer);
     glNamedBufferSubData(vao, bufferSize, dataSize, data);
-    FreeArena(tempArena);
+    TempEnd(scratch);
     return bufferSize;
 }
 
-internal u32 CreateVAO(f32 *vertices, u32 verticesSize, s32 *elemCounts, u32 elemCountsSize, u32 *indices,
-                       u32 indicesSize)
+// Creates the geometry buffer's buffers, empty, and the vertex array every draw of its geometry goes through.
+internal void CreateGeometryBuffer(GeometryBuffer *geometry)
+{
+    *geometry = {};
+    glCreateBuffers(1, &geometry->vertexBuffer);
+    glObjectLabel(GL_BUFFER, geometry->vertexBuffer, -1, "Geometry: vertices");
+    glNamedBufferStorage(geometry->vertexBuffer, GEOMETRY_MAX_VERTICES * sizeof(PackedVertex), NULL,
+                         GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &geometry->indexBuffer);
+    glObjectLabel(GL_BUFFER, geometry->indexBuffer, -1, "Geometry: indices");
+    glNamedBufferStorage(geometry->indexBuffer, GEOMETRY_MAX_INDICES * sizeof(u32), NULL, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &geometry->commandBuffer);
+    glObjectLabel(GL_BUFFER, geometry->commandBuffer, -1, "Geometry: indirect commands");
+    glNamedBufferStorage(geometry->commandBuffer, GEOMETRY_MAX_COMMANDS * sizeof(DrawElementsIndirectCommand), NULL,
+                         GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &geometry->materialBuffer);
+    glObjectLabel(GL_BUFFER, geometry->materialBuffer, -1, "Geometry: materials");
+    glNamedBufferStorage(geometry->materialBuffer, GEOMETRY_MAX_MATERIALS * sizeof(TextureHandles), NULL,
+                         GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_MATERIALS, geometry->materialBuffer);
+
+    glCreateVertexArrays(1, &geometry->vao);
+    glObjectLabel(GL_VERTEX_ARRAY, geometry->vao, -1, "Geometry");
+    SetPackedVertexFormat(geometry->vao, geometry->vertexBuffer);
+    glVertexArrayElementBuffer(geometry->vao, geometry->indexBuffer);
+
+    InitRangeAllocator(&geometry->vertices, GEOMETRY_MAX_VERTICES, GEOMETRY_MAX_FREE_RANGES, "Geometry vertices");
+    InitRangeAllocator(&geometry->indices, GEOMETRY_MAX_INDICES, GEOMETRY_MAX_FREE_RANGES, "Geometry indices");
+    InitRangeAllocator(&geometry->commands, GEOMETRY_MAX_COMMANDS, GEOMETRY_MAX_FREE_RANGES, "Geometry commands");
+    InitRangeAllocator(&geometry->materials, GEOMETRY_MAX_MATERIALS, GEOMETRY_MAX_FREE_RANGES, "Geometry materials");
+}
+
+// Returns the offset of a range of one of the geometry buffer's allocators. There being no way to draw without its
+// geometry, a full geometry buffer is fatal, as a full pool is (see: PoolAlloc()).
+internal u32 AllocGeometryRange(RangeAllocator *allocator, u32 size, u64 elementSize)
+{
+    u32 result = RangeAlloc(allocator, size);
+    if (result == RANGE_ALLOC_FAILED)
+    {
+        ArenaFatalError("geometry buffer is full", (allocator->used + size) * elementSize,
+                        allocator->capacity * elementSize);
+    }
+    return result;
+}
+
+// Copies the vertices and indices into the geometry buffer, widening 16-bit indices, and returns where they went: the
+// range's base vertex is the first of its vertices, to which its indices are relative.
+internal GeometryRange UploadGeometry(GeometryBuffer *geometry, PackedVertex *vertices, u32 numVertices, void *indices,
+                                      u32 numIndices, u32 indexSize)
+{
+    GeometryRange result = {};
+    result.baseVertex = (s32)AllocGeometryRange(&geometry->vertices, numVertices, sizeof(PackedVertex));
+    result.firstIndex = AllocGeometryRange(&geometry->indices, numIndices, sizeof(u32));
+    result.numIndices = numIndices;
+    glNamedBufferSubData(geometry->vertexBuffer, (u64)result.baseVertex * sizeof(PackedVertex),
+                         numVertices * sizeof(PackedVertex), vertices);
+
+    TempMemory scratch = GetScratch();
+    u32 *wideIndices = (u32 *)indices;
+    if (indexSize == sizeof(u16))
+    {
+        wideIndices = PushArray<u32>(scratch.arena, numIndices);
+        for (u32 i = 0; i < numIndices; i++)
+        {
+            wideIndices[i] = ((u16 *)indices)[i];
+        }
+    }
+    glNamedBufferSubData(geometry->indexBuffer, (u64)result.firstIndex * sizeof(u32), numIndices * sizeof(u32),
+                         wideIndices);
+    TempEnd(scratch);
+    return result;
+}
+
+// Packs the vertices into the geometry buffer along with the indices, e.g. for a cube (see: UploadGeometry()).
+internal GeometryRange CreateGeometry(GeometryBuffer *geometry, Vertex *vertices, u32 numVertices, u32 *indices,
+                                      u32 numIndices)
+{
+    TempMemory scratch = GetScratch();
+    PackedVertex *packedVertices = PushArray<PackedVertex>(scratch.arena, numVertices);
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        packedVertices[i] = PackVertex(&vertices[i]);
+    }
+    GeometryRange result = UploadGeometry(geometry, packedVertices, numVertices, indices, numIndices, sizeof(u32));
+    TempEnd(scratch);
+    return result;
+}
+
+// Returns the index of the first of the materials, which draw commands pick as their base instance.
+internal u32 UploadMaterials(GeometryBuffer *geometry, TextureHandles *materials, u32 count)
 {
-    VaoInformation vaoInfo = {};
-    vaoInfo.vertices = vertices;
-    vaoInfo.verticesSize = verticesSize;
-    vaoInfo.elemCounts = elemCounts;
-    vaoInfo.elementCountsSize = elemCountsSize;
-    vaoInfo.indices = indices;
-    vaoInfo.indicesSize = indicesSize;
+    u32 result = AllocGeometryRange(&geometry->materials, count, sizeof(TextureHandles));
+    glNamedBufferSubData(geometry->materialBuffer, (u64)result * sizeof(TextureHandles), count * sizeof(TextureHandles),
+                         materials);
+    return result;
+}
 
-    return CreateVAO(&vaoInfo);
+// Draws the range, the geometry buffer's vertex array being bound.
+internal void DrawGeometry(GeometryRange *range)
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, range->numIndices, GL_UNSIGNED_INT,
+                             (void *)((u64)range->firstIndex * sizeof(u32)), range->baseVertex);
 }
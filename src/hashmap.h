@@ -0,0 +1,359 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASH_MAP_SSE2 1
+#else
+#define HASH_MAP_SSE2 0
+#endif
+
+/***********************************************************************************************************************
+ *
+ * Hash map: open addressing in the style of Swiss tables, for HashMap (backed by an arena) and FixedHashMap (fixed
+ * capacity, slots inline); see common.h for both.
+ *
+ * Talk: https://www.youtube.com/watch?v=ncHmEUmJZf4
+ *
+ * Besides its key and value arrays, a map keeps one control byte per slot: 0 when the slot is empty, 1 when its key
+ * was deleted, and 0x80 plus the low 7 bits of the key's hash when it is full. Slots are probed a group of
+ * HASH_MAP_GROUP_SIZE at a time: one SSE2 compare of the group's control bytes against the hash's 7 bits gives the
+ * few slots whose keys are worth comparing, and one against 0 tells whether the probe can stop. Groups are visited in
+ * triangular order from the one picked by the rest of the hash, which reaches every group of a power of two.
+ *
+ * Maps are kept at most 7/8 full, deleted slots included, so probes always end on an empty slot. A deleted key only
+ * leaves a tombstone behind when its group is full: a probe which went past that group for another key will be looking
+ * for it there again.
+ *
+ * Keys and values must be trivially copyable; keys need operator== and a HashMapHash() overload.
+ *
+ * NOTE: a HashMap which outgrows its capacity moves to bigger arrays pushed onto its arena and leaves the old ones
+ * behind, which costs at most as much again as the final arrays. Reserve up front for maps whose size is known.
+ *
+ **********************************************************************************************************************/
+
+#define HASH_MAP_EMPTY 0x00
+#define HASH_MAP_DELETED 0x01
+#define HASH_MAP_FULL 0x80
+
+// Finalizer of MurmurHash3: spreads the entropy of every bit of the key over the whole hash, which sequential IDs
+// need and which costs little for keys that are hashes already (eg fnv1a() of a path).
+internal u64 HashMapHash(u64 key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+internal u64 HashMapHash(u32 key)
+{
+    return HashMapHash((u64)key);
+}
+
+internal u8 GetHashMapTag(u64 hash)
+{
+    return (u8)(HASH_MAP_FULL | (hash & 0x7f));
+}
+
+// Returns a mask with bit i set when the i-th control byte of the group equals value.
+internal u32 MatchHashMapGroup(u8 *group, u8 value)
+{
+#if HASH_MAP_SSE2
+    __m128i bytes = _mm_load_si128((__m128i *)group);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)value)));
+#else
+    u32 result = 0;
+    for (u32 i = 0; i < HASH_MAP_GROUP_SIZE; i++)
+    {
+        result |= (u32)(group[i] == value) << i;
+    }
+    return result;
+#endif
+}
+
+// Returns a mask with bit i set when the i-th slot of the group is empty or deleted.
+internal u32 MatchHashMapGroupFree(u8 *group)
+{
+#if HASH_MAP_SSE2
+    __m128i bytes = _mm_load_si128((__m128i *)group);
+    return ~(u32)_mm_movemask_epi8(bytes) & ((1u << HASH_MAP_GROUP_SIZE) - 1);
+#else
+    u32 result = 0;
+    for (u32 i = 0; i < HASH_MAP_GROUP_SIZE; i++)
+    {
+        result |= (u32)((group[i] & HASH_MAP_FULL) == 0) << i;
+    }
+    return result;
+#endif
+}
+
+internal u32 GetHashMapMaxCount(u32 capacity)
+{
+    return capacity - capacity / 8;
+}
+
+// The smallest capacity which holds count keys.
+internal u32 GetHashMapCapacity(u32 count)
+{
+    u32 result = HASH_MAP_GROUP_SIZE;
+    while (GetHashMapMaxCount(result) < count)
+    {
+        result *= 2;
+    }
+    return result;
+}
+
+//
+// Shared by both kinds of map.
+//
+
+// Returns the slot holding the key, or -1.
+template <typename Map, typename K> internal s64 FindHashMapSlot(Map *map, K key)
+{
+    if (map->count == 0)
+    {
+        return -1;
+    }
+
+    u64 hash = HashMapHash(key);
+    u8 tag = GetHashMapTag(hash);
+    u32 groupMask = map->capacity / HASH_MAP_GROUP_SIZE - 1;
+    u32 group = (u32)(hash >> 7) & groupMask;
+    for (u32 probe = 1;; probe++)
+    {
+        u8 *control = &map->control[group * HASH_MAP_GROUP_SIZE];
+        for (u32 matches = MatchHashMapGroup(control, tag); matches != 0; matches &= matches - 1)
+        {
+            u32 slot = group * HASH_MAP_GROUP_SIZE + FindLeastSignificantBit(matches);
+            if (map->keys[slot] == key)
+            {
+                return slot;
+            }
+        }
+        if (MatchHashMapGroup(control, HASH_MAP_EMPTY) != 0)
+        {
+            return -1;
+        }
+        group = (group + probe) & groupMask;
+    }
+}
+
+// Puts a key which isn't in the map yet into the first free slot of its probe sequence, which there has to be room
+// for, and returns the slot.
+template <typename Map, typename K, typename V> internal u32 PutHashMapSlot(Map *map, K key, V value)
+{
+    u64 hash = HashMapHash(key);
+    u32 groupMask = map->capacity / HASH_MAP_GROUP_SIZE - 1;
+    u32 group = (u32)(hash >> 7) & groupMask;
+    u32 freeSlots = MatchHashMapGroupFree(&map->control[group * HASH_MAP_GROUP_SIZE]);
+    for (u32 probe = 1; freeSlots == 0; probe++)
+    {
+        group = (group + probe) & groupMask;
+        freeSlots = MatchHashMapGroupFree(&map->control[group * HASH_MAP_GROUP_SIZE]);
+    }
+
+    u32 slot = group * HASH_MAP_GROUP_SIZE + FindLeastSignificantBit(freeSlots);
+    if (map->control[slot] == HASH_MAP_DELETED)
+    {
+        map->numDeleted--;
+    }
+    map->control[slot] = GetHashMapTag(hash);
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->count++;
+    return slot;
+}
+
+// Puts every key back in place, which gets rid of the tombstones.
+template <typename K, typename V, typename Map>
+internal void RehashHashMapInPlace(Map *map, Arena **conflicts, u32 numConflicts)
+{
+    TempMemory scratch = GetScratch(conflicts, numConflicts);
+    u32 count = map->count;
+    K *keys = PushArray<K>(scratch.arena, count);
+    V *values = PushArray<V>(scratch.arena, count);
+    u32 numCopied = 0;
+    for (u32 slot = 0; slot < map->capacity; slot++)
+    {
+        if (map->control[slot] & HASH_MAP_FULL)
+        {
+            keys[numCopied] = map->keys[slot];
+            values[numCopied] = map->values[slot];
+            numCopied++;
+        }
+    }
+
+    memset(map->control, HASH_MAP_EMPTY, map->capacity);
+    map->count = 0;
+    map->numDeleted = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        PutHashMapSlot(map, keys[i], values[i]);
+    }
+    TempEnd(scratch);
+}
+
+template <typename Map, typename K> internal bool DeleteHashMapSlot(Map *map, K key)
+{
+    s64 slot = FindHashMapSlot(map, key);
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    u8 *group = &map->control[slot & ~(s64)(HASH_MAP_GROUP_SIZE - 1)];
+    if (MatchHashMapGroup(group, HASH_MAP_EMPTY) != 0)
+    {
+        map->control[slot] = HASH_MAP_EMPTY;
+    }
+    else
+    {
+        map->control[slot] = HASH_MAP_DELETED;
+        map->numDeleted++;
+    }
+    map->count--;
+    return true;
+}
+
+//
+// HashMap.
+//
+
+// Moves the map to arrays of the given capacity, pushed onto its arena.
+template <typename K, typename V> internal void ResizeHashMap(HashMap<K, V> *map, u32 capacity)
+{
+    myAssert(capacity >= GetHashMapCapacity(map->count));
+    HashMap<K, V> old = *map;
+    map->control = (u8 *)ArenaPushAligned(map->arena, capacity, HASH_MAP_GROUP_SIZE);
+    map->keys = PushArray<K>(map->arena, capacity);
+    map->values = PushArray<V>(map->arena, capacity);
+    map->capacity = capacity;
+    map->count = 0;
+    map->numDeleted = 0;
+    memset(map->control, HASH_MAP_EMPTY, capacity);
+    for (u32 slot = 0; slot < old.capacity; slot++)
+    {
+        if (old.control[slot] & HASH_MAP_FULL)
+        {
+            PutHashMapSlot(map, old.keys[slot], old.values[slot]);
+        }
+    }
+}
+
+template <typename K, typename V> internal void InitHashMap(HashMap<K, V> *map, Arena *arena, u32 capacity = 0)
+{
+    *map = {};
+    map->arena = arena;
+    if (capacity > 0)
+    {
+        ResizeHashMap(map, GetHashMapCapacity(capacity));
+    }
+}
+
+// Makes room for count keys without growing again.
+template <typename K, typename V> internal void HashMapReserve(HashMap<K, V> *map, u32 count)
+{
+    u32 capacity = GetHashMapCapacity(count);
+    if (capacity > map->capacity)
+    {
+        ResizeHashMap(map, capacity);
+    }
+}
+
+// Inserts the key, or updates its value if it is in the map already. Returns the value in the map.
+template <typename K, typename V> internal V *HashMapInsert(HashMap<K, V> *map, K key, V value)
+{
+    s64 slot = FindHashMapSlot(map, key);
+    if (slot >= 0)
+    {
+        map->values[slot] = value;
+        return &map->values[slot];
+    }
+
+    if (map->count + map->numDeleted + 1 > GetHashMapMaxCount(map->capacity))
+    {
+        // Mostly tombstones: clearing them out makes room. Otherwise grow, leaving room to spare.
+        if (map->capacity > 0 && map->count + 1 <= GetHashMapMaxCount(map->capacity) / 2)
+        {
+            RehashHashMapInPlace<K, V>(map, &map->arena, 1);
+        }
+        else
+        {
+            ResizeHashMap(map, GetHashMapCapacity(2 * (map->count + 1)));
+        }
+    }
+    return &map->values[PutHashMapSlot(map, key, value)];
+}
+
+// Returns the key's value, or NULL.
+template <typename K, typename V> internal V *HashMapFind(HashMap<K, V> *map, K key)
+{
+    s64 slot = FindHashMapSlot(map, key);
+    return (slot >= 0) ? &map->values[slot] : NULL;
+}
+
+// Returns whether the key was in the map.
+template <typename K, typename V> internal bool HashMapDelete(HashMap<K, V> *map, K key)
+{
+    return DeleteHashMapSlot(map, key);
+}
+
+// Empties the map, keeping its arrays.
+template <typename K, typename V> internal void HashMapClear(HashMap<K, V> *map)
+{
+    if (map->capacity > 0)
+    {
+        memset(map->control, HASH_MAP_EMPTY, map->capacity);
+    }
+    map->count = 0;
+    map->numDeleted = 0;
+}
+
+//
+// FixedHashMap.
+//
+
+// Inserts the key, or updates its value if it is in the map already. Returns the value in the map, or NULL when the
+// map is full.
+template <typename K, typename V, u32 N> internal V *HashMapInsert(FixedHashMap<K, V, N> *map, K key, V value)
+{
+    s64 slot = FindHashMapSlot(map, key);
+    if (slot >= 0)
+    {
+        map->values[slot] = value;
+        return &map->values[slot];
+    }
+
+    if (map->count + 1 > GetHashMapMaxCount(N))
+    {
+        return NULL;
+    }
+    if (map->count + map->numDeleted + 1 > GetHashMapMaxCount(N))
+    {
+        RehashHashMapInPlace<K, V>(map, NULL, 0);
+    }
+    return &map->values[PutHashMapSlot(map, key, value)];
+}
+
+template <typename K, typename V, u32 N> internal V *HashMapFind(FixedHashMap<K, V, N> *map, K key)
+{
+    s64 slot = FindHashMapSlot(map, key);
+    return (slot >= 0) ? &map->values[slot] : NULL;
+}
+
+template <typename K, typename V, u32 N> internal bool HashMapDelete(FixedHashMap<K, V, N> *map, K key)
+{
+    return DeleteHashMapSlot(map, key);
+}
+
+template <typename K, typename V, u32 N> internal void HashMapClear(FixedHashMap<K, V, N> *map)
+{
+    memset(map->control, HASH_MAP_EMPTY, N);
+    map->count = 0;
+    map->numDeleted = 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+
+/***********************************************************************************************************************
+ *
+ * Timestamped input events, normalized from window messages by the message pump and handed to their consumer through
+ * a single-producer/single-consumer lock-free ring.
+ *
+ **********************************************************************************************************************/
+
+enum class InputEventType
+{
+    // Consumed by the simulation (see: ApplyInputEvent() in main.cpp).
+    KeyDown,
+    KeyUp,
+    MouseWheel,
+
+    // Consumed by the render thread (see: ProcessRenderEvents() in main.cpp).
+    Click,
+    Look,
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    u64 timestamp; // Wall clock when the message was pumped, see: Win32GetWallClock().
+
+    // KeyDown, KeyUp.
+    u32 key;
+    bool altPressed;
+
+    // MouseWheel.
+    s16 wheelRotation;
+    bool shiftPressed;
+
+    // Click.
+    CWPoint coordinates;
+    CWPoint screenSize;
+
+    // Look: the camera orientation after the mouse movement, rather than a delta, so that the consumer only needs
+    // the most recent one.
+    f32 yaw;
+    f32 pitch;
+    u64 sequence;
+};
+
+// Must be a power of two.
+#define INPUT_QUEUE_SIZE 1024
+
+struct InputEventQueue
+{
+    InputEvent events[INPUT_QUEUE_SIZE];
+
+    // Both indices increase monotonically and wrap around naturally; keeping them on separate cache lines stops the
+    // producer and the consumer from invalidating each other's line on every push and pop.
+    alignas(64) std::atomic<u32> writeIndex; // Only written by the producer.
+    alignas(64) std::atomic<u32> readIndex;  // Only written by the consumer.
+
+    u32 numDropped; // Only touched by the producer.
+};
+
+// Producer side. Returns false, dropping the event, if the consumer has fallen INPUT_QUEUE_SIZE events behind.
+internal bool PushInputEvent(InputEventQueue *queue, InputEvent *event)
+{
+    u32 writeIndex = queue->writeIndex.load(std::memory_order_relaxed);
+    u32 readIndex = queue->readIndex.load(std::memory_order_acquire);
+    if (writeIndex - readIndex == INPUT_QUEUE_SIZE)
+    {
+        queue->numDropped++;
+        return false;
+    }
+
+    queue->events[writeIndex & (INPUT_QUEUE_SIZE - 1)] = *event;
+    queue->writeIndex.store(writeIndex + 1, std::memory_order_release);
+    return true;
+}
+
+// Consumer side. Returns the oldest event without consuming it, or NULL if the queue is empty.
+internal InputEvent *PeekInputEvent(InputEventQueue *queue)
+{
+    u32 readIndex = queue->readIndex.load(std::memory_order_relaxed);
+    u32 writeIndex = queue->writeIndex.load(std::memory_order_acquire);
+    if (readIndex == writeIndex)
+    {
+        return NULL;
+    }
+    return &queue->events[readIndex & (INPUT_QUEUE_SIZE - 1)];
+}
+
+// Consumer side. Releases the event returned by the last PeekInputEvent() back to the producer.
+internal void PopInputEvent(InputEventQueue *queue)
+{
+    u32 readIndex = queue->readIndex.load(std::memory_order_relaxed);
+    queue->readIndex.store(readIndex + 1, std::memory_order_release);
+}
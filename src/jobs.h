@@ -0,0 +1,668 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // _mm_pause().
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************************************************************************
+ *
+ * Job system: a worker thread per core beyond the first, each taking jobs from its own Chase-Lev deque and stealing
+ * from the others' when it runs dry.
+ *
+ * Paper: https://fzn.fr/readings/ppopp13.pdf (Lê et al., Correct and Efficient Work-Stealing for Weak Memory Models)
+ *
+ * Any thread can push jobs: threads which aren't workers (the game and render threads) get a deque of their own the
+ * first time they do. A job may decrement a counter once it has run, which is how work fans in: WaitForJobCounter()
+ * runs other jobs until the counter gets to zero rather than blocking, so waiting from within a job is fine.
+ * ParallelFor() splits an index range into such jobs.
+ *
+ * OpenGL calls can only be made from the thread which holds the context, so jobs which make them go into a separate
+ * queue (see: PushGLJob()) which only that thread runs, between frames and while it waits on a counter.
+ *
+ * The platform layer owns the job system, its threads included, and hands it to the game code when loading it (see:
+ * SetJobSystem()), so that reloading the game code doesn't restart the workers. Jobs point into the code which pushed
+ * them, which is why the job system has to be idle before the game code is unloaded (see: WaitForJobSystemIdle()).
+ *
+ * NOTE: deques hold jobs by value, in atomic words: a thief may read a slot while its owner writes it, but then the
+ * owner has taken that job, so the thief's compare-and-swap fails and the torn copy is thrown away.
+ *
+ **********************************************************************************************************************/
+
+// Workers and the threads which push jobs without being workers.
+#define MAX_JOB_THREADS 32
+// Must be a power of two.
+#define JOB_DEQUE_SIZE 1024
+#define JOB_GL_QUEUE_SIZE 1024
+// How many times a worker looks for a job before going to sleep.
+#define JOB_SPIN_COUNT 64
+// ParallelFor() splits the range into this many batches per thread, for stealing to even out.
+#define JOB_BATCHES_PER_THREAD 4
+// How long the render loop spends running GL jobs per frame (see: RunGLJobs()), so that streaming assets in doesn't
+// cause hitches.
+#define JOB_GL_FRAME_BUDGET_MS 2.f
+
+// Runs the job on [begin, end); jobs which don't come from ParallelFor() get [0, 1).
+typedef void (*JobProc)(void *data, u32 begin, u32 end);
+
+struct JobCounter
+{
+    std::atomic<u32> count; // Jobs pushed with this counter which haven't finished yet.
+};
+
+struct Job
+{
+    JobProc proc;
+    void *data;
+    u32 begin;
+    u32 end;
+    JobCounter *counter; // Decremented once the job has run, may be NULL.
+    const char *name;    // Tracy zone name, must be a string literal.
+};
+
+#define JOB_WORDS (sizeof(Job) / sizeof(u64))
+static_assert(sizeof(Job) % sizeof(u64) == 0, "jobs are copied in and out of deques a word at a time");
+
+struct JobSlot
+{
+    std::atomic<u64> words[JOB_WORDS];
+};
+
+struct JobDeque
+{
+    alignas(64) std::atomic<s64> top;    // Next job to steal.
+    alignas(64) std::atomic<s64> bottom; // Next slot to push into, only written by the owner.
+    alignas(64) JobSlot slots[JOB_DEQUE_SIZE];
+};
+
+#ifdef _WIN32
+typedef HANDLE JobSemaphore;
+#else
+typedef sem_t JobSemaphore;
+#endif
+
+// Runs a job; the game code instruments jobs with Tracy zones through this, as only it links the Tracy client.
+typedef void (*RunJobHook_t)(Job *job);
+
+struct JobSystem;
+
+struct JobWorkerParameter
+{
+    JobSystem *system;
+    u32 threadIndex;
+};
+
+struct JobSystem
+{
+    JobDeque deques[MAX_JOB_THREADS]; // Workers' first, by worker index.
+    std::atomic<u32> numThreads;      // Deques handed out so far.
+    u32 numWorkers;
+
+    // Jobs pushed but not finished, GL jobs included.
+    std::atomic<u32> numUnfinishedJobs;
+
+    // Workers with nothing to do wait on the semaphore, see: SleepJobWorker().
+    JobSemaphore wakeUp;
+    std::atomic<u32> numSleepingWorkers;
+    std::atomic<bool> running;
+
+    // Jobs to be run by the thread which holds the OpenGL context.
+    std::atomic<bool> glQueueLock;
+    Job glJobs[JOB_GL_QUEUE_SIZE];
+    u32 glReadIndex;
+    u32 glWriteIndex;
+    std::atomic<u32> glThreadIndex; // Job thread index plus one, zero before SetGLJobThread().
+
+    std::atomic<RunJobHook_t> runJobHook;
+
+    // Each thread's job thread index plus one, zero for threads which haven't pushed or run a job yet. Thread local
+    // storage of the platform rather than thread_local, which is per module.
+#ifdef _WIN32
+    DWORD threadIndexTls;
+    HANDLE workers[MAX_JOB_THREADS];
+#else
+    pthread_key_t threadIndexTls;
+    pthread_t workers[MAX_JOB_THREADS];
+#endif
+    JobWorkerParameter workerParameters[MAX_JOB_THREADS];
+    Arena *arena;
+};
+
+// Set by the platform layer, and handed to the game code through SetJobSystem().
+global_variable JobSystem *gJobSystem;
+
+//
+// Platform.
+//
+
+// Spin-wait hint.
+internal void JobPause()
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    _mm_pause();
+#endif
+}
+
+internal u32 GetNumCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    u32 numCores = systemInfo.dwNumberOfProcessors;
+#else
+    u32 numCores = (u32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return intMax(numCores, 1u);
+}
+
+internal void WaitJobSemaphore(JobSemaphore *semaphore)
+{
+#ifdef _WIN32
+    WaitForSingleObject(*semaphore, INFINITE);
+#else
+    while (sem_wait(semaphore) != 0)
+    {
+    }
+#endif
+}
+
+internal void SignalJobSemaphore(JobSemaphore *semaphore, u32 count)
+{
+#ifdef _WIN32
+    ReleaseSemaphore(*semaphore, count, NULL);
+#else
+    for (u32 i = 0; i < count; i++)
+    {
+        sem_post(semaphore);
+    }
+#endif
+}
+
+internal void SetJobThreadIndex(JobSystem *system, u32 index)
+{
+    u64 indexPlusOne = index + 1;
+#ifdef _WIN32
+    TlsSetValue(system->threadIndexTls, (void *)indexPlusOne);
+#else
+    pthread_setspecific(system->threadIndexTls, (void *)indexPlusOne);
+#endif
+}
+
+// Returns the calling thread's index, giving it a deque the first time.
+internal u32 GetJobThreadIndex(JobSystem *system)
+{
+#ifdef _WIN32
+    u64 indexPlusOne = (u64)TlsGetValue(system->threadIndexTls);
+#else
+    u64 indexPlusOne = (u64)pthread_getspecific(system->threadIndexTls);
+#endif
+    if (indexPlusOne == 0)
+    {
+        u32 index = system->numThreads.fetch_add(1, std::memory_order_acq_rel);
+        if (index >= MAX_JOB_THREADS)
+        {
+            DebugPrintA("Job system error: more than %u threads push jobs.\n", MAX_JOB_THREADS);
+            myAssert(false);
+            abort();
+        }
+        SetJobThreadIndex(system, index);
+        return index;
+    }
+    return (u32)(indexPlusOne - 1);
+}
+
+//
+// Deques.
+//
+
+internal void WriteJobSlot(JobSlot *slot, Job *job)
+{
+    u64 words[JOB_WORDS];
+    memcpy(words, job, sizeof(Job));
+    for (u32 i = 0; i < JOB_WORDS; i++)
+    {
+        slot->words[i].store(words[i], std::memory_order_relaxed);
+    }
+}
+
+internal void ReadJobSlot(JobSlot *slot, Job *job)
+{
+    u64 words[JOB_WORDS];
+    for (u32 i = 0; i < JOB_WORDS; i++)
+    {
+        words[i] = slot->words[i].load(std::memory_order_relaxed);
+    }
+    memcpy(job, words, sizeof(Job));
+}
+
+// Owner only.
+internal void PushJobDeque(JobDeque *deque, Job *job)
+{
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed);
+    s64 top = deque->top.load(std::memory_order_acquire);
+    if (bottom - top >= JOB_DEQUE_SIZE)
+    {
+        DebugPrintA("Job system error: more than %u jobs queued by one thread.\n", JOB_DEQUE_SIZE);
+        myAssert(false);
+        abort();
+    }
+    WriteJobSlot(&deque->slots[bottom & (JOB_DEQUE_SIZE - 1)], job);
+    deque->bottom.store(bottom + 1, std::memory_order_release);
+}
+
+// Owner only: takes the job pushed last.
+internal bool PopJobDeque(JobDeque *deque, Job *job)
+{
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(bottom, std::memory_order_seq_cst);
+    s64 top = deque->top.load(std::memory_order_seq_cst);
+    bool result = false;
+    if (top <= bottom)
+    {
+        ReadJobSlot(&deque->slots[bottom & (JOB_DEQUE_SIZE - 1)], job);
+        result = true;
+        if (top == bottom)
+        {
+            // The last job: race thieves for it.
+            result = deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                        std::memory_order_relaxed);
+            deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// Any thread: takes the job pushed first. Fails when the deque is empty or another thread got there first.
+internal bool StealJobDeque(JobDeque *deque, Job *job)
+{
+    s64 top = deque->top.load(std::memory_order_seq_cst);
+    s64 bottom = deque->bottom.load(std::memory_order_seq_cst);
+    if (top >= bottom)
+    {
+        return false;
+    }
+    ReadJobSlot(&deque->slots[top & (JOB_DEQUE_SIZE - 1)], job);
+    return deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+//
+// Running jobs.
+//
+
+internal void FinishJob(JobSystem *system, Job *job)
+{
+    if (job->counter)
+    {
+        job->counter->count.fetch_sub(1, std::memory_order_release);
+    }
+    system->numUnfinishedJobs.fetch_sub(1, std::memory_order_release);
+}
+
+internal void RunJob(JobSystem *system, Job *job)
+{
+    RunJobHook_t hook = system->runJobHook.load(std::memory_order_acquire);
+    if (hook)
+    {
+        hook(job);
+    }
+    else
+    {
+        job->proc(job->data, job->begin, job->end);
+    }
+    FinishJob(system, job);
+}
+
+// Takes a job from the thread's own deque, or steals one, starting from a different deque every time.
+internal bool GetJob(JobSystem *system, u32 threadIndex, Job *job)
+{
+    if (PopJobDeque(&system->deques[threadIndex], job))
+    {
+        return true;
+    }
+
+    // NOTE: seeded from the thread's index, so that threads don't all go after the same victims in the same order.
+    // The golden ratio constant is odd, so the seed is never the zero xorshift gets stuck on.
+    local_persist thread_local u32 victimSeed = 0x9E3779B9 * (threadIndex + 1);
+    victimSeed ^= victimSeed << 13;
+    victimSeed ^= victimSeed >> 17;
+    victimSeed ^= victimSeed << 5;
+    u32 numThreads = system->numThreads.load(std::memory_order_acquire);
+    for (u32 i = 0; i < numThreads; i++)
+    {
+        u32 victim = (victimSeed + i) % numThreads;
+        if (victim != threadIndex && StealJobDeque(&system->deques[victim], job))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs the GL jobs queued so far, or as many as fit in the budget, which always lets one through. Only the thread
+// which holds the OpenGL context may call this.
+internal void RunGLJobs(JobSystem *system, f32 budgetMs = INFINITY)
+{
+    myAssert(system->glThreadIndex.load(std::memory_order_acquire) == GetJobThreadIndex(system) + 1);
+    u64 start = Win32GetWallClock();
+    while (Win32GetElapsedMs(start, Win32GetWallClock()) < budgetMs)
+    {
+        while (system->glQueueLock.exchange(true, std::memory_order_acquire))
+        {
+            JobPause();
+        }
+        bool empty = (system->glReadIndex == system->glWriteIndex);
+        Job job;
+        if (!empty)
+        {
+            job = system->glJobs[system->glReadIndex % JOB_GL_QUEUE_SIZE];
+            system->glReadIndex++;
+        }
+        system->glQueueLock.store(false, std::memory_order_release);
+
+        if (empty)
+        {
+            break;
+        }
+        RunJob(system, &job);
+    }
+}
+
+internal bool IsGLJobThread(JobSystem *system)
+{
+    return system->glThreadIndex.load(std::memory_order_acquire) == GetJobThreadIndex(system) + 1;
+}
+
+//
+// Pushing and waiting.
+//
+
+internal void WakeJobWorkers(JobSystem *system, u32 count)
+{
+    // Orders the pushes before the load, against the worker's increment before its last look for work.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    u32 numSleeping = system->numSleepingWorkers.load(std::memory_order_seq_cst);
+    if (numSleeping > 0)
+    {
+        SignalJobSemaphore(&system->wakeUp, intMin(count, numSleeping));
+    }
+}
+
+internal void PushJobs(JobSystem *system, Job *jobs, u32 count)
+{
+    u32 threadIndex = GetJobThreadIndex(system);
+    system->numUnfinishedJobs.fetch_add(count, std::memory_order_relaxed);
+    for (u32 i = 0; i < count; i++)
+    {
+        if (jobs[i].counter)
+        {
+            jobs[i].counter->count.fetch_add(1, std::memory_order_relaxed);
+        }
+        PushJobDeque(&system->deques[threadIndex], &jobs[i]);
+    }
+    WakeJobWorkers(system, count);
+}
+
+internal void PushJob(JobSystem *system, JobProc proc, void *data, JobCounter *counter, const char *name)
+{
+    Job job = {proc, data, 0, 1, counter, name};
+    PushJobs(system, &job, 1);
+}
+
+// Queues a job for the thread which holds the OpenGL context (see: SetGLJobThread()).
+internal void PushGLJob(JobSystem *system, JobProc proc, void *data, JobCounter *counter, const char *name)
+{
+    Job job = {proc, data, 0, 1, counter, name};
+    system->numUnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+    if (counter)
+    {
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    }
+    while (true)
+    {
+        while (system->glQueueLock.exchange(true, std::memory_order_acquire))
+        {
+            JobPause();
+        }
+        if (system->glWriteIndex - system->glReadIndex < JOB_GL_QUEUE_SIZE)
+        {
+            break;
+        }
+        // Full: leave room for the GL thread to drain it.
+        system->glQueueLock.store(false, std::memory_order_release);
+        if (IsGLJobThread(system))
+        {
+            RunGLJobs(system);
+        }
+    }
+    system->glJobs[system->glWriteIndex % JOB_GL_QUEUE_SIZE] = job;
+    system->glWriteIndex++;
+    system->glQueueLock.store(false, std::memory_order_release);
+}
+
+// Runs jobs until the counter gets to zero. On the thread which holds the OpenGL context, that includes GL jobs.
+internal void WaitForJobCounter(JobSystem *system, JobCounter *counter)
+{
+    u32 threadIndex = GetJobThreadIndex(system);
+    bool glThread = IsGLJobThread(system);
+    while (counter->count.load(std::memory_order_acquire) != 0)
+    {
+        if (glThread)
+        {
+            RunGLJobs(system);
+        }
+        Job job;
+        if (GetJob(system, threadIndex, &job))
+        {
+            RunJob(system, &job);
+        }
+        else
+        {
+            JobPause();
+        }
+    }
+}
+
+// Runs the procedure over [0, count) in batches of at least minBatchSize indices, spread over the workers and the
+// calling thread, and returns once all of them are done. Without a job system, runs it on the calling thread.
+internal void ParallelFor(JobSystem *system, u32 count, u32 minBatchSize, JobProc proc, void *data, const char *name)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (!system)
+    {
+        proc(data, 0, count);
+        return;
+    }
+
+    u32 numThreads = system->numWorkers + 1;
+    u32 batchSize = intMax(minBatchSize, (count + numThreads * JOB_BATCHES_PER_THREAD - 1) /
+                                             (numThreads * JOB_BATCHES_PER_THREAD));
+    u32 numBatches = (count + batchSize - 1) / batchSize;
+    if (numBatches == 1)
+    {
+        Job job = {proc, data, 0, count, NULL, name};
+        system->numUnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+        RunJob(system, &job);
+        return;
+    }
+
+    // Every batch but the first is pushed, in reverse so that the ones stolen first are the ones popped last; the
+    // calling thread runs the first one itself.
+    JobCounter counter = {};
+    Job jobs[JOB_BATCHES_PER_THREAD * MAX_JOB_THREADS];
+    myAssert(numBatches <= myArraySize(jobs));
+    for (u32 batch = 1; batch < numBatches; batch++)
+    {
+        u32 begin = batch * batchSize;
+        jobs[numBatches - 1 - batch] = {proc, data, begin, intMin(begin + batchSize, count), &counter, name};
+    }
+    PushJobs(system, jobs, numBatches - 1);
+
+    Job first = {proc, data, 0, batchSize, NULL, name};
+    system->numUnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+    RunJob(system, &first);
+    WaitForJobCounter(system, &counter);
+}
+
+// Runs jobs until none are left anywhere, GL jobs included when called from the thread which holds the context. Jobs
+// pushed by threads other than the caller while it waits have to be waited on too.
+internal void WaitForJobSystemIdle(JobSystem *system)
+{
+    u32 threadIndex = GetJobThreadIndex(system);
+    bool glThread = IsGLJobThread(system);
+    while (system->numUnfinishedJobs.load(std::memory_order_acquire) != 0)
+    {
+        if (glThread)
+        {
+            RunGLJobs(system);
+        }
+        Job job;
+        if (GetJob(system, threadIndex, &job))
+        {
+            RunJob(system, &job);
+        }
+        else
+        {
+            JobPause();
+        }
+    }
+}
+
+//
+// Workers.
+//
+
+internal void RunJobWorker(JobSystem *system, u32 threadIndex)
+{
+    SetJobThreadIndex(system, threadIndex);
+    u32 numFailures = 0;
+    while (system->running.load(std::memory_order_acquire))
+    {
+        Job job;
+        if (GetJob(system, threadIndex, &job))
+        {
+            RunJob(system, &job);
+            numFailures = 0;
+        }
+        else if (++numFailures < JOB_SPIN_COUNT)
+        {
+            JobPause();
+        }
+        else
+        {
+            // Announce the sleep before looking one last time, so that a push either sees a sleeper to wake or
+            // happened before the last look (see: WakeJobWorkers()).
+            system->numSleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+            if (GetJob(system, threadIndex, &job))
+            {
+                system->numSleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+                RunJob(system, &job);
+            }
+            else
+            {
+                WaitJobSemaphore(&system->wakeUp);
+                system->numSleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+            }
+            numFailures = 0;
+        }
+    }
+}
+
+#ifdef _WIN32
+internal DWORD WINAPI JobWorkerProc(LPVOID parameter)
+{
+    JobWorkerParameter *worker = (JobWorkerParameter *)parameter;
+    RunJobWorker(worker->system, worker->threadIndex);
+    return 0;
+}
+#else
+internal void *JobWorkerProc(void *parameter)
+{
+    JobWorkerParameter *worker = (JobWorkerParameter *)parameter;
+    RunJobWorker(worker->system, worker->threadIndex);
+    return NULL;
+}
+#endif
+
+// Starts numWorkers workers, by default one per core beyond the calling thread's but at least one, as jobs which no
+// thread waits on (see: StartLoadingModel()) only run on workers. Without workers, jobs run on the threads which wait
+// on them.
+internal JobSystem *StartJobSystem(u32 numWorkers = intMax(GetNumCores(), 2u) - 1)
+{
+    // Leaves deques for the threads which push jobs without being workers.
+    numWorkers = intMin(numWorkers, (u32)MAX_JOB_THREADS - 4);
+
+    Arena *arena = AllocArena(AlignUp(sizeof(JobSystem), sizeof(void *)), "Job system");
+    JobSystem *system = PushStruct<JobSystem>(arena);
+    system->arena = arena;
+    system->numWorkers = numWorkers;
+    system->running.store(true, std::memory_order_release);
+#ifdef _WIN32
+    system->threadIndexTls = TlsAlloc();
+    system->wakeUp = CreateSemaphoreW(NULL, 0, MAX_JOB_THREADS, NULL);
+#else
+    pthread_key_create(&system->threadIndexTls, NULL);
+    sem_init(&system->wakeUp, 0, 0);
+#endif
+
+    // Worker i gets deque i, other threads get theirs from GetJobThreadIndex().
+    system->numThreads.store(numWorkers, std::memory_order_release);
+    for (u32 i = 0; i < numWorkers; i++)
+    {
+        JobWorkerParameter *parameter = &system->workerParameters[i];
+        parameter->system = system;
+        parameter->threadIndex = i;
+#ifdef _WIN32
+        system->workers[i] = CreateThread(NULL, 0, JobWorkerProc, parameter, 0, NULL);
+#else
+        pthread_create(&system->workers[i], NULL, JobWorkerProc, parameter);
+#endif
+    }
+    return system;
+}
+
+internal void StopJobSystem(JobSystem *system)
+{
+    WaitForJobSystemIdle(system);
+    system->running.store(false, std::memory_order_release);
+    SignalJobSemaphore(&system->wakeUp, system->numWorkers);
+    for (u32 i = 0; i < system->numWorkers; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(system->workers[i], INFINITE);
+        CloseHandle(system->workers[i]);
+#else
+        pthread_join(system->workers[i], NULL);
+#endif
+    }
+#ifdef _WIN32
+    CloseHandle(system->wakeUp);
+    TlsFree(system->threadIndexTls);
+#else
+    sem_destroy(&system->wakeUp);
+    pthread_key_delete(system->threadIndexTls);
+#endif
+    FreeArena(system->arena);
+}
+
+// Makes the calling thread the one which runs GL jobs, ie the one which holds the OpenGL context.
+internal void SetGLJobThread(JobSystem *system)
+{
+    system->glThreadIndex.store(GetJobThreadIndex(system) + 1, std::memory_order_release);
+}
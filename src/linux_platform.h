@@ -0,0 +1,310 @@
+#pragma once
+
+// Linux stand-ins for the Win32 types, functions and MSVC CRT extensions that the game code relies on, so that
+// game.cpp can be built as a shared object and driven by a Linux platform layer (see: bench.cpp).
+// Only what the game DLL actually touches is provided here; the Win32 platform layer (main.cpp) stays Windows-only.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#define __debugbreak() raise(SIGTRAP)
+#define __declspec(x) __attribute__((visibility("default")))
+
+typedef unsigned char BYTE;
+typedef char CHAR;
+typedef uint32_t UINT;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef int errno_t;
+typedef intptr_t LRESULT;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef void *HANDLE;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+/***********************************************************************************************************************
+ *
+ * Window and device context.
+ *
+ **********************************************************************************************************************/
+
+// There is no window on the headless path: the "client area" is the size of the EGL pbuffer we render into.
+struct LinuxWindow
+{
+    int32_t width;
+    int32_t height;
+};
+typedef LinuxWindow *HWND;
+
+struct LinuxDeviceContext
+{
+    EGLDisplay display;
+    EGLSurface surface;
+};
+typedef LinuxDeviceContext *HDC;
+
+struct RECT
+{
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+inline BOOL GetClientRect(HWND window, RECT *rect)
+{
+    rect->left = 0;
+    rect->top = 0;
+    rect->right = window->width;
+    rect->bottom = window->height;
+    return TRUE;
+}
+
+inline BOOL SwapBuffers(HDC hdc)
+{
+    return eglSwapBuffers(hdc->display, hdc->surface) == EGL_TRUE;
+}
+
+#define MB_OK 0
+#define IDOK 1
+#define S_OK 0
+
+inline int MessageBoxW(HWND window, const wchar_t *text, const wchar_t *caption, UINT type)
+{
+    fwprintf(stderr, L"%ls: %ls\n", caption, text);
+    return IDOK;
+}
+
+/***********************************************************************************************************************
+ *
+ * Timing and debug output.
+ *
+ **********************************************************************************************************************/
+
+union LARGE_INTEGER {
+    int64_t QuadPart;
+};
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER *counter)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counter->QuadPart = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+    frequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+inline void OutputDebugStringA(const char *string)
+{
+    fputs(string, stderr);
+}
+
+/***********************************************************************************************************************
+ *
+ * Virtual memory.
+ *
+ **********************************************************************************************************************/
+
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define PAGE_READWRITE 0x04
+
+inline void *VirtualAlloc(void *address, size_t size, DWORD allocationType, DWORD protect)
+{
+    void *result = mmap(address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (result == MAP_FAILED) ? NULL : result;
+}
+
+// NOTE: unlike on Windows, munmap() needs the size of the mapping; every call site already passes it.
+inline BOOL VirtualFree(void *address, size_t size, DWORD freeType)
+{
+    return munmap(address, size) == 0;
+}
+
+/***********************************************************************************************************************
+ *
+ * Files.
+ *
+ **********************************************************************************************************************/
+
+#define GENERIC_READ 0x80000000
+#define FILE_SHARE_READ 0x1
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+struct FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+inline HANDLE CreateFileA(const char *filename, DWORD desiredAccess, DWORD shareMode, void *securityAttributes,
+                          DWORD creationDisposition, DWORD flagsAndAttributes, HANDLE templateFile)
+{
+    int fd = open(filename, O_RDONLY);
+    return (fd == -1) ? INVALID_HANDLE_VALUE : (HANDLE)(intptr_t)fd;
+}
+
+inline BOOL CloseHandle(HANDLE file)
+{
+    return (file != INVALID_HANDLE_VALUE) && close((int)(intptr_t)file) == 0;
+}
+
+inline BOOL GetFileTime(HANDLE file, FILETIME *creationTime, FILETIME *lastAccessTime, FILETIME *lastWriteTime)
+{
+    struct stat fileStat;
+    if (file == INVALID_HANDLE_VALUE || fstat((int)(intptr_t)file, &fileStat) != 0)
+    {
+        return FALSE;
+    }
+    uint64_t nanoseconds = (uint64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+    lastWriteTime->dwLowDateTime = (DWORD)nanoseconds;
+    lastWriteTime->dwHighDateTime = (DWORD)(nanoseconds >> 32);
+    return TRUE;
+}
+
+inline long CompareFileTime(const FILETIME *a, const FILETIME *b)
+{
+    uint64_t first = ((uint64_t)a->dwHighDateTime << 32) | a->dwLowDateTime;
+    uint64_t second = ((uint64_t)b->dwHighDateTime << 32) | b->dwLowDateTime;
+    return (first < second) ? -1 : (first > second) ? 1 : 0;
+}
+
+inline DWORD GetFileSize(HANDLE file, DWORD *fileSizeHigh)
+{
+    struct stat fileStat;
+    if (file == INVALID_HANDLE_VALUE || fstat((int)(intptr_t)file, &fileStat) != 0)
+    {
+        return 0xffffffff;
+    }
+    if (fileSizeHigh)
+    {
+        *fileSizeHigh = (DWORD)((uint64_t)fileStat.st_size >> 32);
+    }
+    return (DWORD)fileStat.st_size;
+}
+
+inline BOOL ReadFile(HANDLE file, void *buffer, DWORD bytesToRead, DWORD *bytesRead, void *overlapped)
+{
+    *bytesRead = 0;
+    while (*bytesRead < bytesToRead)
+    {
+        ssize_t result = read((int)(intptr_t)file, (char *)buffer + *bytesRead, bytesToRead - *bytesRead);
+        if (result <= 0)
+        {
+            return result == 0;
+        }
+        *bytesRead += (DWORD)result;
+    }
+    return TRUE;
+}
+
+#define PAGE_READONLY 0x02
+#define FILE_MAP_READ 0x4
+
+// The mapping object is a duplicate of the file descriptor, so that both handles can be closed independently.
+inline HANDLE CreateFileMappingA(HANDLE file, void *attributes, DWORD protect, DWORD maximumSizeHigh,
+                                 DWORD maximumSizeLow, const char *name)
+{
+    int fd = (file == INVALID_HANDLE_VALUE) ? -1 : dup((int)(intptr_t)file);
+    return (fd == -1) ? NULL : (HANDLE)(intptr_t)fd;
+}
+
+// Maps the whole file. NOTE: munmap() needs the size of the mapping, which UnmapViewOfFile() doesn't get, so the view
+// is preceded by a page which holds it.
+inline void *MapViewOfFile(HANDLE mapping, DWORD desiredAccess, DWORD offsetHigh, DWORD offsetLow, size_t numBytes)
+{
+    struct stat fileStat;
+    if (fstat((int)(intptr_t)mapping, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        return NULL;
+    }
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)fileStat.st_size;
+    void *reserved = mmap(NULL, pageSize + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        return NULL;
+    }
+    void *view = (char *)reserved + pageSize;
+    if (mmap(view, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, (int)(intptr_t)mapping, 0) == MAP_FAILED)
+    {
+        munmap(reserved, pageSize + size);
+        return NULL;
+    }
+    *(size_t *)reserved = size;
+    return view;
+}
+
+inline BOOL UnmapViewOfFile(const void *view)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    void *reserved = (char *)view - pageSize;
+    return munmap(reserved, pageSize + *(size_t *)reserved) == 0;
+}
+
+/***********************************************************************************************************************
+ *
+ * MSVC "secure" CRT extensions.
+ *
+ **********************************************************************************************************************/
+
+template <size_t N, typename... Args> int sprintf_s(char (&buffer)[N], const char *format, Args... args)
+{
+    return snprintf(buffer, N, format, args...);
+}
+
+template <typename... Args> int sprintf_s(char *buffer, size_t bufferSize, const char *format, Args... args)
+{
+    return snprintf(buffer, bufferSize, format, args...);
+}
+
+template <size_t N> int vsprintf_s(char (&buffer)[N], const char *format, va_list args)
+{
+    return vsnprintf(buffer, N, format, args);
+}
+
+template <size_t N> errno_t strcpy_s(char (&destination)[N], const char *source)
+{
+    snprintf(destination, N, "%s", source);
+    return 0;
+}
+
+inline errno_t memcpy_s(void *destination, size_t destinationSize, const void *source, size_t count)
+{
+    if (count > destinationSize)
+    {
+        return -1;
+    }
+    memcpy(destination, source, count);
+    return 0;
+}
+
+inline errno_t fopen_s(FILE **file, const char *filename, const char *mode)
+{
+    *file = fopen(filename, mode);
+    return (*file == NULL) ? -1 : 0;
+}
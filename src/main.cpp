@@ -1,5 +1,9 @@
 #include "arena.h"
 #include "common.h"
+#include "file_watcher.h"
+#include "input.h"
+#include "jobs.h"
+#include "telemetry.h"
 
 /***********************************************************************************************************************
  *
@@ -14,6 +18,23 @@
 typedef void (*InitializeTracyGPUContext_t)();
 InitializeTracyGPUContext_t InitializeTracyGPUContext;
 
+//
+// Memory.
+//
+
+typedef void (*SetArenaRegistry_t)(ArenaRegistry *registry);
+SetArenaRegistry_t SetArenaRegistry;
+
+typedef void (*FreeModuleArenas_t)();
+FreeModuleArenas_t FreeModuleArenas;
+
+//
+// Jobs.
+//
+
+typedef void (*SetJobSystem_t)(JobSystem *system);
+SetJobSystem_t SetJobSystem;
+
 //
 // Dear ImGui.
 //
@@ -24,9 +45,16 @@ InitializeImGuiInModule_t InitializeImGuiInModule;
 typedef ImGuiIO *(*GetImGuiIO_t)();
 GetImGuiIO_t GetImGuiIO;
 
+// The Win32 backend only works on the window's thread, which calls these, see: Win32ProcessMessages().
 typedef LRESULT (*ImGui_WndProcHandler_t)(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 ImGui_WndProcHandler_t ImGui_WndProcHandler;
 
+typedef void (*ImGuiPlatformNewFrame_t)();
+ImGuiPlatformNewFrame_t ImGuiPlatformNewFrame;
+
+typedef s32 (*GetImGuiMouseCursor_t)();
+GetImGuiMouseCursor_t GetImGuiMouseCursor;
+
 //
 // Rendering.
 //
@@ -40,7 +68,8 @@ typedef bool (*SaveDrawingInfo_t)(TransientDrawingInfo *transientInfo, Persisten
 SaveDrawingInfo_t SaveDrawingInfo;
 
 // Main rendering function.
-typedef void (*DrawWindow_t)(HWND window, HDC hdc, ApplicationState *appState, Arena *listArena, Arena *tempArena);
+// Presenting the frame is left to the caller.
+typedef void (*DrawWindow_t)(HWND window, ApplicationState *appState, Arena *listArena, Arena *tempArena);
 DrawWindow_t DrawWindow;
 
 //
@@ -51,6 +80,10 @@ DrawWindow_t DrawWindow;
 typedef void (*ProvideCameraVectors_t)(CameraInfo *cameraInfo);
 ProvideCameraVectors_t ProvideCameraVectors;
 
+// SimulateGame() advances the game by one fixed simulation step.
+typedef void (*SimulateGame_t)(ApplicationState *appState, f32 stepSeconds);
+SimulateGame_t SimulateGame;
+
 // GameHandleClick() handles screen picking, to add a cube to the clicked-on face of a cube already in the scene.
 typedef void (*GameHandleClick_t)(TransientDrawingInfo *transientInfo, CWInput button, CWPoint coordinates,
                                   CWPoint screenSize);
@@ -67,12 +100,22 @@ PFNWGLCREATECONTEXTATTRIBSARBPROC wglCreateContextAttribsARB;
 
 /***********************************************************************************************************************
  *
- * Handle OpenGL viewport resizing, called upon initialization as well as from WndProc's WM_SIZE case.
+ * Handle OpenGL viewport resizing, called upon initialization as well as from the render thread when the game thread
+ * reports a new client area size (see: ApplyFrameSnapshot()).
  *
  **********************************************************************************************************************/
 
-internal void ResizeGLViewport(HWND window, CameraInfo *cameraInfo, TransientDrawingInfo *transientInfo,
-                               PersistentDrawingInfo *persistentInfo)
+internal void UpdateAspectRatio(HWND window, CameraInfo *cameraInfo)
+{
+    RECT clientRect;
+    GetClientRect(window, &clientRect);
+    if (clientRect.bottom != 0)
+    {
+        cameraInfo->aspectRatio = (f32)clientRect.right / (f32)clientRect.bottom;
+    }
+}
+
+internal void ResizeGLViewport(HWND window, TransientDrawingInfo *transientInfo, PersistentDrawingInfo *persistentInfo)
 {
     // Get new client area size.
     RECT clientRect;
@@ -85,9 +128,8 @@ internal void ResizeGLViewport(HWND window, CameraInfo *cameraInfo, TransientDra
     }
 
 
-    // Resize GL viewport to match client area and update aspect ratio.
+    // Resize GL viewport to match client area.
     glViewport(0, 0, width, height);
-    cameraInfo->aspectRatio = (f32)width / (f32)height;
 
     // Resize our framebuffers.
     if (persistentInfo->initialized)
@@ -130,6 +172,139 @@ internal void ResizeGLViewport(HWND window, CameraInfo *cameraInfo, TransientDra
     }
 }
 
+/***********************************************************************************************************************
+ *
+ * Frame snapshots, handed over from the game thread, which owns the window and runs the message pump and the
+ * simulation, to the render thread, which owns the OpenGL context and draws Dear ImGui's frames.
+ *
+ **********************************************************************************************************************/
+
+// Number of snapshots in flight: the game thread prepares the next frame while the render thread draws this one, and
+// blocks once it is that many frames ahead.
+#define FRAME_PIPELINE_DEPTH 2
+
+// When set, the render thread overrides the snapshot's camera orientation with the latest mouse look event pumped
+// after the snapshot was submitted, right before drawing (see: ProcessRenderEvents()).
+#define LATE_CAMERA_SAMPLING 1
+
+struct FrameSnapshot
+{
+    // Game state as of the end of the game thread's frame. The render thread draws from its own copy and never reads
+    // the game thread's state directly.
+    CameraInfo cameraInfo;
+    PersistentDrawingInfo persistentInfo;
+    Simulation simulation;
+    bool playing;
+    CWPoint clientSize;
+
+    // The last mouse look event whose orientation cameraInfo includes.
+    u64 lookSequence;
+    u64 lookTimestamp;
+
+    // Game thread timings, recorded into the telemetry by the render thread; negative when not measured.
+    f32 gameTimingsMs[(u32)FrameTimingCategory::Count];
+
+    bool shadersChanged;
+    bool reloadGameCode;
+    bool quit;
+};
+
+// The fields of the drawing info which the editor menu edits. Each one is handed back on its own, so that an edit only
+// overwrites the field it was made to, and not whatever the game thread changed in the rest of the drawing info since
+// the snapshot was taken, e.g. through the keyboard (see: ApplyInputEvent()).
+struct EditorField
+{
+    u32 offset;
+    u32 size;
+};
+
+#define EDITOR_FIELD(field) {offsetof(PersistentDrawingInfo, field), sizeof(((PersistentDrawingInfo *)0)->field)}
+#define EDITOR_POINT_LIGHT_FIELDS(i)                                                                                   \
+    EDITOR_FIELD(pointLights[i].position), EDITOR_FIELD(pointLights[i].ambient),                                       \
+        EDITOR_FIELD(pointLights[i].diffuse), EDITOR_FIELD(pointLights[i].specular),                                   \
+        EDITOR_FIELD(pointLights[i].attIndex)
+
+global_variable EditorField editorFields[] = {
+    EDITOR_FIELD(materialShininess),
+    EDITOR_FIELD(blinn),
+    EDITOR_FIELD(gamma),
+    EDITOR_FIELD(exposure),
+    EDITOR_FIELD(ssaoSamplingRadius),
+    EDITOR_FIELD(ssaoPower),
+    EDITOR_FIELD(lodErrorPixels),
+    EDITOR_FIELD(meshletCulling),
+    EDITOR_FIELD(dirLight.direction),
+    EDITOR_FIELD(dirLight.ambient),
+    EDITOR_FIELD(dirLight.diffuse),
+    EDITOR_FIELD(dirLight.specular),
+    EDITOR_POINT_LIGHT_FIELDS(0),
+    EDITOR_POINT_LIGHT_FIELDS(1),
+    EDITOR_POINT_LIGHT_FIELDS(2),
+    EDITOR_POINT_LIGHT_FIELDS(3),
+    EDITOR_FIELD(spotLight.position),
+    EDITOR_FIELD(spotLight.direction),
+    EDITOR_FIELD(spotLight.ambient),
+    EDITOR_FIELD(spotLight.diffuse),
+    EDITOR_FIELD(spotLight.specular),
+    EDITOR_FIELD(spotLight.innerCutoff),
+    EDITOR_FIELD(spotLight.outerCutoff),
+};
+static_assert(NUM_POINTLIGHTS == 4, "Update editorFields.");
+static_assert(myArraySize(editorFields) <= 64, "Changed editor fields are tracked in a u64.");
+
+// Changes made through the editor menu, which runs on the render thread, for the game thread to adopt.
+struct EditorChanges
+{
+    u64 changedFields;                    // Bit i set when editorFields[i] changed.
+    PersistentDrawingInfo persistentInfo; // Only the changed fields are meaningful.
+
+    bool simulationChanged;
+    SimulationState simulationState;
+    f32 simulationRate;
+    bool playing;
+
+    bool cameraChanged;
+    f32 yaw;
+    f32 pitch;
+};
+
+struct RenderThread
+{
+    HANDLE thread;
+    HWND window;
+    HDC hdc;
+    HGLRC renderingContext;
+
+    // Only touched by the render thread once it has been started.
+    ApplicationState *renderState;
+    Arena *listArena;
+    Arena *tempArena;
+    CWPoint clientSize;
+    InputEvent latestLook;
+    u64 lastPresentedLookSequence;
+
+    FrameSnapshot snapshots[FRAME_PIPELINE_DEPTH];
+    HANDLE freeSnapshots;  // Semaphore counting the snapshots the game thread may fill.
+    HANDLE readySnapshots; // Semaphore counting the snapshots waiting to be drawn.
+    u32 writeIndex;        // Game thread only.
+    u32 readIndex;         // Render thread only.
+
+    // Clicks and mouse look, pushed by the game thread's message pump.
+    InputEventQueue *events;
+    u64 lookSequence;  // Game thread only.
+    u64 lookTimestamp; // Game thread only.
+
+    CRITICAL_SECTION editorChangesLock;
+    EditorChanges editorChanges;
+
+    // Dear ImGui's input capture state as of the last drawn frame, consulted by the message pump.
+    volatile LONG imGuiWantsMouse;
+    volatile LONG imGuiWantsKeyboard;
+};
+
+// The cursor Dear ImGui wants as of the last drawn frame, which only the window's thread can set (see: WndProc()).
+global_variable volatile LONG imGuiMouseCursor = ImGuiMouseCursor_Arrow;
+
 /***********************************************************************************************************************
  *
  * Windows message loop processing, done from within the game loop.
@@ -141,28 +316,93 @@ internal f32 clampf(f32 x, f32 min, f32 max, f32 safety = 0.f)
     return (x < min + safety) ? (min + safety) : (x > max - safety) ? (max - safety) : x;
 }
 
-internal void Win32ProcessMessages(HWND window, bool *running, PersistentDrawingInfo *persistentInfo,
-                                   TransientDrawingInfo *transientInfo, glm::vec3 *movement, CameraInfo *cameraInfo)
+// Mirrors ImGui_ImplWin32_UpdateMouseCursor(), on the window's thread.
+internal void Win32SetImGuiMouseCursor(s32 mouseCursor)
 {
+    LPTSTR cursor = IDC_ARROW;
+    switch (mouseCursor)
+    {
+    case ImGuiMouseCursor_None:
+        SetCursor(NULL);
+        return;
+    case ImGuiMouseCursor_TextInput:
+        cursor = IDC_IBEAM;
+        break;
+    case ImGuiMouseCursor_ResizeAll:
+        cursor = IDC_SIZEALL;
+        break;
+    case ImGuiMouseCursor_ResizeEW:
+        cursor = IDC_SIZEWE;
+        break;
+    case ImGuiMouseCursor_ResizeNS:
+        cursor = IDC_SIZENS;
+        break;
+    case ImGuiMouseCursor_ResizeNESW:
+        cursor = IDC_SIZENESW;
+        break;
+    case ImGuiMouseCursor_ResizeNWSE:
+        cursor = IDC_SIZENWSE;
+        break;
+    case ImGuiMouseCursor_Hand:
+        cursor = IDC_HAND;
+        break;
+    case ImGuiMouseCursor_NotAllowed:
+        cursor = IDC_NO;
+        break;
+    }
+    SetCursor(LoadCursor(NULL, cursor));
+}
+
+// Input handed from the message pump to its consumers.
+struct Win32InputQueues
+{
+    InputEventQueue *simulationEvents; // Drained by the simulation on the game thread, see: ApplyInputEvents().
+    RenderThread *renderThread;        // Drained by the render thread, see: ProcessRenderEvents().
+};
+
+internal void PushRenderEvent(Win32InputQueues *queues, InputEvent *event)
+{
+    if (!PushInputEvent(queues->renderThread->events, event))
+    {
+        DebugPrintA("Render thread input queue full, dropping event.\n");
+    }
+}
+
+internal void PushSimulationEvent(Win32InputQueues *queues, InputEvent *event)
+{
+    if (!PushInputEvent(queues->simulationEvents, event))
+    {
+        DebugPrintA("Simulation input queue full, dropping event.\n");
+    }
+}
+
+// Turns window messages into input events. Only what cannot wait for the consumers is handled here: quitting, mouse
+// capture and the mouse look itself, which the render thread samples as late as possible.
+internal void Win32ProcessMessages(HWND window, bool *running, CameraInfo *cameraInfo, Win32InputQueues *queues)
+{
+    RenderThread *renderThread = queues->renderThread;
+
     MSG message;
     while (PeekMessageW(&message, NULL, 0, 0, PM_REMOVE))
     {
-        // Give Dear ImGui first dibs to ensure input processing is correctly handled.
-        if (ImGui_WndProcHandler(window, message.message, message.wParam, message.lParam))
-        {
-            break;
-        }
-        ImGuiIO *imGuiIO = GetImGuiIO();
-        if (imGuiIO->WantCaptureKeyboard || imGuiIO->WantTextInput)
+        InputEvent event = {};
+        event.timestamp = Win32GetWallClock();
+
+        // Give Dear ImGui first dibs to ensure input processing is correctly handled. Its Win32 backend runs here, on
+        // the window's thread, but its frames are drawn on the render thread, so we go by whether it wanted the
+        // keyboard as of the last drawn frame. Key releases always go through, lest a key pressed before Dear ImGui
+        // took the keyboard stay held.
+        ImGui_WndProcHandler(window, message.message, message.wParam, message.lParam);
+        bool keyUp = (message.message == WM_KEYUP || message.message == WM_SYSKEYUP);
+        if (renderThread->imGuiWantsKeyboard && message.message != WM_QUIT && !keyUp)
         {
             TranslateMessage(&message);
             DispatchMessage(&message);
-            break;
+            continue;
         }
-        
+
         // Mouse parameters.
         local_persist bool capturing = false;
-        local_persist f32 speed = .1f;
 
         // Retrieve window information.
         POINT windowOrigin = {};
@@ -183,11 +423,19 @@ internal void Win32ProcessMessages(HWND window, bool *running, PersistentDrawing
             *running = false;
             break;
         case WM_LBUTTONDOWN: {
+            // Clicks on the editor menu are Dear ImGui's.
+            if (renderThread->imGuiWantsMouse)
+            {
+                break;
+            }
+
             // NOTE: received coordinates will be relative to the top left of the client area,
             // so we convert them into OpenGL's lower-left-origin coordinate system.
-            CWPoint coordinates = {GET_X_LPARAM(message.lParam), height - GET_Y_LPARAM(message.lParam)};
-            CWPoint screenSize = {width, height};
-            GameHandleClick(transientInfo, CWInput::LeftButton, coordinates, screenSize);
+            // Picking reads back the G-buffer, so it is left to the render thread.
+            event.type = InputEventType::Click;
+            event.coordinates = {GET_X_LPARAM(message.lParam), height - GET_Y_LPARAM(message.lParam)};
+            event.screenSize = {width, height};
+            PushRenderEvent(queues, &event);
         }
         break;
         case WM_RBUTTONDOWN:
@@ -204,7 +452,6 @@ internal void Win32ProcessMessages(HWND window, bool *running, PersistentDrawing
             capturing = false;
             break;
         case WM_MOUSEMOVE: {
-            bool rightButtonDown = (message.wParam & 0x2);
             if (capturing)
             {
                 // NOTE: we have to use these macros instead of LOWORD() and HIWORD() for things to
@@ -212,114 +459,56 @@ internal void Win32ProcessMessages(HWND window, bool *running, PersistentDrawing
                 // https://learn.microsoft.com/en-us/windows/win32/inputdev/wm-rbuttondown
                 s16 xCoord = originX + GET_X_LPARAM(message.lParam);
                 s16 yCoord = originY + GET_Y_LPARAM(message.lParam);
+                if (xCoord == centreX && yCoord == centreY)
+                {
+                    // Produced by our own recentring below.
+                    break;
+                }
                 cameraInfo->yaw -= (xCoord - centreX) / 100.f;
                 cameraInfo->pitch = clampf(cameraInfo->pitch - (yCoord - centreY) / 100.f, -PI / 2, PI / 2, .01f);
 
+                event.type = InputEventType::Look;
+                event.yaw = cameraInfo->yaw;
+                event.pitch = cameraInfo->pitch;
+                event.sequence = ++renderThread->lookSequence;
+                renderThread->lookTimestamp = event.timestamp;
+                PushRenderEvent(queues, &event);
+
                 SetCursorPos(centreX, centreY);
             }
             break;
         }
-        case WM_MOUSEWHEEL: {
-            // Implement Unreal-style modification of viewport movement speed via mouse wheel (scroll up to increase
-            // speed, scroll down to decrease it).
-            s16 wheelRotation = HIWORD(message.wParam);
-            bool shiftPressed = (GetKeyState(VK_SHIFT) < 0);
-            if (shiftPressed)
-            {
-                cameraInfo->fov = clampf(cameraInfo->fov - (f32)wheelRotation * 3.f / WHEEL_DELTA, 0.f, 90.f);
-            }
-            else
-            {
-                speed = fmax(speed + (f32)wheelRotation / (20.f * WHEEL_DELTA), 0.f);
-                DebugPrintA("New speed: %f\n", speed);
-            }
+        case WM_MOUSEWHEEL:
+            event.type = InputEventType::MouseWheel;
+            event.wheelRotation = HIWORD(message.wParam);
+            event.shiftPressed = (GetKeyState(VK_SHIFT) < 0);
+            PushSimulationEvent(queues, &event);
             break;
-        }
         case WM_CHAR:
-            imGuiIO->AddInputCharacter((u32)message.wParam);
+            // Already forwarded to Dear ImGui above.
+            break;
+        case WM_KEYUP:
+        case WM_SYSKEYUP:
+            event.type = InputEventType::KeyUp;
+            event.key = (u32)message.wParam;
+            PushSimulationEvent(queues, &event);
+            TranslateMessage(&message);
+            DispatchMessage(&message);
             break;
         case WM_KEYDOWN:
         case WM_SYSKEYDOWN: {
-            // Treat WASD specially, for the purposes of viewport movement when the right mouse button is held down (see
-            // WM_RBUTTONDOWN case above).
-            float deltaZ = (GetKeyState('W') < 0) ? .1f : (GetKeyState('S') < 0) ? -.1f : 0.f;
-            float deltaX = (GetKeyState('D') < 0) ? .1f : (GetKeyState('A') < 0) ? -.1f : 0.f;
-            *movement += cameraInfo->forwardVector * deltaZ * speed;
-            *movement += cameraInfo->rightVector * deltaX * speed;
-
-            // Handle other keys.
             bool altPressed = (message.lParam >> 29) & 1;
             u32 vkCode = (u32)message.wParam;
-            switch (vkCode)
+            if (vkCode == VK_ESCAPE || (vkCode == VK_F4 && altPressed))
             {
-            case VK_F4:
-                if (altPressed)
-                {
-                    *running = false;
-                }
-                break;
-            case VK_ESCAPE:
                 *running = false;
                 break;
-            case VK_UP:
-                if (altPressed)
-                {
-                }
-                else
-                {
-                    persistentInfo->spotLight.innerCutoff += .05f;
-                    DebugPrintA("innerCutoff: %f\n", persistentInfo->spotLight.innerCutoff);
-                }
-                break;
-            case VK_DOWN:
-                if (altPressed)
-                {
-                }
-                else
-                {
-                    persistentInfo->spotLight.innerCutoff -= .05f;
-                    DebugPrintA("innerCutoff: %f\n", persistentInfo->spotLight.innerCutoff);
-                }
-                break;
-            case VK_LEFT:
-                persistentInfo->spotLight.outerCutoff -= .05f;
-                DebugPrintA("outerCutoff: %f\n", persistentInfo->spotLight.outerCutoff);
-                break;
-            case VK_RIGHT:
-                persistentInfo->spotLight.outerCutoff += .05f;
-                DebugPrintA("outerCutoff: %f\n", persistentInfo->spotLight.outerCutoff);
-                break;
-            case 'Q':
-                cameraInfo->aspectRatio = fmax(cameraInfo->aspectRatio - .1f, 0.f);
-                break;
-            case 'E':
-                cameraInfo->aspectRatio = fmin(cameraInfo->aspectRatio + .1f, 10.f);
-                break;
-            case 'X':
-                persistentInfo->wireframeMode = !persistentInfo->wireframeMode;
-                glPolygonMode(GL_FRONT_AND_BACK, persistentInfo->wireframeMode ? GL_LINE : GL_FILL);
-                break;
-            case 'O':
-                break;
-            case 'J':
-                break;
-            case 'K':
-                break;
-            case 'L':
-                break;
-            case 'F': {
-                local_persist bool flashLightOn = true;
-                flashLightOn = !flashLightOn;
-                persistentInfo->spotLight.ambient = flashLightOn ? glm::vec3(.1f) : glm::vec3(0.f);
-                persistentInfo->spotLight.diffuse = flashLightOn ? glm::vec3(.5f) : glm::vec3(0.f);
-                persistentInfo->spotLight.specular = flashLightOn ? glm::vec3(1.f) : glm::vec3(0.f);
-                break;
-            }
-            case 'G':
-                break;
-            case 'H':
-                break;
             }
+
+            event.type = InputEventType::KeyDown;
+            event.key = vkCode;
+            event.altPressed = altPressed;
+            PushSimulationEvent(queues, &event);
             break;
         }
         default:
@@ -329,6 +518,113 @@ internal void Win32ProcessMessages(HWND window, bool *running, PersistentDrawing
     }
 }
 
+// Applies a key or mouse wheel event from the message pump to the game state.
+internal void ApplyInputEvent(InputEvent *event, ApplicationState *appState)
+{
+    local_persist bool keysDown[256];
+
+    PersistentDrawingInfo *persistentInfo = &appState->persistentInfo;
+    CameraInfo *cameraInfo = &appState->cameraInfo;
+    SimulationInput *input = &appState->simulation.input;
+
+    switch (event->type)
+    {
+    case InputEventType::MouseWheel:
+        // Implement Unreal-style modification of viewport movement speed via mouse wheel (scroll up to increase
+        // speed, scroll down to decrease it).
+        if (event->shiftPressed)
+        {
+            cameraInfo->fov = clampf(cameraInfo->fov - (f32)event->wheelRotation * 3.f / WHEEL_DELTA, 0.f, 90.f);
+        }
+        else
+        {
+            input->speed = fmax(input->speed + (f32)event->wheelRotation / (20.f * WHEEL_DELTA), 0.f);
+            DebugPrintA("New speed: %f\n", input->speed);
+        }
+        break;
+    case InputEventType::KeyUp:
+        keysDown[event->key & 0xff] = false;
+        break;
+    case InputEventType::KeyDown: {
+        keysDown[event->key & 0xff] = true;
+
+        // Handle keys other than WASD.
+        switch (event->key)
+        {
+        case VK_UP:
+            if (event->altPressed)
+            {
+            }
+            else
+            {
+                persistentInfo->spotLight.innerCutoff += .05f;
+                DebugPrintA("innerCutoff: %f\n", persistentInfo->spotLight.innerCutoff);
+            }
+            break;
+        case VK_DOWN:
+            if (event->altPressed)
+            {
+            }
+            else
+            {
+                persistentInfo->spotLight.innerCutoff -= .05f;
+                DebugPrintA("innerCutoff: %f\n", persistentInfo->spotLight.innerCutoff);
+            }
+            break;
+        case VK_LEFT:
+            persistentInfo->spotLight.outerCutoff -= .05f;
+            DebugPrintA("outerCutoff: %f\n", persistentInfo->spotLight.outerCutoff);
+            break;
+        case VK_RIGHT:
+            persistentInfo->spotLight.outerCutoff += .05f;
+            DebugPrintA("outerCutoff: %f\n", persistentInfo->spotLight.outerCutoff);
+            break;
+        case 'Q':
+            cameraInfo->aspectRatio = fmax(cameraInfo->aspectRatio - .1f, 0.f);
+            break;
+        case 'E':
+            cameraInfo->aspectRatio = fmin(cameraInfo->aspectRatio + .1f, 10.f);
+            break;
+        case 'X':
+            // The render thread switches the polygon mode when it sees the change (see: ApplyFrameSnapshot()).
+            persistentInfo->wireframeMode = !persistentInfo->wireframeMode;
+            break;
+        case 'F': {
+            local_persist bool flashLightOn = true;
+            flashLightOn = !flashLightOn;
+            persistentInfo->spotLight.ambient = flashLightOn ? glm::vec3(.1f) : glm::vec3(0.f);
+            persistentInfo->spotLight.diffuse = flashLightOn ? glm::vec3(.5f) : glm::vec3(0.f);
+            persistentInfo->spotLight.specular = flashLightOn ? glm::vec3(1.f) : glm::vec3(0.f);
+            break;
+        }
+        }
+        break;
+    }
+    default:
+        myAssert(false);
+    }
+
+    // Treat WASD specially, for the purposes of viewport movement when the right mouse button is held down (see
+    // WM_RBUTTONDOWN case in Win32ProcessMessages()). The simulation keeps moving the camera for as long as the keys
+    // are held.
+    input->forward = keysDown['W'] ? 1.f : keysDown['S'] ? -1.f : 0.f;
+    input->right = keysDown['D'] ? 1.f : keysDown['A'] ? -1.f : 0.f;
+}
+
+// Applies the events pumped up to the given wall clock time, leaving later ones for a later simulation step.
+internal void ApplyInputEvents(InputEventQueue *queue, u64 until, ApplicationState *appState)
+{
+    while (InputEvent *event = PeekInputEvent(queue))
+    {
+        if (event->timestamp > until)
+        {
+            break;
+        }
+        ApplyInputEvent(event, appState);
+        PopInputEvent(queue);
+    }
+}
+
 /***********************************************************************************************************************
  *
  * Initialize modern OpenGL context.
@@ -442,6 +738,11 @@ void LoadRenderingCode(HWND window)
     HMODULE loglLib = GetModuleHandleW(L"logl_runtime.dll");
     if (loglLib != NULL)
     {
+        // Queued jobs point into the old code, and running ones may be in its Tracy hook.
+        WaitForJobSystemIdle(gJobSystem);
+        gJobSystem->runJobHook.store(NULL, std::memory_order_release);
+        // NOTE: its scratch arenas would otherwise stay committed, and listed in the registry, for good.
+        FreeModuleArenas();
         FreeLibrary(loglLib);
     }
 
@@ -450,12 +751,20 @@ void LoadRenderingCode(HWND window)
     myAssert(loglLib != NULL);
 
     // Assign function pointers from game DLL.
+    SetArenaRegistry = (SetArenaRegistry_t)GetProcAddress(loglLib, "SetArenaRegistry");
+    SetArenaRegistry(gArenaRegistry);
+    FreeModuleArenas = (FreeModuleArenas_t)GetProcAddress(loglLib, "FreeModuleArenas");
+    SetJobSystem = (SetJobSystem_t)GetProcAddress(loglLib, "SetJobSystem");
+    SetJobSystem(gJobSystem);
+
     InitializeTracyGPUContext = (InitializeTracyGPUContext_t)GetProcAddress(loglLib, "InitializeTracyGPUContext");
     
     InitializeImGuiInModule = (InitializeImGuiInModule_t)GetProcAddress(loglLib, "InitializeImGuiInModule");
     InitializeImGuiInModule(window);
     GetImGuiIO = (GetImGuiIO_t)GetProcAddress(loglLib, "GetImGuiIO");
     ImGui_WndProcHandler = (ImGui_WndProcHandler_t)GetProcAddress(loglLib, "ImGui_WndProcHandler");
+    ImGuiPlatformNewFrame = (ImGuiPlatformNewFrame_t)GetProcAddress(loglLib, "ImGuiPlatformNewFrame");
+    GetImGuiMouseCursor = (GetImGuiMouseCursor_t)GetProcAddress(loglLib, "GetImGuiMouseCursor");
     
     InitializeDrawingInfo = (InitializeDrawingInfo_t)GetProcAddress(loglLib, "InitializeDrawingInfo");
     SaveDrawingInfo = (SaveDrawingInfo_t)GetProcAddress(loglLib, "SaveDrawingInfo");
@@ -463,19 +772,315 @@ void LoadRenderingCode(HWND window)
     
     ProvideCameraVectors = (ProvideCameraVectors_t)GetProcAddress(loglLib, "ProvideCameraVectors");
     GameHandleClick = (GameHandleClick_t)GetProcAddress(loglLib, "GameHandleClick");
+    SimulateGame = (SimulateGame_t)GetProcAddress(loglLib, "SimulateGame");
 }
 
-void CheckForNewDLL(HWND window, FILETIME *lastFileTime)
+/***********************************************************************************************************************
+ *
+ * Render thread.
+ *
+ **********************************************************************************************************************/
+
+// Adopts the game state from the snapshot, along with the OpenGL state changes that follow from it.
+// NOTE: state is copied with memcpy() rather than assignment so that padding matches as well, as
+// PublishEditorChanges() compares the simulation state against the snapshot byte for byte.
+internal void ApplyFrameSnapshot(RenderThread *renderThread, FrameSnapshot *snapshot)
 {
-    HANDLE renderingDLL = CreateFileW(L"logl.dll", GENERIC_READ, 0, 0, OPEN_EXISTING, 0, 0);
-    FILETIME fileTime = {};
-    GetFileTime(renderingDLL, 0, 0, &fileTime);
-    CloseHandle(renderingDLL);
-    if (CompareFileTime(lastFileTime, &fileTime) != 0)
+    ApplicationState *renderState = renderThread->renderState;
+
+    if (snapshot->persistentInfo.wireframeMode != renderState->persistentInfo.wireframeMode)
     {
-        LoadRenderingCode(window);
+        glPolygonMode(GL_FRONT_AND_BACK, snapshot->persistentInfo.wireframeMode ? GL_LINE : GL_FILL);
+    }
+
+    memcpy(&renderState->cameraInfo, &snapshot->cameraInfo, sizeof(CameraInfo));
+    memcpy(&renderState->persistentInfo, &snapshot->persistentInfo, sizeof(PersistentDrawingInfo));
+    memcpy(&renderState->simulation, &snapshot->simulation, sizeof(Simulation));
+    renderState->playing = snapshot->playing;
+    renderState->shadersChanged |= snapshot->shadersChanged;
+
+    if (snapshot->clientSize.x != renderThread->clientSize.x || snapshot->clientSize.y != renderThread->clientSize.y)
+    {
+        ResizeGLViewport(renderThread->window, &renderState->transientInfo, &renderState->persistentInfo);
+        renderThread->clientSize = snapshot->clientSize;
     }
-    *lastFileTime = fileTime;
+}
+
+// Drains the events pumped for the render thread so far, then brings the camera orientation up to date with the most
+// recent mouse look event, which may well be newer than the snapshot. Returns the time at which the newest mouse look
+// event being presented for the first time was pumped, or 0 if there is none.
+internal u64 ProcessRenderEvents(RenderThread *renderThread, FrameSnapshot *snapshot)
+{
+    ApplicationState *renderState = renderThread->renderState;
+
+    while (InputEvent *event = PeekInputEvent(renderThread->events))
+    {
+        switch (event->type)
+        {
+        case InputEventType::Click:
+            GameHandleClick(&renderState->transientInfo, CWInput::LeftButton, event->coordinates, event->screenSize);
+            break;
+        case InputEventType::Look:
+            renderThread->latestLook = *event;
+            break;
+        default:
+            myAssert(false);
+        }
+        PopInputEvent(renderThread->events);
+    }
+
+    u64 lookSequence = snapshot->lookSequence;
+    u64 lookTimestamp = snapshot->lookTimestamp;
+#if LATE_CAMERA_SAMPLING
+    InputEvent *latestLook = &renderThread->latestLook;
+    if (latestLook->sequence > lookSequence)
+    {
+        renderState->cameraInfo.yaw = latestLook->yaw;
+        renderState->cameraInfo.pitch = latestLook->pitch;
+        ProvideCameraVectors(&renderState->cameraInfo);
+        lookSequence = latestLook->sequence;
+        lookTimestamp = latestLook->timestamp;
+    }
+#endif
+
+    if (lookSequence <= renderThread->lastPresentedLookSequence)
+    {
+        return 0;
+    }
+    renderThread->lastPresentedLookSequence = lookSequence;
+    return lookTimestamp;
+}
+
+// Hands whatever the editor menu changed this frame back to the game thread, which owns that state. The camera
+// orientation is compared against the one drawn with, which late sampling may have changed from the snapshot's.
+internal void PublishEditorChanges(RenderThread *renderThread, FrameSnapshot *snapshot, CameraInfo *drawnCameraInfo)
+{
+    ApplicationState *renderState = renderThread->renderState;
+    u8 *edited = (u8 *)&renderState->persistentInfo;
+    u8 *drawn = (u8 *)&snapshot->persistentInfo;
+    u64 changedFields = 0;
+    for (u32 i = 0; i < myArraySize(editorFields); i++)
+    {
+        EditorField *field = &editorFields[i];
+        if (memcmp(edited + field->offset, drawn + field->offset, field->size) != 0)
+        {
+            changedFields |= 1ull << i;
+        }
+    }
+    bool simulationChanged =
+        memcmp(&renderState->simulation.current, &snapshot->simulation.current, sizeof(SimulationState)) != 0 ||
+        renderState->simulation.rate != snapshot->simulation.rate || renderState->playing != snapshot->playing;
+    bool cameraChanged = renderState->cameraInfo.yaw != drawnCameraInfo->yaw ||
+                         renderState->cameraInfo.pitch != drawnCameraInfo->pitch;
+    if (!changedFields && !simulationChanged && !cameraChanged)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&renderThread->editorChangesLock);
+    EditorChanges *changes = &renderThread->editorChanges;
+    // NOTE: changes which the game thread hasn't adopted yet are kept, only the fields changed again are replaced.
+    for (u32 i = 0; i < myArraySize(editorFields); i++)
+    {
+        if (changedFields & (1ull << i))
+        {
+            EditorField *field = &editorFields[i];
+            memcpy((u8 *)&changes->persistentInfo + field->offset, edited + field->offset, field->size);
+        }
+    }
+    changes->changedFields |= changedFields;
+    if (simulationChanged)
+    {
+        changes->simulationChanged = true;
+        changes->simulationState = renderState->simulation.current;
+        changes->simulationRate = renderState->simulation.rate;
+        changes->playing = renderState->playing;
+    }
+    if (cameraChanged)
+    {
+        changes->cameraChanged = true;
+        changes->yaw = renderState->cameraInfo.yaw;
+        changes->pitch = renderState->cameraInfo.pitch;
+    }
+    LeaveCriticalSection(&renderThread->editorChangesLock);
+}
+
+internal DWORD WINAPI RenderThreadProc(LPVOID parameter)
+{
+    RenderThread *renderThread = (RenderThread *)parameter;
+    ApplicationState *renderState = renderThread->renderState;
+    FrameTelemetry *telemetry = &renderState->telemetry;
+
+    // The context was created on the main thread, which let go of it before starting us.
+    wglMakeCurrent(renderThread->hdc, renderThread->renderingContext);
+    SetGLJobThread(gJobSystem);
+    InitializeTracyGPUContext();
+
+    while (true)
+    {
+        WaitForSingleObject(renderThread->readySnapshots, INFINITE);
+        FrameSnapshot *snapshot = &renderThread->snapshots[renderThread->readIndex];
+        renderThread->readIndex = (renderThread->readIndex + 1) % FRAME_PIPELINE_DEPTH;
+        if (snapshot->quit)
+        {
+            ReleaseSemaphore(renderThread->freeSnapshots, 1, NULL);
+            break;
+        }
+
+        // The game thread waits for the pipeline to drain before calling into the game DLL again (see:
+        // ReloadGameCode()), which makes this the one place where the DLL can safely be swapped out.
+        if (snapshot->reloadGameCode)
+        {
+            LoadRenderingCode(renderThread->window);
+        }
+
+        ApplyFrameSnapshot(renderThread, snapshot);
+        u64 lookTimestamp = ProcessRenderEvents(renderThread, snapshot);
+        CameraInfo drawnCameraInfo = renderState->cameraInfo;
+
+        u64 renderStart = Win32GetWallClock();
+        RunGLJobs(gJobSystem, JOB_GL_FRAME_BUDGET_MS);
+        DrawWindow(renderThread->window, renderState, renderThread->listArena, renderThread->tempArena);
+
+        u64 swapStart = Win32GetWallClock();
+        if (!SwapBuffers(renderThread->hdc))
+        {
+            if (MessageBoxW(renderThread->window, L"Failed to swap buffers", L"OpenGL error", MB_OK) == S_OK)
+            {
+                PostMessageW(renderThread->window, WM_CLOSE, 0, 0);
+            }
+        }
+        u64 swapEnd = Win32GetWallClock();
+        if (telemetry->firstFrameMs == 0.f)
+        {
+            telemetry->firstFrameMs = Win32GetElapsedMs(telemetry->startTimestamp, swapEnd);
+            DebugPrintA("First frame after %.1f ms\n", telemetry->firstFrameMs);
+        }
+
+        for (u32 i = 0; i < (u32)FrameTimingCategory::Count; i++)
+        {
+            if (snapshot->gameTimingsMs[i] >= 0.f)
+            {
+                RecordFrameTiming(telemetry, (FrameTimingCategory)i, snapshot->gameTimingsMs[i]);
+            }
+        }
+        RecordFrameTiming(telemetry, FrameTimingCategory::RenderSubmit, Win32GetElapsedMs(renderStart, swapStart));
+        RecordFrameTiming(telemetry, FrameTimingCategory::Swap, Win32GetElapsedMs(swapStart, swapEnd));
+        if (lookTimestamp != 0)
+        {
+            RecordFrameTiming(telemetry, FrameTimingCategory::InputLatency, Win32GetElapsedMs(lookTimestamp, swapEnd));
+        }
+
+        PublishEditorChanges(renderThread, snapshot, &drawnCameraInfo);
+        ImGuiIO *imGuiIO = GetImGuiIO();
+        InterlockedExchange(&renderThread->imGuiWantsMouse, imGuiIO->WantCaptureMouse);
+        InterlockedExchange(&renderThread->imGuiWantsKeyboard, imGuiIO->WantCaptureKeyboard || imGuiIO->WantTextInput);
+        InterlockedExchange(&imGuiMouseCursor, GetImGuiMouseCursor());
+
+        ReleaseSemaphore(renderThread->freeSnapshots, 1, NULL);
+    }
+
+    wglMakeCurrent(NULL, NULL);
+    return 0;
+}
+
+//
+// Game thread side.
+//
+
+// Hands out the next snapshot to fill. The caller must have waited on freeSnapshots, which blocks while the render
+// thread is FRAME_PIPELINE_DEPTH frames behind.
+internal FrameSnapshot *BeginFrameSnapshot(RenderThread *renderThread)
+{
+    FrameSnapshot *snapshot = &renderThread->snapshots[renderThread->writeIndex];
+    renderThread->writeIndex = (renderThread->writeIndex + 1) % FRAME_PIPELINE_DEPTH;
+
+    snapshot->shadersChanged = false;
+    snapshot->reloadGameCode = false;
+    snapshot->quit = false;
+    for (u32 i = 0; i < (u32)FrameTimingCategory::Count; i++)
+    {
+        snapshot->gameTimingsMs[i] = -1.f;
+    }
+    return snapshot;
+}
+
+internal void SubmitFrameSnapshot(RenderThread *renderThread, FrameSnapshot *snapshot, ApplicationState *appState)
+{
+    snapshot->cameraInfo = appState->cameraInfo;
+    snapshot->persistentInfo = appState->persistentInfo;
+    snapshot->simulation = appState->simulation;
+    snapshot->playing = appState->playing;
+    snapshot->lookSequence = renderThread->lookSequence;
+    snapshot->lookTimestamp = renderThread->lookTimestamp;
+
+    RECT clientRect;
+    GetClientRect(renderThread->window, &clientRect);
+    snapshot->clientSize = {clientRect.right, clientRect.bottom};
+
+    // Dear ImGui's Win32 backend begins its frames here, on the window's thread, and so do we set the cursor, as it
+    // would.
+    ImGuiPlatformNewFrame();
+    local_persist LONG lastMouseCursor = ImGuiMouseCursor_Arrow;
+    if (imGuiMouseCursor != lastMouseCursor)
+    {
+        lastMouseCursor = imGuiMouseCursor;
+        Win32SetImGuiMouseCursor(lastMouseCursor);
+    }
+
+    ReleaseSemaphore(renderThread->readySnapshots, 1, NULL);
+}
+
+// Blocks until the render thread has drawn every snapshot submitted so far.
+internal void WaitForRenderThread(RenderThread *renderThread)
+{
+    for (u32 i = 0; i < FRAME_PIPELINE_DEPTH; i++)
+    {
+        WaitForSingleObject(renderThread->freeSnapshots, INFINITE);
+    }
+    ReleaseSemaphore(renderThread->freeSnapshots, FRAME_PIPELINE_DEPTH, NULL);
+}
+
+// Has the render thread reload the game DLL, and waits for it to be done so that the game thread can safely call the
+// new code.
+internal void ReloadGameCode(RenderThread *renderThread, ApplicationState *appState)
+{
+    WaitForSingleObject(renderThread->freeSnapshots, INFINITE);
+    FrameSnapshot *snapshot = BeginFrameSnapshot(renderThread);
+    snapshot->reloadGameCode = true;
+    SubmitFrameSnapshot(renderThread, snapshot, appState);
+    WaitForRenderThread(renderThread);
+}
+
+// Adopts the changes made through the editor menu on the render thread since the last call.
+internal void AdoptEditorChanges(RenderThread *renderThread, ApplicationState *appState)
+{
+    EnterCriticalSection(&renderThread->editorChangesLock);
+    EditorChanges *changes = &renderThread->editorChanges;
+    for (u32 i = 0; i < myArraySize(editorFields); i++)
+    {
+        if (changes->changedFields & (1ull << i))
+        {
+            EditorField *field = &editorFields[i];
+            memcpy((u8 *)&appState->persistentInfo + field->offset, (u8 *)&changes->persistentInfo + field->offset,
+                   field->size);
+        }
+    }
+    if (changes->simulationChanged)
+    {
+        // Editor changes teleport, see: ResetSimulationState().
+        appState->simulation.current = changes->simulationState;
+        appState->simulation.previous = changes->simulationState;
+        appState->simulation.rate = changes->simulationRate;
+        appState->playing = changes->playing;
+    }
+    if (changes->cameraChanged)
+    {
+        appState->cameraInfo.yaw = changes->yaw;
+        appState->cameraInfo.pitch = changes->pitch;
+    }
+    *changes = {};
+    LeaveCriticalSection(&renderThread->editorChangesLock);
 }
 
 /***********************************************************************************************************************
@@ -505,6 +1110,8 @@ LRESULT WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
+    // Time to first frame and to fully loaded are measured from here (see: FrameTelemetry).
+    u64 startTimestamp = Win32GetWallClock();
     if (InitializeOpenGLExtensions(hInstance) == -1)
     {
         OutputDebugStringW(L"Failed to initialize OpenGL extensions.");
@@ -522,7 +1129,15 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
     RegisterClassW(&windowClass);
 
+    // The main thread holds the OpenGL context until it starts the render thread, and again once that's done.
+    gJobSystem = StartJobSystem();
+    SetGLJobThread(gJobSystem);
+
+    // The game thread's state, and the render thread's copy of it (see: FrameSnapshot). The transient drawing info
+    // only exists on the render side.
     ApplicationState appState = {};
+    ApplicationState renderState = {};
+    renderState.telemetry.startTimestamp = startTimestamp;
 
     HWND window = CreateWindowW(windowClassName,     // lpClassName,
                                 L"Cooler World",     // lpWindowName,
@@ -629,63 +1244,128 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
 
-        ResizeGLViewport(window, &appState.cameraInfo, &appState.transientInfo, &appState.persistentInfo);
+        UpdateAspectRatio(window, &appState.cameraInfo);
+        ResizeGLViewport(window, &renderState.transientInfo, &renderState.persistentInfo);
 
-        // Load rendering code and initialize Tracy context.
+        // Load rendering code.
         LoadRenderingCode(window);
-        InitializeTracyGPUContext();
 
         // Initialize drawing info.
-        TransientDrawingInfo *transientInfo = &appState.transientInfo;
+        // NOTE: the transient info, which holds the OpenGL objects, belongs to the render thread; the rest is the
+        // game thread's.
         PersistentDrawingInfo *persistentInfo = &appState.persistentInfo;
         CameraInfo *cameraInfo = &appState.cameraInfo;
-        if (!InitializeDrawingInfo(window, transientInfo, persistentInfo, cameraInfo))
+        if (!InitializeDrawingInfo(window, &renderState.transientInfo, persistentInfo, cameraInfo))
         {
             return -1;
         }
 
-        // Initialize our game DLL timestamp for hot reloading purposes.
-        HANDLE renderingDLL = CreateFileW(L"logl.dll", GENERIC_READ, 0, 0, OPEN_EXISTING, 0, 0);
-        FILETIME lastFileTime = {};
-        GetFileTime(renderingDLL, 0, 0, &lastFileTime);
-        CloseHandle(renderingDLL);
-
-        // Accumulates delta time every frame to allow setting a minimum interval on DLL timestamp checking.
-        f32 dllAccumulator = 0.f;
-
-        // Allocate memory arenas used on a per-frame basis.
-        Arena *listArena = AllocArena(2048);
-        Arena *tempArena = AllocArena(1920 * 1080 * 32);
+        // Watch the working directory, which holds the game DLL, the shaders and the assets, for hot reloading
+        // purposes.
+        FileWatcher fileWatcher = {};
+        if (!StartFileWatcher(&fileWatcher, "."))
+        {
+            OutputDebugStringW(L"Failed to start file watcher, hot reloading is disabled.");
+        }
+        bool shadersChanged = false;
+
+        // Start the simulation from the loaded camera position.
+        Simulation *simulation = &appState.simulation;
+        simulation->current.cameraPos = cameraInfo->pos;
+        simulation->previous = simulation->current;
+
+        // Hand the OpenGL context over to the render thread, along with the memory arenas it uses on a per-frame
+        // basis.
+        RenderThread renderThread = {};
+        renderThread.window = window;
+        renderThread.hdc = hdc;
+        renderThread.renderingContext = renderingContext;
+        renderThread.renderState = &renderState;
+        renderThread.listArena = AllocArena(2048, "Render list");
+        renderThread.tempArena = AllocArena(1920 * 1080 * 32, "Render temp", ARENA_FLAG_HUGE_PAGES);
+        RECT clientRect;
+        GetClientRect(window, &clientRect);
+        renderThread.clientSize = {clientRect.right, clientRect.bottom};
+        renderThread.freeSnapshots = CreateSemaphoreW(NULL, FRAME_PIPELINE_DEPTH, FRAME_PIPELINE_DEPTH, NULL);
+        renderThread.readySnapshots = CreateSemaphoreW(NULL, 0, FRAME_PIPELINE_DEPTH, NULL);
+        InitializeCriticalSection(&renderThread.editorChangesLock);
+
+        // Input event queues, filled by the message pump (see: Win32ProcessMessages()).
+        Win32InputQueues inputQueues = {};
+        inputQueues.simulationEvents = (InputEventQueue *)VirtualAlloc(NULL, sizeof(InputEventQueue),
+                                                                      MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        inputQueues.renderThread = &renderThread;
+        renderThread.events = (InputEventQueue *)VirtualAlloc(NULL, sizeof(InputEventQueue), MEM_RESERVE | MEM_COMMIT,
+                                                              PAGE_READWRITE);
+        myAssert(inputQueues.simulationEvents && renderThread.events);
+
+        wglMakeCurrent(NULL, NULL);
+        renderThread.thread = CreateThread(NULL, 0, RenderThreadProc, &renderThread, 0, NULL);
+        if (!renderThread.thread)
+        {
+            OutputDebugStringW(L"Failed to create render thread.");
+            return -1;
+        }
 
         // Set up variables needed for tracking changes frame by frame.
-        glm::vec3 movementPerFrame = {};
         f32 targetFrameTime = 1000.f / 60;
         f32 deltaTime = targetFrameTime;
         u64 lastFrameCount = Win32GetWallClock();
 
-        // Main game loop.
+        // Main game loop. Each iteration fills a snapshot that the render thread draws while we move on to the next
+        // one.
         appState.running = true;
         while (appState.running)
         {
-            // Periodically check for a new game DLL; if it has been rebuilt, CheckForNewDLL() will call
-            // LoadRenderingCode() to perform hot reload.
-            // TODO: not a huge fan of this side effect, a function called CheckForNewDLL() shouldn't also perform a
-            // *load*. Make it return a bool that you act upon instead.
-            dllAccumulator += deltaTime;
-            if (dllAccumulator >= 50.f)
+            // Act upon the file changes posted by the file watcher. A new game DLL is reloaded right away, by the
+            // render thread; shader changes are passed on with the next snapshot.
+            bool reloadGameCode = false;
+            while (FileChange *change = PeekFileChange(&fileWatcher))
+            {
+                switch (change->kind)
+                {
+                case FileChangeKind::GameCode:
+                    reloadGameCode = true;
+                    break;
+                case FileChangeKind::Shader:
+                    shadersChanged = true;
+                    break;
+                case FileChangeKind::Asset:
+                    DebugPrintA("%s changed, restart to see the changes.\n", change->path);
+                    break;
+                default:
+                    break;
+                }
+                PopFileChange(&fileWatcher);
+            }
+            if (reloadGameCode)
             {
-                CheckForNewDLL(window, &lastFileTime);
-                dllAccumulator = 0.f;
+                ReloadGameCode(&renderThread, &appState);
             }
 
-            // Retrieve the camera's front and right unit vectors so we can pass them to our Windows message processor
-            // for the purposes of viewport movement.
-            ProvideCameraVectors(cameraInfo);
-
-            // Process Windows messages.
-            // movementPerFrame gets written to based on input received from Windows.
-            Win32ProcessMessages(window, &appState.running, persistentInfo, transientInfo, &movementPerFrame,
-                                 cameraInfo);
+            // Wait for the render thread to free up a snapshot, pumping messages in the meantime so that it gets to
+            // sample the latest camera orientation (see: ProcessRenderEvents()).
+            f32 messagePumpMs = 0.f;
+            while (MsgWaitForMultipleObjects(1, &renderThread.freeSnapshots, FALSE, INFINITE, QS_ALLINPUT) ==
+                   WAIT_OBJECT_0 + 1)
+            {
+                u64 messagePumpStart = Win32GetWallClock();
+                Win32ProcessMessages(window, &appState.running, cameraInfo, &inputQueues);
+                messagePumpMs += Win32GetElapsedMs(messagePumpStart, Win32GetWallClock());
+            }
+            FrameSnapshot *snapshot = BeginFrameSnapshot(&renderThread);
+            snapshot->shadersChanged = shadersChanged;
+            shadersChanged = false;
+            u64 gameStart = Win32GetWallClock();
+            AdoptEditorChanges(&renderThread, &appState);
+
+            // Process the remaining Windows messages.
+            // Key and mouse wheel input is queued up for the simulation, and whatever needs the OpenGL context for the
+            // render thread.
+            u64 messagePumpStart = Win32GetWallClock();
+            Win32ProcessMessages(window, &appState.running, cameraInfo, &inputQueues);
+            u64 messagePumpEnd = Win32GetWallClock();
+            messagePumpMs += Win32GetElapsedMs(messagePumpStart, messagePumpEnd);
 
             // Calculate delta time.
             u64 currentFrameCount = Win32GetWallClock();
@@ -698,32 +1378,62 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
             {
                 deltaTime = targetFrameTime;
             }
+            else
+            {
+                snapshot->gameTimingsMs[(u32)FrameTimingCategory::Frame] = deltaTime;
+            }
 
-            // Handle viewport movement and actually draw the scene at the new viewport position.
-            cameraInfo->pos += movementPerFrame * deltaTime;
-            DrawWindow(window, hdc, &appState, listArena, tempArena);
-            movementPerFrame = glm::vec3(0.f);
+            // Retrieve the camera's front and right unit vectors, along which the simulation moves the viewport.
+            ProvideCameraVectors(cameraInfo);
 
-            // Code to allow viewing the average framerate over the last 60 frames.
-            struct RingBuffer
+            // Advance the simulation in fixed steps, running as many steps as the elapsed time calls for (possibly
+            // none), then let the renderer interpolate between the last two simulation states.
+            f32 stepMs = 1000.f / simulation->rate;
+            simulation->accumulatorMs += deltaTime;
+            u32 numSteps = 0;
+            while (simulation->accumulatorMs >= stepMs && numSteps < MAX_SIMULATION_STEPS_PER_FRAME)
             {
-                f32 deltaTimes[60];
-                u32 index = 0;
-            };
-            local_persist RingBuffer deltaTimeBuffer;
-            deltaTimeBuffer.deltaTimes[deltaTimeBuffer.index] = deltaTime;
-            deltaTimeBuffer.index = (deltaTimeBuffer.index + 1) % 60;
-            f32 totalDeltaTime = 0.f;
-            for (u32 i = 0; i < 60; i++)
+                // Each step gets the input that was pumped before the wall clock time it simulates up to.
+                u64 stepEnd = currentFrameCount -
+                              (u64)((simulation->accumulatorMs - stepMs) / Win32GetWallClockPeriod());
+                ApplyInputEvents(inputQueues.simulationEvents, stepEnd, &appState);
+                SimulateGame(&appState, stepMs / 1000.f);
+                simulation->accumulatorMs -= stepMs;
+                numSteps++;
+            }
+            if (numSteps == MAX_SIMULATION_STEPS_PER_FRAME)
             {
-                totalDeltaTime += deltaTimeBuffer.deltaTimes[i];
+                simulation->accumulatorMs = fmin(simulation->accumulatorMs, stepMs);
             }
-            f32 averageDeltaTime = totalDeltaTime / 60;
+            simulation->alpha = simulation->accumulatorMs / stepMs;
+
+            // Hand the frame over to the render thread, which draws the scene at the interpolated viewport position.
+            u64 gameEnd = Win32GetWallClock();
+            snapshot->gameTimingsMs[(u32)FrameTimingCategory::MessagePump] = messagePumpMs;
+            snapshot->gameTimingsMs[(u32)FrameTimingCategory::Game] =
+                Win32GetElapsedMs(gameStart, messagePumpStart) + Win32GetElapsedMs(messagePumpEnd, gameEnd);
+            SubmitFrameSnapshot(&renderThread, snapshot, &appState);
         }
+
+        // Let the render thread finish the frames in flight, then take back the OpenGL context.
+        WaitForSingleObject(renderThread.freeSnapshots, INFINITE);
+        FrameSnapshot *snapshot = BeginFrameSnapshot(&renderThread);
+        snapshot->quit = true;
+        SubmitFrameSnapshot(&renderThread, snapshot, &appState);
+        WaitForSingleObject(renderThread.thread, INFINITE);
+        CloseHandle(renderThread.thread);
+        wglMakeCurrent(hdc, renderingContext);
+        SetGLJobThread(gJobSystem);
+        AdoptEditorChanges(&renderThread, &appState);
+        StopFileWatcher(&fileWatcher);
+
+        DumpFrameTelemetry(&renderState.telemetry, "frame_timings.txt");
     }
 
     // Save the programme's info when exiting.
-    SaveDrawingInfo(&appState.transientInfo, &appState.persistentInfo, &appState.cameraInfo);
+    appState.cameraInfo.pos = appState.simulation.current.cameraPos;
+    SaveDrawingInfo(&renderState.transientInfo, &appState.persistentInfo, &appState.cameraInfo);
+    StopJobSystem(gJobSystem);
 
     return 0;
 }
@@ -750,13 +1460,31 @@ LRESULT WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         return 0;
     }
     case WM_SIZE: {
-        ResizeGLViewport(hWnd, &appState->cameraInfo, &appState->transientInfo, &appState->persistentInfo);
+        // The render thread resizes the framebuffers once it sees the new client area size (see: ApplyFrameSnapshot()).
+        UpdateAspectRatio(hWnd, &appState->cameraInfo);
         return 0;
     }
     case WM_ERASEBKGND:
         // See:
         // https://stackoverflow.com/questions/43670470/drawn-opengl-disappearing-on-window-resize
         return 1;
+    case WM_SETFOCUS:
+    case WM_KILLFOCUS:
+        // Sent rather than posted, so the message pump never sees them.
+        if (ImGui_WndProcHandler)
+        {
+            ImGui_WndProcHandler(hWnd, uMsg, wParam, lParam);
+        }
+        break;
+    case WM_SETCURSOR:
+        // Dear ImGui doesn't set the cursor itself, as it only can from this thread (see: ImGui_WndProcHandler() in
+        // game.cpp).
+        if (LOWORD(lParam) == HTCLIENT)
+        {
+            Win32SetImGuiMouseCursor(imGuiMouseCursor);
+            return 1;
+        }
+        break;
     }
 
     return DefWindowProcW(hWnd, uMsg, wParam, lParam);
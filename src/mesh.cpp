@@ -1,46 +1,119 @@
 #include "arena.h"
 #include "common.h"
+#include "hashmap.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "pool.h"
 #include "render.h"
 #include "texture.h"
-
-internal Mesh ProcessMesh(aiMesh *mesh, const aiScene *scene, Arena *texturesArena, LoadedTextures *loadedTextures,
-                          Arena *vertices, Arena *indices, DrawElementsIndirectCommand *command,
-                          TextureHandles *handles)
+#include "vertex.h"
+
+/*
+ * Cooking: the source file is imported through Assimp and its meshes converted and optimized (see: OptimizeMesh()),
+ * their LODs built and split into meshlets, then written to the cooked file along with their draw commands,
+ * transforms and texture paths (see: CookedMeshHeader).
+ */
+
+// A LOD is only kept when it has at most this fraction of the triangles of the one before, otherwise it repeats it.
+#define LOD_MAX_TRIANGLE_RATIO .8f
+
+// Appends the coarser LODs of the mesh after its indices, each simplified from the one before to about half its
+// triangles and reordered for the vertex cache. The commands are those of every LOD of the mesh, the first one's
+// being set already.
+internal void BuildMeshLods(PackedVertex *vertices, u32 numVertices, TempMemory indexData,
+                            DrawElementsIndirectCommand *commands, MeshOptimizationStats *stats)
 {
-    Mesh result = {};
+    Arena *indices = indexData.arena;
+    u32 *indexBase = (u32 *)((u8 *)indices->memory + indexData.stackPointer);
+    stats->lodTriangles[0] = commands[0].count / 3;
+    stats->lodErrors[0] = 0.f;
+    bool simplified = true;
+    for (u32 lod = 1; lod < MAX_MODEL_LODS; lod++)
+    {
+        DrawElementsIndirectCommand *previous = &commands[(lod - 1) * MAX_MESHES_PER_MODEL];
+        DrawElementsIndirectCommand *command = &commands[lod * MAX_MESHES_PER_MODEL];
+        *command = *previous;
+        stats->lodTriangles[lod] = stats->lodTriangles[lod - 1];
+        stats->lodErrors[lod] = stats->lodErrors[lod - 1];
+        if (!simplified)
+        {
+            continue;
+        }
 
-    command->baseVertex = (u32)(vertices->stackPointer / sizeof(Vertex));
-    result.verticesSize = mesh->mNumVertices * sizeof(Vertex);
-    result.vertices = (Vertex *)ArenaPush(vertices, result.verticesSize);
-    myAssert(((u8 *)result.vertices + result.verticesSize) == ((u8 *)vertices->memory + vertices->stackPointer));
+        u32 *lodIndices = PushArray<u32>(indices, previous->count);
+        f32 error;
+        u32 targetCount = (previous->count / 6) * 3;
+        u32 count =
+            SimplifyMesh(vertices, numVertices, indexBase + previous->firstIndex, previous->count, targetCount,
+                         lodIndices, &error);
+        simplified = (count <= (u32)(previous->count * LOD_MAX_TRIANGLE_RATIO));
+        if (!simplified)
+        {
+            ArenaPop(indices, previous->count * sizeof(u32));
+            continue;
+        }
+
+        TempMemory scratch = GetScratch();
+        u32 *clusters = PushArray<u32>(scratch.arena, count / 3 + 1);
+        OptimizeVertexCache(lodIndices, count, numVertices, clusters);
+        TempEnd(scratch);
+        ArenaPop(indices, (previous->count - count) * sizeof(u32));
+
+        command->firstIndex = (u32)(lodIndices - indexBase);
+        command->count = count;
+        // NOTE: each LOD's error is measured against the one before, so they add up.
+        stats->lodTriangles[lod] = count / 3;
+        stats->lodErrors[lod] += error;
+    }
+}
+
+internal void ProcessMesh(aiMesh *mesh, const aiScene *scene, CookedMesh *result, Arena *strings,
+                          TempMemory vertexData, TempMemory indexData, DrawElementsIndirectCommand *commands,
+                          MeshOptimizationStats *stats)
+{
+    DrawElementsIndirectCommand *command = &commands[0];
+    // NOTE: the commands live in arena memory, which isn't constructed: the default instance count never gets set.
+    command->instanceCount = 1;
+    // The vertex and index data of every mesh are packed after the markers, offsets are relative to them.
+    Arena *vertices = vertexData.arena;
+    Arena *indices = indexData.arena;
+    command->baseVertex = (u32)((vertices->stackPointer - vertexData.stackPointer) / sizeof(PackedVertex));
+    u64 verticesSize = mesh->mNumVertices * sizeof(PackedVertex);
+    PackedVertex *meshVertices = (PackedVertex *)ArenaPush(vertices, verticesSize);
+    myAssert(((u8 *)meshVertices + verticesSize) == ((u8 *)vertices->memory + vertices->stackPointer));
 
     for (u32 i = 0; i < mesh->mNumVertices; i++)
     {
-        result.vertices[i].position.x = mesh->mVertices[i].x;
-        result.vertices[i].position.y = mesh->mVertices[i].y;
-        result.vertices[i].position.z = mesh->mVertices[i].z;
+        Vertex vertex = {};
+        vertex.position.x = mesh->mVertices[i].x;
+        vertex.position.y = mesh->mVertices[i].y;
+        vertex.position.z = mesh->mVertices[i].z;
 
-        result.vertices[i].normal.x = mesh->mNormals[i].x;
-        result.vertices[i].normal.y = mesh->mNormals[i].y;
-        result.vertices[i].normal.z = mesh->mNormals[i].z;
+        vertex.normal.x = mesh->mNormals[i].x;
+        vertex.normal.y = mesh->mNormals[i].y;
+        vertex.normal.z = mesh->mNormals[i].z;
 
-        result.vertices[i].tangent.x = mesh->mTangents[i].x;
-        result.vertices[i].tangent.y = mesh->mTangents[i].y;
-        result.vertices[i].tangent.z = mesh->mTangents[i].z;
+        vertex.tangent.x = mesh->mTangents[i].x;
+        vertex.tangent.y = mesh->mTangents[i].y;
+        vertex.tangent.z = mesh->mTangents[i].z;
 
-        result.vertices[i].bitangent.x = mesh->mBitangents[i].x;
-        result.vertices[i].bitangent.y = mesh->mBitangents[i].y;
-        result.vertices[i].bitangent.z = mesh->mBitangents[i].z;
+        vertex.bitangent.x = mesh->mBitangents[i].x;
+        vertex.bitangent.y = mesh->mBitangents[i].y;
+        vertex.bitangent.z = mesh->mBitangents[i].z;
 
         if (mesh->mTextureCoords[0])
         {
-            result.vertices[i].texCoords.x = mesh->mTextureCoords[0][i].x;
-            result.vertices[i].texCoords.y = mesh->mTextureCoords[0][i].y;
+            vertex.texCoords.x = mesh->mTextureCoords[0][i].x;
+            vertex.texCoords.y = mesh->mTextureCoords[0][i].y;
         }
+        meshVertices[i] = PackVertex(&vertex);
     }
 
-    command->firstIndex = (u32)(indices->stackPointer / sizeof(u32));
-    result.indices = (u32 *)((u8 *)indices->memory + indices->stackPointer);
+    command->firstIndex = (u32)((indices->stackPointer - indexData.stackPointer) / sizeof(u32));
+    u32 *meshIndices = (u32 *)((u8 *)indices->memory + indices->stackPointer);
     u32 indicesCount = 0;
     for (u32 i = 0; i < mesh->mNumFaces; i++)
     {
@@ -54,162 +127,530 @@ internal Mesh ProcessMesh(aiMesh *mesh, const aiScene *scene, Arena *texturesAre
         }
     }
     command->count = indicesCount;
-    result.indicesSize = indicesCount * sizeof(u32);
-    myAssert(((u8 *)result.indices + result.indicesSize) == ((u8 *)indices->memory + indices->stackPointer));
-
+    myAssert(((u8 *)meshIndices + indicesCount * sizeof(u32)) ==
+             ((u8 *)indices->memory + indices->stackPointer));
+
+    // NOTE: the mesh's vertices are the last ones pushed, so those which welding leaves over can be popped.
+    *stats = OptimizeMesh(meshVertices, mesh->mNumVertices, meshIndices, indicesCount);
+    ArenaPop(vertices, (mesh->mNumVertices - stats->numVertices) * sizeof(PackedVertex));
+    BuildMeshLods(meshVertices, stats->numVertices, indexData, commands, stats);
+
+    aiTextureType types[] = {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT,
+                             aiTextureType_DISPLACEMENT};
+    static_assert(myArraySize(types) == myArraySize(result->texturePaths), "one path per texture type");
+    for (u32 i = 0; i < myArraySize(types); i++)
+    {
+        result->texturePaths[i] = COOKED_MESH_NO_TEXTURE;
+    }
     if (mesh->mMaterialIndex >= 0)
     {
         aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-
-        u32 numDiffuse = material->GetTextureCount(aiTextureType_DIFFUSE);
-        u32 numSpecular = material->GetTextureCount(aiTextureType_SPECULAR);
-        u32 numNormals = material->GetTextureCount(aiTextureType_HEIGHT);
-        u32 numDisp = material->GetTextureCount(aiTextureType_DISPLACEMENT);
-        u32 numTextures = numDiffuse + numSpecular + numNormals + numDisp;
-
-        u64 texturesSize = sizeof(Texture) * numTextures;
-
-        Material *textures = &result.material;
-        LoadTextures(&result, &textures->diffuse, numDiffuse, material, aiTextureType_DIFFUSE, texturesArena,
-                     loadedTextures);
-        LoadTextures(&result, &textures->specular, numSpecular, material, aiTextureType_SPECULAR, texturesArena,
-                     loadedTextures);
-        LoadTextures(&result, &textures->normals, numNormals, material, aiTextureType_HEIGHT, texturesArena,
-                     loadedTextures);
-        LoadTextures(&result, &textures->displacement, numDisp, material, aiTextureType_DISPLACEMENT, texturesArena,
-                     loadedTextures);
-
-        *handles = CreateTextureHandlesFromMaterial(textures);
+        for (u32 i = 0; i < myArraySize(types); i++)
+        {
+            // NOTE: for now we only handle one texture per texture type.
+            myAssert(material->GetTextureCount(types[i]) <= 1);
+            aiString path;
+            if (material->GetTexture(types[i], 0, &path) == aiReturn_SUCCESS)
+            {
+                result->texturePaths[(u32)GetTextureTypeFromAssimp(types[i])] = (u32)strings->stackPointer;
+                char *string = PushArray<char>(strings, path.length + 1);
+                memcpy(string, path.C_Str(), path.length + 1);
+            }
+        }
     }
-
-    return result;
 }
 
-internal void ProcessNode(aiNode *node, const aiScene *scene, Mesh *meshes, u32 *meshCount, Arena *texturesArena,
-                          LoadedTextures *loadedTextures, Arena *vertices, Arena *indices,
-                          IndirectCommandBuffer *commandBuffer, TextureHandleBuffer *texHandleBuffer)
+// The commands are laid out as in the cooked file, a run per LOD, but runs are MAX_MESHES_PER_MODEL long.
+internal void ProcessNode(aiNode *node, const aiScene *scene, CookedMesh *meshes, Arena *strings, TempMemory vertices,
+                          TempMemory indices, DrawElementsIndirectCommand *commands, u32 *numMeshes,
+                          MeshOptimizationStats *stats)
 {
     for (u32 i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
 
-        DrawElementsIndirectCommand *command = &commandBuffer->commands[commandBuffer->numCommands];
-        TextureHandles *handles = &texHandleBuffer->handleGroups[texHandleBuffer->numHandleGroups];
-        Mesh processedMesh =
-            ProcessMesh(mesh, scene, texturesArena, loadedTextures, vertices, indices, command, handles);
-        commandBuffer->numCommands++;
-        texHandleBuffer->numHandleGroups++;
-
-        myAssert(commandBuffer->numCommands <= MAX_MESHES_PER_MODEL);
-        myAssert(texHandleBuffer->numHandleGroups <= MAX_MESHES_PER_MODEL);
-        myAssert(commandBuffer->numCommands == texHandleBuffer->numHandleGroups);
+        myAssert(*numMeshes < MAX_MESHES_PER_MODEL);
+        CookedMesh *cookedMesh = &meshes[*numMeshes];
+        ProcessMesh(mesh, scene, cookedMesh, strings, vertices, indices, &commands[*numMeshes], &stats[*numMeshes]);
+        (*numMeshes)++;
 
         aiMatrix4x4 trans = node->mTransformation;
         glm::mat4 rowMajorTrans = {trans.a1, trans.a2, trans.a3, trans.a4, trans.b1, trans.b2, trans.b3, trans.b4,
                                    trans.c1, trans.c2, trans.c3, trans.c4, trans.d1, trans.d2, trans.d3, trans.d4};
-        processedMesh.relativeTransform = glm::transpose(rowMajorTrans);
-        meshes[*meshCount] = processedMesh;
-        *meshCount += 1;
+        cookedMesh->relativeTransform = glm::transpose(rowMajorTrans);
     }
 
     for (u32 i = 0; i < node->mNumChildren; i++)
     {
-        ProcessNode(node->mChildren[i], scene, meshes, meshCount, texturesArena, loadedTextures, vertices, indices,
-                    commandBuffer, texHandleBuffer);
+        ProcessNode(node->mChildren[i], scene, meshes, strings, vertices, indices, commands, numMeshes, stats);
     }
 }
 
-internal Model LoadModel(const char *filename, s32 *elemCounts, u32 elemCountsSize, Arena *texturesArena,
-                         Arena *meshDataArena, u32 *objectId, f32 scale = 1.f)
+// Pads the file up to the section's offset, then writes the section.
+internal void WriteCookedMeshSection(FILE *file, u64 offset, void *data, u64 size)
 {
-    Model result = {};
+    local_persist u8 padding[COOKED_MESH_ALIGNMENT];
+    u64 position = (u64)ftell(file);
+    myAssert(position <= offset && offset - position < COOKED_MESH_ALIGNMENT);
+    fwrite(padding, 1, offset - position, file);
+    fwrite(data, 1, size, file);
+}
 
+internal bool CookModel(const char *filename, const char *cookedFilename, u64 sourceHash)
+{
     Assimp::Importer importer;
     const aiScene *scene =
         importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    myAssert(scene);
-    Mesh *meshes = (Mesh *)ArenaPush(meshDataArena, 100 * sizeof(Mesh));
-    u32 meshCount = 0;
-
-    LoadedTextures loadedTextures = {};
-    loadedTextures.textures = (Texture *)texturesArena->memory;
-
-    Arena *vertices = AllocArena(1000000 * sizeof(Vertex));
-    Arena *indices = AllocArena(1500000 * sizeof(u32));
-    IndirectCommandBuffer commandBuffer = {};
-    TextureHandleBuffer *texHandleBuffer = &result.textureHandleBuffer;
-    ProcessNode(scene->mRootNode, scene, meshes, &meshCount, texturesArena, &loadedTextures, vertices, indices,
-                &commandBuffer, texHandleBuffer);
-    myAssert(commandBuffer.numCommands == meshCount);
-    myAssert(texHandleBuffer->numHandleGroups == meshCount);
-
-    u32 *vao = &result.vao;
-    glCreateVertexArrays(1, vao);
-
-    u32 vbo;
-    glCreateBuffers(1, &vbo);
-    glNamedBufferStorage(vbo, vertices->stackPointer, vertices->memory, 0);
-
-    u32 ebo;
-    glCreateBuffers(1, &ebo);
-    glNamedBufferStorage(ebo, indices->stackPointer, indices->memory, 0);
-
-    glVertexArrayVertexBuffer(*vao, 0, vbo, 0, sizeof(Vertex));
-    glVertexArrayElementBuffer(*vao, ebo);
-
-    glVertexArrayAttribFormat(*vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayAttribFormat(*vao, 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(f32));
-    glVertexArrayAttribFormat(*vao, 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(f32));
-    glVertexArrayAttribFormat(*vao, 3, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(f32));
-    glVertexArrayAttribFormat(*vao, 4, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(f32));
-    glVertexArrayAttribBinding(*vao, 0, 0);
-    glVertexArrayAttribBinding(*vao, 1, 0);
-    glVertexArrayAttribBinding(*vao, 2, 0);
-    glVertexArrayAttribBinding(*vao, 3, 0);
-    glVertexArrayAttribBinding(*vao, 4, 0);
-    glEnableVertexArrayAttrib(*vao, 0);
-    glEnableVertexArrayAttrib(*vao, 1);
-    glEnableVertexArrayAttrib(*vao, 2);
-    glEnableVertexArrayAttrib(*vao, 3);
-    glEnableVertexArrayAttrib(*vao, 4);
-
-    u32 *icb = &result.commandBuffer;
-    glCreateBuffers(1, icb);
-    glNamedBufferStorage(*icb, sizeof(DrawElementsIndirectCommand) * commandBuffer.numCommands, commandBuffer.commands,
-                         0);
+    if (!scene)
+    {
+        DebugPrintA("Failed to import %s: %s\n", filename, importer.GetErrorString());
+        return false;
+    }
 
-    FreeArena(vertices);
+    // NOTE: sizes are reservations, see: AllocArena().
+    Arena *arena = AllocArena(1024 * 1024, "Model cook");
+    Arena *vertices = AllocArena(SCRATCH_ARENA_SIZE, "Model cook vertices", ARENA_FLAG_HUGE_PAGES);
+    Arena *indices = AllocArena(SCRATCH_ARENA_SIZE, "Model cook indices", ARENA_FLAG_HUGE_PAGES);
+    Arena *strings = AllocArena(1024 * 1024, "Model cook strings");
+    CookedMesh *meshes = PushArray<CookedMesh>(arena, MAX_MESHES_PER_MODEL);
+    u32 numCommands = MAX_MODEL_LODS * MAX_MESHES_PER_MODEL;
+    DrawElementsIndirectCommand *commands = PushArray<DrawElementsIndirectCommand>(arena, numCommands);
+    MeshOptimizationStats *stats = PushArray<MeshOptimizationStats>(arena, MAX_MESHES_PER_MODEL);
+    u32 numMeshes = 0;
+    ProcessNode(scene->mRootNode, scene, meshes, strings, TempBegin(vertices), TempBegin(indices), commands,
+                &numMeshes, stats);
+
+    // Indices are relative to each mesh's base vertex, so they fit in 16 bits as long as every mesh is small enough.
+    // LODs go as far as any mesh still got simplified, and are as far off as the furthest off mesh.
+    u32 maxMeshVertices = 0;
+    u32 numLods = 1;
+    f32 lodErrors[MAX_MODEL_LODS] = {};
+    for (u32 i = 0; i < numMeshes; i++)
+    {
+        maxMeshVertices = intMax(maxMeshVertices, stats[i].numVertices);
+        for (u32 lod = 1; lod < MAX_MODEL_LODS; lod++)
+        {
+            if (stats[i].lodTriangles[lod] < stats[i].lodTriangles[lod - 1])
+            {
+                numLods = intMax(numLods, lod + 1);
+            }
+            lodErrors[lod] = fmaxf(lodErrors[lod], stats[i].lodErrors[lod]);
+        }
+        DebugPrintA("%s, mesh %u: %u triangles, %u -> %u vertices, %u clusters, ACMR %.3f -> %.3f (welded) -> %.3f, "
+                    "ATVR %.3f -> %.3f (welded) -> %.3f, LODs %u/%u/%u/%u triangles, error %.4f/%.4f/%.4f\n",
+                    filename, i, stats[i].numTriangles, stats[i].numImportedVertices, stats[i].numVertices,
+                    stats[i].numClusters, stats[i].imported.acmr, stats[i].welded.acmr, stats[i].optimized.acmr,
+                    stats[i].imported.atvr, stats[i].welded.atvr, stats[i].optimized.atvr, stats[i].lodTriangles[0],
+                    stats[i].lodTriangles[1], stats[i].lodTriangles[2], stats[i].lodTriangles[3],
+                    stats[i].lodErrors[1], stats[i].lodErrors[2], stats[i].lodErrors[3]);
+    }
+    static_assert(MAX_MODEL_LODS == 4, "the report above prints every LOD");
+    // The runs of commands are packed together for the file.
+    for (u32 lod = 1; lod < numLods; lod++)
+    {
+        memmove(&commands[lod * numMeshes], &commands[lod * MAX_MESHES_PER_MODEL],
+                numMeshes * sizeof(DrawElementsIndirectCommand));
+    }
+
+    // Every LOD's meshlets are packed into blocks of their own, their meshes' one after the other (see: meshlet.h).
+    // NOTE: the mesh index is drawn as the base instance, which picks the mesh's textures.
+    PackedVertex *cookedVertices = (PackedVertex *)vertices->memory;
+    u32 *cookedIndices = (u32 *)indices->memory;
+    Arena *meshletBlocks = AllocArena(SCRATCH_ARENA_SIZE, "Model cook meshlets");
+    u32 lodMeshletBlocks[MAX_MODEL_LODS + 1] = {};
+    u32 numMeshlets = 0;
+    for (u32 lod = 0; lod < numLods; lod++)
+    {
+        lodMeshletBlocks[lod] = (u32)(meshletBlocks->stackPointer / sizeof(MeshletBlock));
+        MeshletBlock *block = NULL;
+        u32 lane = MESHLET_BLOCK_SIZE;
+        for (u32 i = 0; i < numMeshes; i++)
+        {
+            DrawElementsIndirectCommand *command = &commands[lod * numMeshes + i];
+            command->baseInstance = i;
+            TempMemory scratch = GetScratch();
+            Meshlet *meshlets = PushArray<Meshlet>(scratch.arena, command->count / 3);
+            u32 numMeshMeshlets = BuildMeshlets(cookedVertices + command->baseVertex, stats[i].numVertices,
+                                                cookedIndices + command->firstIndex, command->count, meshlets);
+            for (u32 j = 0; j < numMeshMeshlets; j++)
+            {
+                if (lane == MESHLET_BLOCK_SIZE)
+                {
+                    block = PushStruct<MeshletBlock>(meshletBlocks);
+                    memset(block, 0, sizeof(MeshletBlock));
+                    lane = 0;
+                }
+                SetMeshletBlockLane(block, lane++, &meshlets[j], command->firstIndex, command->baseVertex, i);
+            }
+            TempEnd(scratch);
+            numMeshlets += numMeshMeshlets;
+        }
+    }
+    lodMeshletBlocks[numLods] = (u32)(meshletBlocks->stackPointer / sizeof(MeshletBlock));
+    DebugPrintA("%s: %u meshlets over %u LODs\n", filename, numMeshlets, numLods);
+
+    f32 boundingRadius = 0.f;
+    for (u32 i = 0; i < vertices->stackPointer / sizeof(PackedVertex); i++)
+    {
+        boundingRadius = fmaxf(boundingRadius, glm::length(cookedVertices[i].position));
+    }
+    u32 indexSize = sizeof(u32);
+    if (maxMeshVertices <= 0x10000)
+    {
+        // NOTE: narrowing in place is safe, as every index is written at or before where it's read.
+        u32 numIndices = (u32)(indices->stackPointer / sizeof(u32));
+        u32 *wideIndices = (u32 *)indices->memory;
+        u16 *narrowIndices = (u16 *)indices->memory;
+        for (u32 i = 0; i < numIndices; i++)
+        {
+            narrowIndices[i] = (u16)wideIndices[i];
+        }
+        indexSize = sizeof(u16);
+        ArenaPop(indices, numIndices * (sizeof(u32) - sizeof(u16)));
+    }
+
+    CookedMeshHeader header = {};
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+    header.sourceHash = sourceHash;
+    header.vertexSize = sizeof(PackedVertex);
+    header.indexSize = indexSize;
+    header.numMeshes = numMeshes;
+    header.numLods = numLods;
+    memcpy(header.lodErrors, lodErrors, sizeof(lodErrors));
+    header.boundingRadius = boundingRadius;
+    memcpy(header.lodMeshletBlocks, lodMeshletBlocks, sizeof(lodMeshletBlocks));
+    header.meshesOffset = AlignUp(sizeof(CookedMeshHeader), COOKED_MESH_ALIGNMENT);
+    header.commandsOffset = AlignUp(header.meshesOffset + header.numMeshes * sizeof(CookedMesh), COOKED_MESH_ALIGNMENT);
+    header.meshletsOffset =
+        AlignUp(header.commandsOffset + header.numLods * header.numMeshes * sizeof(DrawElementsIndirectCommand),
+                COOKED_MESH_ALIGNMENT);
+    header.verticesOffset = AlignUp(header.meshletsOffset + meshletBlocks->stackPointer, COOKED_MESH_ALIGNMENT);
+    header.verticesSize = vertices->stackPointer;
+    header.indicesOffset = AlignUp(header.verticesOffset + header.verticesSize, COOKED_MESH_ALIGNMENT);
+    header.indicesSize = indices->stackPointer;
+    header.stringsOffset = AlignUp(header.indicesOffset + header.indicesSize, COOKED_MESH_ALIGNMENT);
+    header.stringsSize = strings->stackPointer;
+
+    FILE *file;
+    bool result = (fopen_s(&file, cookedFilename, "wb") == 0);
+    if (result)
+    {
+        WriteCookedMeshSection(file, 0, &header, sizeof(CookedMeshHeader));
+        WriteCookedMeshSection(file, header.meshesOffset, meshes, header.numMeshes * sizeof(CookedMesh));
+        WriteCookedMeshSection(file, header.commandsOffset, commands,
+                               header.numLods * header.numMeshes * sizeof(DrawElementsIndirectCommand));
+        WriteCookedMeshSection(file, header.meshletsOffset, meshletBlocks->memory, meshletBlocks->stackPointer);
+        WriteCookedMeshSection(file, header.verticesOffset, vertices->memory, header.verticesSize);
+        WriteCookedMeshSection(file, header.indicesOffset, indices->memory, header.indicesSize);
+        WriteCookedMeshSection(file, header.stringsOffset, strings->memory, header.stringsSize);
+        result = (ferror(file) == 0);
+        fclose(file);
+    }
+    if (!result)
+    {
+        DebugPrintA("Failed to write %s\n", cookedFilename);
+    }
+
+    FreeArena(meshletBlocks);
+    FreeArena(strings);
     FreeArena(indices);
+    FreeArena(vertices);
+    FreeArena(arena);
+    return result;
+}
 
-    result.meshCount = meshCount;
-    result.scale = glm::vec3(scale);
+// Returns NULL unless the cooked file is there, complete, and cooked from the same source by this version of the code.
+// A source hash of 0 matches any source.
+internal CookedMeshHeader *MapCookedMesh(const char *cookedFilename, u64 sourceHash, MappedFile *cooked)
+{
+    if (!Win32MapFile(cookedFilename, cooked))
+    {
+        return NULL;
+    }
 
-    result.id = *objectId++;
+    CookedMeshHeader *header = (CookedMeshHeader *)cooked->memory;
+    bool valid = cooked->size >= sizeof(CookedMeshHeader) && header->magic == COOKED_MESH_MAGIC &&
+                 header->version == COOKED_MESH_VERSION && header->vertexSize == sizeof(PackedVertex) &&
+                 (header->sourceHash == sourceHash || sourceHash == 0) && header->numMeshes <= MAX_MESHES_PER_MODEL &&
+                 header->numLods >= 1 && header->numLods <= MAX_MODEL_LODS;
+    for (u32 lod = 0; valid && lod < header->numLods; lod++)
+    {
+        valid &= (header->lodMeshletBlocks[lod] <= header->lodMeshletBlocks[lod + 1]);
+    }
+    if (valid)
+    {
+        // NOTE: a file cut short while it was being written is caught by its sections running past its end.
+        u64 sectionEnds[] = {header->meshesOffset + header->numMeshes * sizeof(CookedMesh),
+                             header->commandsOffset +
+                                 header->numLods * header->numMeshes * sizeof(DrawElementsIndirectCommand),
+                             header->meshletsOffset + header->lodMeshletBlocks[header->numLods] * sizeof(MeshletBlock),
+                             header->verticesOffset + header->verticesSize,
+                             header->indicesOffset + header->indicesSize,
+                             header->stringsOffset + header->stringsSize};
+        for (u32 i = 0; i < myArraySize(sectionEnds); i++)
+        {
+            valid &= (sectionEnds[i] <= cooked->size);
+        }
+    }
 
+    if (!valid)
+    {
+        Win32UnmapFile(cooked);
+        return NULL;
+    }
+    return header;
+}
+
+// fnv1a() of the file's contents, or 0 if there's no such file.
+internal u64 HashFile(const char *filename)
+{
+    MappedFile file;
+    if (!Win32MapFile(filename, &file))
+    {
+        return 0;
+    }
+    u64 result = fnv1a((u8 *)file.memory, file.size);
+    Win32UnmapFile(&file);
     return result;
 }
 
-internal u32 AddModel(const char *filename, TransientDrawingInfo *transientInfo, s32 *elemCounts, u32 elemCountsSize,
-                      Arena *texturesArena, Arena *meshDataArena, u32 *objectId, f32 scale = 1.f)
+/*
+ * Model streaming: models are imported on the job system, each by a job which maps its cooked file, cooking it first
+ * if the source has changed, and starts decoding its images as jobs of their own. Once the images are decoded, the
+ * import queues GL jobs which upload them and then the model's buffers straight from the cooked file, run by the
+ * render loop a few at a time (see: RunGLJobs()). Loading several models then takes about as long as the slowest, and
+ * doesn't hold up the first frame.
+ */
+
+internal void UploadModelJob(void *data, u32 begin, u32 end)
 {
-    u32 modelIndex = transientInfo->numModels;
-    transientInfo->models[modelIndex] =
-        LoadModel(filename, elemCounts, elemCountsSize, texturesArena, meshDataArena, objectId, scale);
-    transientInfo->numModels++;
-    myAssert(transientInfo->numModels <= MAX_MODELS);
-    return modelIndex;
+    ModelLoad *load = (ModelLoad *)data;
+    AssetLoading *loading = load->loading;
+    Model *model = PoolGet(&loading->transientInfo->models, load->handle);
+
+    // The meshes' textures only have their hashes so far, their images being uploaded by the GL jobs queued before.
+    LoadedTextures *loadedTextures = &load->loadedTextures;
+    TextureHandleBuffer *texHandleBuffer = &model->textureHandleBuffer;
+    for (u32 i = 0; i < load->meshCount; i++)
+    {
+        Material *material = &load->meshes[i].material;
+        Texture *textures[] = {&material->diffuse, &material->specular, &material->normals, &material->displacement};
+        for (u32 j = 0; j < myArraySize(textures); j++)
+        {
+            u32 *imageIndex = NULL;
+            if (textures[j]->hash != 0)
+            {
+                imageIndex = HashMapFind(&loadedTextures->imageIndices, textures[j]->hash);
+            }
+            if (imageIndex)
+            {
+                textures[j]->id = loadedTextures->images[*imageIndex].texture;
+            }
+        }
+        texHandleBuffer->handleGroups[i] = CreateTextureHandlesFromMaterial(material);
+    }
+    texHandleBuffer->numHandleGroups = load->meshCount;
+
+    CookedMeshHeader *header = load->header;
+    u8 *cooked = (u8 *)header;
+
+    // The commands are offset to where the model's vertices, indices and materials go in the geometry buffer, as are
+    // the meshlets, which produce commands of their own.
+    GeometryBuffer *geometry = &loading->transientInfo->geometry;
+    u32 numVertices = (u32)(header->verticesSize / header->vertexSize);
+    u32 numIndices = (u32)(header->indicesSize / header->indexSize);
+    GeometryRange range = UploadGeometry(geometry, (PackedVertex *)(cooked + header->verticesOffset), numVertices,
+                                         cooked + header->indicesOffset, numIndices, header->indexSize);
+    model->firstVertex = (u32)range.baseVertex;
+    model->numVertices = numVertices;
+    model->firstIndex = range.firstIndex;
+    model->numIndices = numIndices;
+    model->firstMaterial = UploadMaterials(geometry, texHandleBuffer->handleGroups, load->meshCount);
+
+    Arena *modelGeometryArena = loading->transientInfo->modelGeometryArena;
+    u32 numCommands = header->numLods * header->numMeshes;
+    DrawElementsIndirectCommand *commands = PushArray<DrawElementsIndirectCommand>(modelGeometryArena, numCommands);
+    memcpy(commands, cooked + header->commandsOffset, numCommands * sizeof(DrawElementsIndirectCommand));
+    for (u32 i = 0; i < numCommands; i++)
+    {
+        commands[i].firstIndex += model->firstIndex;
+        commands[i].baseVertex += model->firstVertex;
+        commands[i].baseInstance += model->firstMaterial;
+    }
+    model->commands = commands;
+    model->firstCommand =
+        AllocGeometryRange(&geometry->commands, numCommands, sizeof(DrawElementsIndirectCommand));
+    glNamedBufferSubData(geometry->commandBuffer, (u64)model->firstCommand * sizeof(DrawElementsIndirectCommand),
+                         numCommands * sizeof(DrawElementsIndirectCommand), commands);
+    model->meshCount = load->meshCount;
+    model->numLods = header->numLods;
+    model->boundingRadius = header->boundingRadius;
+    // NOTE: unlike the rest of the file, the meshlets stay on the CPU, culled every frame.
+    u32 numMeshletBlocks = header->lodMeshletBlocks[header->numLods];
+    model->meshletBlocks = PushArray<MeshletBlock>(modelGeometryArena, numMeshletBlocks);
+    memcpy(model->meshletBlocks, cooked + header->meshletsOffset, numMeshletBlocks * sizeof(MeshletBlock));
+    memcpy(model->lodMeshletBlocks, header->lodMeshletBlocks, sizeof(model->lodMeshletBlocks));
+    for (u32 i = 0; i < numMeshletBlocks; i++)
+    {
+        MeshletBlock *block = &model->meshletBlocks[i];
+        for (u32 lane = 0; lane < MESHLET_BLOCK_SIZE; lane++)
+        {
+            block->firstIndex[lane] += model->firstIndex;
+            block->baseVertex[lane] += model->firstVertex;
+            block->baseInstance[lane] += model->firstMaterial;
+        }
+    }
+    for (u32 lod = 0; lod < header->numLods; lod++)
+    {
+        model->lodErrors[lod] = header->lodErrors[lod];
+        model->lodTriangles[lod] = 0;
+        for (u32 i = 0; i < header->numMeshes; i++)
+        {
+            model->lodTriangles[lod] += commands[lod * header->numMeshes + i].count / 3;
+        }
+    }
+    model->loaded = true;
+
+    loading->vertexBytes += header->verticesSize;
+    loading->indexBytes += numIndices * sizeof(u32);
+    loading->slowestModelMs = fmaxf(loading->slowestModelMs, Win32GetElapsedMs(load->start, Win32GetWallClock()));
+
+    Win32UnmapFile(&load->cooked);
+    FreeArena(load->arena);
+}
+
+internal void ImportModelJob(void *data, u32 begin, u32 end)
+{
+    ModelLoad *load = (ModelLoad *)data;
+    load->start = Win32GetWallClock();
+
+    // Assimp only runs when the source has changed since it was cooked.
+    // NOTE: without the source, e.g. when only the cooked files are shipped, whatever was cooked is used.
+    char cookedFilename[256];
+    sprintf_s(cookedFilename, "%s.cwmesh", load->filename);
+    u64 sourceHash = HashFile(load->filename);
+    CookedMeshHeader *header = MapCookedMesh(cookedFilename, sourceHash, &load->cooked);
+    if (!header)
+    {
+        u64 cookStart = Win32GetWallClock();
+        if (CookModel(load->filename, cookedFilename, sourceHash))
+        {
+            DebugPrintA("Cooked %s in %.1f ms\n", cookedFilename, Win32GetElapsedMs(cookStart, Win32GetWallClock()));
+            header = MapCookedMesh(cookedFilename, sourceHash, &load->cooked);
+        }
+    }
+    if (!header)
+    {
+        // NOTE: the model stays a proxy; returning counts this job done, which is all there is to the model's load.
+        DebugPrintA("Failed to cook %s, skipping it\n", load->filename);
+        FreeArena(load->arena);
+        return;
+    }
+    load->header = header;
+
+    // Images shared between meshes are only loaded once. Every texture type of a mesh has at most one.
+    CookedMesh *cookedMeshes = (CookedMesh *)((u8 *)header + header->meshesOffset);
+    char *strings = (char *)header + header->stringsOffset;
+    load->meshCount = header->numMeshes;
+    load->meshes = PushArray<Mesh>(load->arena, load->meshCount);
+    LoadedTextures *loadedTextures = &load->loadedTextures;
+    loadedTextures->maxImages = myArraySize(cookedMeshes->texturePaths) * load->meshCount;
+    loadedTextures->images = PushArray<ImageLoad>(load->arena, loadedTextures->maxImages);
+    InitHashMap(&loadedTextures->imageIndices, load->arena);
+    for (u32 i = 0; i < load->meshCount; i++)
+    {
+        Mesh *mesh = &load->meshes[i];
+        *mesh = {};
+        mesh->relativeTransform = cookedMeshes[i].relativeTransform;
+        Texture *textures[] = {&mesh->material.diffuse, &mesh->material.specular, &mesh->material.normals,
+                               &mesh->material.displacement};
+        for (u32 j = 0; j < myArraySize(textures); j++)
+        {
+            u32 path = cookedMeshes[i].texturePaths[j];
+            if (path != COOKED_MESH_NO_TEXTURE)
+            {
+                LoadTexture(textures[j], strings + path, (TextureType)j, loadedTextures, load->arena);
+                mesh->numTextures++;
+            }
+        }
+    }
+
+    // Decodes images along with the workers, then hands the model over to the thread which holds the OpenGL context,
+    // a texture per GL job so that uploads spread over frames.
+    // NOTE: the upload jobs are counted before this job is, so the assets' counter can't get to zero in between.
+    WaitForJobCounter(gJobSystem, &loadedTextures->decoded);
+    JobCounter *counter = &load->loading->counter;
+    for (u32 i = 0; i < loadedTextures->numImages; i++)
+    {
+        PushGLJob(gJobSystem, UploadImageJob, &loadedTextures->images[i], counter, "Upload texture");
+    }
+    PushGLJob(gJobSystem, UploadModelJob, load, counter, "Upload model");
+}
+
+// Adds the model right away, and queues its import: until it's uploaded, it's drawn as a proxy with placeholder
+// textures (see: Model::loaded).
+internal ModelHandle StartLoadingModel(const char *filename, AssetLoading *loading, u32 *objectId, f32 scale = 1.f)
+{
+    Pool<Model> *models = &loading->transientInfo->models;
+    ModelHandle handle = PoolAlloc(models);
+    Model *model = PoolGet(models, handle);
+    *model = {};
+    model->scale = glm::vec3(scale);
+    model->id = (*objectId)++;
+
+    // NOTE: sizes are reservations, see: AllocArena().
+    Arena *arena = AllocArena(64 * 1024 * 1024, "Model import");
+    ModelLoad *load = PushStruct<ModelLoad>(arena);
+    load->filename = filename;
+    load->handle = handle;
+    load->loading = loading;
+    load->arena = arena;
+
+    loading->numModels++;
+    PushJob(gJobSystem, ImportModelJob, load, &loading->counter, "Import model");
+    return handle;
+}
+
+internal AssetLoading *StartAssetLoading(TransientDrawingInfo *transientInfo)
+{
+    Arena *arena = AllocArena(sizeof(AssetLoading), "Asset loading");
+    AssetLoading *result = PushStruct<AssetLoading>(arena);
+    result->arena = arena;
+    result->transientInfo = transientInfo;
+    result->start = Win32GetWallClock();
+    return result;
 }
 
-internal u32 AddObject(TransientDrawingInfo *transientInfo, u32 vao, u32 numIndices, glm::vec3 position,
-                       u32 *objectId, Material *textures = nullptr)
+// Called every frame: once every asset is uploaded, records the time to fully loaded.
+internal void UpdateAssetLoading(TransientDrawingInfo *transientInfo, FrameTelemetry *telemetry)
 {
-    u32 objectIndex = transientInfo->numObjects;
-    transientInfo->objects[objectIndex] = {*objectId++, vao, numIndices, position};
-    if (textures)
+    AssetLoading *loading = transientInfo->assetLoading;
+    if (!loading || loading->counter.count.load(std::memory_order_acquire) != 0)
     {
-        transientInfo->objects[objectIndex].textures = CreateTextureHandlesFromMaterial(textures);
+        return;
     }
-    transientInfo->numObjects++;
-    myAssert(transientInfo->numObjects <= MAX_OBJECTS);
-    return objectIndex;
+
+    u64 now = Win32GetWallClock();
+    telemetry->fullyLoadedMs = Win32GetElapsedMs(telemetry->startTimestamp, now);
+    DebugPrintA("Fully loaded after %.1f ms: %u models in %.1f ms, the slowest taking %.1f ms\n",
+                telemetry->fullyLoadedMs, loading->numModels, Win32GetElapsedMs(loading->start, now),
+                loading->slowestModelMs);
+    DebugPrintA("Model geometry: %.2f MB of vertices (%u bytes each), %.2f MB of indices\n",
+                loading->vertexBytes / (1024.f * 1024.f), (u32)sizeof(PackedVertex),
+                loading->indexBytes / (1024.f * 1024.f));
+    FreeArena(loading->arena);
+    transientInfo->assetLoading = NULL;
+}
+
+internal ObjectHandle AddObject(TransientDrawingInfo *transientInfo, GeometryRange geometry, glm::vec3 position,
+                                u32 *objectId, TextureHandles *textures, u32 material)
+{
+    ObjectHandle handle = PoolAlloc(&transientInfo->objects);
+    Object *object = PoolGet(&transientInfo->objects, handle);
+    *object = {(*objectId)++, geometry, position};
+    HashMapInsert(&transientInfo->objectsById, object->id, handle);
+    object->textures = *textures;
+    object->material = material;
+    return handle;
 }
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.h"
+#include "jobs.h"
+#include "render.h"
+#include "texture.h"
+#include "vertex.h"
+
+/*
+ * Cooked meshes (.cwmesh): what the renderer needs of a model source file, cooked once through Assimp and then mapped
+ * and copied into the geometry buffer as is, bar 16-bit indices (see: UploadModelJob()). Sections follow the header in
+ * this order, each aligned to COOKED_MESH_ALIGNMENT, at offsets from the start of the file.
+ */
+
+#define COOKED_MESH_MAGIC ('C' | ('W' << 8) | ('M' << 16) | ('S' << 24))
+// Bumped whenever the layout of the file changes, or what the import makes of the source does, which re-cooks it.
+#define COOKED_MESH_VERSION 5
+#define COOKED_MESH_ALIGNMENT 16
+#define COOKED_MESH_NO_TEXTURE 0xffffffff
+
+struct CookedMeshHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceHash; // fnv1a() of the source file's contents.
+    u32 vertexSize; // sizeof(PackedVertex) when cooked.
+    u32 indexSize;  // 2 when every mesh has fewer than 65536 vertices, 4 otherwise; widened once uploaded.
+    u32 numMeshes;
+    u32 numLods;
+    f32 lodErrors[MAX_MODEL_LODS]; // The largest of the meshes', see: SimplifyMesh().
+    f32 boundingRadius;
+    // LOD l's meshlet blocks are [lodMeshletBlocks[l], lodMeshletBlocks[l + 1]).
+    u32 lodMeshletBlocks[MAX_MODEL_LODS + 1];
+
+    u64 meshesOffset; // numMeshes CookedMesh.
+    // numLods runs of numMeshes DrawElementsIndirectCommand, into the vertices and indices below: every LOD of a mesh
+    // has the same vertices, and indices of its own.
+    u64 commandsOffset;
+    u64 meshletsOffset; // MeshletBlock, see: meshlet.h.
+    u64 verticesOffset;
+    u64 verticesSize;
+    u64 indicesOffset;
+    u64 indicesSize;
+    u64 stringsOffset; // NUL-terminated texture paths.
+    u64 stringsSize;
+};
+
+struct CookedMesh
+{
+    glm::mat4 relativeTransform;
+    u32 texturePaths[4]; // Offsets into the strings by TextureType, or COOKED_MESH_NO_TEXTURE.
+};
+
+// Assets streaming in after startup: the scene is drawn with placeholders (see: Model::loaded) until they're all
+// uploaded, a few GL jobs per frame (see: JOB_GL_FRAME_BUDGET_MS).
+struct AssetLoading
+{
+    JobCounter counter; // Counts the assets which aren't uploaded yet.
+    u32 numModels;
+    f32 slowestModelMs; // From the start of a model's import to the end of its upload. Only set by the GL jobs.
+    u64 vertexBytes;    // Of the models' vertex and index buffers, also only set by the GL jobs.
+    u64 indexBytes;
+    u64 start;
+    Arena *arena;
+
+    TransientDrawingInfo *transientInfo;
+    DecodedImage skyboxImages[6]; // See: CreateSkybox().
+};
+
+// A model's import, from the job which reads it to the GL job which uploads it.
+struct ModelLoad
+{
+    const char *filename;
+    ModelHandle handle;
+    AssetLoading *loading;
+    u64 start;
+
+    Arena *arena; // Holds this struct, the meshes and the image paths.
+    MappedFile cooked;
+    CookedMeshHeader *header; // Into the cooked file.
+    Mesh *meshes;
+    u32 meshCount;
+    LoadedTextures loadedTextures;
+};
@@ -0,0 +1,412 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+#include "vertex.h"
+
+#include <stdlib.h> // qsort().
+
+/***********************************************************************************************************************
+ *
+ * Mesh optimization: what the cook does to a mesh's vertices and indices before writing them (see: OptimizeMesh()),
+ * so that the GPU transforms, shades and fetches less of them.
+ *
+ *   1. Welding: Assimp emits a vertex per corner of every face, which are merged back when identical once packed.
+ *   2. Vertex cache: triangles are reordered with Tipsify (Sander et al., "Fast Triangle Reordering for Vertex
+ *      Locality and Reduced Overdraw"), fanning around the vertices most recently transformed.
+ *   3. Overdraw: Tipsify's output is split into clusters, which are then drawn outermost first, since they are the
+ *      likeliest to hide the rest, whatever the view.
+ *   4. Vertex fetch: vertices are renumbered in the order the indices first use them.
+ *
+ * Both orderings are measured against a FIFO post-transform cache (see: AnalyzeVertexCache()): ACMR, the vertices
+ * transformed per triangle (3 at worst, around 0.5 for a regular grid), and ATVR, the vertices transformed per
+ * vertex of the mesh (1 at best).
+ *
+ **********************************************************************************************************************/
+
+// Entries of the simulated post-transform cache, and the cache Tipsify optimizes for.
+#define VERTEX_CACHE_SIZE 16
+// A Tipsify cluster is split where the ACMR of its triangles so far gets within this factor of the whole cluster's:
+// higher makes smaller clusters, which sort better for overdraw and cost more vertex cache misses.
+#define OVERDRAW_CLUSTER_THRESHOLD 1.05f
+
+struct VertexCacheStats
+{
+    f32 acmr;
+    f32 atvr;
+};
+
+struct MeshOptimizationStats
+{
+    u32 numImportedVertices;
+    u32 numVertices;
+    u32 numTriangles;
+    u32 numClusters;
+    VertexCacheStats imported; // As Assimp emits them.
+    VertexCacheStats welded;   // Still in Assimp's order.
+    VertexCacheStats optimized;
+    u32 lodTriangles[MAX_MODEL_LODS]; // Set by the cook once the LODs are built, see: BuildMeshLods().
+    f32 lodErrors[MAX_MODEL_LODS];
+};
+
+// Counts the misses of a FIFO cache, which the cached-at timestamps of vertices emulate: a vertex is still cached
+// while fewer than VERTEX_CACHE_SIZE others went in after it.
+internal u32 SimulateVertexCache(u32 *triangle, u32 *cachedAt, u32 *timestamp)
+{
+    u32 misses = 0;
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (*timestamp - cachedAt[triangle[i]] > VERTEX_CACHE_SIZE)
+        {
+            cachedAt[triangle[i]] = (*timestamp)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+internal VertexCacheStats AnalyzeVertexCache(u32 *indices, u32 numIndices, u32 numVertices)
+{
+    TempMemory scratch = GetScratch();
+    u32 *cachedAt = PushArray<u32>(scratch.arena, numVertices);
+    memset(cachedAt, 0, numVertices * sizeof(u32));
+    u8 *used = PushArray<u8>(scratch.arena, numVertices);
+    memset(used, 0, numVertices);
+
+    u32 timestamp = VERTEX_CACHE_SIZE + 1;
+    u32 misses = 0;
+    u32 numUsed = 0;
+    for (u32 i = 0; i < numIndices; i += 3)
+    {
+        misses += SimulateVertexCache(&indices[i], cachedAt, &timestamp);
+        for (u32 j = i; j < i + 3; j++)
+        {
+            numUsed += (used[indices[j]] == 0);
+            used[indices[j]] = 1;
+        }
+    }
+    TempEnd(scratch);
+
+    VertexCacheStats result = {};
+    if (numIndices > 0)
+    {
+        result.acmr = (f32)misses / (f32)(numIndices / 3);
+        result.atvr = (f32)misses / (f32)numUsed;
+    }
+    return result;
+}
+
+// Merges the vertices which are identical, bit for bit, and returns how many are left, at the front of the array.
+internal u32 WeldVertices(PackedVertex *vertices, u32 numVertices, u32 *indices, u32 numIndices)
+{
+    TempMemory scratch = GetScratch();
+    u32 tableSize = 1;
+    while (tableSize < numVertices * 2)
+    {
+        tableSize *= 2;
+    }
+    u32 *table = PushArray<u32>(scratch.arena, tableSize);
+    memset(table, 0xff, tableSize * sizeof(u32));
+    u32 *remap = PushArray<u32>(scratch.arena, numVertices);
+
+    // NOTE: unique vertices are moved down as they're found, which only ever overwrites vertices already remapped.
+    u32 numUnique = 0;
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        u32 slot = (u32)fnv1a((u8 *)&vertices[i], sizeof(PackedVertex)) & (tableSize - 1);
+        while (table[slot] != 0xffffffff && memcmp(&vertices[table[slot]], &vertices[i], sizeof(PackedVertex)) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == 0xffffffff)
+        {
+            vertices[numUnique] = vertices[i];
+            table[slot] = numUnique++;
+        }
+        remap[i] = table[slot];
+    }
+
+    for (u32 i = 0; i < numIndices; i++)
+    {
+        indices[i] = remap[indices[i]];
+    }
+    TempEnd(scratch);
+    return numUnique;
+}
+
+// Tipsify: fans around a vertex, emitting its remaining triangles, then moves on to the vertex among those just
+// emitted which is still cached and will stay so while its own triangles are emitted, preferring the oldest; failing
+// that, to the most recent one with triangles left, or the next in the mesh. Reorders the triangles in place, and
+// writes the first triangle of every run between such dead ends to the clusters, returning how many there are.
+internal u32 OptimizeVertexCache(u32 *indices, u32 numIndices, u32 numVertices, u32 *clusters)
+{
+    TempMemory scratch = GetScratch();
+    Arena *arena = scratch.arena;
+    u32 numTriangles = numIndices / 3;
+
+    // Every vertex's triangles, and how many of them are left to emit.
+    u32 *liveTriangles = PushArray<u32>(arena, numVertices);
+    memset(liveTriangles, 0, numVertices * sizeof(u32));
+    for (u32 i = 0; i < numIndices; i++)
+    {
+        liveTriangles[indices[i]]++;
+    }
+    u32 *adjacencyOffsets = PushArray<u32>(arena, numVertices + 1);
+    adjacencyOffsets[0] = 0;
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+    }
+    u32 *adjacency = PushArray<u32>(arena, numIndices);
+    u32 *cachedAt = PushArray<u32>(arena, numVertices);
+    memcpy(cachedAt, adjacencyOffsets, numVertices * sizeof(u32));
+    for (u32 i = 0; i < numIndices; i++)
+    {
+        adjacency[cachedAt[indices[i]]++] = i / 3;
+    }
+    memset(cachedAt, 0, numVertices * sizeof(u32));
+
+    u8 *emitted = PushArray<u8>(arena, numTriangles);
+    memset(emitted, 0, numTriangles);
+    u32 *deadEnds = PushArray<u32>(arena, numIndices);
+    u32 *output = PushArray<u32>(arena, numIndices);
+    u32 numDeadEnds = 0;
+    u32 numOutput = 0;
+    u32 numClusters = 0;
+    u32 nextInMesh = 0;
+    u32 timestamp = VERTEX_CACHE_SIZE + 1;
+    u32 fanning = 0xffffffff;
+    if (numTriangles > 0)
+    {
+        fanning = indices[0];
+        clusters[numClusters++] = 0;
+    }
+    while (fanning != 0xffffffff)
+    {
+        u32 fanStart = numOutput;
+        for (u32 i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++)
+        {
+            u32 triangle = adjacency[i];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            for (u32 j = 0; j < 3; j++)
+            {
+                u32 vertex = indices[triangle * 3 + j];
+                output[numOutput++] = vertex;
+                deadEnds[numDeadEnds++] = vertex;
+                liveTriangles[vertex]--;
+                if (timestamp - cachedAt[vertex] > VERTEX_CACHE_SIZE)
+                {
+                    cachedAt[vertex] = timestamp++;
+                }
+            }
+            emitted[triangle] = 1;
+        }
+
+        u32 next = 0xffffffff;
+        s32 bestPriority = -1;
+        for (u32 i = fanStart; i < numOutput; i++)
+        {
+            u32 vertex = output[i];
+            if (liveTriangles[vertex] == 0)
+            {
+                continue;
+            }
+            s32 priority = 0;
+            u32 age = timestamp - cachedAt[vertex];
+            if (age + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+            {
+                priority = (s32)age;
+            }
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        if (next == 0xffffffff)
+        {
+            while (numDeadEnds > 0 && next == 0xffffffff)
+            {
+                u32 vertex = deadEnds[--numDeadEnds];
+                next = (liveTriangles[vertex] > 0) ? vertex : next;
+            }
+            for (; nextInMesh < numVertices && next == 0xffffffff; nextInMesh++)
+            {
+                next = (liveTriangles[nextInMesh] > 0) ? nextInMesh : next;
+            }
+            if (next != 0xffffffff)
+            {
+                clusters[numClusters++] = numOutput / 3;
+            }
+        }
+        fanning = next;
+    }
+    myAssert(numOutput == numTriangles * 3);
+
+    memcpy(indices, output, numIndices * sizeof(u32));
+    TempEnd(scratch);
+    return numClusters;
+}
+
+struct OverdrawCluster
+{
+    f32 sortKey;
+    u32 firstTriangle;
+    u32 numTriangles;
+};
+
+internal int CompareOverdrawClusters(const void *a, const void *b)
+{
+    f32 left = ((const OverdrawCluster *)a)->sortKey;
+    f32 right = ((const OverdrawCluster *)b)->sortKey;
+    return (left < right) - (left > right);
+}
+
+// Splits the clusters of OptimizeVertexCache() further where the vertex cache allows (see: OVERDRAW_CLUSTER_THRESHOLD),
+// then sorts them by how far out they are along their own normal, from the mesh's centroid: outer surfaces facing
+// away from the center are drawn before what they may hide. Returns the number of clusters.
+internal u32 OptimizeOverdraw(u32 *indices, u32 numIndices, PackedVertex *vertices, u32 numVertices, u32 *clusters,
+                              u32 numClusters)
+{
+    TempMemory scratch = GetScratch();
+    Arena *arena = scratch.arena;
+    u32 numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+    {
+        TempEnd(scratch);
+        return 0;
+    }
+
+    u32 *cachedAt = PushArray<u32>(arena, numVertices);
+    memset(cachedAt, 0, numVertices * sizeof(u32));
+    u32 timestamp = VERTEX_CACHE_SIZE + 1;
+    OverdrawCluster *splits = PushArray<OverdrawCluster>(arena, numTriangles);
+    u32 numSplits = 0;
+    for (u32 i = 0; i < numClusters; i++)
+    {
+        u32 begin = clusters[i];
+        u32 end = (i + 1 < numClusters) ? clusters[i + 1] : numTriangles;
+
+        // NOTE: moving the timestamp past the cache's size flushes it.
+        timestamp += VERTEX_CACHE_SIZE + 1;
+        u32 clusterMisses = 0;
+        for (u32 triangle = begin; triangle < end; triangle++)
+        {
+            clusterMisses += SimulateVertexCache(&indices[triangle * 3], cachedAt, &timestamp);
+        }
+        f32 threshold = OVERDRAW_CLUSTER_THRESHOLD * (f32)clusterMisses / (f32)(end - begin);
+
+        timestamp += VERTEX_CACHE_SIZE + 1;
+        u32 splitBegin = begin;
+        u32 splitMisses = 0;
+        for (u32 triangle = begin; triangle < end; triangle++)
+        {
+            splitMisses += SimulateVertexCache(&indices[triangle * 3], cachedAt, &timestamp);
+            if (triangle + 1 == end || (f32)splitMisses / (f32)(triangle + 1 - splitBegin) <= threshold)
+            {
+                splits[numSplits++] = {0.f, splitBegin, triangle + 1 - splitBegin};
+                splitBegin = triangle + 1;
+                splitMisses = 0;
+                timestamp += VERTEX_CACHE_SIZE + 1;
+            }
+        }
+    }
+
+    // Centroids are weighted by area, which the length of the cross product is twice of.
+    glm::vec3 *centroids = PushArray<glm::vec3>(arena, numSplits);
+    glm::vec3 *normals = PushArray<glm::vec3>(arena, numSplits);
+    glm::vec3 meshCentroid = glm::vec3(0.f);
+    f32 meshArea = 0.f;
+    for (u32 i = 0; i < numSplits; i++)
+    {
+        glm::vec3 centroid = glm::vec3(0.f);
+        glm::vec3 normal = glm::vec3(0.f);
+        f32 area = 0.f;
+        for (u32 triangle = splits[i].firstTriangle; triangle < splits[i].firstTriangle + splits[i].numTriangles;
+             triangle++)
+        {
+            glm::vec3 a = vertices[indices[triangle * 3]].position;
+            glm::vec3 b = vertices[indices[triangle * 3 + 1]].position;
+            glm::vec3 c = vertices[indices[triangle * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            f32 triangleArea = glm::length(cross);
+            centroid += (a + b + c) * (triangleArea / 3.f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[i] = (area > 0.f) ? centroid / area : vertices[indices[splits[i].firstTriangle * 3]].position;
+        normals[i] = normal;
+    }
+    meshCentroid = (meshArea > 0.f) ? meshCentroid / meshArea : centroids[0];
+    for (u32 i = 0; i < numSplits; i++)
+    {
+        f32 length = glm::length(normals[i]);
+        splits[i].sortKey = (length > 0.f) ? glm::dot(centroids[i] - meshCentroid, normals[i] / length) : 0.f;
+    }
+    qsort(splits, numSplits, sizeof(OverdrawCluster), CompareOverdrawClusters);
+
+    u32 *output = PushArray<u32>(arena, numIndices);
+    u32 numOutput = 0;
+    for (u32 i = 0; i < numSplits; i++)
+    {
+        memcpy(&output[numOutput], &indices[splits[i].firstTriangle * 3], splits[i].numTriangles * 3 * sizeof(u32));
+        numOutput += splits[i].numTriangles * 3;
+    }
+    myAssert(numOutput == numIndices);
+    memcpy(indices, output, numIndices * sizeof(u32));
+    TempEnd(scratch);
+    return numSplits;
+}
+
+// Renumbers the vertices in the order the indices first use them, so that the fetch reads them about sequentially.
+// Returns how many there are left, as those which no triangle uses are dropped.
+internal u32 OptimizeVertexFetch(PackedVertex *vertices, u32 numVertices, u32 *indices, u32 numIndices)
+{
+    TempMemory scratch = GetScratch();
+    u32 *remap = PushArray<u32>(scratch.arena, numVertices);
+    memset(remap, 0xff, numVertices * sizeof(u32));
+    PackedVertex *reordered = PushArray<PackedVertex>(scratch.arena, numVertices);
+    u32 numReordered = 0;
+    for (u32 i = 0; i < numIndices; i++)
+    {
+        u32 vertex = indices[i];
+        if (remap[vertex] == 0xffffffff)
+        {
+            remap[vertex] = numReordered;
+            reordered[numReordered++] = vertices[vertex];
+        }
+        indices[i] = remap[vertex];
+    }
+    memcpy(vertices, reordered, numReordered * sizeof(PackedVertex));
+    TempEnd(scratch);
+    return numReordered;
+}
+
+// Runs every stage on a mesh, in place, and returns how the vertex cache fares before and after. The vertices which
+// are left are at the front of the array.
+internal MeshOptimizationStats OptimizeMesh(PackedVertex *vertices, u32 numVertices, u32 *indices, u32 numIndices)
+{
+    MeshOptimizationStats result = {};
+    result.numImportedVertices = numVertices;
+    result.numTriangles = numIndices / 3;
+    result.imported = AnalyzeVertexCache(indices, numIndices, numVertices);
+
+    numVertices = WeldVertices(vertices, numVertices, indices, numIndices);
+    result.welded = AnalyzeVertexCache(indices, numIndices, numVertices);
+
+    TempMemory scratch = GetScratch();
+    u32 *clusters = PushArray<u32>(scratch.arena, result.numTriangles + 1);
+    u32 numClusters = OptimizeVertexCache(indices, numIndices, numVertices, clusters);
+    result.numClusters = OptimizeOverdraw(indices, numIndices, vertices, numVertices, clusters, numClusters);
+    TempEnd(scratch);
+
+    result.numVertices = OptimizeVertexFetch(vertices, numVertices, indices, numIndices);
+    result.optimized = AnalyzeVertexCache(indices, numIndices, result.numVertices);
+    return result;
+}
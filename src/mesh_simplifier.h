@@ -0,0 +1,346 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+#include "vertex.h"
+
+#include <stdlib.h> // qsort().
+
+/***********************************************************************************************************************
+ *
+ * Mesh simplification: what the cook builds the LODs of a mesh with (see: MAX_MODEL_LODS), by collapsing edges
+ * ordered by quadric error (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+ *
+ * Every vertex accumulates the planes of the triangles around it, weighted by their area, and moving it onto a
+ * neighbour costs the mean squared distance from there to the planes of both. Edges are collapsed onto one of their
+ * existing vertices rather than onto an optimal position, so that a LOD is only a new index range into the mesh's
+ * vertices, which every LOD shares.
+ *
+ * Vertices on an open border, or on a seam where vertices at the same position differ in their attributes, stay
+ * where they are, so that simplifying never opens holes; other vertices can still collapse onto them.
+ *
+ **********************************************************************************************************************/
+
+// Collapses are rejected when they'd turn a triangle around the moved vertex by more than about 84 degrees.
+#define SIMPLIFY_MIN_NORMAL_COSINE .1f
+
+struct Quadric
+{
+    // The symmetric 4x4 matrix of the sum of squared distances to planes (a, b, c, d): their outer products.
+    f32 a2, b2, c2, d2;
+    f32 ab, ac, ad;
+    f32 bc, bd;
+    f32 cd;
+    f32 weight;
+};
+
+internal Quadric MakePlaneQuadric(glm::vec3 normal, f32 d, f32 weight)
+{
+    Quadric result;
+    result.a2 = normal.x * normal.x * weight;
+    result.b2 = normal.y * normal.y * weight;
+    result.c2 = normal.z * normal.z * weight;
+    result.d2 = d * d * weight;
+    result.ab = normal.x * normal.y * weight;
+    result.ac = normal.x * normal.z * weight;
+    result.ad = normal.x * d * weight;
+    result.bc = normal.y * normal.z * weight;
+    result.bd = normal.y * d * weight;
+    result.cd = normal.z * d * weight;
+    result.weight = weight;
+    return result;
+}
+
+internal void AddQuadric(Quadric *quadric, Quadric *other)
+{
+    f32 *values = &quadric->a2;
+    f32 *otherValues = &other->a2;
+    for (u32 i = 0; i < sizeof(Quadric) / sizeof(f32); i++)
+    {
+        values[i] += otherValues[i];
+    }
+}
+
+// The weighted mean of the squared distances from the point to the quadric's planes.
+internal f32 EvaluateQuadric(Quadric *q, glm::vec3 p)
+{
+    f32 result = q->a2 * p.x * p.x + q->b2 * p.y * p.y + q->c2 * p.z * p.z + q->d2 +
+                 2.f * (q->ab * p.x * p.y + q->ac * p.x * p.z + q->bc * p.y * p.z) +
+                 2.f * (q->ad * p.x + q->bd * p.y + q->cd * p.z);
+    return (q->weight > 0.f) ? fabsf(result) / q->weight : 0.f;
+}
+
+struct EdgeCollapse
+{
+    f32 cost;
+    u32 from; // Vertices, rather than positions.
+    u32 to;
+};
+
+internal int CompareEdgeCollapses(const void *a, const void *b)
+{
+    f32 left = ((const EdgeCollapse *)a)->cost;
+    f32 right = ((const EdgeCollapse *)b)->cost;
+    return (left > right) - (left < right);
+}
+
+// Finds the vertices which share their position with an earlier one. Returns the first vertex at each vertex's
+// position, and counts the vertices there.
+internal void WeldPositions(PackedVertex *vertices, u32 numVertices, u32 *positionRemap, u32 *numAtPosition,
+                            Arena *arena)
+{
+    TempMemory temp = TempBegin(arena);
+    u32 tableSize = 1;
+    while (tableSize < numVertices * 2)
+    {
+        tableSize *= 2;
+    }
+    u32 *table = PushArray<u32>(arena, tableSize);
+    memset(table, 0xff, tableSize * sizeof(u32));
+    memset(numAtPosition, 0, numVertices * sizeof(u32));
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        glm::vec3 *position = &vertices[i].position;
+        u32 slot = (u32)fnv1a((u8 *)position, sizeof(glm::vec3)) & (tableSize - 1);
+        while (table[slot] != 0xffffffff && memcmp(&vertices[table[slot]].position, position, sizeof(glm::vec3)) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        if (table[slot] == 0xffffffff)
+        {
+            table[slot] = i;
+        }
+        positionRemap[i] = table[slot];
+        numAtPosition[table[slot]]++;
+    }
+    TempEnd(temp);
+}
+
+// Locks the positions on an edge which isn't shared by exactly two triangles, in either direction: open borders, and
+// non-manifold edges.
+internal void LockBorders(u32 *indices, u32 numIndices, u32 *positionRemap, u8 *locked, Arena *arena)
+{
+    TempMemory temp = TempBegin(arena);
+    u32 tableSize = 1;
+    while (tableSize < numIndices * 2)
+    {
+        tableSize *= 2;
+    }
+    u64 *edges = PushArray<u64>(arena, tableSize);
+    memset(edges, 0xff, tableSize * sizeof(u64));
+    u8 *counts = PushArray<u8>(arena, tableSize);
+    memset(counts, 0, tableSize);
+    for (u32 pass = 0; pass < 2; pass++)
+    {
+        for (u32 i = 0; i < numIndices; i++)
+        {
+            u32 a = positionRemap[indices[i]];
+            u32 b = positionRemap[indices[(i % 3 == 2) ? i - 2 : i + 1]];
+            u64 edge = (a < b) ? (((u64)a << 32) | b) : (((u64)b << 32) | a);
+            u32 slot = (u32)fnv1a((u8 *)&edge, sizeof(u64)) & (tableSize - 1);
+            while (edges[slot] != 0xffffffffffffffff && edges[slot] != edge)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (pass == 0)
+            {
+                edges[slot] = edge;
+                counts[slot] = (u8)intMin(counts[slot] + 1, 3);
+            }
+            else if (counts[slot] != 2)
+            {
+                locked[a] = 1;
+                locked[b] = 1;
+            }
+        }
+    }
+    TempEnd(temp);
+}
+
+// Whether moving the position onto another one turns any of the triangles around it which remain.
+internal bool CollapseFlipsTriangles(PackedVertex *vertices, u32 *indices, u32 *positionRemap, u32 *adjacencyOffsets,
+                                     u32 *adjacency, u32 from, u32 to)
+{
+    glm::vec3 target = vertices[to].position;
+    for (u32 i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++)
+    {
+        u32 *triangle = &indices[adjacency[i] * 3];
+        u32 corners[3] = {positionRemap[triangle[0]], positionRemap[triangle[1]], positionRemap[triangle[2]]};
+        if (corners[0] == to || corners[1] == to || corners[2] == to)
+        {
+            continue;
+        }
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (u32 j = 0; j < 3; j++)
+        {
+            before[j] = vertices[corners[j]].position;
+            after[j] = (corners[j] == from) ? target : before[j];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <=
+            SIMPLIFY_MIN_NORMAL_COSINE * glm::length(normalBefore) * glm::length(normalAfter))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Simplifies the triangles down to about the target number of indices, writing them to the result, and returns how
+// many there are: more than the target when there was nothing left to collapse without opening holes or turning
+// triangles around. The error is the largest distance a collapse moved the surface by, as a root mean square over
+// the planes around it.
+internal u32 SimplifyMesh(PackedVertex *vertices, u32 numVertices, u32 *indices, u32 numIndices,
+                          u32 targetNumIndices, u32 *result, f32 *error)
+{
+    TempMemory scratch = GetScratch();
+    Arena *arena = scratch.arena;
+
+    // Positions are represented by the first vertex there, which the arrays below are indexed by.
+    u32 *positionRemap = PushArray<u32>(arena, numVertices);
+    u32 *numAtPosition = PushArray<u32>(arena, numVertices);
+    WeldPositions(vertices, numVertices, positionRemap, numAtPosition, arena);
+    u8 *locked = PushArray<u8>(arena, numVertices);
+    for (u32 i = 0; i < numVertices; i++)
+    {
+        locked[i] = (numAtPosition[i] > 1);
+    }
+    LockBorders(indices, numIndices, positionRemap, locked, arena);
+
+    Quadric *quadrics = PushArray<Quadric>(arena, numVertices);
+    memset(quadrics, 0, numVertices * sizeof(Quadric));
+    for (u32 i = 0; i < numIndices; i += 3)
+    {
+        u32 corners[3] = {positionRemap[indices[i]], positionRemap[indices[i + 1]], positionRemap[indices[i + 2]]};
+        glm::vec3 p0 = vertices[corners[0]].position;
+        glm::vec3 normal = glm::cross(vertices[corners[1]].position - p0, vertices[corners[2]].position - p0);
+        f32 length = glm::length(normal);
+        if (length == 0.f)
+        {
+            continue;
+        }
+        normal /= length;
+        Quadric plane = MakePlaneQuadric(normal, -glm::dot(normal, p0), length * .5f);
+        for (u32 j = 0; j < 3; j++)
+        {
+            AddQuadric(&quadrics[corners[j]], &plane);
+        }
+    }
+
+    memcpy(result, indices, numIndices * sizeof(u32));
+    u32 numResult = numIndices;
+    u32 *adjacencyOffsets = PushArray<u32>(arena, numVertices + 1);
+    u32 *adjacency = PushArray<u32>(arena, numIndices);
+    u32 *collapses = PushArray<u32>(arena, numVertices);
+    u8 *touched = PushArray<u8>(arena, numVertices);
+    EdgeCollapse *candidates = PushArray<EdgeCollapse>(arena, numIndices * 2);
+    f32 maxCost = 0.f;
+    while (numResult > targetNumIndices)
+    {
+        // Every position's triangles, as of this pass.
+        memset(adjacencyOffsets, 0, (numVertices + 1) * sizeof(u32));
+        for (u32 i = 0; i < numResult; i++)
+        {
+            adjacencyOffsets[positionRemap[result[i]] + 1]++;
+        }
+        for (u32 i = 0; i < numVertices; i++)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        for (u32 i = 0; i < numResult; i++)
+        {
+            adjacency[adjacencyOffsets[positionRemap[result[i]]]++] = i / 3;
+        }
+        for (u32 i = numVertices; i > 0; i--)
+        {
+            adjacencyOffsets[i] = adjacencyOffsets[i - 1];
+        }
+        adjacencyOffsets[0] = 0;
+
+        // NOTE: interior edges come up once per triangle on either side, which the touched flags below sort out.
+        u32 numCandidates = 0;
+        for (u32 i = 0; i < numResult; i++)
+        {
+            u32 a = result[i];
+            u32 b = result[(i % 3 == 2) ? i - 2 : i + 1];
+            u32 positionA = positionRemap[a];
+            u32 positionB = positionRemap[b];
+            if (positionA == positionB)
+            {
+                continue;
+            }
+            Quadric quadric = quadrics[positionA];
+            AddQuadric(&quadric, &quadrics[positionB]);
+            if (!locked[positionA])
+            {
+                candidates[numCandidates++] = {EvaluateQuadric(&quadric, vertices[b].position), a, b};
+            }
+            if (!locked[positionB])
+            {
+                candidates[numCandidates++] = {EvaluateQuadric(&quadric, vertices[a].position), b, a};
+            }
+        }
+        qsort(candidates, numCandidates, sizeof(EdgeCollapse), CompareEdgeCollapses);
+
+        // A collapse removes about two triangles, and nothing around it can move again until the next pass, so that
+        // every collapse is checked against the triangles as they'll be.
+        for (u32 i = 0; i < numVertices; i++)
+        {
+            collapses[i] = i;
+        }
+        memset(touched, 0, numVertices);
+        u32 trianglesToRemove = (numResult - targetNumIndices) / 3;
+        u32 trianglesRemoved = 0;
+        for (u32 i = 0; i < numCandidates && trianglesRemoved < trianglesToRemove; i++)
+        {
+            EdgeCollapse *collapse = &candidates[i];
+            u32 from = positionRemap[collapse->from];
+            u32 to = positionRemap[collapse->to];
+            if (touched[from] || touched[to] ||
+                CollapseFlipsTriangles(vertices, result, positionRemap, adjacencyOffsets, adjacency, from, to))
+            {
+                continue;
+            }
+            // NOTE: the moved vertex is alone at its position, as seams are locked.
+            myAssert(collapse->from == from);
+            collapses[from] = collapse->to;
+            AddQuadric(&quadrics[to], &quadrics[from]);
+            maxCost = fmaxf(maxCost, collapse->cost);
+            for (u32 j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1]; j++)
+            {
+                u32 *triangle = &result[adjacency[j] * 3];
+                for (u32 k = 0; k < 3; k++)
+                {
+                    touched[positionRemap[triangle[k]]] = 1;
+                }
+            }
+            trianglesRemoved += 2;
+        }
+        if (trianglesRemoved == 0)
+        {
+            break;
+        }
+
+        u32 numKept = 0;
+        for (u32 i = 0; i < numResult; i += 3)
+        {
+            u32 a = collapses[result[i]];
+            u32 b = collapses[result[i + 1]];
+            u32 c = collapses[result[i + 2]];
+            if (positionRemap[a] != positionRemap[b] && positionRemap[b] != positionRemap[c] &&
+                positionRemap[a] != positionRemap[c])
+            {
+                result[numKept++] = a;
+                result[numKept++] = b;
+                result[numKept++] = c;
+            }
+        }
+        numResult = numKept;
+    }
+
+    TempEnd(scratch);
+    *error = sqrtf(maxCost);
+    return numResult;
+}
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+#include "jobs.h"
+#include "render.h"
+#include "vertex.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHLET_CULL_SSE2 1
+#else
+#define MESHLET_CULL_SSE2 0
+#endif
+
+/***********************************************************************************************************************
+ *
+ * Meshlets: the cook splits every LOD of every mesh into runs of consecutive triangles (see: BuildMeshlets()), each
+ * with a bounding sphere and a cone which bounds its triangles' normals. Every frame, a pass culls the meshlets of the
+ * models it draws against its frustum and, when back faces are culled, against the eye (see: CullMeshletDraws()), and
+ * draws those which remain through a command buffer of its own, a command per meshlet.
+ *
+ * A meshlet is a range of the mesh's indices as they are after optimization (see: OptimizeMesh()), which being in
+ * vertex cache order are already close together, so meshlets need no indices of their own and are drawn in the same
+ * order as the whole mesh.
+ *
+ * The cone test (after Arseny Kapoulkine's meshoptimizer): with the cone's axis a and cutoff sin(t), t being the
+ * largest angle between a and a triangle's normal, every triangle of a meshlet centred at c with radius r faces away
+ * from the eye e when dot(c - e, a) >= sin(t) * |c - e| + r.
+ *
+ * Meshlets are stored and culled four at a time (see: MeshletBlock), in model space: the frustum planes are extracted
+ * from the model-view-projection matrix, and the eye is moved into model space, which also holds for a non-uniform
+ * scale.
+ *
+ **********************************************************************************************************************/
+
+// A meshlet ends once it would use more vertices or triangles than these.
+#define MESHLET_MAX_VERTICES 96
+#define MESHLET_MAX_TRIANGLES 128
+#define MESHLET_BLOCK_SIZE 4
+// Meshlet blocks per culling job; see: CullMeshletDraws().
+#define MESHLET_CULL_BATCH_BLOCKS 32
+
+struct Meshlet
+{
+    glm::vec3 center;
+    f32 radius;
+    glm::vec3 coneAxis;
+    f32 coneCutoff; // 1 when the normals are too far apart for the meshlet to ever be culled by its cone.
+    u32 firstIndex; // Relative to the mesh's first index.
+    u32 count;
+};
+
+// Four meshlets' bounds and draw commands, structure of arrays. Lanes past the last meshlet have a count of 0.
+struct MeshletBlock
+{
+    f32 centerX[MESHLET_BLOCK_SIZE];
+    f32 centerY[MESHLET_BLOCK_SIZE];
+    f32 centerZ[MESHLET_BLOCK_SIZE];
+    f32 radius[MESHLET_BLOCK_SIZE];
+    f32 coneAxisX[MESHLET_BLOCK_SIZE];
+    f32 coneAxisY[MESHLET_BLOCK_SIZE];
+    f32 coneAxisZ[MESHLET_BLOCK_SIZE];
+    f32 coneCutoff[MESHLET_BLOCK_SIZE];
+    u32 firstIndex[MESHLET_BLOCK_SIZE];
+    u32 count[MESHLET_BLOCK_SIZE];
+    s32 baseVertex[MESHLET_BLOCK_SIZE];
+    // Picks the textures: the index of the mesh when cooked, its material once uploaded (see: UploadModelJob()).
+    u32 baseInstance[MESHLET_BLOCK_SIZE];
+};
+
+/*
+ * Building.
+ */
+
+// Splits the triangles into meshlets in the order they come, and returns how many there are: at most one per
+// triangle.
+internal u32 BuildMeshlets(PackedVertex *vertices, u32 numVertices, u32 *indices, u32 numIndices, Meshlet *meshlets)
+{
+    TempMemory scratch = GetScratch();
+    // The meshlet which last used each vertex, plus one.
+    u32 *usedBy = PushArray<u32>(scratch.arena, numVertices);
+    memset(usedBy, 0, numVertices * sizeof(u32));
+
+    u32 numMeshlets = 0;
+    u32 numMeshletVertices = 0;
+    for (u32 i = 0; i < numIndices; i += 3)
+    {
+        u32 newVertices = 0;
+        for (u32 j = 0; j < 3; j++)
+        {
+            newVertices += (usedBy[indices[i + j]] != numMeshlets);
+        }
+        Meshlet *meshlet = (numMeshlets > 0) ? &meshlets[numMeshlets - 1] : NULL;
+        if (!meshlet || numMeshletVertices + newVertices > MESHLET_MAX_VERTICES ||
+            meshlet->count == MESHLET_MAX_TRIANGLES * 3)
+        {
+            meshlet = &meshlets[numMeshlets++];
+            *meshlet = {};
+            meshlet->firstIndex = i;
+            numMeshletVertices = 0;
+        }
+        for (u32 j = 0; j < 3; j++)
+        {
+            if (usedBy[indices[i + j]] != numMeshlets)
+            {
+                usedBy[indices[i + j]] = numMeshlets;
+                numMeshletVertices++;
+            }
+        }
+        meshlet->count += 3;
+    }
+
+    for (u32 i = 0; i < numMeshlets; i++)
+    {
+        Meshlet *meshlet = &meshlets[i];
+        u32 *meshletIndices = &indices[meshlet->firstIndex];
+
+        // NOTE: the centre of the bounding box, which is close enough to the smallest sphere for such small sets.
+        glm::vec3 boundsMin = vertices[meshletIndices[0]].position;
+        glm::vec3 boundsMax = boundsMin;
+        glm::vec3 normalSum = glm::vec3(0.f);
+        for (u32 j = 0; j < meshlet->count; j += 3)
+        {
+            glm::vec3 p[3];
+            for (u32 k = 0; k < 3; k++)
+            {
+                p[k] = vertices[meshletIndices[j + k]].position;
+                boundsMin = glm::min(boundsMin, p[k]);
+                boundsMax = glm::max(boundsMax, p[k]);
+            }
+            glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            f32 length = glm::length(normal);
+            normalSum += (length > 0.f) ? normal / length : glm::vec3(0.f);
+        }
+        meshlet->center = (boundsMin + boundsMax) * .5f;
+        for (u32 j = 0; j < meshlet->count; j++)
+        {
+            meshlet->radius =
+                fmaxf(meshlet->radius, glm::distance(meshlet->center, vertices[meshletIndices[j]].position));
+        }
+
+        meshlet->coneCutoff = 1.f;
+        f32 normalSumLength = glm::length(normalSum);
+        if (normalSumLength == 0.f)
+        {
+            continue;
+        }
+        meshlet->coneAxis = normalSum / normalSumLength;
+        f32 minCosine = 1.f;
+        for (u32 j = 0; j < meshlet->count; j += 3)
+        {
+            glm::vec3 p0 = vertices[meshletIndices[j]].position;
+            glm::vec3 normal = glm::cross(vertices[meshletIndices[j + 1]].position - p0,
+                                          vertices[meshletIndices[j + 2]].position - p0);
+            f32 length = glm::length(normal);
+            if (length > 0.f)
+            {
+                minCosine = fminf(minCosine, glm::dot(meshlet->coneAxis, normal / length));
+            }
+        }
+        // Past 90 degrees, some triangle faces the eye wherever it is.
+        meshlet->coneCutoff = (minCosine > 0.f) ? sqrtf(1.f - minCosine * minCosine) : 1.f;
+    }
+
+    TempEnd(scratch);
+    return numMeshlets;
+}
+
+internal void SetMeshletBlockLane(MeshletBlock *block, u32 lane, Meshlet *meshlet, u32 firstIndex, s32 baseVertex,
+                                  u32 baseInstance)
+{
+    block->centerX[lane] = meshlet->center.x;
+    block->centerY[lane] = meshlet->center.y;
+    block->centerZ[lane] = meshlet->center.z;
+    block->radius[lane] = meshlet->radius;
+    block->coneAxisX[lane] = meshlet->coneAxis.x;
+    block->coneAxisY[lane] = meshlet->coneAxis.y;
+    block->coneAxisZ[lane] = meshlet->coneAxis.z;
+    block->coneCutoff[lane] = meshlet->coneCutoff;
+    block->firstIndex[lane] = firstIndex + meshlet->firstIndex;
+    block->count[lane] = meshlet->count;
+    block->baseVertex[lane] = baseVertex;
+    block->baseInstance[lane] = baseInstance;
+}
+
+/*
+ * Culling.
+ */
+
+// What a model's meshlets are culled against, in its model space.
+struct MeshletCullView
+{
+    glm::vec4 planes[6]; // Normalized, pointing inwards.
+    glm::vec3 eye;
+    bool cones; // Only when the pass culls back faces, otherwise they're drawn.
+};
+
+internal MeshletCullView MakeMeshletCullView(glm::mat4 viewProjection, glm::mat4 modelMatrix, glm::vec3 eye,
+                                             bool cones)
+{
+    MeshletCullView result;
+    // Gribb and Hartmann: the planes are sums and differences of the rows of the model-view-projection matrix.
+    glm::mat4 m = glm::transpose(viewProjection * modelMatrix);
+    result.planes[0] = m[3] + m[0];
+    result.planes[1] = m[3] - m[0];
+    result.planes[2] = m[3] + m[1];
+    result.planes[3] = m[3] - m[1];
+    result.planes[4] = m[3] + m[2];
+    result.planes[5] = m[3] - m[2];
+    for (u32 i = 0; i < 6; i++)
+    {
+        result.planes[i] /= glm::length(glm::vec3(result.planes[i]));
+    }
+    result.eye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(eye, 1.f));
+    result.cones = cones;
+    return result;
+}
+
+// Returns a mask with bit i set when the i-th meshlet of the block is to be drawn.
+internal u32 CullMeshletBlockScalar(MeshletBlock *block, MeshletCullView *view)
+{
+    u32 result = 0;
+    for (u32 i = 0; i < MESHLET_BLOCK_SIZE; i++)
+    {
+        glm::vec3 center = glm::vec3(block->centerX[i], block->centerY[i], block->centerZ[i]);
+        bool visible = (block->count[i] != 0);
+        for (u32 j = 0; j < 6; j++)
+        {
+            visible &= (glm::dot(glm::vec3(view->planes[j]), center) + view->planes[j].w >= -block->radius[i]);
+        }
+        if (view->cones)
+        {
+            glm::vec3 toCenter = center - view->eye;
+            glm::vec3 axis = glm::vec3(block->coneAxisX[i], block->coneAxisY[i], block->coneAxisZ[i]);
+            visible &= (glm::dot(toCenter, axis) < block->coneCutoff[i] * glm::length(toCenter) + block->radius[i]);
+        }
+        result |= (u32)visible << i;
+    }
+    return result;
+}
+
+internal u32 CullMeshletBlock(MeshletBlock *block, MeshletCullView *view)
+{
+#if MESHLET_CULL_SSE2
+    __m128 x = _mm_loadu_ps(block->centerX);
+    __m128 y = _mm_loadu_ps(block->centerY);
+    __m128 z = _mm_loadu_ps(block->centerZ);
+    __m128 radius = _mm_loadu_ps(block->radius);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+    __m128 visible = _mm_castsi128_ps(
+        _mm_xor_si128(_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)block->count), _mm_setzero_si128()),
+                      _mm_set1_epi32(-1)));
+    for (u32 i = 0; i < 6; i++)
+    {
+        glm::vec4 *plane = &view->planes[i];
+        // NOTE: summed in the same order as the scalar version, so both cull the same meshlets.
+        __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane->x)), _mm_mul_ps(y, _mm_set1_ps(plane->y)));
+        distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane->z))), _mm_set1_ps(plane->w));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+    }
+    if (view->cones)
+    {
+        __m128 toX = _mm_sub_ps(x, _mm_set1_ps(view->eye.x));
+        __m128 toY = _mm_sub_ps(y, _mm_set1_ps(view->eye.y));
+        __m128 toZ = _mm_sub_ps(z, _mm_set1_ps(view->eye.z));
+        __m128 length =
+            _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, toX), _mm_mul_ps(toY, toY)), _mm_mul_ps(toZ, toZ)));
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, _mm_loadu_ps(block->coneAxisX)),
+                                           _mm_mul_ps(toY, _mm_loadu_ps(block->coneAxisY))),
+                                _mm_mul_ps(toZ, _mm_loadu_ps(block->coneAxisZ)));
+        __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(block->coneCutoff), length), radius);
+        visible = _mm_and_ps(visible, _mm_cmplt_ps(dot, limit));
+    }
+    return (u32)_mm_movemask_ps(visible);
+#else
+    return CullMeshletBlockScalar(block, view);
+#endif
+}
+
+// Writes a command per meshlet which remains, and returns how many there are.
+internal u32 CullMeshlets(MeshletBlock *blocks, u32 numBlocks, MeshletCullView *view,
+                          DrawElementsIndirectCommand *commands)
+{
+    u32 numCommands = 0;
+    for (u32 i = 0; i < numBlocks; i++)
+    {
+        MeshletBlock *block = &blocks[i];
+        for (u32 mask = CullMeshletBlock(block, view); mask != 0; mask &= mask - 1)
+        {
+            u32 lane = FindLeastSignificantBit(mask);
+            commands[numCommands++] = {block->count[lane], 1, block->firstIndex[lane], block->baseVertex[lane],
+                                       block->baseInstance[lane]};
+        }
+    }
+    return numCommands;
+}
+
+// A model drawn by a pass, and once culled, the commands of its meshlets which remain.
+struct MeshletCullDraw
+{
+    MeshletBlock *blocks; // Of the LOD it's drawn at.
+    u32 numBlocks;
+    MeshletCullView view;
+
+    u32 firstCommand;
+    u32 numCommands;
+    u32 numTriangles;
+};
+
+// Up to MESHLET_CULL_BATCH_BLOCKS blocks of a draw, which get room for a command per meshlet.
+struct MeshletCullBatch
+{
+    u32 drawIndex;
+    u32 firstBlock; // Of the draw's.
+    u32 numBlocks;
+    u32 firstCommand;
+    u32 numCommands;
+};
+
+struct MeshletCullJob
+{
+    MeshletCullDraw *draws;
+    MeshletCullBatch *batches;
+    DrawElementsIndirectCommand *commands;
+};
+
+internal void CullMeshletBatchesJob(void *data, u32 begin, u32 end)
+{
+    MeshletCullJob *job = (MeshletCullJob *)data;
+    for (u32 i = begin; i < end; i++)
+    {
+        MeshletCullBatch *batch = &job->batches[i];
+        MeshletCullDraw *draw = &job->draws[batch->drawIndex];
+        batch->numCommands = CullMeshlets(draw->blocks + batch->firstBlock, batch->numBlocks, &draw->view,
+                                          job->commands + batch->firstCommand);
+    }
+}
+
+// The most commands culling the draws can write, see: CullMeshletDraws().
+internal u32 GetMaxMeshletCommands(MeshletCullDraw *draws, u32 numDraws)
+{
+    u32 result = 0;
+    for (u32 i = 0; i < numDraws; i++)
+    {
+        result += draws[i].numBlocks * MESHLET_BLOCK_SIZE;
+    }
+    return result;
+}
+
+// Culls the draws' meshlets in batches spread over the job system, then packs the commands of the draws one after the
+// other, in their order, and returns how many there are. There has to be room for GetMaxMeshletCommands().
+internal u32 CullMeshletDraws(JobSystem *system, MeshletCullDraw *draws, u32 numDraws,
+                              DrawElementsIndirectCommand *commands, Arena *arena)
+{
+    TempMemory temp = TempBegin(arena);
+    u32 maxBatches = 0;
+    for (u32 i = 0; i < numDraws; i++)
+    {
+        maxBatches += (draws[i].numBlocks + MESHLET_CULL_BATCH_BLOCKS - 1) / MESHLET_CULL_BATCH_BLOCKS;
+    }
+    MeshletCullBatch *batches = PushArray<MeshletCullBatch>(arena, maxBatches);
+    u32 numBatches = 0;
+    u32 maxCommands = 0;
+    for (u32 i = 0; i < numDraws; i++)
+    {
+        draws[i].firstCommand = 0;
+        draws[i].numCommands = 0;
+        draws[i].numTriangles = 0;
+        for (u32 block = 0; block < draws[i].numBlocks; block += MESHLET_CULL_BATCH_BLOCKS)
+        {
+            u32 numBlocks = intMin(draws[i].numBlocks - block, (u32)MESHLET_CULL_BATCH_BLOCKS);
+            batches[numBatches++] = {i, block, numBlocks, maxCommands, 0};
+            maxCommands += numBlocks * MESHLET_BLOCK_SIZE;
+        }
+    }
+    MeshletCullJob job = {draws, batches, commands};
+    ParallelFor(system, numBatches, 4, CullMeshletBatchesJob, &job, "Meshlet culling");
+
+    // NOTE: packing only ever moves commands down, as every batch has room for all of its meshlets.
+    u32 numCommands = 0;
+    for (u32 i = 0; i < numBatches; i++)
+    {
+        MeshletCullBatch *batch = &batches[i];
+        MeshletCullDraw *draw = &draws[batch->drawIndex];
+        if (batch->firstBlock == 0)
+        {
+            draw->firstCommand = numCommands;
+        }
+        memmove(&commands[numCommands], &commands[batch->firstCommand],
+                batch->numCommands * sizeof(DrawElementsIndirectCommand));
+        for (u32 j = 0; j < batch->numCommands; j++)
+        {
+            draw->numTriangles += commands[numCommands + j].count / 3;
+        }
+        draw->numCommands += batch->numCommands;
+        numCommands += batch->numCommands;
+    }
+
+    TempEnd(temp);
+    return numCommands;
+}
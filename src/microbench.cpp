@@ -0,0 +1,1803 @@
+#include "arena.h"
+#include "common.h"
+
+#include "hashmap.h"
+#include "jobs.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "range_allocator.h"
+#include "render_queue.h"
+#include "skiplist.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <stdlib.h> // qsort().
+#include <vector>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/***********************************************************************************************************************
+ *
+ * cw_microbench: CPU-only benchmarks of the engine's core data structures, each run on a synthetic workload shaped
+ * like the one the engine puts it through. Every benchmark is run several times and reported as its median time.
+ *
+ * Usage: cw_microbench [--runs N] [--filter name] [--threads N]
+ *
+ **********************************************************************************************************************/
+
+/***********************************************************************************************************************
+ *
+ * Harness.
+ *
+ **********************************************************************************************************************/
+
+#define MAX_BENCHMARK_RUNS 256
+#define MAX_BENCHMARK_THREADS 64
+
+struct BenchmarkSettings
+{
+    u32 numRuns;
+    const char *filter; // Only benchmarks whose name contains this are run.
+    u32 maxThreads;     // Multi-threaded benchmarks scale from 1 up to this.
+};
+
+// Deterministic, so that every variant of a benchmark sees the same workload.
+struct BenchmarkRandom
+{
+    u64 state;
+};
+
+internal u32 NextRandom(BenchmarkRandom *random)
+{
+    // xorshift64*.
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    return (u32)((random->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+internal bool ShouldRunBenchmark(BenchmarkSettings *settings, const char *name)
+{
+    return settings->filter == NULL || strstr(name, settings->filter) != NULL;
+}
+
+internal int CompareF32(const void *a, const void *b)
+{
+    f32 left = *(const f32 *)a;
+    f32 right = *(const f32 *)b;
+    return (left > right) - (left < right);
+}
+
+internal f32 GetMedian(f32 *samples, u32 count)
+{
+    qsort(samples, count, sizeof(f32), CompareF32);
+    return samples[count / 2];
+}
+
+internal void PrintBenchmarkResult(const char *name, const char *variant, f32 median, const char *unit,
+                                   const char *note)
+{
+    printf("%-28s %-28s %10.3f %-2s  %s\n", name, variant, median, unit, note);
+}
+
+// Keeps the optimizer from dropping work whose result is otherwise unused.
+global_variable volatile u64 gBenchmarkSink;
+
+//
+// Threads.
+//
+
+typedef void (*BenchmarkThreadProc_t)(void *context, u32 threadIndex);
+
+struct BenchmarkThreadStart
+{
+    BenchmarkThreadProc_t proc;
+    void *context;
+    u32 threadIndex;
+};
+
+#ifdef _WIN32
+internal DWORD WINAPI BenchmarkThreadProc(LPVOID parameter)
+{
+    BenchmarkThreadStart *start = (BenchmarkThreadStart *)parameter;
+    start->proc(start->context, start->threadIndex);
+    return 0;
+}
+#else
+internal void *BenchmarkThreadProc(void *parameter)
+{
+    BenchmarkThreadStart *start = (BenchmarkThreadStart *)parameter;
+    start->proc(start->context, start->threadIndex);
+    return NULL;
+}
+#endif
+
+internal u32 GetNumBenchmarkCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    u32 numCores = systemInfo.dwNumberOfProcessors;
+#else
+    u32 numCores = (u32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return intMin(intMax(numCores, 1u), (u32)MAX_BENCHMARK_THREADS);
+}
+
+// Runs the procedure on the given number of threads, the calling thread being thread 0, and returns once every one of
+// them is done.
+internal void RunOnBenchmarkThreads(u32 numThreads, BenchmarkThreadProc_t proc, void *context)
+{
+    BenchmarkThreadStart starts[MAX_BENCHMARK_THREADS];
+#ifdef _WIN32
+    HANDLE threads[MAX_BENCHMARK_THREADS];
+#else
+    pthread_t threads[MAX_BENCHMARK_THREADS];
+#endif
+    for (u32 i = 1; i < numThreads; i++)
+    {
+        starts[i] = {proc, context, i};
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, BenchmarkThreadProc, &starts[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, BenchmarkThreadProc, &starts[i]);
+#endif
+    }
+    proc(context, 0);
+    for (u32 i = 1; i < numThreads; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+// Spins until every thread has arrived, so that thread creation isn't timed.
+internal void WaitForBenchmarkThreads(std::atomic<u32> *numArrived, u32 numThreads)
+{
+    numArrived->fetch_add(1, std::memory_order_acq_rel);
+    while (numArrived->load(std::memory_order_acquire) < numThreads)
+    {
+    }
+}
+
+/***********************************************************************************************************************
+ *
+ * Arena page backing: the effect of huge pages (see: ARENA_FLAG_HUGE_PAGES) on the two ways the engine uses arenas
+ * heavily.
+ *
+ **********************************************************************************************************************/
+
+struct ArenaBackingVariant
+{
+    const char *name;
+    u32 flags;
+};
+
+global_variable ArenaBackingVariant gArenaBackingVariants[] = {
+    {"pages", 0},
+    {"huge pages", ARENA_FLAG_HUGE_PAGES},
+    {"explicit huge pages", ARENA_FLAG_EXPLICIT_HUGE_PAGES},
+};
+
+// Model import: LoadModel() fills a fresh scratch arena with a large mesh's vertices and then walks them
+// through the indices, so the time goes into first-touch page faults and TLB misses on the random accesses.
+#define IMPORT_NUM_VERTICES (1024 * 1024)
+#define IMPORT_NUM_INDICES (3 * IMPORT_NUM_VERTICES)
+
+internal void RunImportBenchmark(Arena *arena, BenchmarkRandom *random)
+{
+    Vertex *vertices = PushArray<Vertex>(arena, IMPORT_NUM_VERTICES);
+    for (u32 i = 0; i < IMPORT_NUM_VERTICES; i++)
+    {
+        vertices[i].position = glm::vec3((f32)i, 0.f, 0.f);
+        vertices[i].normal = glm::vec3(0.f, 1.f, 0.f);
+        vertices[i].texCoords = glm::vec2(0.f);
+        vertices[i].tangent = glm::vec3(1.f, 0.f, 0.f);
+        vertices[i].bitangent = glm::vec3(0.f, 0.f, 1.f);
+    }
+
+    u32 *indices = PushArray<u32>(arena, IMPORT_NUM_INDICES);
+    f32 sum = 0.f;
+    for (u32 i = 0; i < IMPORT_NUM_INDICES; i++)
+    {
+        indices[i] = NextRandom(random) % IMPORT_NUM_VERTICES;
+        sum += vertices[indices[i]].position.x;
+    }
+    gBenchmarkSink = gBenchmarkSink + (u64)sum;
+}
+
+// Per-frame temp memory: a long-lived arena which every frame fills with a few large buffers and many small ones, and
+// then clears (which gives back everything above ARENA_DECOMMIT_THRESHOLD).
+#define FRAME_TEMP_NUM_FRAMES 100
+#define FRAME_TEMP_LARGE_SIZE (8 * 1024 * 1024)
+#define FRAME_TEMP_NUM_SMALL_PUSHES 2000
+
+internal void RunFrameTempBenchmark(Arena *arena, BenchmarkRandom *random)
+{
+    for (u32 frame = 0; frame < FRAME_TEMP_NUM_FRAMES; frame++)
+    {
+        u32 *large = PushArray<u32>(arena, FRAME_TEMP_LARGE_SIZE / sizeof(u32));
+        for (u32 i = 0; i < FRAME_TEMP_LARGE_SIZE / sizeof(u32); i += 16)
+        {
+            large[i] = i;
+        }
+        u64 sum = 0;
+        for (u32 i = 0; i < FRAME_TEMP_NUM_SMALL_PUSHES; i++)
+        {
+            glm::mat4 *matrix = PushStruct<glm::mat4>(arena);
+            *matrix = glm::mat4(1.f);
+            sum += large[(NextRandom(random) % (FRAME_TEMP_LARGE_SIZE / sizeof(u32))) & ~15u];
+        }
+        gBenchmarkSink = gBenchmarkSink + sum;
+        ArenaClear(arena);
+    }
+}
+
+internal void RunArenaBenchmarks(BenchmarkSettings *settings)
+{
+    f32 samples[MAX_BENCHMARK_RUNS];
+    if (ShouldRunBenchmark(settings, "arena import"))
+    {
+        for (u32 variant = 0; variant < myArraySize(gArenaBackingVariants); variant++)
+        {
+            const char *backing = "";
+            for (u32 run = 0; run < settings->numRuns; run++)
+            {
+                BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+                u64 start = Win32GetWallClock();
+                Arena *arena = AllocArena(SCRATCH_ARENA_SIZE, "Benchmark import", gArenaBackingVariants[variant].flags);
+                RunImportBenchmark(arena, &random);
+                backing = GetArenaBackingName(arena->backing);
+                FreeArena(arena);
+                samples[run] = Win32GetElapsedMs(start, Win32GetWallClock());
+            }
+            PrintBenchmarkResult("arena import", gArenaBackingVariants[variant].name,
+                                 GetMedian(samples, settings->numRuns), "ms", backing);
+        }
+    }
+
+    if (ShouldRunBenchmark(settings, "arena frame temp"))
+    {
+        for (u32 variant = 0; variant < myArraySize(gArenaBackingVariants); variant++)
+        {
+            Arena *arena = AllocArena(1920 * 1080 * 32, "Benchmark frame temp", gArenaBackingVariants[variant].flags);
+            for (u32 run = 0; run < settings->numRuns; run++)
+            {
+                BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+                u64 start = Win32GetWallClock();
+                RunFrameTempBenchmark(arena, &random);
+                samples[run] = Win32GetElapsedMs(start, Win32GetWallClock()) / FRAME_TEMP_NUM_FRAMES;
+            }
+            PrintBenchmarkResult("arena frame temp (per frame)", gArenaBackingVariants[variant].name,
+                                 GetMedian(samples, settings->numRuns), "ms", GetArenaBackingName(arena->backing));
+            FreeArena(arena);
+        }
+    }
+}
+
+/***********************************************************************************************************************
+ *
+ * Ordered maps: the skip list (see: skiplist.h) against std::map and a sorted vector, from 10^2 to 10^6 random keys.
+ * Times are per operation: inserting every key, finding every key in another order, iterating in key order and
+ * accessing random indices.
+ *
+ * NOTE: the sorted vector is built in bulk (append, then sort) since inserting in order would be quadratic, and
+ * std::map has no index access short of walking from the start, so it is skipped for large maps.
+ *
+ **********************************************************************************************************************/
+
+#define ORDERED_MAP_NUM_INDEX_ACCESSES 1000
+#define ORDERED_MAP_MAX_WALKED_INDEX 10000
+
+enum OrderedMapOperation
+{
+    OrderedMapInsert,
+    OrderedMapFind,
+    OrderedMapIterate,
+    OrderedMapIndex,
+    NUM_ORDERED_MAP_OPERATIONS,
+};
+
+global_variable const char *gOrderedMapOperationNames[NUM_ORDERED_MAP_OPERATIONS] = {
+    "ordered map insert",
+    "ordered map find",
+    "ordered map iterate",
+    "ordered map index",
+};
+
+struct OrderedMapWorkload
+{
+    u64 *keys;    // In insertion order.
+    u64 *lookups; // The same keys, shuffled.
+    u32 *indices; // ORDERED_MAP_NUM_INDEX_ACCESSES random indices, below the number of distinct keys.
+    u32 count;
+};
+
+// Returns nanoseconds per operation.
+internal f32 GetNsPerOperation(u64 start, u32 numOperations)
+{
+    return Win32GetElapsedMs(start, Win32GetWallClock()) * 1e6f / (f32)numOperations;
+}
+
+internal void RunSkipListBenchmark(OrderedMapWorkload *workload, Arena *arena, f32 *times)
+{
+    u64 start = Win32GetWallClock();
+    SkipList<u64, u64> list;
+    InitSkipList(&list, arena);
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        SkipListInsert(&list, workload->keys[i], workload->keys[i]);
+    }
+    times[OrderedMapInsert] = GetNsPerOperation(start, workload->count);
+
+    u64 sum = 0;
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += *SkipListFind(&list, workload->lookups[i]);
+    }
+    times[OrderedMapFind] = GetNsPerOperation(start, workload->count);
+
+    start = Win32GetWallClock();
+    for (SkipListNode<u64, u64> *node = SkipListFirst(&list); node; node = SkipListNext(node))
+    {
+        sum += node->value;
+    }
+    times[OrderedMapIterate] = GetNsPerOperation(start, list.count);
+
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < ORDERED_MAP_NUM_INDEX_ACCESSES; i++)
+    {
+        sum += SkipListAt(&list, workload->indices[i])->value;
+    }
+    times[OrderedMapIndex] = GetNsPerOperation(start, ORDERED_MAP_NUM_INDEX_ACCESSES);
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+internal void RunStdMapBenchmark(OrderedMapWorkload *workload, f32 *times)
+{
+    u64 start = Win32GetWallClock();
+    std::map<u64, u64> map;
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        map[workload->keys[i]] = workload->keys[i];
+    }
+    times[OrderedMapInsert] = GetNsPerOperation(start, workload->count);
+
+    u64 sum = 0;
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += map.find(workload->lookups[i])->second;
+    }
+    times[OrderedMapFind] = GetNsPerOperation(start, workload->count);
+
+    start = Win32GetWallClock();
+    for (auto &entry : map)
+    {
+        sum += entry.second;
+    }
+    times[OrderedMapIterate] = GetNsPerOperation(start, (u32)map.size());
+
+    times[OrderedMapIndex] = -1.f;
+    if (map.size() <= ORDERED_MAP_MAX_WALKED_INDEX)
+    {
+        start = Win32GetWallClock();
+        for (u32 i = 0; i < ORDERED_MAP_NUM_INDEX_ACCESSES; i++)
+        {
+            sum += std::next(map.begin(), workload->indices[i])->second;
+        }
+        times[OrderedMapIndex] = GetNsPerOperation(start, ORDERED_MAP_NUM_INDEX_ACCESSES);
+    }
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+struct SortedVectorEntry
+{
+    u64 key;
+    u64 value;
+};
+
+internal void RunSortedVectorBenchmark(OrderedMapWorkload *workload, f32 *times)
+{
+    auto keyLess = [](const SortedVectorEntry &a, const SortedVectorEntry &b) { return a.key < b.key; };
+    auto keyEqual = [](const SortedVectorEntry &a, const SortedVectorEntry &b) { return a.key == b.key; };
+
+    u64 start = Win32GetWallClock();
+    std::vector<SortedVectorEntry> entries;
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        entries.push_back({workload->keys[i], workload->keys[i]});
+    }
+    std::stable_sort(entries.begin(), entries.end(), keyLess);
+    entries.erase(std::unique(entries.begin(), entries.end(), keyEqual), entries.end());
+    times[OrderedMapInsert] = GetNsPerOperation(start, workload->count);
+
+    u64 sum = 0;
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        SortedVectorEntry lookup = {workload->lookups[i], 0};
+        sum += std::lower_bound(entries.begin(), entries.end(), lookup, keyLess)->value;
+    }
+    times[OrderedMapFind] = GetNsPerOperation(start, workload->count);
+
+    start = Win32GetWallClock();
+    for (SortedVectorEntry &entry : entries)
+    {
+        sum += entry.value;
+    }
+    times[OrderedMapIterate] = GetNsPerOperation(start, (u32)entries.size());
+
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < ORDERED_MAP_NUM_INDEX_ACCESSES; i++)
+    {
+        sum += entries[workload->indices[i]].value;
+    }
+    times[OrderedMapIndex] = GetNsPerOperation(start, ORDERED_MAP_NUM_INDEX_ACCESSES);
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+internal void RunOrderedMapBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "ordered map"))
+    {
+        return;
+    }
+
+    const char *variants[] = {"skip list", "std::map", "sorted vector"};
+    Arena *workloadArena = AllocArena(64 * 1024 * 1024, "Benchmark ordered map workload");
+    Arena *listArena = AllocArena(256 * 1024 * 1024, "Benchmark skip list", ARENA_FLAG_HUGE_PAGES);
+    for (u32 count = 100; count <= 1000000; count *= 10)
+    {
+        // Random keys, with the odd duplicate; the skip list tells us how many are distinct.
+        BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+        OrderedMapWorkload workload = {};
+        workload.count = count;
+        workload.keys = PushArray<u64>(workloadArena, count);
+        workload.lookups = PushArray<u64>(workloadArena, count);
+        workload.indices = PushArray<u32>(workloadArena, ORDERED_MAP_NUM_INDEX_ACCESSES);
+        for (u32 i = 0; i < count; i++)
+        {
+            workload.keys[i] = ((u64)NextRandom(&random) << 32) | NextRandom(&random);
+            workload.keys[i] %= (u64)count * 64;
+            workload.lookups[i] = workload.keys[i];
+        }
+        for (u32 i = count - 1; i > 0; i--)
+        {
+            u32 j = NextRandom(&random) % (i + 1);
+            u64 swap = workload.lookups[i];
+            workload.lookups[i] = workload.lookups[j];
+            workload.lookups[j] = swap;
+        }
+        SkipList<u64, u64> distinct;
+        InitSkipList(&distinct, listArena);
+        for (u32 i = 0; i < count; i++)
+        {
+            SkipListInsert(&distinct, workload.keys[i], (u64)0);
+        }
+        for (u32 i = 0; i < ORDERED_MAP_NUM_INDEX_ACCESSES; i++)
+        {
+            workload.indices[i] = NextRandom(&random) % distinct.count;
+        }
+        ArenaClear(listArena);
+
+        for (u32 variant = 0; variant < myArraySize(variants); variant++)
+        {
+            f32 samples[NUM_ORDERED_MAP_OPERATIONS][MAX_BENCHMARK_RUNS];
+            for (u32 run = 0; run < settings->numRuns; run++)
+            {
+                f32 times[NUM_ORDERED_MAP_OPERATIONS];
+                if (variant == 0)
+                {
+                    RunSkipListBenchmark(&workload, listArena, times);
+                    ArenaClear(listArena);
+                }
+                else if (variant == 1)
+                {
+                    RunStdMapBenchmark(&workload, times);
+                }
+                else
+                {
+                    RunSortedVectorBenchmark(&workload, times);
+                }
+                for (u32 operation = 0; operation < NUM_ORDERED_MAP_OPERATIONS; operation++)
+                {
+                    samples[operation][run] = times[operation];
+                }
+            }
+
+            char variantName[64];
+            snprintf(variantName, sizeof(variantName), "%s, n = %u", variants[variant], count);
+            for (u32 operation = 0; operation < NUM_ORDERED_MAP_OPERATIONS; operation++)
+            {
+                if (samples[operation][0] < 0.f)
+                {
+                    PrintBenchmarkResult(gOrderedMapOperationNames[operation], variantName, 0.f, "ns",
+                                         "skipped, O(n) per access");
+                    continue;
+                }
+                const char *note = (variant == 2 && operation == OrderedMapInsert) ? "bulk build" : "";
+                PrintBenchmarkResult(gOrderedMapOperationNames[operation], variantName,
+                                     GetMedian(samples[operation], settings->numRuns), "ns", note);
+            }
+        }
+        ArenaClear(workloadArena);
+    }
+    FreeArena(listArena);
+    FreeArena(workloadArena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Concurrent skip list scaling: threads insert their share of 2^18 random keys into one list and then look up their
+ * share again, from 1 thread up to one per core, against the sequential skip list behind a global spinlock.
+ *
+ **********************************************************************************************************************/
+
+#define CONCURRENT_MAP_NUM_KEYS (1 << 18)
+
+struct ConcurrentMapBenchmark
+{
+    u64 *keys;
+    u64 *lookups;
+    u32 numThreads;
+    bool locked;
+
+    ConcurrentSkipList<u64, u64> list;
+    SkipList<u64, u64> lockedList;
+    std::atomic<bool> lock;
+
+    std::atomic<u32> numArrived;
+    std::atomic<u32> numInserted;
+    u64 insertStart;
+    u64 insertEnd;
+    u64 findEnd;
+};
+
+internal void LockBenchmarkSpinlock(std::atomic<bool> *lock)
+{
+    while (lock->exchange(true, std::memory_order_acquire))
+    {
+    }
+}
+
+internal void RunConcurrentMapThread(void *context, u32 threadIndex)
+{
+    ConcurrentMapBenchmark *benchmark = (ConcurrentMapBenchmark *)context;
+    u32 first = CONCURRENT_MAP_NUM_KEYS / benchmark->numThreads * threadIndex;
+    u32 end = CONCURRENT_MAP_NUM_KEYS / benchmark->numThreads * (threadIndex + 1);
+    if (threadIndex == benchmark->numThreads - 1)
+    {
+        end = CONCURRENT_MAP_NUM_KEYS;
+    }
+
+    WaitForBenchmarkThreads(&benchmark->numArrived, benchmark->numThreads);
+    if (threadIndex == 0)
+    {
+        benchmark->insertStart = Win32GetWallClock();
+    }
+    ConcurrentArenaChunk chunk = {};
+    for (u32 i = first; i < end; i++)
+    {
+        if (benchmark->locked)
+        {
+            LockBenchmarkSpinlock(&benchmark->lock);
+            SkipListInsert(&benchmark->lockedList, benchmark->keys[i], benchmark->keys[i]);
+            benchmark->lock.store(false, std::memory_order_release);
+        }
+        else
+        {
+            ConcurrentSkipListInsert(&benchmark->list, benchmark->keys[i], benchmark->keys[i], &chunk);
+        }
+    }
+
+    WaitForBenchmarkThreads(&benchmark->numInserted, benchmark->numThreads);
+    if (threadIndex == 0)
+    {
+        benchmark->insertEnd = Win32GetWallClock();
+    }
+    u64 sum = 0;
+    for (u32 i = first; i < end; i++)
+    {
+        if (benchmark->locked)
+        {
+            LockBenchmarkSpinlock(&benchmark->lock);
+            sum += *SkipListFind(&benchmark->lockedList, benchmark->lookups[i]);
+            benchmark->lock.store(false, std::memory_order_release);
+        }
+        else
+        {
+            sum += *ConcurrentSkipListFind(&benchmark->list, benchmark->lookups[i]);
+        }
+    }
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+internal void RunConcurrentMapBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "concurrent map"))
+    {
+        return;
+    }
+
+    Arena *workloadArena = AllocArena(16 * 1024 * 1024, "Benchmark concurrent map workload");
+    ConcurrentMapBenchmark *benchmark = PushStruct<ConcurrentMapBenchmark>(workloadArena);
+    benchmark->keys = PushArray<u64>(workloadArena, CONCURRENT_MAP_NUM_KEYS);
+    benchmark->lookups = PushArray<u64>(workloadArena, CONCURRENT_MAP_NUM_KEYS);
+    // Distinct keys: the low bits are the index, the high bits random.
+    BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+    for (u32 i = 0; i < CONCURRENT_MAP_NUM_KEYS; i++)
+    {
+        benchmark->keys[i] = ((u64)NextRandom(&random) << 20) | i;
+        benchmark->lookups[i] = benchmark->keys[i];
+    }
+    for (u32 i = CONCURRENT_MAP_NUM_KEYS - 1; i > 0; i--)
+    {
+        u32 j = NextRandom(&random) % (i + 1);
+        u64 swap = benchmark->lookups[i];
+        benchmark->lookups[i] = benchmark->lookups[j];
+        benchmark->lookups[j] = swap;
+    }
+    ConcurrentArena *listArena = AllocConcurrentArena(256 * 1024 * 1024, "Benchmark concurrent skip list");
+    Arena *lockedListArena = AllocArena(256 * 1024 * 1024, "Benchmark locked skip list");
+
+    f32 singleThreadedNs[2][2] = {};
+    for (u32 numThreads = 1;; numThreads = intMin(numThreads * 2, settings->maxThreads))
+    {
+        for (u32 locked = 0; locked < 2; locked++)
+        {
+            f32 samples[2][MAX_BENCHMARK_RUNS];
+            for (u32 run = 0; run < settings->numRuns; run++)
+            {
+                benchmark->numThreads = numThreads;
+                benchmark->locked = (locked == 1);
+                benchmark->numArrived.store(0, std::memory_order_relaxed);
+                benchmark->numInserted.store(0, std::memory_order_relaxed);
+                benchmark->lock.store(false, std::memory_order_relaxed);
+                InitConcurrentSkipList(&benchmark->list, listArena);
+                InitSkipList(&benchmark->lockedList, lockedListArena);
+
+                RunOnBenchmarkThreads(numThreads, RunConcurrentMapThread, benchmark);
+                benchmark->findEnd = Win32GetWallClock();
+                samples[0][run] =
+                    Win32GetElapsedMs(benchmark->insertStart, benchmark->insertEnd) * 1e6f / CONCURRENT_MAP_NUM_KEYS;
+                samples[1][run] =
+                    Win32GetElapsedMs(benchmark->insertEnd, benchmark->findEnd) * 1e6f / CONCURRENT_MAP_NUM_KEYS;
+                ConcurrentArenaClear(listArena);
+                ArenaClear(lockedListArena);
+            }
+
+            const char *names[] = {"concurrent map insert", "concurrent map find"};
+            char variantName[64];
+            snprintf(variantName, sizeof(variantName), "%s, %u thread%s", locked ? "locked skip list" : "skip list",
+                     numThreads, (numThreads == 1) ? "" : "s");
+            for (u32 operation = 0; operation < 2; operation++)
+            {
+                f32 median = GetMedian(samples[operation], settings->numRuns);
+                if (numThreads == 1)
+                {
+                    singleThreadedNs[locked][operation] = median;
+                }
+                char note[32];
+                snprintf(note, sizeof(note), "%.2fx vs 1 thread", singleThreadedNs[locked][operation] / median);
+                PrintBenchmarkResult(names[operation], variantName, median, "ns", note);
+            }
+        }
+        if (numThreads == settings->maxThreads)
+        {
+            break;
+        }
+    }
+
+    FreeArena(lockedListArena);
+    FreeConcurrentArena(listArena);
+    FreeArena(workloadArena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Render queue sorting: the radix sort of draw keys (see: render_queue.h) against std::sort, on queues shaped like a
+ * frame's: a few hundred materials and random depths.
+ *
+ **********************************************************************************************************************/
+
+#define RENDER_QUEUE_NUM_MATERIALS 300
+
+internal void FillBenchmarkRenderQueue(RenderQueue *queue, u32 count, bool transparent, BenchmarkRandom *random)
+{
+    queue->count = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 material = NextRandom(random) % RENDER_QUEUE_NUM_MATERIALS;
+        f32 distance = (f32)(NextRandom(random) % 100000) / 100.f;
+        u64 key = transparent ? MakeTransparentDrawKey(0, material, distance)
+                              : MakeOpaqueDrawKey(0, material, distance);
+        PushRenderDraw(queue, key, {RenderDrawKind::Object, i});
+    }
+}
+
+internal void RunRenderQueueBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "render queue sort"))
+    {
+        return;
+    }
+
+    const char *variants[] = {"radix", "std::sort"};
+    Arena *arena = AllocArena(64 * 1024 * 1024, "Benchmark render queue");
+    for (u32 transparent = 0; transparent < 2; transparent++)
+    {
+        for (u32 count = 1000; count <= 100000; count *= 10)
+        {
+            RenderQueue queue = BeginRenderQueue(arena, count);
+            for (u32 variant = 0; variant < myArraySize(variants); variant++)
+            {
+                f32 samples[MAX_BENCHMARK_RUNS];
+                for (u32 run = 0; run < settings->numRuns; run++)
+                {
+                    BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+                    FillBenchmarkRenderQueue(&queue, count, transparent, &random);
+
+                    u64 start = Win32GetWallClock();
+                    if (variant == 0)
+                    {
+                        SortRenderQueue(&queue, arena);
+                    }
+                    else
+                    {
+                        std::sort(queue.entries, queue.entries + queue.count,
+                                  [](const RenderQueueEntry &a, const RenderQueueEntry &b) { return a.key < b.key; });
+                    }
+                    samples[run] = GetNsPerOperation(start, count);
+
+                    for (u32 i = 1; i < queue.count; i++)
+                    {
+                        myAssert(queue.entries[i - 1].key <= queue.entries[i].key);
+                    }
+                    gBenchmarkSink = gBenchmarkSink + queue.entries[0].drawIndex;
+                }
+
+                char variantName[64];
+                snprintf(variantName, sizeof(variantName), "%s, n = %u", variants[variant], count);
+                PrintBenchmarkResult(transparent ? "render queue sort, blended" : "render queue sort, opaque",
+                                     variantName, GetMedian(samples, settings->numRuns), "ns", "per draw");
+            }
+            ArenaClear(arena);
+        }
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Hash maps: HashMap and FixedHashMap (see: hashmap.h) against std::unordered_map, on the engine's two key shapes:
+ * fnv1a() hashes of paths, as texture deduplication uses, and sequential IDs, as the object lookup uses. Times are per
+ * operation: inserting every key, finding every key in another order, and looking up as many keys which aren't there.
+ *
+ **********************************************************************************************************************/
+
+#define HASH_MAP_FIXED_CAPACITY 16384
+
+enum HashMapOperation
+{
+    HashMapOperationInsert,
+    HashMapOperationFind,
+    HashMapOperationMiss,
+    NUM_HASH_MAP_OPERATIONS,
+};
+
+global_variable const char *gHashMapOperationNames[NUM_HASH_MAP_OPERATIONS] = {
+    "hash map insert",
+    "hash map find",
+    "hash map miss",
+};
+
+template <typename K> struct HashMapWorkload
+{
+    K *keys;    // In insertion order.
+    K *lookups; // The same keys, shuffled.
+    K *misses;  // As many keys which aren't in the map.
+    u32 count;
+};
+
+// Times the operations on any map with HashMapInsert() and HashMapFind(), which has to start out empty.
+template <typename Map, typename K>
+internal void RunHashMapBenchmark(Map *map, HashMapWorkload<K> *workload, f32 *times)
+{
+    u64 start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        HashMapInsert(map, workload->keys[i], i);
+    }
+    times[HashMapOperationInsert] = GetNsPerOperation(start, workload->count);
+
+    u64 sum = 0;
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += *HashMapFind(map, workload->lookups[i]);
+    }
+    times[HashMapOperationFind] = GetNsPerOperation(start, workload->count);
+
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += (HashMapFind(map, workload->misses[i]) != NULL);
+    }
+    times[HashMapOperationMiss] = GetNsPerOperation(start, workload->count);
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+template <typename K> internal void RunStdUnorderedMapBenchmark(HashMapWorkload<K> *workload, f32 *times)
+{
+    std::unordered_map<K, u32> map;
+    u64 start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        map[workload->keys[i]] = i;
+    }
+    times[HashMapOperationInsert] = GetNsPerOperation(start, workload->count);
+
+    u64 sum = 0;
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += map.find(workload->lookups[i])->second;
+    }
+    times[HashMapOperationFind] = GetNsPerOperation(start, workload->count);
+
+    start = Win32GetWallClock();
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        sum += (map.find(workload->misses[i]) != map.end());
+    }
+    times[HashMapOperationMiss] = GetNsPerOperation(start, workload->count);
+    gBenchmarkSink = gBenchmarkSink + sum;
+}
+
+// Path hashes are fnv1a() of distinct paths; IDs count up from zero, with misses past the last one.
+internal void FillHashMapWorkload(HashMapWorkload<u64> *workload, BenchmarkRandom *random)
+{
+    for (u32 i = 0; i < 2 * workload->count; i++)
+    {
+        char path[64];
+        s32 length = snprintf(path, sizeof(path), "assets/textures/material_%u_diffuse.png", i);
+        u64 hash = fnv1a((u8 *)path, length);
+        if (i < workload->count)
+        {
+            workload->keys[i] = hash;
+        }
+        else
+        {
+            workload->misses[i - workload->count] = hash;
+        }
+    }
+}
+
+internal void FillHashMapWorkload(HashMapWorkload<u32> *workload, BenchmarkRandom *random)
+{
+    for (u32 i = 0; i < workload->count; i++)
+    {
+        workload->keys[i] = i;
+        workload->misses[i] = workload->count + i;
+    }
+}
+
+template <typename K>
+internal void RunHashMapBenchmarks(BenchmarkSettings *settings, const char *keyName, Arena *workloadArena,
+                                   Arena *mapArena)
+{
+    const char *variants[] = {"HashMap", "FixedHashMap", "std::unordered_map"};
+    for (u32 count = 100; count <= 1000000; count *= 100)
+    {
+        BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+        HashMapWorkload<K> workload = {};
+        workload.count = count;
+        workload.keys = PushArray<K>(workloadArena, count);
+        workload.lookups = PushArray<K>(workloadArena, count);
+        workload.misses = PushArray<K>(workloadArena, count);
+        FillHashMapWorkload(&workload, &random);
+        memcpy(workload.lookups, workload.keys, count * sizeof(K));
+        for (u32 i = count - 1; i > 0; i--)
+        {
+            u32 j = NextRandom(&random) % (i + 1);
+            K swap = workload.lookups[i];
+            workload.lookups[i] = workload.lookups[j];
+            workload.lookups[j] = swap;
+        }
+
+        for (u32 variant = 0; variant < myArraySize(variants); variant++)
+        {
+            if (variant == 1 && count > GetHashMapMaxCount(HASH_MAP_FIXED_CAPACITY))
+            {
+                continue;
+            }
+
+            f32 samples[NUM_HASH_MAP_OPERATIONS][MAX_BENCHMARK_RUNS];
+            for (u32 run = 0; run < settings->numRuns; run++)
+            {
+                f32 times[NUM_HASH_MAP_OPERATIONS];
+                if (variant == 0)
+                {
+                    HashMap<K, u32> map;
+                    InitHashMap(&map, mapArena);
+                    RunHashMapBenchmark(&map, &workload, times);
+                }
+                else if (variant == 1)
+                {
+                    auto *map = PushStruct<FixedHashMap<K, u32, HASH_MAP_FIXED_CAPACITY>>(mapArena);
+                    HashMapClear(map);
+                    RunHashMapBenchmark(map, &workload, times);
+                }
+                else
+                {
+                    RunStdUnorderedMapBenchmark(&workload, times);
+                }
+                ArenaClear(mapArena);
+                for (u32 operation = 0; operation < NUM_HASH_MAP_OPERATIONS; operation++)
+                {
+                    samples[operation][run] = times[operation];
+                }
+            }
+
+            char variantName[64];
+            snprintf(variantName, sizeof(variantName), "%s, n = %u", variants[variant], count);
+            for (u32 operation = 0; operation < NUM_HASH_MAP_OPERATIONS; operation++)
+            {
+                PrintBenchmarkResult(gHashMapOperationNames[operation], variantName,
+                                     GetMedian(samples[operation], settings->numRuns), "ns", keyName);
+            }
+        }
+        ArenaClear(workloadArena);
+    }
+}
+
+internal void RunHashMapBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "hash map"))
+    {
+        return;
+    }
+
+    Arena *workloadArena = AllocArena(64 * 1024 * 1024, "Benchmark hash map workload");
+    Arena *mapArena = AllocArena(256 * 1024 * 1024, "Benchmark hash map", ARENA_FLAG_HUGE_PAGES);
+    RunHashMapBenchmarks<u64>(settings, "path hashes", workloadArena, mapArena);
+    RunHashMapBenchmarks<u32>(settings, "IDs", workloadArena, mapArena);
+    FreeArena(mapArena);
+    FreeArena(workloadArena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Job system (see: jobs.h): ParallelFor() over per-object transforms like UpdateTransforms()'s, scaling from one
+ * thread up, and the cost of a job on its own, pushed from one thread or fanned out by jobs themselves.
+ *
+ **********************************************************************************************************************/
+
+#define JOBS_NUM_TRANSFORMS 100000
+#define JOBS_NUM_EMPTY 100000
+// Every job of the fan-out tree pushes this many more, down to JOBS_FAN_OUT_DEPTH: 1 + 8 + ... + 8^5 jobs.
+#define JOBS_FAN_OUT 8
+#define JOBS_FAN_OUT_DEPTH 5
+
+struct JobsTransformWorkload
+{
+    glm::vec3 *positions;
+    glm::mat4 *modelMatrices;
+    glm::mat3 *normalMatrices;
+};
+
+internal void RunTransformJob(void *data, u32 begin, u32 end)
+{
+    JobsTransformWorkload *workload = (JobsTransformWorkload *)data;
+    for (u32 i = begin; i < end; i++)
+    {
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.f), workload->positions[i]);
+        modelMatrix = glm::rotate(modelMatrix, (f32)i, glm::vec3(0.f, 1.f, 0.f));
+        modelMatrix = glm::scale(modelMatrix, glm::vec3(1.f + (i % 7)));
+        workload->modelMatrices[i] = modelMatrix;
+        workload->normalMatrices[i] = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+    }
+}
+
+internal void RunEmptyJob(void *data, u32 begin, u32 end)
+{
+    ((std::atomic<u32> *)data)->fetch_add(1, std::memory_order_relaxed);
+}
+
+struct FanOutJob
+{
+    std::atomic<u32> *numRun;
+    u32 depth;
+};
+
+internal void RunFanOutJob(void *data, u32 begin, u32 end)
+{
+    FanOutJob *job = (FanOutJob *)data;
+    job->numRun->fetch_add(1, std::memory_order_relaxed);
+    if (job->depth == JOBS_FAN_OUT_DEPTH)
+    {
+        return;
+    }
+
+    FanOutJob children[JOBS_FAN_OUT];
+    JobCounter counter = {};
+    for (u32 i = 0; i < JOBS_FAN_OUT; i++)
+    {
+        children[i] = {job->numRun, job->depth + 1};
+        PushJob(gJobSystem, RunFanOutJob, &children[i], &counter, "Fan out");
+    }
+    WaitForJobCounter(gJobSystem, &counter);
+}
+
+internal void RunJobSystemBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "job system"))
+    {
+        return;
+    }
+
+    Arena *arena = AllocArena(JOBS_NUM_TRANSFORMS * (sizeof(glm::vec3) + sizeof(glm::mat4) + sizeof(glm::mat3) * 2),
+                              "Benchmark jobs");
+    JobsTransformWorkload workload = {};
+    workload.positions = PushArray<glm::vec3>(arena, JOBS_NUM_TRANSFORMS);
+    workload.modelMatrices = PushArray<glm::mat4>(arena, JOBS_NUM_TRANSFORMS);
+    workload.normalMatrices = PushArray<glm::mat3>(arena, JOBS_NUM_TRANSFORMS);
+    glm::mat3 *expectedNormalMatrices = PushArray<glm::mat3>(arena, JOBS_NUM_TRANSFORMS);
+    BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+    for (u32 i = 0; i < JOBS_NUM_TRANSFORMS; i++)
+    {
+        workload.positions[i] = glm::vec3(NextRandom(&random) % 1000, NextRandom(&random) % 1000, 0.f);
+    }
+    RunTransformJob(&workload, 0, JOBS_NUM_TRANSFORMS);
+    memcpy(expectedNormalMatrices, workload.normalMatrices, JOBS_NUM_TRANSFORMS * sizeof(glm::mat3));
+
+    f32 serialMedian = 0.f;
+    for (u32 numThreads = 1; numThreads <= settings->maxThreads; numThreads *= 2)
+    {
+        // The calling thread runs jobs as well while it waits.
+        gJobSystem = StartJobSystem(numThreads - 1);
+
+        f32 samples[MAX_BENCHMARK_RUNS];
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            memset(workload.normalMatrices, 0, JOBS_NUM_TRANSFORMS * sizeof(glm::mat3));
+            u64 start = Win32GetWallClock();
+            ParallelFor(gJobSystem, JOBS_NUM_TRANSFORMS, 256, RunTransformJob, &workload, "Transforms");
+            samples[run] = GetNsPerOperation(start, JOBS_NUM_TRANSFORMS);
+            myAssert(memcmp(workload.normalMatrices, expectedNormalMatrices,
+                            JOBS_NUM_TRANSFORMS * sizeof(glm::mat3)) == 0);
+        }
+        char variantName[64];
+        snprintf(variantName, sizeof(variantName), "%u threads", numThreads);
+        f32 median = GetMedian(samples, settings->numRuns);
+        serialMedian = (numThreads == 1) ? median : serialMedian;
+        char note[64];
+        snprintf(note, sizeof(note), "per object, %.2fx", serialMedian / median);
+        PrintBenchmarkResult("job system, ParallelFor", variantName, median, "ns", note);
+
+        std::atomic<u32> numRun(0);
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            numRun.store(0, std::memory_order_relaxed);
+            JobCounter counter = {};
+            u64 start = Win32GetWallClock();
+            for (u32 i = 0; i < JOBS_NUM_EMPTY; i += JOB_DEQUE_SIZE / 2)
+            {
+                // Waits every half deque, as a thread can only have so many jobs queued.
+                for (u32 j = i; j < intMin(i + JOB_DEQUE_SIZE / 2, (u32)JOBS_NUM_EMPTY); j++)
+                {
+                    PushJob(gJobSystem, RunEmptyJob, &numRun, &counter, "Empty");
+                }
+                WaitForJobCounter(gJobSystem, &counter);
+            }
+            samples[run] = GetNsPerOperation(start, JOBS_NUM_EMPTY);
+            myAssert(numRun.load(std::memory_order_relaxed) == JOBS_NUM_EMPTY);
+        }
+        PrintBenchmarkResult("job system, empty jobs", variantName, GetMedian(samples, settings->numRuns), "ns",
+                             "per job, pushed by one thread");
+
+        u32 numFanOutJobs = 0;
+        for (u32 depth = 0, level = 1; depth <= JOBS_FAN_OUT_DEPTH; depth++, level *= JOBS_FAN_OUT)
+        {
+            numFanOutJobs += level;
+        }
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            numRun.store(0, std::memory_order_relaxed);
+            FanOutJob root = {&numRun, 0};
+            u64 start = Win32GetWallClock();
+            RunFanOutJob(&root, 0, 1);
+            samples[run] = GetNsPerOperation(start, numFanOutJobs);
+            myAssert(numRun.load(std::memory_order_relaxed) == numFanOutJobs);
+        }
+        PrintBenchmarkResult("job system, fan-out jobs", variantName, GetMedian(samples, settings->numRuns), "ns",
+                             "per job, pushed by jobs");
+
+        StopJobSystem(gJobSystem);
+        gJobSystem = NULL;
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Vertex format (see: PackedVertex): the vertex fetch of a draw, walking a large mesh's vertices through its indices
+ * and reading what the G-buffer pass reads of them, full precision against packed and decoded as the vertex shaders
+ * do; and the cost of packing them when cooking.
+ *
+ **********************************************************************************************************************/
+
+// Well past the last-level cache, so that the fetch is bound by memory bandwidth, as it is on the GPU.
+#define VERTEX_FORMAT_NUM_VERTICES (4 * 1024 * 1024)
+#define VERTEX_FORMAT_NUM_INDICES (3 * VERTEX_FORMAT_NUM_VERTICES)
+// Indices stay within a small window of the previous ones, like those of a mesh in the cooked files' order.
+#define VERTEX_FORMAT_INDEX_WINDOW 64
+
+// Only reads the attributes: on the GPU, the decoding is ALU work which hides behind the fetch (see: "decode").
+internal f32 FetchVertices(Vertex *vertices, u32 *indices)
+{
+    f32 sum = 0.f;
+    for (u32 i = 0; i < VERTEX_FORMAT_NUM_INDICES; i++)
+    {
+        Vertex *vertex = &vertices[indices[i]];
+        sum += vertex->position.x + vertex->normal.y + vertex->tangent.z + vertex->bitangent.x + vertex->texCoords.x;
+    }
+    return sum;
+}
+
+internal f32 FetchVertices(PackedVertex *vertices, u32 *indices)
+{
+    f32 sum = 0.f;
+    for (u32 i = 0; i < VERTEX_FORMAT_NUM_INDICES; i++)
+    {
+        PackedVertex *vertex = &vertices[indices[i]];
+        sum += vertex->position.x + (f32)(vertex->tangentFrame & 0x3ff) + (f32)(vertex->texCoords & 0xffff);
+    }
+    return sum;
+}
+
+internal void RunVertexFormatBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "vertex format"))
+    {
+        return;
+    }
+
+    Arena *arena =
+        AllocArena(VERTEX_FORMAT_NUM_VERTICES * (sizeof(Vertex) + sizeof(PackedVertex)) +
+                       VERTEX_FORMAT_NUM_INDICES * sizeof(u32), "Benchmark vertex format", ARENA_FLAG_HUGE_PAGES);
+    Vertex *vertices = PushArray<Vertex>(arena, VERTEX_FORMAT_NUM_VERTICES);
+    PackedVertex *packedVertices = PushArray<PackedVertex>(arena, VERTEX_FORMAT_NUM_VERTICES);
+    u32 *indices = PushArray<u32>(arena, VERTEX_FORMAT_NUM_INDICES);
+    BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+    for (u32 i = 0; i < VERTEX_FORMAT_NUM_VERTICES; i++)
+    {
+        Vertex *vertex = &vertices[i];
+        vertex->position = glm::vec3((f32)i, (f32)(i % 97), (f32)(i % 89));
+        vertex->normal = glm::normalize(glm::vec3((f32)(NextRandom(&random) % 2001) - 1000.f,
+                                                  (f32)(NextRandom(&random) % 2001) - 1000.f,
+                                                  (f32)(NextRandom(&random) % 2001) - 999.5f));
+        glm::vec3 axis = (fabsf(vertex->normal.x) < 0.9f) ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+        vertex->tangent = glm::normalize(glm::cross(axis, vertex->normal));
+        vertex->bitangent = glm::cross(vertex->normal, vertex->tangent) * ((i % 5 == 0) ? -1.f : 1.f);
+        vertex->texCoords = glm::vec2((f32)(i % 1024) / 1024.f, (f32)(i % 777) / 777.f);
+    }
+    for (u32 i = 0; i < VERTEX_FORMAT_NUM_INDICES; i++)
+    {
+        indices[i] = (i / 3 + NextRandom(&random) % VERTEX_FORMAT_INDEX_WINDOW) % VERTEX_FORMAT_NUM_VERTICES;
+    }
+
+    f32 samples[MAX_BENCHMARK_RUNS];
+    for (u32 run = 0; run < settings->numRuns; run++)
+    {
+        u64 start = Win32GetWallClock();
+        for (u32 i = 0; i < VERTEX_FORMAT_NUM_VERTICES; i++)
+        {
+            packedVertices[i] = PackVertex(&vertices[i]);
+        }
+        samples[run] = GetNsPerOperation(start, VERTEX_FORMAT_NUM_VERTICES);
+    }
+    PrintBenchmarkResult("vertex format, pack", "PackedVertex", GetMedian(samples, settings->numRuns), "ns",
+                         "per vertex");
+
+    // How far the decoded frames are from the source ones, so that the packing can't get cheaper by getting wrong.
+    f32 maxNormalError = 0.f;
+    f32 maxTangentError = 0.f;
+    u32 numWrongSigns = 0;
+    for (u32 i = 0; i < VERTEX_FORMAT_NUM_VERTICES; i++)
+    {
+        glm::vec3 normal, tangent;
+        f32 bitangentSign;
+        UnpackTangentFrame(packedVertices[i].tangentFrame, &normal, &tangent, &bitangentSign);
+        f32 expectedSign = (i % 5 == 0) ? -1.f : 1.f;
+        maxNormalError = fmaxf(maxNormalError, acosf(fminf(glm::dot(normal, vertices[i].normal), 1.f)));
+        maxTangentError = fmaxf(maxTangentError, acosf(fminf(glm::dot(tangent, vertices[i].tangent), 1.f)));
+        numWrongSigns += (bitangentSign != expectedSign);
+    }
+    myAssert(numWrongSigns == 0);
+
+    for (u32 run = 0; run < settings->numRuns; run++)
+    {
+        f32 sum = 0.f;
+        u64 start = Win32GetWallClock();
+        for (u32 i = 0; i < VERTEX_FORMAT_NUM_VERTICES; i++)
+        {
+            glm::vec3 normal, tangent;
+            f32 bitangentSign;
+            UnpackTangentFrame(packedVertices[i].tangentFrame, &normal, &tangent, &bitangentSign);
+            sum += normal.y + tangent.z + bitangentSign + glm::unpackHalf2x16(packedVertices[i].texCoords).x;
+        }
+        samples[run] = GetNsPerOperation(start, VERTEX_FORMAT_NUM_VERTICES);
+        gBenchmarkSink = gBenchmarkSink + (u64)sum;
+    }
+    char note[96];
+    snprintf(note, sizeof(note), "per vertex, max error %.3f (normal), %.3f (tangent) degrees",
+             glm::degrees(maxNormalError), glm::degrees(maxTangentError));
+    PrintBenchmarkResult("vertex format, decode", "PackedVertex", GetMedian(samples, settings->numRuns), "ns", note);
+
+    f32 fullMedian = 0.f;
+    for (u32 variant = 0; variant < 2; variant++)
+    {
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            u64 start = Win32GetWallClock();
+            f32 sum = (variant == 0) ? FetchVertices(vertices, indices) : FetchVertices(packedVertices, indices);
+            samples[run] = GetNsPerOperation(start, VERTEX_FORMAT_NUM_INDICES);
+            gBenchmarkSink = gBenchmarkSink + (u64)sum;
+        }
+        f32 median = GetMedian(samples, settings->numRuns);
+        fullMedian = (variant == 0) ? median : fullMedian;
+        snprintf(note, sizeof(note), "per index, %u bytes per vertex, %.2fx",
+                 (variant == 0) ? (u32)sizeof(Vertex) : (u32)sizeof(PackedVertex), fullMedian / median);
+        PrintBenchmarkResult("vertex format, fetch", (variant == 0) ? "Vertex" : "PackedVertex", median, "ns", note);
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Mesh optimization (see: OptimizeMesh()): the cook's welding and reordering of a regular grid, imported as Assimp
+ * does without aiProcess_JoinIdenticalVertices, a vertex per corner, with its triangles in row order or shuffled, and
+ * the vertex cache before and after.
+ *
+ **********************************************************************************************************************/
+
+#define MESH_OPTIMIZER_GRID_SIZE 256
+#define MESH_OPTIMIZER_NUM_TRIANGLES (MESH_OPTIMIZER_GRID_SIZE * MESH_OPTIMIZER_GRID_SIZE * 2)
+
+// Independent of the order of the triangles, which the optimization is free to change, but not of their vertices'.
+internal u64 HashTriangles(PackedVertex *vertices, u32 *indices, u32 numTriangles)
+{
+    u64 result = 0;
+    for (u32 i = 0; i < numTriangles; i++)
+    {
+        glm::vec3 positions[3];
+        for (u32 j = 0; j < 3; j++)
+        {
+            positions[j] = vertices[indices[i * 3 + j]].position;
+        }
+        result += fnv1a((u8 *)positions, sizeof(positions));
+    }
+    return result;
+}
+
+internal void RunMeshOptimizerBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "mesh optimizer"))
+    {
+        return;
+    }
+
+    u32 numIndices = MESH_OPTIMIZER_NUM_TRIANGLES * 3;
+    Arena *arena = AllocArena(numIndices * (sizeof(PackedVertex) + sizeof(u32)) * 2, "Benchmark mesh optimizer");
+    PackedVertex *importedVertices = PushArray<PackedVertex>(arena, numIndices);
+    u32 *importedIndices = PushArray<u32>(arena, numIndices);
+    PackedVertex *vertices = PushArray<PackedVertex>(arena, numIndices);
+    u32 *indices = PushArray<u32>(arena, numIndices);
+
+    const char *variants[] = {"grid, row order", "grid, shuffled"};
+    for (u32 variant = 0; variant < myArraySize(variants); variant++)
+    {
+        u32 *order = indices;
+        for (u32 i = 0; i < MESH_OPTIMIZER_NUM_TRIANGLES; i++)
+        {
+            order[i] = i;
+        }
+        BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+        for (u32 i = MESH_OPTIMIZER_NUM_TRIANGLES - 1; variant == 1 && i > 0; i--)
+        {
+            u32 j = NextRandom(&random) % (i + 1);
+            u32 swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+        for (u32 i = 0; i < MESH_OPTIMIZER_NUM_TRIANGLES; i++)
+        {
+            u32 quad = order[i] / 2;
+            u32 x = quad % MESH_OPTIMIZER_GRID_SIZE;
+            u32 y = quad / MESH_OPTIMIZER_GRID_SIZE;
+            u32 corners[2][3][2] = {{{0, 0}, {1, 0}, {1, 1}}, {{0, 0}, {1, 1}, {0, 1}}};
+            for (u32 j = 0; j < 3; j++)
+            {
+                Vertex vertex = {};
+                vertex.position = glm::vec3((f32)(x + corners[order[i] % 2][j][0]), 0.f,
+                                            (f32)(y + corners[order[i] % 2][j][1]));
+                vertex.normal = glm::vec3(0.f, 1.f, 0.f);
+                vertex.tangent = glm::vec3(1.f, 0.f, 0.f);
+                vertex.bitangent = glm::vec3(0.f, 0.f, 1.f);
+                vertex.texCoords = glm::vec2(vertex.position.x, vertex.position.z) / (f32)MESH_OPTIMIZER_GRID_SIZE;
+                importedVertices[i * 3 + j] = PackVertex(&vertex);
+                importedIndices[i * 3 + j] = i * 3 + j;
+            }
+        }
+        u64 expectedHash = HashTriangles(importedVertices, importedIndices, MESH_OPTIMIZER_NUM_TRIANGLES);
+
+        f32 samples[MAX_BENCHMARK_RUNS];
+        MeshOptimizationStats stats = {};
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            memcpy(vertices, importedVertices, numIndices * sizeof(PackedVertex));
+            memcpy(indices, importedIndices, numIndices * sizeof(u32));
+            u64 start = Win32GetWallClock();
+            stats = OptimizeMesh(vertices, numIndices, indices, numIndices);
+            samples[run] = GetNsPerOperation(start, MESH_OPTIMIZER_NUM_TRIANGLES);
+            myAssert(stats.numVertices == (MESH_OPTIMIZER_GRID_SIZE + 1) * (MESH_OPTIMIZER_GRID_SIZE + 1));
+            myAssert(HashTriangles(vertices, indices, MESH_OPTIMIZER_NUM_TRIANGLES) == expectedHash);
+        }
+        char note[128];
+        snprintf(note, sizeof(note), "per triangle, ACMR %.3f -> %.3f -> %.3f, ATVR %.3f -> %.3f, %u clusters",
+                 stats.imported.acmr, stats.welded.acmr, stats.optimized.acmr, stats.welded.atvr,
+                 stats.optimized.atvr, stats.numClusters);
+        PrintBenchmarkResult("mesh optimizer", variants[variant], GetMedian(samples, settings->numRuns), "ns", note);
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Mesh simplification (see: SimplifyMesh()): the cook's LOD chain of a unit UV sphere, each LOD simplified from the
+ * one before to half its triangles, with the error each one reports and the largest distance of its vertices from the
+ * sphere.
+ *
+ **********************************************************************************************************************/
+
+#define MESH_SIMPLIFIER_RINGS 128
+#define MESH_SIMPLIFIER_SEGMENTS 256
+
+// A unit UV sphere, its vertices welded and its triangles optimized by the cook's OptimizeMesh(); returns the number of
+// indices. The texture coordinates wrap around, so the first and last columns of vertices are a seam. There's room
+// for MAX_MODEL_LODS times the indices after them.
+internal u32 BuildBenchmarkSphere(Arena *arena, u32 rings, u32 segments, PackedVertex **outVertices,
+                                  u32 *outNumVertices, u32 **outIndices)
+{
+    u32 numVertices = (rings + 1) * (segments + 1);
+    PackedVertex *vertices = PushArray<PackedVertex>(arena, numVertices);
+    for (u32 ring = 0; ring <= rings; ring++)
+    {
+        for (u32 segment = 0; segment <= segments; segment++)
+        {
+            f32 theta = PI * ring / rings;
+            f32 phi = 2.f * PI * (segment % segments) / segments;
+            Vertex vertex = {};
+            vertex.position = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            vertex.normal = vertex.position;
+            vertex.tangent = glm::vec3(-sinf(phi), 0.f, cosf(phi));
+            vertex.bitangent = glm::cross(vertex.normal, vertex.tangent);
+            vertex.texCoords = glm::vec2((f32)segment / segments, (f32)ring / rings);
+            vertices[ring * (segments + 1) + segment] = PackVertex(&vertex);
+        }
+    }
+    u32 *indices = PushArray<u32>(arena, rings * segments * 6 * MAX_MODEL_LODS);
+    u32 numIndices = 0;
+    for (u32 ring = 0; ring < rings; ring++)
+    {
+        for (u32 segment = 0; segment < segments; segment++)
+        {
+            u32 a = ring * (segments + 1) + segment;
+            u32 b = a + segments + 1;
+            // NOTE: the triangles at the poles would be degenerate. Counter-clockwise seen from outside.
+            if (ring != 0)
+            {
+                u32 triangle[3] = {a, a + 1, b};
+                memcpy(&indices[numIndices], triangle, sizeof(triangle));
+                numIndices += 3;
+            }
+            if (ring != rings - 1)
+            {
+                u32 triangle[3] = {a + 1, b + 1, b};
+                memcpy(&indices[numIndices], triangle, sizeof(triangle));
+                numIndices += 3;
+            }
+        }
+    }
+    MeshOptimizationStats stats = OptimizeMesh(vertices, numVertices, indices, numIndices);
+
+    *outVertices = vertices;
+    *outNumVertices = stats.numVertices;
+    *outIndices = indices;
+    return numIndices;
+}
+
+internal void RunMeshSimplifierBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "mesh simplifier"))
+    {
+        return;
+    }
+
+    u32 numVertices = (MESH_SIMPLIFIER_RINGS + 1) * (MESH_SIMPLIFIER_SEGMENTS + 1);
+    u32 numIndices = MESH_SIMPLIFIER_RINGS * MESH_SIMPLIFIER_SEGMENTS * 6;
+    u64 arenaSize = AlignUp(numVertices * sizeof(PackedVertex), 8) + numIndices * sizeof(u32) * MAX_MODEL_LODS;
+    Arena *arena = AllocArena(arenaSize, "Benchmark mesh simplifier");
+    PackedVertex *vertices;
+    u32 *indices;
+    u32 numSphereIndices =
+        BuildBenchmarkSphere(arena, MESH_SIMPLIFIER_RINGS, MESH_SIMPLIFIER_SEGMENTS, &vertices, &numVertices, &indices);
+
+    u32 *lodIndices[MAX_MODEL_LODS] = {indices};
+    u32 lodCounts[MAX_MODEL_LODS] = {numSphereIndices};
+    f32 errors[MAX_MODEL_LODS] = {};
+    for (u32 lod = 1; lod < MAX_MODEL_LODS; lod++)
+    {
+        lodIndices[lod] = lodIndices[lod - 1] + lodCounts[lod - 1];
+        f32 samples[MAX_BENCHMARK_RUNS];
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            u64 start = Win32GetWallClock();
+            lodCounts[lod] = SimplifyMesh(vertices, numVertices, lodIndices[lod - 1], lodCounts[lod - 1],
+                                          (lodCounts[lod - 1] / 6) * 3, lodIndices[lod], &errors[lod]);
+            samples[run] = GetNsPerOperation(start, lodCounts[lod - 1] / 3);
+        }
+
+        // NOTE: the vertices all lie on the sphere, so the distance of the surface from it peaks at triangle centres.
+        f32 maxDistance = 0.f;
+        for (u32 i = 0; i < lodCounts[lod]; i += 3)
+        {
+            glm::vec3 centre = (vertices[lodIndices[lod][i]].position + vertices[lodIndices[lod][i + 1]].position +
+                                vertices[lodIndices[lod][i + 2]].position) /
+                               3.f;
+            maxDistance = fmaxf(maxDistance, 1.f - glm::length(centre));
+        }
+        char variant[32];
+        snprintf(variant, sizeof(variant), "LOD %u", lod);
+        char note[128];
+        snprintf(note, sizeof(note), "per triangle, %u -> %u triangles, error %.4f, off the sphere by %.4f",
+                 lodCounts[lod - 1] / 3, lodCounts[lod] / 3, errors[lod], maxDistance);
+        PrintBenchmarkResult("mesh simplifier", variant, GetMedian(samples, settings->numRuns), "ns", note);
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Meshlet culling (see: meshlet.h): a field of spheres split into meshlets, in front of and around a camera, culled
+ * against its frustum and eye a block at a time, scalar and SSE2, and then as the renderer does a pass, through
+ * CullMeshletDraws() on the job system. Checks that both versions agree, that the job system gets the same commands
+ * on any number of threads, and that every meshlet culled is wholly outside a plane or wholly facing away.
+ *
+ **********************************************************************************************************************/
+
+#define MESHLET_CULLING_RINGS 64
+#define MESHLET_CULLING_SEGMENTS 128
+#define MESHLET_CULLING_INSTANCES 1024
+
+internal void RunMeshletCullingBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "meshlet culling"))
+    {
+        return;
+    }
+
+    Arena *arena = AllocArena(256 * 1024 * 1024, "Benchmark meshlet culling");
+    PackedVertex *vertices;
+    u32 numVertices;
+    u32 *indices;
+    u32 numIndices =
+        BuildBenchmarkSphere(arena, MESHLET_CULLING_RINGS, MESHLET_CULLING_SEGMENTS, &vertices, &numVertices, &indices);
+    Meshlet *meshlets = PushArray<Meshlet>(arena, numIndices / 3);
+    u32 numMeshlets = BuildMeshlets(vertices, numVertices, indices, numIndices, meshlets);
+    u32 numBlocks = (numMeshlets + MESHLET_BLOCK_SIZE - 1) / MESHLET_BLOCK_SIZE;
+    MeshletBlock *blocks = PushArray<MeshletBlock>(arena, numBlocks);
+    memset(blocks, 0, numBlocks * sizeof(MeshletBlock));
+    for (u32 i = 0; i < numMeshlets; i++)
+    {
+        SetMeshletBlockLane(&blocks[i / MESHLET_BLOCK_SIZE], i % MESHLET_BLOCK_SIZE, &meshlets[i], 0, 0, 0);
+    }
+
+    glm::vec3 eye = glm::vec3(0.f);
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 500.f) *
+                               glm::lookAt(eye, glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    MeshletCullDraw *draws = PushArray<MeshletCullDraw>(arena, MESHLET_CULLING_INSTANCES);
+    BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+    for (u32 i = 0; i < MESHLET_CULLING_INSTANCES; i++)
+    {
+        glm::vec3 position = glm::vec3((f32)(NextRandom(&random) % 200) - 100.f,
+                                       (f32)(NextRandom(&random) % 100) - 50.f, -(f32)(NextRandom(&random) % 200));
+        f32 angle = glm::radians((f32)(NextRandom(&random) % 360));
+        f32 scale = 1.f + (f32)(NextRandom(&random) % 3);
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.f), position);
+        modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0.f, 1.f, 0.f));
+        modelMatrix = glm::scale(modelMatrix, glm::vec3(scale));
+        draws[i] = {};
+        draws[i].blocks = blocks;
+        draws[i].numBlocks = numBlocks;
+        draws[i].view = MakeMeshletCullView(viewProjection, modelMatrix, eye, true);
+    }
+    u32 numInstanceMeshlets = numMeshlets * MESHLET_CULLING_INSTANCES;
+
+    // Every meshlet culled has to be culled by either test alone, as only then is the test conservative.
+    u32 numDrawn = 0;
+    for (u32 i = 0; i < MESHLET_CULLING_INSTANCES; i++)
+    {
+        MeshletCullView *view = &draws[i].view;
+        for (u32 j = 0; j < numMeshlets; j++)
+        {
+            MeshletBlock *block = &blocks[j / MESHLET_BLOCK_SIZE];
+            u32 lane = j % MESHLET_BLOCK_SIZE;
+            u32 mask = CullMeshletBlockScalar(block, view);
+            myAssert(mask == CullMeshletBlock(block, view));
+            if (mask & (1 << lane))
+            {
+                numDrawn++;
+                continue;
+            }
+
+            u32 *meshletIndices = &indices[block->firstIndex[lane]];
+            bool outside = false;
+            for (u32 plane = 0; plane < 6 && !outside; plane++)
+            {
+                outside = true;
+                for (u32 k = 0; k < block->count[lane]; k++)
+                {
+                    glm::vec3 position = vertices[meshletIndices[k]].position;
+                    outside &= (glm::dot(glm::vec3(view->planes[plane]), position) + view->planes[plane].w < 0.f);
+                }
+            }
+            bool backFacing = true;
+            for (u32 k = 0; k < block->count[lane] && !outside; k += 3)
+            {
+                glm::vec3 p0 = vertices[meshletIndices[k]].position;
+                glm::vec3 normal = glm::cross(vertices[meshletIndices[k + 1]].position - p0,
+                                              vertices[meshletIndices[k + 2]].position - p0);
+                glm::vec3 toTriangle = p0 - view->eye;
+                // NOTE: some slack for triangles seen edge on.
+                backFacing &= (glm::dot(normal, toTriangle) >= -1e-4f * glm::length(normal) * glm::length(toTriangle));
+            }
+            myAssert(outside || backFacing);
+        }
+    }
+
+    const char *variants[] = {"scalar", MESHLET_CULL_SSE2 ? "SSE2" : "SSE2 (scalar fallback)"};
+    for (u32 variant = 0; variant < myArraySize(variants); variant++)
+    {
+        f32 samples[MAX_BENCHMARK_RUNS];
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            u32 numVisible = 0;
+            u64 start = Win32GetWallClock();
+            for (u32 i = 0; i < MESHLET_CULLING_INSTANCES; i++)
+            {
+                for (u32 j = 0; j < numBlocks; j++)
+                {
+                    u32 mask = (variant == 0) ? CullMeshletBlockScalar(&blocks[j], &draws[i].view)
+                                              : CullMeshletBlock(&blocks[j], &draws[i].view);
+                    for (; mask != 0; mask &= mask - 1)
+                    {
+                        numVisible++;
+                    }
+                }
+            }
+            samples[run] = GetNsPerOperation(start, numInstanceMeshlets);
+            myAssert(numVisible == numDrawn);
+        }
+        char note[128];
+        snprintf(note, sizeof(note), "per meshlet, %u meshlets of %u triangles, %.1f%% drawn", numMeshlets,
+                 numIndices / 3, 100.f * numDrawn / numInstanceMeshlets);
+        PrintBenchmarkResult("meshlet culling, blocks", variants[variant], GetMedian(samples, settings->numRuns), "ns",
+                             note);
+    }
+
+    u32 maxCommands = GetMaxMeshletCommands(draws, MESHLET_CULLING_INSTANCES);
+    DrawElementsIndirectCommand *commands = PushArray<DrawElementsIndirectCommand>(arena, maxCommands);
+    DrawElementsIndirectCommand *expectedCommands = PushArray<DrawElementsIndirectCommand>(arena, maxCommands);
+    u32 numExpectedCommands = 0;
+    f32 serialMedian = 0.f;
+    for (u32 numThreads = 1; numThreads <= settings->maxThreads; numThreads *= 2)
+    {
+        // The calling thread runs jobs as well while it waits.
+        gJobSystem = StartJobSystem(numThreads - 1);
+
+        f32 samples[MAX_BENCHMARK_RUNS];
+        for (u32 run = 0; run < settings->numRuns; run++)
+        {
+            u64 start = Win32GetWallClock();
+            u32 numCommands = CullMeshletDraws(gJobSystem, draws, MESHLET_CULLING_INSTANCES, commands, arena);
+            samples[run] = GetNsPerOperation(start, numInstanceMeshlets);
+            if (numExpectedCommands == 0)
+            {
+                numExpectedCommands = numCommands;
+                memcpy(expectedCommands, commands, numCommands * sizeof(DrawElementsIndirectCommand));
+            }
+            myAssert(numCommands == numDrawn && numCommands == numExpectedCommands);
+            myAssert(memcmp(commands, expectedCommands, numCommands * sizeof(DrawElementsIndirectCommand)) == 0);
+        }
+        char variantName[64];
+        snprintf(variantName, sizeof(variantName), "%u threads", numThreads);
+        f32 median = GetMedian(samples, settings->numRuns);
+        serialMedian = (numThreads == 1) ? median : serialMedian;
+        char note[64];
+        snprintf(note, sizeof(note), "per meshlet, %.2fx", serialMedian / median);
+        PrintBenchmarkResult("meshlet culling, jobs", variantName, median, "ns", note);
+
+        StopJobSystem(gJobSystem);
+        gJobSystem = NULL;
+    }
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Range allocation: the geometry buffer's allocator (see: range_allocator.h), on ranges shaped like models' vertices,
+ * filling the buffer to three quarters and then churning it, freeing a random range and allocating another, as
+ * streaming assets in and out would. Times are per allocation or free.
+ *
+ **********************************************************************************************************************/
+
+#define RANGE_ALLOC_MIN_SIZE 256
+#define RANGE_ALLOC_MAX_SIZE 16384
+#define RANGE_ALLOC_NUM_CHURNS 100000
+
+internal void CheckRangeAllocator(RangeAllocator *allocator, FreeRange *live, u32 numLive)
+{
+    u64 used = 0;
+    for (u32 i = 0; i < numLive; i++)
+    {
+        used += live[i].size;
+    }
+    u64 freeSize = 0;
+    for (u32 i = 0; i < allocator->numFreeRanges; i++)
+    {
+        FreeRange *range = &allocator->freeRanges[i];
+        myAssert(range->size > 0);
+        myAssert(i == 0 || allocator->freeRanges[i - 1].offset + allocator->freeRanges[i - 1].size < range->offset);
+        freeSize += range->size;
+    }
+    myAssert(used == allocator->used && used + freeSize == allocator->capacity);
+}
+
+internal void RunRangeAllocatorBenchmarks(BenchmarkSettings *settings)
+{
+    if (!ShouldRunBenchmark(settings, "range allocator"))
+    {
+        return;
+    }
+
+    Arena *arena = AllocArena(16 * 1024 * 1024, "Benchmark range allocator");
+    u32 maxLive = GEOMETRY_MAX_VERTICES / RANGE_ALLOC_MIN_SIZE;
+    FreeRange *live = PushArray<FreeRange>(arena, maxLive);
+    f32 fillSamples[MAX_BENCHMARK_RUNS];
+    f32 churnSamples[MAX_BENCHMARK_RUNS];
+    u32 numFreeRanges = 0;
+    u32 numFailed = 0;
+    for (u32 run = 0; run < settings->numRuns; run++)
+    {
+        RangeAllocator allocator;
+        InitRangeAllocator(&allocator, GEOMETRY_MAX_VERTICES, GEOMETRY_MAX_FREE_RANGES, "Benchmark free ranges");
+        BenchmarkRandom random = {0x9E3779B97F4A7C15ULL};
+        u32 sizeRange = RANGE_ALLOC_MAX_SIZE - RANGE_ALLOC_MIN_SIZE + 1;
+
+        u32 numLive = 0;
+        u64 start = Win32GetWallClock();
+        while (allocator.used < GEOMETRY_MAX_VERTICES / 4 * 3)
+        {
+            u32 size = RANGE_ALLOC_MIN_SIZE + NextRandom(&random) % sizeRange;
+            live[numLive] = {RangeAlloc(&allocator, size), size};
+            myAssert(live[numLive].offset != RANGE_ALLOC_FAILED);
+            numLive++;
+        }
+        fillSamples[run] = GetNsPerOperation(start, numLive);
+        CheckRangeAllocator(&allocator, live, numLive);
+
+        numFailed = 0;
+        start = Win32GetWallClock();
+        for (u32 i = 0; i < RANGE_ALLOC_NUM_CHURNS; i++)
+        {
+            u32 index = NextRandom(&random) % numLive;
+            RangeFree(&allocator, live[index].offset, live[index].size);
+            u32 size = RANGE_ALLOC_MIN_SIZE + NextRandom(&random) % sizeRange;
+            u32 offset = RangeAlloc(&allocator, size);
+            if (offset == RANGE_ALLOC_FAILED)
+            {
+                // NOTE: too fragmented for this size, the range stays free.
+                live[index] = live[--numLive];
+                numFailed++;
+            }
+            else
+            {
+                live[index] = {offset, size};
+            }
+        }
+        churnSamples[run] = GetNsPerOperation(start, 2 * RANGE_ALLOC_NUM_CHURNS);
+        CheckRangeAllocator(&allocator, live, numLive);
+
+        numFreeRanges = allocator.numFreeRanges;
+        FreeRangeAllocator(&allocator);
+    }
+
+    PrintBenchmarkResult("range allocator", "fill to 3/4", GetMedian(fillSamples, settings->numRuns), "ns",
+                         "per allocation");
+    char note[64];
+    snprintf(note, sizeof(note), "per op, %u free ranges, %u failed", numFreeRanges, numFailed);
+    PrintBenchmarkResult("range allocator", "churn", GetMedian(churnSamples, settings->numRuns), "ns", note);
+    FreeArena(arena);
+}
+
+/***********************************************************************************************************************
+ *
+ * Entry point.
+ *
+ **********************************************************************************************************************/
+
+int main(int argc, char **argv)
+{
+    BenchmarkSettings settings = {};
+    settings.numRuns = 9;
+    settings.maxThreads = GetNumBenchmarkCores();
+
+    for (s32 i = 1; i < argc - 1; i += 2)
+    {
+        const char *option = argv[i];
+        const char *value = argv[i + 1];
+        if (strcmp(option, "--runs") == 0)
+        {
+            settings.numRuns = (u32)atoi(value);
+        }
+        else if (strcmp(option, "--filter") == 0)
+        {
+            settings.filter = value;
+        }
+        else if (strcmp(option, "--threads") == 0)
+        {
+            settings.maxThreads = (u32)atoi(value);
+        }
+        else
+        {
+            DebugPrintA("Unknown option %s\n", option);
+            return -1;
+        }
+    }
+    if (settings.numRuns == 0 || settings.numRuns > MAX_BENCHMARK_RUNS)
+    {
+        DebugPrintA("The number of runs must be between 1 and %u.\n", MAX_BENCHMARK_RUNS);
+        return -1;
+    }
+    if (settings.maxThreads == 0 || settings.maxThreads > MAX_BENCHMARK_THREADS)
+    {
+        DebugPrintA("The number of threads must be between 1 and %u.\n", MAX_BENCHMARK_THREADS);
+        return -1;
+    }
+
+    printf("%-28s %-28s %13s  %s\n", "benchmark", "variant", "median", "note");
+    RunArenaBenchmarks(&settings);
+    RunOrderedMapBenchmarks(&settings);
+    RunConcurrentMapBenchmarks(&settings);
+    RunRenderQueueBenchmarks(&settings);
+    RunHashMapBenchmarks(&settings);
+    RunJobSystemBenchmarks(&settings);
+    RunVertexFormatBenchmarks(&settings);
+    RunMeshOptimizerBenchmarks(&settings);
+    RunMeshSimplifierBenchmarks(&settings);
+    RunMeshletCullingBenchmarks(&settings);
+    RunRangeAllocatorBenchmarks(&settings);
+    return 0;
+}
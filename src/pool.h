@@ -0,0 +1,123 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+/***********************************************************************************************************************
+ *
+ * Pool: typed storage with O(1) allocation and freeing, handing out generational handles (see: Handle and Pool in
+ * common.h).
+ *
+ * Live items are kept densely packed, so iterating over them is a plain loop over items[0, count); freeing an item
+ * moves the last one into its place. Handles go through a slot, which remembers where its item currently lives and
+ * whose generation is bumped whenever the item is freed, so that a stale handle resolves to NULL instead of to
+ * whatever took its place. Free slots form an intrusive list.
+ *
+ * Each array lives in its own arena, which only commits memory as the pool grows: the capacity is an upper bound
+ * rather than what the pool costs.
+ *
+ **********************************************************************************************************************/
+
+#define POOL_NO_SLOT 0xffffffff
+
+// The name must be a string literal, see: AllocArena().
+template <typename T> internal void InitPool(Pool<T> *pool, u32 capacity, const char *name)
+{
+    *pool = {};
+    pool->capacity = capacity;
+    pool->firstFree = POOL_NO_SLOT;
+    pool->itemsArena = AllocArena(AlignUp((u64)capacity * sizeof(T), sizeof(void *)), name);
+    pool->itemSlotsArena = AllocArena(AlignUp((u64)capacity * sizeof(u32), sizeof(void *)), "Pool item slots");
+    pool->slotsArena = AllocArena((u64)capacity * sizeof(PoolSlot), "Pool slots");
+    pool->items = (T *)pool->itemsArena->memory;
+    pool->itemSlots = (u32 *)pool->itemSlotsArena->memory;
+    pool->slots = (PoolSlot *)pool->slotsArena->memory;
+}
+
+template <typename T> internal void FreePool(Pool<T> *pool)
+{
+    FreeArena(pool->slotsArena);
+    FreeArena(pool->itemSlotsArena);
+    FreeArena(pool->itemsArena);
+    *pool = {};
+}
+
+// Returns a handle to a new, zero-initialized item.
+template <typename T> internal Handle<T> PoolAlloc(Pool<T> *pool)
+{
+    if (pool->count == pool->capacity)
+    {
+        ArenaFatalError("pool is full", (u64)(pool->count + 1) * sizeof(T), (u64)pool->capacity * sizeof(T));
+    }
+
+    u32 slotIndex = pool->firstFree;
+    if (slotIndex != POOL_NO_SLOT)
+    {
+        pool->firstFree = pool->slots[slotIndex].denseIndex;
+    }
+    else
+    {
+        slotIndex = pool->numSlots++;
+        PoolSlot *newSlot = PushStruct<PoolSlot>(pool->slotsArena);
+        newSlot->generation = 1;
+    }
+    PoolSlot *slot = &pool->slots[slotIndex];
+
+    // The dense arrays never shrink, so they only need to grow when the pool reaches a new high-water mark.
+    u32 denseIndex = pool->count++;
+    if (pool->itemsArena->stackPointer < pool->count * sizeof(T))
+    {
+        ArenaPush(pool->itemsArena, sizeof(T));
+        ArenaPush(pool->itemSlotsArena, sizeof(u32));
+    }
+    pool->items[denseIndex] = {};
+    pool->itemSlots[denseIndex] = slotIndex;
+    slot->denseIndex = denseIndex;
+
+    Handle<T> result = {slotIndex, slot->generation};
+    return result;
+}
+
+// Returns NULL if the handle is null or its item has been freed.
+template <typename T> internal T *PoolGet(Pool<T> *pool, Handle<T> handle)
+{
+    if (handle.index >= pool->numSlots || pool->slots[handle.index].generation != handle.generation)
+    {
+        return NULL;
+    }
+    return &pool->items[pool->slots[handle.index].denseIndex];
+}
+
+// Returns the handle of the item at the given dense index, eg while iterating over items[0, count).
+template <typename T> internal Handle<T> PoolGetHandle(Pool<T> *pool, u32 denseIndex)
+{
+    myAssert(denseIndex < pool->count);
+    u32 slotIndex = pool->itemSlots[denseIndex];
+    Handle<T> result = {slotIndex, pool->slots[slotIndex].generation};
+    return result;
+}
+
+// Returns false if the handle was already stale.
+template <typename T> internal bool PoolFree(Pool<T> *pool, Handle<T> handle)
+{
+    if (PoolGet(pool, handle) == NULL)
+    {
+        return false;
+    }
+
+    PoolSlot *slot = &pool->slots[handle.index];
+    u32 denseIndex = slot->denseIndex;
+    u32 lastIndex = --pool->count;
+    if (denseIndex != lastIndex)
+    {
+        pool->items[denseIndex] = pool->items[lastIndex];
+        pool->itemSlots[denseIndex] = pool->itemSlots[lastIndex];
+        pool->slots[pool->itemSlots[denseIndex]].denseIndex = denseIndex;
+    }
+
+    // Skip zero on wrap-around so that a null handle never matches.
+    slot->generation = (slot->generation == 0xffffffff) ? 1 : slot->generation + 1;
+    slot->denseIndex = pool->firstFree;
+    pool->firstFree = handle.index;
+    return true;
+}
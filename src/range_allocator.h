@@ -0,0 +1,131 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+/***********************************************************************************************************************
+ *
+ * Range allocator: hands out ranges of a span of fixed size, in whatever unit the caller counts it in, e.g. the
+ * vertices of the geometry buffer (see: GeometryBuffer in common.h). The span itself lives elsewhere, typically in a
+ * GPU buffer, so the allocator only keeps the free ranges: sorted by offset, with no two of them adjacent, since a
+ * range which is freed merges with the free ranges on either side of it.
+ *
+ * Allocation takes the first free range which is large enough, which keeps the span's start densely packed when
+ * ranges are rarely freed, as is the case for assets. Both allocating and freeing are linear in the number of free
+ * ranges, which fragmentation alone makes grow.
+ *
+ **********************************************************************************************************************/
+
+#define RANGE_ALLOC_FAILED 0xffffffff
+
+// The name must be a string literal, see: AllocArena().
+internal void InitRangeAllocator(RangeAllocator *allocator, u32 capacity, u32 maxFreeRanges, const char *name)
+{
+    *allocator = {};
+    allocator->capacity = capacity;
+    allocator->maxFreeRanges = maxFreeRanges;
+    allocator->arena = AllocArena(AlignUp((u64)maxFreeRanges * sizeof(FreeRange), sizeof(void *)), name);
+    allocator->freeRanges = PushArray<FreeRange>(allocator->arena, maxFreeRanges);
+    allocator->freeRanges[0] = {0, capacity};
+    allocator->numFreeRanges = (capacity > 0) ? 1 : 0;
+}
+
+internal void FreeRangeAllocator(RangeAllocator *allocator)
+{
+    FreeArena(allocator->arena);
+    *allocator = {};
+}
+
+// Returns the offset of the range, or RANGE_ALLOC_FAILED when no free range is large enough.
+internal u32 RangeAlloc(RangeAllocator *allocator, u32 size)
+{
+    myAssert(size > 0);
+    for (u32 i = 0; i < allocator->numFreeRanges; i++)
+    {
+        FreeRange *range = &allocator->freeRanges[i];
+        if (range->size < size)
+        {
+            continue;
+        }
+
+        u32 result = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (range->size == 0)
+        {
+            allocator->numFreeRanges--;
+            memmove(range, range + 1, (allocator->numFreeRanges - i) * sizeof(FreeRange));
+        }
+        allocator->used += size;
+        return result;
+    }
+    return RANGE_ALLOC_FAILED;
+}
+
+// The size has to be the one the range was allocated with.
+internal void RangeFree(RangeAllocator *allocator, u32 offset, u32 size)
+{
+    myAssert(size > 0 && offset + size <= allocator->capacity);
+    FreeRange *ranges = allocator->freeRanges;
+
+    // The first free range past the freed one.
+    u32 next = 0;
+    u32 count = allocator->numFreeRanges;
+    while (count > 0)
+    {
+        u32 half = count / 2;
+        if (ranges[next + half].offset < offset)
+        {
+            next += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    myAssert(next == allocator->numFreeRanges || offset + size <= ranges[next].offset);
+    myAssert(next == 0 || ranges[next - 1].offset + ranges[next - 1].size <= offset);
+
+    bool mergesBefore = (next > 0 && ranges[next - 1].offset + ranges[next - 1].size == offset);
+    bool mergesAfter = (next < allocator->numFreeRanges && offset + size == ranges[next].offset);
+    if (mergesBefore && mergesAfter)
+    {
+        ranges[next - 1].size += size + ranges[next].size;
+        allocator->numFreeRanges--;
+        memmove(&ranges[next], &ranges[next + 1], (allocator->numFreeRanges - next) * sizeof(FreeRange));
+    }
+    else if (mergesBefore)
+    {
+        ranges[next - 1].size += size;
+    }
+    else if (mergesAfter)
+    {
+        ranges[next].offset = offset;
+        ranges[next].size += size;
+    }
+    else
+    {
+        if (allocator->numFreeRanges == allocator->maxFreeRanges)
+        {
+            ArenaFatalError("range allocator has too many free ranges",
+                            (u64)(allocator->numFreeRanges + 1) * sizeof(FreeRange),
+                            (u64)allocator->maxFreeRanges * sizeof(FreeRange));
+        }
+        memmove(&ranges[next + 1], &ranges[next], (allocator->numFreeRanges - next) * sizeof(FreeRange));
+        ranges[next] = {offset, size};
+        allocator->numFreeRanges++;
+    }
+    allocator->used -= size;
+}
+
+// The largest range which can be allocated right now.
+internal u32 GetLargestFreeRange(RangeAllocator *allocator)
+{
+    u32 result = 0;
+    for (u32 i = 0; i < allocator->numFreeRanges; i++)
+    {
+        result = intMax(result, allocator->freeRanges[i].size);
+    }
+    return result;
+}
@@ -11,8 +11,17 @@ struct DrawElementsIndirectCommand
     u32 baseInstance;
 };
 
-struct IndirectCommandBuffer
+// Shader storage buffer bindings, which the shaders declare as well.
+#define SSBO_BINDING_MATERIALS 0     // TextureHandles, see: GeometryBuffer::materialBuffer.
+#define SSBO_BINDING_DRAWS 1         // DrawData of the frame's draws.
+#define SSBO_BINDING_COMMAND_DRAWS 2 // u32 per command of the frame: the draw it belongs to.
+
+// What the vertex shaders of the passes know about the draw a command belongs to (see: ExecuteRenderQueue()), laid out
+// as std430 lays out the shaders' struct.
+struct DrawData
 {
-    DrawElementsIndirectCommand commands[MAX_MESHES_PER_MODEL];
-    u32 numCommands = 0;
-};
\ No newline at end of file
+    glm::mat4 modelMatrix;
+    glm::vec4 normalMatrix[3]; // A mat3, whose columns std430 pads to a vec4.
+    u32 objectId;
+    u32 padding[3];
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "arena.h"
+#include "common.h"
+
+/***********************************************************************************************************************
+ *
+ * Render queue: every draw of a pass is emitted with a packed 64-bit key, the keys are radix sorted, and the draws'
+ * commands are then written in key order into the pass' multi-draw (see: ExecuteRenderQueue() in game.cpp). Every
+ * draw of a queue shares the program and the geometry buffer's vertex array, so that the keys only order the commands.
+ *
+ * Key layout, from the most significant bit:
+ *
+ *   opaque:       pass (4) | material (16) | depth (24), front to back
+ *   transparent:  pass (4) | depth (24), back to front | material (16)
+ *
+ * Opaque draws are drawn front to back so that early depth testing rejects what's hidden, within runs of draws which
+ * sample the same textures, which then stay in the texture caches from one command to the next. Transparent draws have
+ * to be blended back to front, so depth comes first there. The pass is the index of the SHADER_PASS_* bit, so that a
+ * queue holding several passes draws them in that order.
+ *
+ * The material is hashed into its field: it only groups draws, the command's base instance picks the textures.
+ *
+ **********************************************************************************************************************/
+
+#define DRAW_KEY_DEPTH_BITS 24
+#define DRAW_KEY_MATERIAL_BITS 16
+#define DRAW_KEY_PASS_BITS 4
+
+#define DRAW_KEY_MASK(bits) ((1ULL << (bits)) - 1)
+
+enum class RenderDrawKind : u32
+{
+    Object,
+    Model,
+};
+
+struct RenderDraw
+{
+    RenderDrawKind kind;
+    u32 itemIndex; // Dense index into the objects or models pool.
+    u32 lod; // Of a model, see: SelectModelLod().
+    // Set when the model's meshlets are culled, to the commands of those which remain (see: CullModelMeshlets()).
+    bool meshletsCulled;
+    u32 firstMeshletCommand;
+    u32 numMeshletCommands;
+};
+
+struct RenderQueueEntry
+{
+    u64 key;
+    u32 drawIndex;
+};
+
+struct RenderQueue
+{
+    RenderDraw *draws;
+    RenderQueueEntry *entries; // Sorted by SortRenderQueue().
+    u32 count;
+    u32 capacity;
+};
+
+internal RenderQueue BeginRenderQueue(Arena *arena, u32 capacity)
+{
+    RenderQueue result = {};
+    result.draws = PushArray<RenderDraw>(arena, capacity);
+    result.entries = PushArray<RenderQueueEntry>(arena, capacity);
+    result.capacity = capacity;
+    return result;
+}
+
+internal void PushRenderDraw(RenderQueue *queue, u64 key, RenderDraw draw)
+{
+    myAssert(queue->count < queue->capacity);
+    queue->draws[queue->count] = draw;
+    queue->entries[queue->count] = {key, queue->count};
+    queue->count++;
+}
+
+// Monotonic in the distance: the bits of a positive float order like the float, so their top bits quantize it
+// logarithmically without needing a far plane.
+internal u64 QuantizeDrawDepth(f32 distance)
+{
+    f32 clamped = fmaxf(distance, 0.f);
+    u32 bits;
+    memcpy(&bits, &clamped, sizeof(bits));
+    return (bits >> (31 - DRAW_KEY_DEPTH_BITS)) & DRAW_KEY_MASK(DRAW_KEY_DEPTH_BITS);
+}
+
+internal u64 MakeOpaqueDrawKey(u32 pass, u32 material, f32 distance)
+{
+    return ((u64)(pass & DRAW_KEY_MASK(DRAW_KEY_PASS_BITS)) << 60) |
+           ((u64)(material & DRAW_KEY_MASK(DRAW_KEY_MATERIAL_BITS)) << DRAW_KEY_DEPTH_BITS) |
+           QuantizeDrawDepth(distance);
+}
+
+internal u64 MakeTransparentDrawKey(u32 pass, u32 material, f32 distance)
+{
+    u64 backToFront = DRAW_KEY_MASK(DRAW_KEY_DEPTH_BITS) - QuantizeDrawDepth(distance);
+    return ((u64)(pass & DRAW_KEY_MASK(DRAW_KEY_PASS_BITS)) << 60) | (backToFront << DRAW_KEY_MATERIAL_BITS) |
+           (material & DRAW_KEY_MASK(DRAW_KEY_MATERIAL_BITS));
+}
+
+// Hashes textures into the material field of a key.
+internal u32 GetDrawKeyMaterial(void *textures, u64 size)
+{
+    u64 hash = fnv1a((u8 *)textures, size);
+    return (u32)(hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48)) & DRAW_KEY_MASK(DRAW_KEY_MATERIAL_BITS);
+}
+
+// LSD radix sort of the entries by key, 8 bits at a time, into a buffer pushed onto the arena. It is stable, which
+// keeps draws with equal keys in the order they were pushed. Digits on which every key agrees are skipped, so keys
+// which only differ in a few fields cost a few passes rather than eight.
+internal void SortRenderQueue(RenderQueue *queue, Arena *arena)
+{
+    if (queue->count < 2)
+    {
+        return;
+    }
+
+    u32 histograms[8][256] = {};
+    for (u32 i = 0; i < queue->count; i++)
+    {
+        u64 key = queue->entries[i].key;
+        for (u32 digit = 0; digit < 8; digit++)
+        {
+            histograms[digit][(key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    TempMemory temp = TempBegin(arena);
+    RenderQueueEntry *source = queue->entries;
+    RenderQueueEntry *destination = PushArray<RenderQueueEntry>(arena, queue->count);
+    for (u32 digit = 0; digit < 8; digit++)
+    {
+        u32 shift = digit * 8;
+        u32 *histogram = histograms[digit];
+        if (histogram[(source[0].key >> shift) & 0xff] == queue->count)
+        {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < 256; bucket++)
+        {
+            u32 bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (u32 i = 0; i < queue->count; i++)
+        {
+            destination[histogram[(source[i].key >> shift) & 0xff]++] = source[i];
+        }
+
+        RenderQueueEntry *swap = source;
+        source = destination;
+        destination = swap;
+    }
+    if (source != queue->entries)
+    {
+        memcpy(queue->entries, source, queue->count * sizeof(RenderQueueEntry));
+    }
+    TempEnd(temp);
+}
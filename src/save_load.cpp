@@ -1,12 +1,8 @@
 #include "common.h"
+#include "pool.h"
 
-internal void SaveShaderPass(FILE *file, ShaderProgram *shader)
-{
-    fwrite(&shader->numObjects, sizeof(u32), 1, file);
-    fwrite(shader->objectIndices, sizeof(u32), shader->numObjects, file);
-    fwrite(&shader->numModels, sizeof(u32), 1, file);
-    fwrite(shader->modelIndices, sizeof(u32), shader->numModels, file);
-}
+// Bumped whenever the layout of the save file changes, so that an older file is ignored rather than misread.
+#define SAVE_FILE_VERSION 5
 
 extern "C" __declspec(dllexport) void SaveDrawingInfo(TransientDrawingInfo *transientInfo, PersistentDrawingInfo *info,
                                                       CameraInfo *cameraInfo)
@@ -14,44 +10,29 @@ extern "C" __declspec(dllexport) void SaveDrawingInfo(TransientDrawingInfo *tran
     FILE *file;
     fopen_s(&file, "save.bin", "wb");
 
-    info->numObjects = transientInfo->numObjects;
-    for (u32 i = 0; i < transientInfo->numObjects; i++)
+    u32 version = SAVE_FILE_VERSION;
+    fwrite(&version, sizeof(u32), 1, file);
+
+    // NOTE: shader pass membership lives with the objects and models themselves (see: SHADER_PASS_GBUFFER) and
+    // isn't saved.
+    info->numObjects = intMin(transientInfo->objects.count, MAX_SAVED_OBJECTS);
+    for (u32 i = 0; i < info->numObjects; i++)
     {
-        info->objectPositions[i] = transientInfo->objects[i].position;
+        Pool<Object> *objects = &transientInfo->objects;
+        info->objectPositions[i] = {PoolGetHandle(objects, i), objects->items[i].position};
     }
-    info->numModels = transientInfo->numModels;
-    for (u32 i = 0; i < transientInfo->numModels; i++)
+    info->numModels = intMin(transientInfo->models.count, MAX_SAVED_MODELS);
+    for (u32 i = 0; i < info->numModels; i++)
     {
-        info->modelPositions[i] = transientInfo->models[i].position;
+        Pool<Model> *models = &transientInfo->models;
+        info->modelPositions[i] = {PoolGetHandle(models, i), models->items[i].position};
     }
     fwrite(info, sizeof(PersistentDrawingInfo), 1, file);
-    SaveShaderPass(file, &transientInfo->gBufferShader);
-    SaveShaderPass(file, &transientInfo->ssaoShader);
-    SaveShaderPass(file, &transientInfo->ssaoBlurShader);
-    SaveShaderPass(file, &transientInfo->dirDepthMapShader);
-    SaveShaderPass(file, &transientInfo->spotDepthMapShader);
-    SaveShaderPass(file, &transientInfo->pointDepthMapShader);
-    SaveShaderPass(file, &transientInfo->instancedObjectShader);
-    SaveShaderPass(file, &transientInfo->colorShader);
-    SaveShaderPass(file, &transientInfo->outlineShader);
-    SaveShaderPass(file, &transientInfo->glassShader);
-    SaveShaderPass(file, &transientInfo->textureShader);
-    SaveShaderPass(file, &transientInfo->postProcessShader);
-    SaveShaderPass(file, &transientInfo->skyboxShader);
-    SaveShaderPass(file, &transientInfo->geometryShader);
     fwrite(cameraInfo, sizeof(CameraInfo), 1, file);
 
     fclose(file);
 }
 
-internal void LoadShaderPass(FILE *file, ShaderProgram *shader)
-{
-    fread(&shader->numObjects, sizeof(u32), 1, file);
-    fread(shader->objectIndices, sizeof(u32), shader->numObjects, file);
-    fread(&shader->numModels, sizeof(u32), 1, file);
-    fread(shader->modelIndices, sizeof(u32), shader->numModels, file);
-}
-
 internal bool LoadDrawingInfo(TransientDrawingInfo *transientInfo, PersistentDrawingInfo *info, CameraInfo *cameraInfo)
 {
     FILE *file;
@@ -61,31 +42,34 @@ internal bool LoadDrawingInfo(TransientDrawingInfo *transientInfo, PersistentDra
         return false;
     }
 
+    u32 version = 0;
+    fread(&version, sizeof(u32), 1, file);
+    if (version != SAVE_FILE_VERSION)
+    {
+        DebugPrintA("Ignoring save file with version %u, expected %u.\n", version, SAVE_FILE_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    // Positions are restored onto the objects and models which already exist, which get the same handles as they're
+    // created in the same order every run; those whose handle doesn't resolve anymore are dropped.
     fread(info, sizeof(PersistentDrawingInfo), 1, file);
-    transientInfo->numObjects = info->numObjects;
-    for (u32 i = 0; i < transientInfo->numObjects; i++)
+    for (u32 i = 0; i < intMin(info->numObjects, MAX_SAVED_OBJECTS); i++)
     {
-        transientInfo->objects[i].position = info->objectPositions[i];
+        SavedPosition<Object> *saved = &info->objectPositions[i];
+        if (Object *object = PoolGet(&transientInfo->objects, saved->handle))
+        {
+            object->position = saved->position;
+        }
     }
-    transientInfo->numModels = info->numModels;
-    for (u32 i = 0; i < transientInfo->numModels; i++)
+    for (u32 i = 0; i < intMin(info->numModels, MAX_SAVED_MODELS); i++)
     {
-        transientInfo->models[i].position = info->modelPositions[i];
+        SavedPosition<Model> *saved = &info->modelPositions[i];
+        if (Model *model = PoolGet(&transientInfo->models, saved->handle))
+        {
+            model->position = saved->position;
+        }
     }
-    LoadShaderPass(file, &transientInfo->gBufferShader);
-    LoadShaderPass(file, &transientInfo->ssaoShader);
-    LoadShaderPass(file, &transientInfo->ssaoBlurShader);
-    LoadShaderPass(file, &transientInfo->dirDepthMapShader);
-    LoadShaderPass(file, &transientInfo->spotDepthMapShader);
-    LoadShaderPass(file, &transientInfo->pointDepthMapShader);
-    LoadShaderPass(file, &transientInfo->instancedObjectShader);
-    LoadShaderPass(file, &transientInfo->colorShader);
-    LoadShaderPass(file, &transientInfo->outlineShader);
-    LoadShaderPass(file, &transientInfo->glassShader);
-    LoadShaderPass(file, &transientInfo->textureShader);
-    LoadShaderPass(file, &transientInfo->postProcessShader);
-    LoadShaderPass(file, &transientInfo->skyboxShader);
-    LoadShaderPass(file, &transientInfo->geometryShader);
     fread(cameraInfo, sizeof(CameraInfo), 1, file);
 
     fclose(file);
@@ -1,4 +1,10 @@
 #include "common.h"
+#include "hashmap.h"
+
+// Uniform locations by program and name, so that setting a uniform every frame doesn't go through the driver's string
+// lookup. Locations only change when a program is linked, which empties the cache (see: CreateShaderProgram()).
+// NOTE: holds every uniform of every program in practice; should it fill up, lookups go to the driver.
+global_variable FixedHashMap<u64, s32, 2048> gUniformLocations;
 
 internal bool CompileShader(u32 *shaderID, GLenum shaderType, const char *shaderFilename)
 {
@@ -83,6 +89,9 @@ internal bool CreateShaderProgram(ShaderProgram *program)
     glDeleteShader(vertexShaderID);
     glDeleteShader(fragmentShaderID);
 
+    // Linking may have moved the program's uniforms, and may reuse the ID of a deleted program.
+    HashMapClear(&gUniformLocations);
+
     return true;
 }
 
@@ -96,44 +105,58 @@ internal FILETIME GetFileTime(const char *filename)
     return fileTime;
 }
 
+internal s32 GetUniformLocation(u32 shaderProgram, const char *uniformName)
+{
+    u64 key = fnv1a((u8 *)uniformName, strlen(uniformName)) ^ ((u64)shaderProgram * 0x9E3779B97F4A7C15ULL);
+    s32 *cached = HashMapFind(&gUniformLocations, key);
+    if (cached)
+    {
+        return *cached;
+    }
+
+    s32 location = glGetUniformLocation(shaderProgram, uniformName);
+    HashMapInsert(&gUniformLocations, key, location);
+    return location;
+}
+
 internal void SetShaderUniformInt(u32 shaderProgram, const char *uniformName, s32 value)
 {
-    glUniform1i(glGetUniformLocation(shaderProgram, uniformName), value);
+    glUniform1i(GetUniformLocation(shaderProgram, uniformName), value);
 }
 
 internal void SetShaderUniformUint(u32 shaderProgram, const char *uniformName, u32 value)
 {
-    glUniform1ui(glGetUniformLocation(shaderProgram, uniformName), value);
+    glUniform1ui(GetUniformLocation(shaderProgram, uniformName), value);
 }
 
 internal void SetShaderUniformFloat(u32 shaderProgram, const char *uniformName, float value)
 {
-    glUniform1f(glGetUniformLocation(shaderProgram, uniformName), value);
+    glUniform1f(GetUniformLocation(shaderProgram, uniformName), value);
 }
 
 internal void SetShaderUniformVec2(u32 shaderProgram, const char *uniformName, glm::vec2 vector)
 {
-    glUniform2fv(glGetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
+    glUniform2fv(GetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
 }
 
 internal void SetShaderUniformVec3(u32 shaderProgram, const char *uniformName, glm::vec3 vector)
 {
-    glUniform3fv(glGetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
+    glUniform3fv(GetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
 }
 
 internal void SetShaderUniformVec4(u32 shaderProgram, const char *uniformName, glm::vec4 vector)
 {
-    glUniform4fv(glGetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
+    glUniform4fv(GetUniformLocation(shaderProgram, uniformName), 1, glm::value_ptr(vector));
 }
 
 internal void SetShaderUniformMat3(u32 shaderProgram, const char *uniformName, glm::mat3 *matrix)
 {
-    glUniformMatrix3fv(glGetUniformLocation(shaderProgram, uniformName), 1, GL_FALSE, glm::value_ptr(*matrix));
+    glUniformMatrix3fv(GetUniformLocation(shaderProgram, uniformName), 1, GL_FALSE, glm::value_ptr(*matrix));
 }
 
 internal void SetShaderUniformMat4(u32 shaderProgram, const char *uniformName, glm::mat4 *matrix)
 {
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, uniformName), 1, GL_FALSE, glm::value_ptr(*matrix));
+    glUniformMatrix4fv(GetUniformLocation(shaderProgram, uniformName), 1, GL_FALSE, glm::value_ptr(*matrix));
 }
 
 internal bool CreateShaderProgram(ShaderProgram *program, const char *vertexShaderFilename,
@@ -152,10 +175,6 @@ internal bool CreateShaderProgram(ShaderProgram *program, const char *vertexShad
     }
     if (glIsProgram(program->id))
     {
-        memcpy(newShaderProgram.objectIndices, program->objectIndices, program->numObjects * sizeof(u32));
-        newShaderProgram.numObjects = program->numObjects;
-        memcpy(newShaderProgram.modelIndices, program->modelIndices, program->numModels * sizeof(u32));
-        newShaderProgram.numModels = program->numModels;
         glDeleteProgram(program->id);
     }
 
@@ -266,11 +285,11 @@ internal bool CreateShaderPrograms(TransientDrawingInfo *info)
     {
         return false;
     }
-    if (!CreateShaderProgram(&info->glassShader, "vertex_shader.vs", "glass.fs"))
+    if (!CreateShaderProgram(&info->glassShader, "vertex_shader_draws.vs", "glass.fs"))
     {
         return false;
     }
-    if (!CreateShaderProgram(&info->textureShader, "vertex_shader.vs", "texture.fs"))
+    if (!CreateShaderProgram(&info->textureShader, "vertex_shader_draws.vs", "texture.fs"))
     {
         return false;
     }
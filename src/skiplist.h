@@ -3,134 +3,593 @@
 #include "arena.h"
 #include "common.h"
 
-/**
+/***********************************************************************************************************************
+ *
+ * Skip list: an ordered map from keys to values, backed by an arena.
+ *
  * Paper: https://15721.courses.cs.cmu.edu/spring2019/papers/07-oltpindexes1/pugh-concurrent-tr1990.pdf
  *
- * This could form a good a basis for implementing an ordered map.
- */
+ * Every link also stores its width, the number of nodes it skips over at level 0, so that finding the node at an
+ * index or the rank of a key descends the list in O(log n) like a search does, instead of walking level 0.
+ *
+ * Node heights come from the list's own PRNG, seeded by the caller, so a list built from the same inserts always has
+ * the same shape. Keys only need operator<; keys which compare neither less nor greater are the same key.
+ *
+ * Deleted nodes can't be given back to the arena, so they are kept on a free list per height and reused by inserts.
+ *
+ **********************************************************************************************************************/
+
+// With p = 1/4, this is enough for 4^16 keys before searches slow down.
+#define SKIP_LIST_MAX_LEVEL 16
+#define SKIP_LIST_DEFAULT_SEED 0x9E3779B97F4A7C15ULL
 
-#define MAX_LEVEL 10
+template <typename K, typename V> struct SkipListNode;
+
+template <typename K, typename V> struct SkipListLink
+{
+    SkipListNode<K, V> *next;
+    u32 width; // Index of next minus index of this node; past the last node, next is NULL and sits at index count.
+};
+
+template <typename K, typename V> struct SkipListNode
+{
+    K key;
+    V value;
+    u32 height;
+    SkipListLink<K, V> links[1]; // Actually height links, see: AllocSkipListNode().
+};
 
-struct SkipListNode
+template <typename K, typename V> struct SkipList
 {
-    SkipListNode **forwardPtrs;
-    s32 height;
-    f32 key;
-    glm::vec3 value;
+    SkipListNode<K, V> *head; // Sentinel with SKIP_LIST_MAX_LEVEL links, before the node at index 0.
+    u32 level;                // Number of levels in use.
+    u32 count;
+    u64 randomState;
+    SkipListNode<K, V> *freeNodes[SKIP_LIST_MAX_LEVEL]; // By height - 1, linked through links[0].next.
+    Arena *arena;
 };
 
-struct SkipList
+// Nodes whose keys are in a range, see: SkipListGetRange().
+template <typename K, typename V> struct SkipListRange
 {
-    SkipListNode *header;
-    s32 level;
+    SkipListNode<K, V> *first; // Follow SkipListNext() for count nodes.
+    u32 count;
 };
 
-SkipList CreateNewList(Arena *arena)
+template <typename K, typename V> internal SkipListNode<K, V> *AllocSkipListNode(SkipList<K, V> *list, u32 height)
 {
-    SkipList list = {};
-    list.header = (SkipListNode *)ArenaPush(arena, sizeof(SkipListNode));
-    list.header->forwardPtrs = (SkipListNode **)ArenaPush(arena, sizeof(SkipListNode *) * MAX_LEVEL);
-    list.header->height = MAX_LEVEL;
-    list.level = 0;
-    return list;
+    SkipListNode<K, V> *node = list->freeNodes[height - 1];
+    if (node)
+    {
+        list->freeNodes[height - 1] = node->links[0].next;
+    }
+    else
+    {
+        u64 size = sizeof(SkipListNode<K, V>) + (height - 1) * sizeof(SkipListLink<K, V>);
+        node = (SkipListNode<K, V> *)ArenaPushAligned(list->arena, size, alignof(SkipListNode<K, V>));
+    }
+    node->height = height;
+    return node;
 }
 
-s32 RandomLevel()
+// NOTE: the arena must outlive the list.
+template <typename K, typename V>
+internal void InitSkipList(SkipList<K, V> *list, Arena *arena, u64 seed = SKIP_LIST_DEFAULT_SEED)
 {
-    s32 level = 1;
-    srand((u32)Win32GetWallClock());
-    while (rand() < RAND_MAX / 2)
+    *list = {};
+    list->arena = arena;
+    // xorshift gets stuck at zero.
+    list->randomState = (seed != 0) ? seed : SKIP_LIST_DEFAULT_SEED;
+    list->head = AllocSkipListNode(list, SKIP_LIST_MAX_LEVEL);
+    list->head->links[0] = {NULL, 1};
+    list->level = 1;
+}
+
+template <typename K, typename V> internal u32 RandomSkipListHeight(SkipList<K, V> *list)
+{
+    // xorshift64*; each pair of zero bits adds a level, ie p = 1/4.
+    list->randomState ^= list->randomState >> 12;
+    list->randomState ^= list->randomState << 25;
+    list->randomState ^= list->randomState >> 27;
+    u64 bits = list->randomState * 0x2545F4914F6CDD1DULL;
+    u32 height = 1;
+    while (height < SKIP_LIST_MAX_LEVEL && (bits & 3) == 0)
     {
-        level++;
+        height++;
+        bits >>= 2;
     }
-    return intMin(level, MAX_LEVEL - 1);
+    return height;
 }
 
-SkipListNode *CreateNode(s32 level, f32 key, glm::vec3 value, Arena *arena)
+// Finds, on every level in use, the last node whose key is less than the given one, along with its index + 1 (0 for
+// the head).
+template <typename K, typename V>
+internal void FindSkipListPredecessors(SkipList<K, V> *list, K key, SkipListNode<K, V> **predecessors, u32 *ranks)
 {
-    SkipListNode *result = (SkipListNode *)ArenaPush(arena, sizeof(SkipListNode));
-    result->height = level;
-    result->key = key;
-    result->value = value;
-    result->forwardPtrs = (SkipListNode **)ArenaPush(arena, sizeof(SkipListNode *) * level);
-    return result;
+    SkipListNode<K, V> *node = list->head;
+    u32 rank = 0;
+    for (s32 i = list->level - 1; i >= 0; i--)
+    {
+        while (node->links[i].next && node->links[i].next->key < key)
+        {
+            rank += node->links[i].width;
+            node = node->links[i].next;
+        }
+        predecessors[i] = node;
+        ranks[i] = rank;
+    }
 }
 
-void Insert(SkipList *list, f32 key, glm::vec3 value, Arena *arena, Arena *tempArena)
+// Inserts the key, or overwrites its value if it is already present. Returns a pointer to the value, which stays
+// valid until the key is deleted.
+template <typename K, typename V> internal V *SkipListInsert(SkipList<K, V> *list, K key, V value)
 {
-    SkipListNode **update = (SkipListNode **)tempArena->memory;
+    SkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+    u32 ranks[SKIP_LIST_MAX_LEVEL];
+    FindSkipListPredecessors(list, key, predecessors, ranks);
 
-    SkipListNode *x = list->header;
+    SkipListNode<K, V> *next = predecessors[0]->links[0].next;
+    if (next && !(key < next->key))
+    {
+        next->value = value;
+        return &next->value;
+    }
+
+    u32 height = RandomSkipListHeight(list);
+    for (u32 i = list->level; i < height; i++)
+    {
+        predecessors[i] = list->head;
+        ranks[i] = 0;
+        list->head->links[i] = {NULL, list->count + 1};
+    }
+    list->level = intMax(list->level, height);
+
+    SkipListNode<K, V> *node = AllocSkipListNode(list, height);
+    node->key = key;
+    node->value = value;
+    // Index + 1 of the new node is ranks[0] + 1; the predecessor on each level now links to it, and it takes over
+    // the rest of the predecessor's link.
+    for (u32 i = 0; i < height; i++)
+    {
+        SkipListLink<K, V> *link = &predecessors[i]->links[i];
+        u32 distance = ranks[0] - ranks[i] + 1;
+        node->links[i] = {link->next, link->width + 1 - distance};
+        *link = {node, distance};
+    }
+    for (u32 i = height; i < list->level; i++)
+    {
+        predecessors[i]->links[i].width++;
+    }
+    list->count++;
+    return &node->value;
+}
+
+// Returns NULL if the key isn't present.
+template <typename K, typename V> internal V *SkipListFind(SkipList<K, V> *list, K key)
+{
+    SkipListNode<K, V> *node = list->head;
     for (s32 i = list->level - 1; i >= 0; i--)
     {
-        while (x->forwardPtrs[i] && x->forwardPtrs[i]->key > key)
+        while (node->links[i].next && node->links[i].next->key < key)
         {
-            x = x->forwardPtrs[i];
+            node = node->links[i].next;
         }
-        update[i] = *(SkipListNode **)ArenaPush(tempArena, sizeof(SkipListNode *));
-        update[i] = x;
     }
-    x = x->forwardPtrs[0];
-    if (x && x->key == key)
+    node = node->links[0].next;
+    if (node && !(key < node->key))
     {
-        x->value = value;
+        return &node->value;
     }
-    else
+    return NULL;
+}
+
+// Returns false if the key wasn't present.
+template <typename K, typename V> internal bool SkipListDelete(SkipList<K, V> *list, K key)
+{
+    SkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+    u32 ranks[SKIP_LIST_MAX_LEVEL];
+    FindSkipListPredecessors(list, key, predecessors, ranks);
+
+    SkipListNode<K, V> *node = predecessors[0]->links[0].next;
+    if (node == NULL || key < node->key)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < list->level; i++)
+    {
+        SkipListLink<K, V> *link = &predecessors[i]->links[i];
+        if (link->next == node)
+        {
+            *link = {node->links[i].next, link->width + node->links[i].width - 1};
+        }
+        else
+        {
+            link->width--;
+        }
+    }
+    while (list->level > 1 && list->head->links[list->level - 1].next == NULL)
+    {
+        list->level--;
+    }
+    list->count--;
+
+    node->links[0].next = list->freeNodes[node->height - 1];
+    list->freeNodes[node->height - 1] = node;
+    return true;
+}
+
+// Returns the node at the given index in key order, or NULL if it is out of range.
+template <typename K, typename V> internal SkipListNode<K, V> *SkipListAt(SkipList<K, V> *list, u32 index)
+{
+    if (index >= list->count)
     {
-        s32 level = RandomLevel();
-        if (level > list->level)
+        return NULL;
+    }
+    SkipListNode<K, V> *node = list->head;
+    u32 rank = 0; // Index + 1 of node.
+    for (s32 i = list->level - 1; i >= 0; i--)
+    {
+        while (node->links[i].next && rank + node->links[i].width <= index + 1)
         {
-            for (s32 i = list->level; i < level; i++)
+            rank += node->links[i].width;
+            node = node->links[i].next;
+        }
+    }
+    return node;
+}
+
+// Returns the first node whose key isn't less than the given one, or NULL if there is none. The rank is the number of
+// keys less than the given one, ie the index of the node returned.
+template <typename K, typename V>
+internal SkipListNode<K, V> *SkipListLowerBound(SkipList<K, V> *list, K key, u32 *rank = NULL)
+{
+    SkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+    u32 ranks[SKIP_LIST_MAX_LEVEL];
+    FindSkipListPredecessors(list, key, predecessors, ranks);
+    if (rank)
+    {
+        *rank = ranks[0];
+    }
+    return predecessors[0]->links[0].next;
+}
+
+// Nodes whose keys are in [minKey, maxKey).
+template <typename K, typename V>
+internal SkipListRange<K, V> SkipListGetRange(SkipList<K, V> *list, K minKey, K maxKey)
+{
+    SkipListRange<K, V> result = {};
+    if (!(minKey < maxKey))
+    {
+        return result;
+    }
+    u32 firstRank;
+    u32 endRank;
+    result.first = SkipListLowerBound(list, minKey, &firstRank);
+    SkipListLowerBound(list, maxKey, &endRank);
+    result.count = endRank - firstRank;
+    return result;
+}
+
+//
+// Iteration in key order: for (node = SkipListFirst(&list); node; node = SkipListNext(node)).
+//
+
+template <typename K, typename V> internal SkipListNode<K, V> *SkipListFirst(SkipList<K, V> *list)
+{
+    return list->head->links[0].next;
+}
+
+template <typename K, typename V> internal SkipListNode<K, V> *SkipListNext(SkipListNode<K, V> *node)
+{
+    return node->links[0].next;
+}
+
+/***********************************************************************************************************************
+ *
+ * Concurrent skip list: a lock-free ordered map which any number of threads can insert into, search, delete from and
+ * pop the smallest key off at once, e.g. to build sorted transparency lists or priority queues (texture streaming
+ * requests) from parallel culling jobs. Based on the lock-free skip list in Herlihy & Shavit, The Art of
+ * Multiprocessor Programming, chapter 14 (itself after Fraser and Pugh).
+ *
+ * The low bit of a next pointer marks its node as deleted at that level. A node is in the map while its level 0 link
+ * is unmarked: deleting marks its links top down and then claims level 0, and searches unlink the marked nodes they
+ * walk past.
+ *
+ * Nodes live in a concurrent arena and are never freed individually, so a thread which still holds a pointer to an
+ * unlinked node can keep following it: reclamation is per arena, once no thread uses the list any more (typically
+ * at the end of the frame, see: ConcurrentArenaClear()). That also rules out ABA on the pointers. A long-lived list
+ * which sees many deletes should be rebuilt into a fresh arena from time to time.
+ *
+ * Unlike SkipList, there are no widths (ranks would need every insert to update every level), and heights come from a
+ * per-thread PRNG, so the shape depends on which thread inserted what.
+ *
+ **********************************************************************************************************************/
+
+template <typename K, typename V> struct ConcurrentSkipListNode
+{
+    K key;
+    V value;
+    u32 height;
+    std::atomic<u64> next[1]; // Actually height pointers, the low bit being the deletion mark.
+};
+
+template <typename K, typename V> struct ConcurrentSkipList
+{
+    ConcurrentSkipListNode<K, V> *head; // Sentinel with SKIP_LIST_MAX_LEVEL pointers.
+    ConcurrentArena *arena;
+    alignas(64) std::atomic<u32> count;
+};
+
+global_variable thread_local u64 tConcurrentSkipListRandomState;
+
+internal u32 RandomConcurrentSkipListHeight()
+{
+    if (tConcurrentSkipListRandomState == 0)
+    {
+        // Any distinct seed per thread will do.
+        tConcurrentSkipListRandomState = ((u64)&tConcurrentSkipListRandomState * 0x9E3779B97F4A7C15ULL) | 1;
+    }
+    // See: RandomSkipListHeight().
+    tConcurrentSkipListRandomState ^= tConcurrentSkipListRandomState >> 12;
+    tConcurrentSkipListRandomState ^= tConcurrentSkipListRandomState << 25;
+    tConcurrentSkipListRandomState ^= tConcurrentSkipListRandomState >> 27;
+    u64 bits = tConcurrentSkipListRandomState * 0x2545F4914F6CDD1DULL;
+    u32 height = 1;
+    while (height < SKIP_LIST_MAX_LEVEL && (bits & 3) == 0)
+    {
+        height++;
+        bits >>= 2;
+    }
+    return height;
+}
+
+#define SKIP_LIST_MARK 1ULL
+
+template <typename K, typename V> internal ConcurrentSkipListNode<K, V> *GetSkipListPointer(u64 next)
+{
+    return (ConcurrentSkipListNode<K, V> *)(next & ~SKIP_LIST_MARK);
+}
+
+// NOTE: not thread safe; the arena must outlive the list.
+template <typename K, typename V>
+internal void InitConcurrentSkipList(ConcurrentSkipList<K, V> *list, ConcurrentArena *arena)
+{
+    u64 size = sizeof(ConcurrentSkipListNode<K, V>) + (SKIP_LIST_MAX_LEVEL - 1) * sizeof(std::atomic<u64>);
+    list->head = (ConcurrentSkipListNode<K, V> *)ConcurrentArenaPush(arena, AlignUp(size, 64)).memory;
+    list->head->height = SKIP_LIST_MAX_LEVEL;
+    for (u32 i = 0; i < SKIP_LIST_MAX_LEVEL; i++)
+    {
+        list->head->next[i].store(0, std::memory_order_relaxed);
+    }
+    list->arena = arena;
+    list->count.store(0, std::memory_order_release);
+}
+
+// Finds, on every level, the last node whose key is less than the given one and its successor, unlinking the marked
+// nodes in between. Returns whether the successor at level 0 has the key.
+template <typename K, typename V>
+internal bool FindConcurrentSkipListNeighbours(ConcurrentSkipList<K, V> *list, K key,
+                                               ConcurrentSkipListNode<K, V> **predecessors,
+                                               ConcurrentSkipListNode<K, V> **successors)
+{
+retry:
+    ConcurrentSkipListNode<K, V> *predecessor = list->head;
+    for (s32 i = SKIP_LIST_MAX_LEVEL - 1; i >= 0; i--)
+    {
+        ConcurrentSkipListNode<K, V> *current =
+            GetSkipListPointer<K, V>(predecessor->next[i].load(std::memory_order_acquire));
+        while (current)
+        {
+            u64 successor = current->next[i].load(std::memory_order_acquire);
+            if (successor & SKIP_LIST_MARK)
             {
-                update[i] = list->header;
+                // The current node is being deleted, unlink it at this level. If the predecessor changed under us,
+                // e.g. because it is being deleted too, start over.
+                u64 expected = (u64)current;
+                if (!predecessor->next[i].compare_exchange_strong(expected, successor & ~SKIP_LIST_MARK,
+                                                                  std::memory_order_acq_rel))
+                {
+                    goto retry;
+                }
+                current = GetSkipListPointer<K, V>(successor);
             }
-            list->level = level;
+            else if (current->key < key)
+            {
+                predecessor = current;
+                current = GetSkipListPointer<K, V>(successor);
+            }
+            else
+            {
+                break;
+            }
+        }
+        predecessors[i] = predecessor;
+        successors[i] = current;
+    }
+    return successors[0] && !(key < successors[0]->key);
+}
+
+// Returns false, leaving the existing value alone, if the key is already present. Nodes are pushed through the
+// calling worker's chunk of the list's arena (see: ConcurrentArenaPushFromChunk()).
+template <typename K, typename V>
+internal bool ConcurrentSkipListInsert(ConcurrentSkipList<K, V> *list, K key, V value, ConcurrentArenaChunk *chunk)
+{
+    ConcurrentSkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+    ConcurrentSkipListNode<K, V> *successors[SKIP_LIST_MAX_LEVEL];
+    ConcurrentSkipListNode<K, V> *node = NULL;
+    while (true)
+    {
+        if (FindConcurrentSkipListNeighbours(list, key, predecessors, successors))
+        {
+            // NOTE: a node allocated by an earlier attempt is lost until the arena is cleared.
+            return false;
         }
-        x = CreateNode(level, key, value, arena);
-        for (s32 i = 0; i < level; i++)
+
+        if (node == NULL)
         {
-            x->forwardPtrs[i] = update[i]->forwardPtrs[i];
-            update[i]->forwardPtrs[i] = x;
+            u32 height = RandomConcurrentSkipListHeight();
+            u64 size = sizeof(ConcurrentSkipListNode<K, V>) + (height - 1) * sizeof(std::atomic<u64>);
+            node = (ConcurrentSkipListNode<K, V> *)ConcurrentArenaPushFromChunk(
+                list->arena, chunk, size, alignof(ConcurrentSkipListNode<K, V>));
+            node->key = key;
+            node->value = value;
+            node->height = height;
+        }
+        for (u32 i = 0; i < node->height; i++)
+        {
+            node->next[i].store((u64)successors[i], std::memory_order_relaxed);
+        }
+
+        // Linking level 0 puts the node in the map and publishes its contents.
+        u64 expected = (u64)successors[0];
+        if (predecessors[0]->next[0].compare_exchange_strong(expected, (u64)node, std::memory_order_release,
+                                                             std::memory_order_relaxed))
+        {
+            break;
         }
     }
+    list->count.fetch_add(1, std::memory_order_relaxed);
+
+    // The upper levels only speed up searches, so they can be linked lazily, and not at all if the node gets deleted
+    // in the meantime.
+    for (u32 i = 1; i < node->height; i++)
+    {
+        while (true)
+        {
+            u64 next = node->next[i].load(std::memory_order_acquire);
+            if (next & SKIP_LIST_MARK)
+            {
+                return true;
+            }
+            if (next != (u64)successors[i] &&
+                !node->next[i].compare_exchange_strong(next, (u64)successors[i], std::memory_order_acq_rel))
+            {
+                continue;
+            }
+            u64 expected = (u64)successors[i];
+            if (predecessors[i]->next[i].compare_exchange_strong(expected, (u64)node, std::memory_order_release,
+                                                                 std::memory_order_relaxed))
+            {
+                break;
+            }
+            FindConcurrentSkipListNeighbours(list, key, predecessors, successors);
+            if (successors[0] != node)
+            {
+                return true; // Deleted already.
+            }
+        }
+    }
+    return true;
 }
 
-glm::vec3 Search(SkipList *list, f32 key)
+// Returns NULL if the key isn't present. The value isn't synchronized beyond its insertion.
+template <typename K, typename V> internal V *ConcurrentSkipListFind(ConcurrentSkipList<K, V> *list, K key)
 {
-    SkipListNode *x = list->header;
-    for (s32 i = list->level - 1; i >= 0; i--)
+    // NOTE: unlike FindConcurrentSkipListNeighbours(), this only walks past marked nodes, so lookups don't write.
+    ConcurrentSkipListNode<K, V> *predecessor = list->head;
+    ConcurrentSkipListNode<K, V> *current = NULL;
+    for (s32 i = SKIP_LIST_MAX_LEVEL - 1; i >= 0; i--)
     {
-        while (x->forwardPtrs[i] && x->forwardPtrs[i]->key > key)
+        current = GetSkipListPointer<K, V>(predecessor->next[i].load(std::memory_order_acquire));
+        while (current)
         {
-            x = x->forwardPtrs[i];
+            u64 successor = current->next[i].load(std::memory_order_acquire);
+            if (!(successor & SKIP_LIST_MARK))
+            {
+                if (!(current->key < key))
+                {
+                    break;
+                }
+                predecessor = current;
+            }
+            current = GetSkipListPointer<K, V>(successor);
         }
     }
-    x = x->forwardPtrs[0];
-    if (x && x->key == key)
+    if (current && !(key < current->key))
+    {
+        return &current->value;
+    }
+    return NULL;
+}
+
+// Marks the node as deleted, top down. Returns true for the one thread whose mark on level 0 takes it out of the map.
+template <typename K, typename V> internal bool MarkConcurrentSkipListNode(ConcurrentSkipListNode<K, V> *node)
+{
+    for (s32 i = node->height - 1; i >= 1; i--)
     {
-        return x->value;
+        node->next[i].fetch_or(SKIP_LIST_MARK, std::memory_order_acq_rel);
     }
-    return glm::vec3();
+    u64 next = node->next[0].fetch_or(SKIP_LIST_MARK, std::memory_order_acq_rel);
+    return !(next & SKIP_LIST_MARK);
 }
 
-f32 GetKey(SkipList *list, u32 index)
+// Returns false if the key wasn't present, or another thread deleted it first.
+template <typename K, typename V> internal bool ConcurrentSkipListDelete(ConcurrentSkipList<K, V> *list, K key)
 {
-    u32 count = 0;
-    SkipListNode *curNode = list->header->forwardPtrs[0];
-    while (count++ < index)
+    ConcurrentSkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+    ConcurrentSkipListNode<K, V> *successors[SKIP_LIST_MAX_LEVEL];
+    if (!FindConcurrentSkipListNeighbours(list, key, predecessors, successors) ||
+        !MarkConcurrentSkipListNode(successors[0]))
     {
-        curNode = curNode->forwardPtrs[0];
+        return false;
     }
-    return curNode->key;
+    list->count.fetch_sub(1, std::memory_order_relaxed);
+    // Unlinks it.
+    FindConcurrentSkipListNeighbours(list, key, predecessors, successors);
+    return true;
 }
 
-glm::vec3 GetValue(SkipList *list, u32 index)
+//
+// Iteration in key order, skipping deleted nodes; only a snapshot if other threads are still modifying the list.
+//
+
+template <typename K, typename V> internal ConcurrentSkipListNode<K, V> *GetLiveConcurrentSkipListNode(u64 next)
 {
-    u32 count = 0;
-    SkipListNode *curNode = list->header->forwardPtrs[0];
-    while (count++ < index)
+    ConcurrentSkipListNode<K, V> *node = GetSkipListPointer<K, V>(next);
+    while (node && (node->next[0].load(std::memory_order_acquire) & SKIP_LIST_MARK))
     {
-        curNode = curNode->forwardPtrs[0];
+        node = GetSkipListPointer<K, V>(node->next[0].load(std::memory_order_acquire));
+    }
+    return node;
+}
+
+template <typename K, typename V>
+internal ConcurrentSkipListNode<K, V> *ConcurrentSkipListFirst(ConcurrentSkipList<K, V> *list)
+{
+    return GetLiveConcurrentSkipListNode<K, V>(list->head->next[0].load(std::memory_order_acquire));
+}
+
+template <typename K, typename V>
+internal ConcurrentSkipListNode<K, V> *ConcurrentSkipListNext(ConcurrentSkipListNode<K, V> *node)
+{
+    return GetLiveConcurrentSkipListNode<K, V>(node->next[0].load(std::memory_order_acquire));
+}
+
+//
+// Priority queue.
+//
+
+// Removes the smallest key, e.g. to use the list as a priority queue. Returns false if the list is empty.
+template <typename K, typename V>
+internal bool ConcurrentSkipListPopMin(ConcurrentSkipList<K, V> *list, K *key, V *value)
+{
+    while (true)
+    {
+        ConcurrentSkipListNode<K, V> *node = ConcurrentSkipListFirst(list);
+        if (node == NULL)
+        {
+            return false;
+        }
+        if (MarkConcurrentSkipListNode(node))
+        {
+            *key = node->key;
+            *value = node->value;
+            list->count.fetch_sub(1, std::memory_order_relaxed);
+            ConcurrentSkipListNode<K, V> *predecessors[SKIP_LIST_MAX_LEVEL];
+            ConcurrentSkipListNode<K, V> *successors[SKIP_LIST_MAX_LEVEL];
+            FindConcurrentSkipListNeighbours(list, node->key, predecessors, successors);
+            return true;
+        }
     }
-    return curNode->value;
 }
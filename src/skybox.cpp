@@ -1,6 +1,13 @@
 #include "common.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "texture.h"
 
-internal void CreateSkybox(TransientDrawingInfo *transientInfo)
+global_variable const char *gSkyboxImages[] = {"space_skybox/right.png",  "space_skybox/left.png",
+                                               "space_skybox/top.png",    "space_skybox/bottom.png",
+                                               "space_skybox/front.png",  "space_skybox/back.png"};
+
+internal u32 CreateSkyboxTexture(DecodedImage *faces)
 {
     u32 skyboxTexture;
     glGenTextures(1, &skyboxTexture);
@@ -8,19 +15,10 @@ internal void CreateSkybox(TransientDrawingInfo *transientInfo)
     char label[] = "Texture (cube map): skybox";
     glObjectLabel(GL_TEXTURE, skyboxTexture, -1, label);
 
-    const char *skyboxImages[] = {"space_skybox/right.png",  "space_skybox/left.png",  "space_skybox/top.png",
-                                  "space_skybox/bottom.png", "space_skybox/front.png", "space_skybox/back.png"};
-    stbi_set_flip_vertically_on_load_thread(false);
-    for (u32 i = 0; i < 6; i++)
+    for (u32 i = 0; i < myArraySize(gSkyboxImages); i++)
     {
-        s32 imageWidth;
-        s32 imageHeight;
-        s32 numChannels;
-        u8 *data = stbi_load(skyboxImages[i], &imageWidth, &imageHeight, &numChannels, 0);
-        myAssert(data);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA,
-                     GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, faces[i].width, faces[i].height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, faces[i].data);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -28,5 +26,49 @@ internal void CreateSkybox(TransientDrawingInfo *transientInfo)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    transientInfo->skyboxTexture = skyboxTexture;
-}
\ No newline at end of file
+    return skyboxTexture;
+}
+
+internal void UploadSkyboxJob(void *data, u32 begin, u32 end)
+{
+    AssetLoading *loading = (AssetLoading *)data;
+    TransientDrawingInfo *transientInfo = loading->transientInfo;
+    glDeleteTextures(1, &transientInfo->skyboxTexture);
+    transientInfo->skyboxTexture = CreateSkyboxTexture(loading->skyboxImages);
+    for (u32 i = 0; i < myArraySize(gSkyboxImages); i++)
+    {
+        FreeDecodedImage(&loading->skyboxImages[i]);
+    }
+}
+
+internal void DecodeSkyboxImagesJob(void *data, u32 begin, u32 end)
+{
+    DecodedImage *images = (DecodedImage *)data;
+    for (u32 i = begin; i < end; i++)
+    {
+        images[i] = DecodeImage(gSkyboxImages[i], false);
+    }
+}
+
+internal void LoadSkyboxJob(void *data, u32 begin, u32 end)
+{
+    AssetLoading *loading = (AssetLoading *)data;
+    ParallelFor(gJobSystem, myArraySize(gSkyboxImages), 1, DecodeSkyboxImagesJob, loading->skyboxImages,
+                "Decode skybox");
+    PushGLJob(gJobSystem, UploadSkyboxJob, loading, &loading->counter, "Upload skybox");
+}
+
+// Starts with a black skybox, and streams the actual one in (see: AssetLoading).
+internal void CreateSkybox(TransientDrawingInfo *transientInfo, AssetLoading *loading)
+{
+    u8 black[4] = {0, 0, 0, 255};
+    DecodedImage placeholder[myArraySize(gSkyboxImages)];
+    for (u32 i = 0; i < myArraySize(gSkyboxImages); i++)
+    {
+        placeholder[i] = {black, 1, 1, 4};
+    }
+    transientInfo->skyboxTexture = CreateSkyboxTexture(placeholder);
+
+    static_assert(myArraySize(gSkyboxImages) == myArraySize(loading->skyboxImages), "one image per face");
+    PushJob(gJobSystem, LoadSkyboxJob, loading, &loading->counter, "Load skybox");
+}
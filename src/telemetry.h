@@ -0,0 +1,148 @@
+#pragma once
+
+#include "common.h"
+
+/***********************************************************************************************************************
+ *
+ * Frame timing telemetry: per-category log-bucketed histograms (see: TimingHistogram in common.h), recorded by the
+ * platform layer every frame, displayed by the game DLL's overlay and dumped to a file on exit.
+ *
+ **********************************************************************************************************************/
+
+internal const char *GetFrameTimingCategoryName(FrameTimingCategory category)
+{
+    switch (category)
+    {
+    case FrameTimingCategory::Frame:
+        return "Frame";
+    case FrameTimingCategory::MessagePump:
+        return "Message pump";
+    case FrameTimingCategory::Game:
+        return "Game";
+    case FrameTimingCategory::RenderSubmit:
+        return "Render submit";
+    case FrameTimingCategory::Swap:
+        return "Swap/vsync wait";
+    case FrameTimingCategory::InputLatency:
+        return "Input latency";
+    case FrameTimingCategory::Count:
+        break;
+    }
+    myAssert(false);
+    return "";
+}
+
+internal u32 GetTimingBucket(u64 microseconds)
+{
+    if (microseconds < TIMING_SUB_BUCKETS)
+    {
+        return (u32)microseconds;
+    }
+    microseconds = intMin(microseconds, (u64)0xffffffff);
+    u32 msb = FindMostSignificantBit(microseconds);
+    u32 shift = msb - TIMING_SUB_BUCKET_BITS;
+    u32 subBucket = (u32)(microseconds >> shift) & (TIMING_SUB_BUCKETS - 1);
+    return (shift + 1) * TIMING_SUB_BUCKETS + subBucket;
+}
+
+// Returns the smallest duration in microseconds that falls into the given bucket.
+internal u64 GetTimingBucketLowerBound(u32 bucket)
+{
+    if (bucket < TIMING_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    u32 shift = bucket / TIMING_SUB_BUCKETS - 1;
+    u64 subBucket = bucket % TIMING_SUB_BUCKETS;
+    return (TIMING_SUB_BUCKETS + subBucket) << shift;
+}
+
+internal void RecordTiming(TimingHistogram *histogram, f32 ms)
+{
+    u64 microseconds = (u64)(fmax(ms, 0.f) * 1000.f);
+    histogram->counts[GetTimingBucket(microseconds)]++;
+    histogram->totalCount++;
+    histogram->totalMs += ms;
+    histogram->maxMs = fmax(histogram->maxMs, ms);
+}
+
+// Returns the upper bound of the bucket holding the given percentile (in [0, 1]), in milliseconds; never reports more
+// than the maximum actually recorded.
+internal f32 GetTimingPercentile(TimingHistogram *histogram, f32 percentile)
+{
+    if (histogram->totalCount == 0)
+    {
+        return 0.f;
+    }
+
+    u64 rank = (u64)ceil(percentile * histogram->totalCount);
+    rank = clamp(rank, (u64)1, histogram->totalCount);
+    u64 cumulative = 0;
+    for (u32 bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+    {
+        cumulative += histogram->counts[bucket];
+        if (cumulative >= rank)
+        {
+            f32 upperBoundMs = GetTimingBucketLowerBound(bucket + 1) / 1000.f;
+            return fmin(upperBoundMs, histogram->maxMs);
+        }
+    }
+    return histogram->maxMs;
+}
+
+internal void RecordFrameTiming(FrameTelemetry *telemetry, FrameTimingCategory category, f32 ms)
+{
+    RecordTiming(&telemetry->histograms[(u32)category], ms);
+    telemetry->lastMs[(u32)category] = ms;
+
+    if (category == FrameTimingCategory::Frame)
+    {
+        telemetry->frameHistory[telemetry->frameHistoryIndex] = ms;
+        telemetry->frameHistoryIndex = (telemetry->frameHistoryIndex + 1) % FRAME_TIMING_HISTORY;
+    }
+}
+
+internal void ResetFrameTelemetry(FrameTelemetry *telemetry)
+{
+    memset(telemetry->histograms, 0, sizeof(telemetry->histograms));
+}
+
+internal bool DumpFrameTelemetry(FrameTelemetry *telemetry, const char *filename)
+{
+    FILE *file;
+    if (fopen_s(&file, filename, "w") != 0)
+    {
+        return false;
+    }
+
+    fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s\n", "category", "count", "mean_ms", "p50_ms", "p95_ms", "p99_ms",
+            "max_ms");
+    for (u32 i = 0; i < (u32)FrameTimingCategory::Count; i++)
+    {
+        TimingHistogram *histogram = &telemetry->histograms[i];
+        f64 mean = histogram->totalCount ? histogram->totalMs / histogram->totalCount : 0.0;
+        fprintf(file, "%-16s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                GetFrameTimingCategoryName((FrameTimingCategory)i), (unsigned long long)histogram->totalCount, mean,
+                GetTimingPercentile(histogram, .5f), GetTimingPercentile(histogram, .95f),
+                GetTimingPercentile(histogram, .99f), histogram->maxMs);
+    }
+
+    // Raw histograms, so that distributions can be compared across runs.
+    for (u32 i = 0; i < (u32)FrameTimingCategory::Count; i++)
+    {
+        TimingHistogram *histogram = &telemetry->histograms[i];
+        fprintf(file, "\n%s histogram (bucket lower bound in us: count)\n",
+                GetFrameTimingCategoryName((FrameTimingCategory)i));
+        for (u32 bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+        {
+            if (histogram->counts[bucket] > 0)
+            {
+                fprintf(file, "%llu: %u\n", (unsigned long long)GetTimingBucketLowerBound(bucket),
+                        histogram->counts[bucket]);
+            }
+        }
+    }
+
+    fclose(file);
+    return true;
+}
@@ -1,15 +1,31 @@
 #include "texture.h"
 #include "arena.h"
 #include "common.h"
+#include "hashmap.h"
 
-internal u32 CreateTextureFromImage(const char *filename, bool sRGB, GLenum wrapMode = GL_REPEAT)
+// Thread-safe: doesn't touch OpenGL.
+internal DecodedImage DecodeImage(const char *filename, bool flipVertically)
+{
+    DecodedImage result = {};
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    result.data = stbi_load(filename, &result.width, &result.height, &result.numChannels, 0);
+    myAssert(result.data);
+    return result;
+}
+
+internal void FreeDecodedImage(DecodedImage *image)
+{
+    stbi_image_free(image->data);
+    image->data = NULL;
+}
+
+// Uploads the image into a new texture, and frees it.
+internal u32 CreateTextureFromDecodedImage(DecodedImage *image, const char *filename, bool sRGB, GLenum wrapMode)
 {
-    s32 width;
-    s32 height;
-    s32 numChannels;
-    stbi_set_flip_vertically_on_load_thread(true);
-    uchar *textureData = stbi_load(filename, &width, &height, &numChannels, 0);
-    myAssert(textureData);
+    s32 width = image->width;
+    s32 height = image->height;
+    s32 numChannels = image->numChannels;
+    uchar *textureData = image->data;
 
     u32 texture;
     glCreateTextures(GL_TEXTURE_2D, 1, &texture);
@@ -39,11 +55,29 @@ internal u32 CreateTextureFromImage(const char *filename, bool sRGB, GLenum wrap
     }
     glGenerateTextureMipmap(texture);
 
-    stbi_image_free(textureData);
+    FreeDecodedImage(image);
 
     return texture;
 }
 
+internal u32 CreateTextureFromImage(const char *filename, bool sRGB, GLenum wrapMode = GL_REPEAT)
+{
+    DecodedImage image = DecodeImage(filename, true);
+    return CreateTextureFromDecodedImage(&image, filename, sRGB, wrapMode);
+}
+
+internal void DecodeImageJob(void *data, u32 begin, u32 end)
+{
+    ImageLoad *load = (ImageLoad *)data;
+    load->image = DecodeImage(load->path, true);
+}
+
+internal void UploadImageJob(void *data, u32 begin, u32 end)
+{
+    ImageLoad *load = (ImageLoad *)data;
+    load->texture = CreateTextureFromDecodedImage(&load->image, load->path, load->sRGB);
+}
+
 internal TextureType GetTextureTypeFromAssimp(aiTextureType type)
 {
     if (type == aiTextureType_DIFFUSE)
@@ -66,39 +100,25 @@ internal TextureType GetTextureTypeFromAssimp(aiTextureType type)
     return TextureType::Diffuse;
 }
 
-internal void LoadTextures(Mesh *mesh, Texture *texture, u64 num, aiMaterial *material, aiTextureType type,
-                           Arena *arena, LoadedTextures *loadedTextures)
+// Starts decoding the image on the job system, unless another of the model's meshes already did. The texture only gets
+// its ID once the image is uploaded (see: UploadModelJob()).
+internal void LoadTexture(Texture *texture, const char *path, TextureType type, LoadedTextures *loadedTextures,
+                          Arena *arena)
 {
-    myAssert(num <= 1); // NOTE: for now we only handle one texture per texture type.
-    for (u32 i = 0; i < num; i++)
+    u64 length = strlen(path);
+    u64 hash = fnv1a((u8 *)path, length);
+    texture->type = type;
+    texture->hash = hash;
+    if (!HashMapFind(&loadedTextures->imageIndices, hash))
     {
-        aiString path;
-        material->GetTexture(type, i, &path);
-        u64 hash = fnv1a((u8 *)path.C_Str(), strlen(path.C_Str()));
-        bool skip = false;
-        for (u32 j = 0; j < loadedTextures->numTextures; j++)
-        {
-            if (loadedTextures->textures[j].hash == hash)
-            {
-                texture->id = loadedTextures->textures[j].id;
-                texture->type = loadedTextures->textures[j].type;
-                texture->hash = hash;
-                skip = true;
-                break;
-            }
-        }
-        if (!skip)
-        {
-            Texture *newTexture = (Texture *)ArenaPush(arena, sizeof(Texture));
-            newTexture->id = CreateTextureFromImage(path.C_Str(), type == aiTextureType_DIFFUSE);
-            newTexture->type = GetTextureTypeFromAssimp(type);
-            newTexture->hash = hash;
-            texture->id = newTexture->id;
-            texture->type = newTexture->type;
-            texture->hash = newTexture->hash;
-            loadedTextures->textures[loadedTextures->numTextures++] = *newTexture;
-        }
-        mesh->numTextures++;
+        myAssert(loadedTextures->numImages < loadedTextures->maxImages);
+        ImageLoad *image = &loadedTextures->images[loadedTextures->numImages];
+        image->path = PushArray<char>(arena, length + 1);
+        memcpy(image->path, path, length + 1);
+        image->sRGB = (type == TextureType::Diffuse);
+        HashMapInsert(&loadedTextures->imageIndices, hash, loadedTextures->numImages);
+        loadedTextures->numImages++;
+        PushJob(gJobSystem, DecodeImageJob, image, &loadedTextures->decoded, "Decode image");
     }
 }
 
@@ -142,6 +162,19 @@ internal Texture CreateTexture(const char *filename, TextureType type, GLenum wr
     return result;
 }
 
+// A single texel, e.g. for placeholders while the actual textures stream in.
+internal Texture CreateSolidColorTexture(u8 r, u8 g, u8 b, TextureType type, const char *label)
+{
+    Texture result = {};
+    u8 texel[4] = {r, g, b, 255};
+    glCreateTextures(GL_TEXTURE_2D, 1, &result.id);
+    glObjectLabel(GL_TEXTURE, result.id, -1, label);
+    glTextureStorage2D(result.id, 1, GL_RGBA8, 1, 1);
+    glTextureSubImage2D(result.id, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    result.type = type;
+    return result;
+}
+
 internal Material CreateTextures(const char *diffusePath, const char *specularPath = "", const char *normalsPath = "",
                                  const char *displacementPath = "")
 {
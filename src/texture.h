@@ -1,13 +1,42 @@
 #pragma once
 
 #include "common.h"
+#include "jobs.h"
 
+// Pixels decoded by stb_image, until CreateTextureFromDecodedImage() uploads and frees them.
+struct DecodedImage
+{
+    u8 *data;
+    s32 width;
+    s32 height;
+    s32 numChannels;
+};
+
+// An image which a model uses, decoded on the job system and uploaded along with the model (see: UploadModelJob()).
+struct ImageLoad
+{
+    char *path;
+    bool sRGB;
+    DecodedImage image;
+    u32 texture;
+};
+
+// The images a model loads, each only once however many of its meshes use it.
 struct LoadedTextures
 {
-    Texture *textures;
-    u32 numTextures;
+    HashMap<u64, u32> imageIndices; // By fnv1a() hash of the path.
+    ImageLoad *images;
+    u32 numImages;
+    u32 maxImages;
+    JobCounter decoded; // Counts the images still being decoded.
 };
 
-internal void LoadTextures(Mesh *mesh, Texture *texture, u64 num, aiMaterial *material, aiTextureType type,
-                           struct Arena *arena, LoadedTextures *loadedTextures);
+internal DecodedImage DecodeImage(const char *filename, bool flipVertically);
+internal void FreeDecodedImage(DecodedImage *image);
+internal u32 CreateTextureFromDecodedImage(DecodedImage *image, const char *filename, bool sRGB,
+                                           GLenum wrapMode = GL_REPEAT);
+internal void UploadImageJob(void *data, u32 begin, u32 end);
+internal TextureType GetTextureTypeFromAssimp(aiTextureType type);
+internal void LoadTexture(Texture *texture, const char *path, TextureType type, LoadedTextures *loadedTextures,
+                          Arena *arena);
 internal TextureHandles CreateTextureHandlesFromMaterial(Material *material);
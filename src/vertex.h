@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common.h"
+
+/***********************************************************************************************************************
+ *
+ * Packed vertices: what vertex buffers hold, 20 bytes where a Vertex takes 56, unpacked by the vertex shaders.
+ *
+ * The position stays a full vec3, so that positions remain exact and the depth-only passes read them as before. The
+ * normal is octahedral-encoded; the tangent, being orthogonal to it, only needs its angle around it, measured in a
+ * basis built from the normal; the bitangent only needs its sign, the shaders rebuilding it as cross(normal, tangent).
+ * All three go in one GL_INT_2_10_10_10_REV, and the texture coordinates are half floats.
+ *
+ * NOTE: the shaders which read the tangent frame mirror OctahedralDecode() and GetOrthonormalBasis() (see:
+ * gbuffer.vs), which have to stay in sync with them.
+ *
+ **********************************************************************************************************************/
+
+struct PackedVertex
+{
+    glm::vec3 position;
+    u32 tangentFrame; // Normal (x, y), tangent angle (z) and bitangent sign (w), as signed normalized 10:10:10:2.
+    u32 texCoords;    // Two half floats.
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex is tightly packed");
+
+// Maps the unit sphere onto the [-1, 1] square: the upper hemisphere onto the inner diamond, the lower one folded
+// over the corners.
+internal glm::vec2 OctahedralEncode(glm::vec3 n)
+{
+    f32 l1Norm = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if (l1Norm == 0.f)
+    {
+        return glm::vec2(0.f);
+    }
+    n /= l1Norm;
+    glm::vec2 result = glm::vec2(n.x, n.y);
+    if (n.z < 0.f)
+    {
+        result.x = (1.f - fabsf(n.y)) * ((n.x >= 0.f) ? 1.f : -1.f);
+        result.y = (1.f - fabsf(n.x)) * ((n.y >= 0.f) ? 1.f : -1.f);
+    }
+    return result;
+}
+
+internal glm::vec3 OctahedralDecode(glm::vec2 e)
+{
+    glm::vec3 n = glm::vec3(e.x, e.y, 1.f - fabsf(e.x) - fabsf(e.y));
+    f32 t = fmaxf(-n.z, 0.f);
+    n.x += (n.x >= 0.f) ? -t : t;
+    n.y += (n.y >= 0.f) ? -t : t;
+    return glm::normalize(n);
+}
+
+// Branchless orthonormal basis around a unit vector (Duff et al., "Building an Orthonormal Basis, Revisited").
+internal void GetOrthonormalBasis(glm::vec3 n, glm::vec3 *b1, glm::vec3 *b2)
+{
+    f32 sign = (n.z >= 0.f) ? 1.f : -1.f;
+    f32 a = -1.f / (sign + n.z);
+    f32 b = n.x * n.y * a;
+    *b1 = glm::vec3(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    *b2 = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+}
+
+internal u32 PackTangentFrame(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent)
+{
+    glm::vec2 octNormal = OctahedralEncode(normal);
+    // The tangent's angle is measured around the normal which the shaders will decode, rather than the exact one.
+    glm::vec4 quantizedNormal = glm::unpackSnorm3x10_1x2(glm::packSnorm3x10_1x2(glm::vec4(octNormal, 0.f, 0.f)));
+    glm::vec3 b1, b2;
+    GetOrthonormalBasis(OctahedralDecode(glm::vec2(quantizedNormal)), &b1, &b2);
+    f32 angle = atan2f(glm::dot(tangent, b2), glm::dot(tangent, b1));
+    f32 sign = (glm::dot(glm::cross(normal, tangent), bitangent) < 0.f) ? -1.f : 1.f;
+    return glm::packSnorm3x10_1x2(glm::vec4(octNormal, angle / PI, sign));
+}
+
+internal void UnpackTangentFrame(u32 tangentFrame, glm::vec3 *normal, glm::vec3 *tangent, f32 *sign)
+{
+    glm::vec4 frame = glm::unpackSnorm3x10_1x2(tangentFrame);
+    *normal = OctahedralDecode(glm::vec2(frame));
+    glm::vec3 b1, b2;
+    GetOrthonormalBasis(*normal, &b1, &b2);
+    f32 angle = frame.z * PI;
+    *tangent = cosf(angle) * b1 + sinf(angle) * b2;
+    *sign = frame.w;
+}
+
+internal PackedVertex PackVertex(Vertex *vertex)
+{
+    PackedVertex result;
+    result.position = vertex->position;
+    result.tangentFrame = PackTangentFrame(vertex->normal, vertex->tangent, vertex->bitangent);
+    result.texCoords = glm::packHalf2x16(vertex->texCoords);
+    return result;
+}